@@ -0,0 +1,329 @@
+/**
+ * @file bench_efivar.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file measures variable store access through firmware.h against each backend that runs here.
+ *
+ * Both stores are filled with the same variables: NVARS vendor variables of 8 to 500 bytes, and a few
+ * Boot#### load options. The efivarfs backend works on a temporary directory laid out as efivarfs (so it
+ * measures the library and the file system, not the firmware), and the emulator on a store in memory
+ * without latency. Set `AST_BENCH_EFIVARFS` to a real efivarfs mount to time enumeration there too.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <unistd.h>
+#include "../src/arena/arena.h"
+#include "../src/firmware/firmware.h"
+#include "../src/firmware/backend.h"
+#include "../src/loadopt/slot.h"
+#include "../src/watch/watch.h"
+#include "harness.h"
+
+#define NVARS    256
+#define NOPTIONS 16
+#define BATCH    16
+#define MAXSIZE  512
+
+static const ast_guid _bench_vendor = AST_GUID_INIT (0x5ee1b4c3, 0x2f6a, 0x4d1e, 0x9a, 0x5b, 0x41, 0x53, 0x54, 0x42, 0x45, 0x4e);
+static const ast_guid _bench_global = AST_GUID_EFI_GLOBAL;
+
+/** Argument of _bench_op_enumerate. */
+struct _bench_enum {
+    unsigned int flags;   /**< ast_efivar_iter_open flags */
+    size_t       minVars; /**< Fewer variables than this is a failure */
+};
+
+static char    _bench_names[NVARS][16];
+static size_t  _bench_sizes[NVARS];
+static uint8_t _bench_values[2][MAXSIZE];
+static size_t  _bench_checksum;
+
+static void _bench_setup_names (void)
+{
+    for (int i = 0; i < NVARS; i++) {
+        snprintf (_bench_names[i], sizeof (_bench_names[i]), "Bench%04X", i);
+        _bench_sizes[i] = 8 + (size_t) (i * 37) % (MAXSIZE - 12);
+    }
+    for (int i = 0; i < MAXSIZE; i++) {
+        _bench_values[0][i] = (uint8_t) i;
+        _bench_values[1][i] = (uint8_t) ~i;
+    }
+}
+
+static int _bench_populate (void)
+{
+    uint8_t option[64];
+
+    for (int i = 0; i < NVARS; i++) {
+        if (ast_write_efivar_guid (_bench_values[0], _bench_sizes[i], &_bench_vendor, _bench_names[i], AST_EFIVAR_DEFAULT_ATTRIBUTES) != AST_RETURN_SUCCESS) {
+            return 1;
+        }
+    }
+    memset (option, 0x7F, sizeof (option));
+    for (int i = 0; i < NOPTIONS; i++) {
+        char name[16];
+
+        snprintf (name, sizeof (name), "Boot%04X", i * 3);
+        if (ast_write_efivar_guid (option, sizeof (option), &_bench_global, name, AST_EFIVAR_DEFAULT_ATTRIBUTES) != AST_RETURN_SUCCESS) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void _bench_rmdir (const char *dir)
+{
+    DIR *d = opendir (dir);
+    struct dirent *ent = NULL;
+    char path[4096];
+
+    if (d == NULL) {
+        return;
+    }
+    while ((ent = readdir (d)) != NULL) {
+        if (ent->d_name[0] != '.') {
+            snprintf (path, sizeof (path), "%s/%s", dir, ent->d_name);
+            unlink (path);
+        }
+    }
+    closedir (d);
+    rmdir (dir);
+}
+
+static int _bench_op_read (void *arg, size_t i)
+{
+    uint8_t buf[MAXSIZE];
+    size_t n = 0;
+
+    i %= NVARS;
+    if (ast_read_efivar_guid (buf, sizeof (buf), &_bench_vendor, _bench_names[i], &n, (arg != NULL) ? (uint32_t *) arg : NULL) != AST_RETURN_SUCCESS) {
+        return 1;
+    }
+    _bench_checksum += n;
+    return 0;
+}
+
+static int _bench_op_read_alloc (void *arg, size_t i)
+{
+    struct ast_arena arena;
+    void *data = NULL;
+    size_t n = 0;
+
+    (void) arg;
+    ast_arena_init (&arena, 0);
+    if (ast_read_efivar_alloc (&arena, &_bench_vendor, _bench_names[i % NVARS], &data, &n, NULL) != AST_RETURN_SUCCESS) {
+        ast_arena_free (&arena);
+        return 1;
+    }
+    _bench_checksum += n;
+    ast_arena_free (&arena);
+    return 0;
+}
+
+static int _bench_op_batch (void *arg, size_t i)
+{
+    static uint8_t bufs[BATCH][MAXSIZE];
+    ast_var_request reqs[BATCH];
+    ast_var_result  results[BATCH];
+
+    (void) arg;
+    for (int k = 0; k < BATCH; k++) {
+        reqs[k].guid     = &_bench_vendor;
+        reqs[k].name     = _bench_names[(i * BATCH + k) % NVARS];
+        reqs[k].buf      = bufs[k];
+        reqs[k].bufSiz   = MAXSIZE;
+        reqs[k].withAttr = 0;
+    }
+    if (ast_read_efivars_batch (reqs, BATCH, results) != AST_RETURN_SUCCESS) {
+        return 1;
+    }
+    for (int k = 0; k < BATCH; k++) {
+        if (results[k].status != AST_RETURN_SUCCESS) {
+            return 1;
+        }
+        _bench_checksum += results[k].nBytes;
+    }
+    return 0;
+}
+
+static int _bench_op_enumerate (void *arg, size_t i)
+{
+    const struct _bench_enum *e = arg;
+    struct ast_efivar_iter *iter = NULL;
+    struct ast_efivar_info infos[32];
+    size_t n = 0, total = 0;
+
+    (void) i;
+    if (ast_efivar_iter_open (&iter, e->flags) != AST_RETURN_SUCCESS) {
+        return 1;
+    }
+    do {
+        if (ast_efivar_iter_next (iter, infos, 32, &n) != AST_RETURN_SUCCESS) {
+            ast_efivar_iter_close (iter);
+            return 1;
+        }
+        total += n;
+    } while (n != 0);
+    ast_efivar_iter_close (iter);
+    _bench_checksum += total;
+    return (total < e->minVars) ? 1 : 0;
+}
+
+static int _bench_op_update_unchanged (void *arg, size_t i)
+{
+    int changed = 0;
+
+    (void) arg;
+    i %= NVARS;
+    if (ast_update_efivar_guid (_bench_values[0], _bench_sizes[i], &_bench_vendor, _bench_names[i], AST_EFIVAR_DEFAULT_ATTRIBUTES, &changed) != AST_RETURN_SUCCESS) {
+        return 1;
+    }
+    return changed;
+}
+
+static int _bench_op_write (void *arg, size_t i)
+{
+    // Alternate between two values so that every call really writes.
+    (void) arg;
+    return ast_write_efivar_guid (_bench_values[(i / NVARS + 1) & 1], _bench_sizes[i % NVARS], &_bench_vendor, _bench_names[i % NVARS],
+                                  AST_EFIVAR_DEFAULT_ATTRIBUTES) != AST_RETURN_SUCCESS;
+}
+
+static int _bench_op_slot_scan (void *arg, size_t i)
+{
+    struct ast_slot_map *map = arg;
+
+    (void) i;
+    memset (map, 0, sizeof (*map));
+    return ast_slot_map_scan (map) != AST_RETURN_SUCCESS;
+}
+
+static int _bench_op_firmware_info (void *arg, size_t i)
+{
+    struct ast_firmware_info info;
+
+    (void) arg;
+    (void) i;
+    if (ast_get_firmware_info (&info) != AST_RETURN_SUCCESS) {
+        return 1;
+    }
+    _bench_checksum += info.type;
+    return 0;
+}
+
+static int _bench_op_watch_check (void *arg, size_t i)
+{
+    size_t n = 0;
+
+    // Nothing changes while measuring: a check finding anything is a failure.
+    (void) i;
+    if (ast_efivar_watch_wait (arg, 0, NULL, NULL, &n) != AST_RETURN_SUCCESS) {
+        return 1;
+    }
+    return n != 0;
+}
+
+static void _bench_watch (const char *backend, unsigned int flags)
+{
+    struct ast_efivar_watch *watch = NULL;
+
+    // Checking the store for changes: one enumeration when polling, one syscall with inotify.
+    if (ast_efivar_watch_open (&watch, flags) == AST_RETURN_SUCCESS) {
+        bench_case ((ast_efivar_watch_fd (watch) >= 0) ? "watch_check_inotify" : "watch_check_poll", backend, _bench_op_watch_check, watch, NULL);
+        ast_efivar_watch_close (watch);
+    }
+}
+
+static void _bench_run (const char *backend)
+{
+    uint32_t attr = 0;
+    struct _bench_enum names = {0, NVARS + NOPTIONS};
+    struct _bench_enum attrs = {AST_EFIVAR_ITER_ATTRIBUTES, NVARS + NOPTIONS};
+    struct ast_slot_map *map = ast_slot_map_new ();
+
+    bench_case ("read", backend, _bench_op_read, NULL, NULL);
+    bench_case ("read_attr", backend, _bench_op_read, &attr, NULL);
+    bench_case ("read_alloc", backend, _bench_op_read_alloc, NULL, NULL);
+    bench_case ("batch16", backend, _bench_op_batch, NULL, NULL);
+    bench_case ("enumerate", backend, _bench_op_enumerate, &names, NULL);
+    bench_case ("enumerate_attr", backend, _bench_op_enumerate, &attrs, NULL);
+    if (map != NULL) {
+        bench_case ("slot_scan", backend, _bench_op_slot_scan, map, NULL);
+        ast_slot_map_free (map);
+    }
+    _bench_watch (backend, AST_EFIVAR_WATCH_POLL);
+    if (strcmp (backend, "efivarfs") == 0) {
+        _bench_watch (backend, 0);
+    }
+    bench_case ("update_unchanged", backend, _bench_op_update_unchanged, NULL, NULL);
+    bench_case ("write", backend, _bench_op_write, NULL, NULL);
+}
+
+int main (void)
+{
+    struct ast_efivar_backend *backend = NULL;
+    struct ast_efivar_emu_config config = {0};
+    char dir[] = "/tmp/ast-bench-XXXXXX";
+    int ret = 0;
+
+    _bench_setup_names ();
+    bench_init ("efivar");
+
+    // Detected on the first call; a health check polling it only copies the cached answer.
+    bench_case ("firmware_info", NULL, _bench_op_firmware_info, NULL, NULL);
+
+    if (mkdtemp (dir) == NULL) {
+        fprintf (stderr, "efivar: cannot create a temporary directory.\n");
+        return 1;
+    }
+    backend = ast_efivar_backend_efivarfs_new (dir);
+    ast_efivar_backend_set (backend);
+    if ((backend == NULL) || (_bench_populate () != 0)) {
+        fprintf (stderr, "efivar: cannot fill %s.\n", dir);
+        ret = 1;
+    } else {
+        _bench_run ("efivarfs");
+    }
+    ast_efivar_backend_set (NULL);
+    ast_efivar_backend_free (backend);
+    _bench_rmdir (dir);
+
+    // Room for the variables many times over, so that writes reclaim now and then as on a real store.
+    config.storeSiz = 1024 * 1024;
+    backend = ast_efivar_backend_emu_new (NULL, &config);
+    ast_efivar_backend_set (backend);
+    if ((backend == NULL) || (_bench_populate () != 0)) {
+        fprintf (stderr, "efivar: cannot fill an emulated store.\n");
+        ret = 1;
+    } else {
+        _bench_run ("emu");
+    }
+    ast_efivar_backend_set (NULL);
+    ast_efivar_backend_free (backend);
+
+    if (getenv ("AST_BENCH_EFIVARFS") != NULL) {
+        backend = ast_efivar_backend_efivarfs_new (getenv ("AST_BENCH_EFIVARFS"));
+        ast_efivar_backend_set (backend);
+        // Only the cases that do not need the benchmark's own variables.
+        if (backend != NULL) {
+            struct _bench_enum names = {0, 0};
+            struct ast_slot_map *map = ast_slot_map_new ();
+
+            bench_case ("enumerate", "efivarfs-host", _bench_op_enumerate, &names, NULL);
+            if (map != NULL) {
+                bench_case ("slot_scan", "efivarfs-host", _bench_op_slot_scan, map, NULL);
+                ast_slot_map_free (map);
+            }
+        }
+        ast_efivar_backend_set (NULL);
+        ast_efivar_backend_free (backend);
+    }
+
+    return bench_finish () | ret;
+}
@@ -0,0 +1,250 @@
+/**
+ * @file bench_fat.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file measures the FAT reader on a FAT16 image holding `\EFI\AST\astg2x64.efi` (IMAGE_SIZE bytes)
+ * and NFILES long-named files beside it: opening the volume, looking a path up, checking every path with
+ * one volume and with one volume per path, and streaming the image.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/fat/fat.h"
+#include "../src/firmware/firmware.h"
+#include "harness.h"
+
+#define SECTOR       512
+#define NSECTORS     4400
+#define FAT_SECTORS  18
+#define ROOT_ENTRIES 512
+#define DATA_SECTOR  (1 + 2 * FAT_SECTORS + ROOT_ENTRIES * 32 / SECTOR)
+#define NFILES       32
+#define AST_CLUSTERS 7
+#define AST_DIR      "\\EFI\\AST\\"
+#define IMAGE_SIZE   (1 << 20)
+
+static const char *_bench_path = "bench_fat.img";
+static char _bench_names[NFILES][64];
+
+static void _bench_put16 (uint8_t *p, unsigned int v)
+{
+    p[0] = (uint8_t) v;
+    p[1] = (uint8_t) (v >> 8);
+}
+
+static void _bench_put32 (uint8_t *p, uint32_t v)
+{
+    _bench_put16 (p, v & 0xffff);
+    _bench_put16 (p + 2, v >> 16);
+}
+
+static uint8_t *_bench_dirent (uint8_t *e, const char *shortName, uint8_t attributes, uint8_t nt, uint16_t cluster, uint32_t size)
+{
+    memcpy (e, shortName, 11);
+    e[11] = attributes;
+    e[12] = nt;
+    _bench_put16 (e + 26, cluster);
+    _bench_put32 (e + 28, size);
+    return e + 32;
+}
+
+/** Two long name entries (up to 26 characters) and the short entry. */
+static uint8_t *_bench_long (uint8_t *e, const char *name, const char *shortName)
+{
+    static const int offsets[13] = { 1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30 };
+    size_t len = strlen (name);
+    uint8_t sum = 0;
+
+    for (int i = 0; i < 11; i++) {
+        sum = (uint8_t) (((sum & 1) << 7) + (sum >> 1) + (uint8_t) shortName[i]);
+    }
+    for (int ord = 2; ord >= 1; ord--) {
+        e[0]  = (uint8_t) (ord | ((ord == 2) ? 0x40 : 0));
+        e[11] = 0x0f;
+        e[13] = sum;
+        for (int k = 0; k < 13; k++) {
+            size_t c = (size_t) (ord - 1) * 13 + (size_t) k;
+
+            _bench_put16 (e + offsets[k], (c < len) ? (uint8_t) name[c] : (c == len) ? 0 : 0xffff);
+        }
+        e += 32;
+    }
+    return _bench_dirent (e, shortName, 0x20, 0, 0, 0);
+}
+
+static uint8_t *_bench_volume (void)
+{
+    uint8_t *v = calloc (NSECTORS, SECTOR);
+    uint8_t *fat = NULL, *e = NULL;
+    uint32_t imageCluster = 3 + AST_CLUSTERS;
+
+    if (v == NULL) {
+        return NULL;
+    }
+    v[0] = 0xeb;
+    v[1] = 0x3c;
+    v[2] = 0x90;
+    _bench_put16 (v + 11, SECTOR);
+    v[13] = 1;
+    _bench_put16 (v + 14, 1);
+    v[16] = 2;
+    _bench_put16 (v + 17, ROOT_ENTRIES);
+    _bench_put16 (v + 19, NSECTORS);
+    v[21] = 0xf8;
+    _bench_put16 (v + 22, FAT_SECTORS);
+    v[510] = 0x55;
+    v[511] = 0xaa;
+
+    // Cluster 2: \EFI; 3 to 9: \EFI\AST; then the image, in one run.
+    fat = v + SECTOR;
+    _bench_put16 (fat, 0xfff8);
+    _bench_put16 (fat + 2, 0xffff);
+    _bench_put16 (fat + 4, 0xffff);
+    for (uint32_t c = 3; c < imageCluster + IMAGE_SIZE / SECTOR; c++) {
+        int last = (c == 2 + AST_CLUSTERS) || (c == imageCluster + IMAGE_SIZE / SECTOR - 1);
+
+        _bench_put16 (fat + 2 * c, last ? 0xffff : c + 1);
+    }
+    memcpy (v + SECTOR * (1 + FAT_SECTORS), fat, FAT_SECTORS * SECTOR);
+
+    _bench_dirent (v + SECTOR * (1 + 2 * FAT_SECTORS), "EFI        ", 0x10, 0, 2, 0);
+    e = v + SECTOR * DATA_SECTOR;
+    e = _bench_dirent (e, ".          ", 0x10, 0, 2, 0);
+    e = _bench_dirent (e, "..         ", 0x10, 0, 0, 0);
+    _bench_dirent (e, "AST        ", 0x10, 0, 3, 0);
+    e = v + SECTOR * (DATA_SECTOR + 1);
+    e = _bench_dirent (e, ".          ", 0x10, 0, 3, 0);
+    e = _bench_dirent (e, "..         ", 0x10, 0, 2, 0);
+    for (int i = 0; i < NFILES; i++) {
+        char shortName[12];
+
+        snprintf (_bench_names[i], sizeof (_bench_names[i]), "Boot Entry %02d.efi", i);
+        snprintf (shortName, sizeof (shortName), "BOOTEN~%dEFI", i % 10);
+        e = _bench_long (e, _bench_names[i], shortName);
+    }
+    _bench_dirent (e, "ASTG2X64EFI", 0x20, 0x18, (uint16_t) imageCluster, IMAGE_SIZE);
+    for (size_t i = 0; i < IMAGE_SIZE; i++) {
+        v[SECTOR * (DATA_SECTOR + imageCluster - 2) + i] = (uint8_t) (i * 2654435761u >> 24);
+    }
+    return v;
+}
+
+static int _bench_op_open (void *arg, size_t i)
+{
+    struct ast_fat *fat = NULL;
+    int ret = ast_fat_open (_bench_path, 0, 0, &fat);
+
+    (void) arg;
+    (void) i;
+    ast_fat_close (fat);
+    return ret;
+}
+
+static int _bench_op_lookup (void *arg, size_t i)
+{
+    struct ast_fat_entry entry;
+
+    (void) i;
+    return ast_fat_lookup (arg, "\\efi\\ast\\ASTG2X64.EFI", &entry);
+}
+
+static int _bench_op_check_one_volume (void *arg, size_t i)
+{
+    struct ast_fat *fat = NULL;
+    struct ast_fat_entry entry;
+    char path[sizeof (AST_DIR) + sizeof (_bench_names[0])];
+    int ret = ast_fat_open (_bench_path, 0, 0, &fat);
+
+    (void) arg;
+    (void) i;
+    for (int k = 0; (k < NFILES) && (ret == AST_RETURN_SUCCESS); k++) {
+        snprintf (path, sizeof (path), AST_DIR "%.*s", (int) sizeof (_bench_names[k]) - 1, _bench_names[k]);
+        ret = ast_fat_lookup (fat, path, &entry);
+    }
+    ast_fat_close (fat);
+    return ret;
+}
+
+static int _bench_op_check_volume_per_path (void *arg, size_t i)
+{
+    struct ast_fat_entry entry;
+    char path[sizeof (AST_DIR) + sizeof (_bench_names[0])];
+    int ret = AST_RETURN_SUCCESS;
+
+    (void) arg;
+    (void) i;
+    for (int k = 0; (k < NFILES) && (ret == AST_RETURN_SUCCESS); k++) {
+        struct ast_fat *fat = NULL;
+
+        snprintf (path, sizeof (path), AST_DIR "%.*s", (int) sizeof (_bench_names[k]) - 1, _bench_names[k]);
+        ret = ast_fat_open (_bench_path, 0, 0, &fat);
+        if (ret == AST_RETURN_SUCCESS) {
+            ret = ast_fat_lookup (fat, path, &entry);
+        }
+        ast_fat_close (fat);
+    }
+    return ret;
+}
+
+static int _bench_sink (void *arg, const void *data, size_t size)
+{
+    size_t *sum = arg;
+
+    *sum += size + ((const uint8_t *) data)[size - 1];
+    return AST_RETURN_SUCCESS;
+}
+
+static int _bench_op_read (void *arg, size_t i)
+{
+    struct ast_fat_entry entry;
+    size_t sum = 0;
+    int ret = ast_fat_lookup (arg, "\\EFI\\AST\\astg2x64.efi", &entry);
+
+    (void) i;
+    if (ret == AST_RETURN_SUCCESS) {
+        ret = ast_fat_read (arg, &entry, _bench_sink, &sum);
+    }
+    return ret;
+}
+
+int main (void)
+{
+    uint8_t *data = _bench_volume ();
+    struct ast_fat *fat = NULL;
+    FILE *fp = NULL;
+    int ret = 0;
+
+    bench_init ("fat");
+
+    fp = fopen (_bench_path, "wb");
+    if ((data == NULL) || (fp == NULL) || (fwrite (data, SECTOR, NSECTORS, fp) != NSECTORS)) {
+        fprintf (stderr, "fat: cannot prepare the image.\n");
+        if (fp != NULL) {
+            fclose (fp);
+        }
+        free (data);
+        return 1;
+    }
+    fclose (fp);
+    if (ast_fat_open (_bench_path, 0, 0, &fat) != AST_RETURN_SUCCESS) {
+        fprintf (stderr, "fat: cannot open the image.\n");
+        remove (_bench_path);
+        free (data);
+        return 1;
+    }
+
+    ret |= bench_case ("open", NULL, _bench_op_open, NULL, NULL);
+    ret |= bench_case ("lookup_cached", NULL, _bench_op_lookup, fat, NULL);
+    ret |= bench_case ("check_32_paths_one_volume", NULL, _bench_op_check_one_volume, NULL, NULL);
+    ret |= bench_case ("check_32_paths_volume_per_path", NULL, _bench_op_check_volume_per_path, NULL, NULL);
+    ret |= bench_case ("read_1m", NULL, _bench_op_read, fat, NULL);
+
+    ast_fat_close (fat);
+    remove (_bench_path);
+    free (data);
+    return bench_finish () | ret;
+}
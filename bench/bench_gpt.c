@@ -0,0 +1,157 @@
+/**
+ * @file bench_gpt.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file measures reading the partition table of a disk image of NBLOCKS 512-byte blocks with a
+ * 128-entry array, and the CRC-32 of such an array, slicing-by-8 against one byte per step.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/crypto/crc32.h"
+#include "../src/gpt/gpt.h"
+#include "../src/firmware/firmware.h"
+#include "harness.h"
+
+#define NBLOCKS    2048
+#define BLOCK_SIZE 512
+#define NENTRIES   128
+#define ENTRY_SIZE 128
+#define ARRAY_SIZE (NENTRIES * ENTRY_SIZE)
+
+static uint32_t _bench_table[256];
+
+static void _bench_put (uint8_t *p, uint64_t v, int n)
+{
+    for (int k = 0; k < n; k++) {
+        p[k] = (uint8_t) (v >> (8 * k));
+    }
+}
+
+static void _bench_header (uint8_t *h, uint64_t myLba, uint64_t altLba, uint64_t arrayLba, uint32_t arrayCrc)
+{
+    memset (h, 0, BLOCK_SIZE);
+    memcpy (h, "EFI PART", 8);
+    _bench_put (h + 8, 0x00010000, 4);
+    _bench_put (h + 12, 92, 4);
+    _bench_put (h + 24, myLba, 8);
+    _bench_put (h + 32, altLba, 8);
+    _bench_put (h + 40, 34, 8);
+    _bench_put (h + 48, NBLOCKS - 34, 8);
+    memset (h + 56, 0x5a, 16);
+    _bench_put (h + 72, arrayLba, 8);
+    _bench_put (h + 80, NENTRIES, 4);
+    _bench_put (h + 84, ENTRY_SIZE, 4);
+    _bench_put (h + 88, arrayCrc, 4);
+    _bench_put (h + 16, ast_crc32 (0, h, 92), 4);
+}
+
+static uint8_t *_bench_disk (void)
+{
+    static const uint8_t espType[16] = {0x28, 0x73, 0x2a, 0xc1, 0x1f, 0xf8, 0xd2, 0x11,
+                                        0xba, 0x4b, 0x00, 0xa0, 0xc9, 0x3e, 0xc9, 0x3b};
+    uint8_t *p = calloc (NBLOCKS, BLOCK_SIZE);
+    uint8_t *array = p + 2 * BLOCK_SIZE;
+    uint32_t arrayCrc = 0;
+
+    if (p == NULL) {
+        return NULL;
+    }
+    p[446 + 4] = 0xee;                 // Protective MBR
+    _bench_put (p + 446 + 8, 1, 4);
+    _bench_put (p + 446 + 12, NBLOCKS - 1, 4);
+    p[510] = 0x55;
+    p[511] = 0xaa;
+    for (int i = 0; i < 4; i++) {
+        uint8_t *e = array + i * ENTRY_SIZE;
+
+        memcpy (e, espType, 16);
+        memset (e + 16, i + 1, 16);
+        _bench_put (e + 32, 34 + i * 400, 8);
+        _bench_put (e + 40, 34 + i * 400 + 399, 8);
+        e[56] = 'P';
+    }
+    arrayCrc = ast_crc32 (0, array, ARRAY_SIZE);
+    memcpy (p + (NBLOCKS - 33) * BLOCK_SIZE, array, ARRAY_SIZE);
+    _bench_header (p + BLOCK_SIZE, 1, NBLOCKS - 1, 2, arrayCrc);
+    _bench_header (p + (NBLOCKS - 1) * BLOCK_SIZE, NBLOCKS - 1, 1, NBLOCKS - 33, arrayCrc);
+    return p;
+}
+
+static int _bench_op_read (void *arg, size_t i)
+{
+    struct ast_gpt gpt;
+    int ret = ast_gpt_read (arg, &gpt);
+
+    (void) i;
+    if (ret == AST_RETURN_SUCCESS) {
+        ret = (gpt.nPartitions == 4) ? 0 : 1;
+        ast_gpt_free (&gpt);
+    }
+    return ret;
+}
+
+static int _bench_op_crc32 (void *arg, size_t i)
+{
+    volatile uint32_t crc = ast_crc32 (0, arg, ARRAY_SIZE);
+
+    (void) i;
+    (void) crc;
+    return 0;
+}
+
+static int _bench_op_crc32_bytewise (void *arg, size_t i)
+{
+    const uint8_t *p = arg;
+    uint32_t crc = 0xffffffffu;
+    volatile uint32_t result = 0;
+
+    (void) i;
+    for (size_t k = 0; k < ARRAY_SIZE; k++) {
+        crc = _bench_table[(crc ^ p[k]) & 0xff] ^ (crc >> 8);
+    }
+    result = ~crc;
+    (void) result;
+    return 0;
+}
+
+int main (void)
+{
+    const char *path = "bench_gpt.img";
+    uint8_t *data = _bench_disk ();
+    FILE *fp = NULL;
+    int ret = 0;
+
+    bench_init ("gpt");
+
+    fp = fopen (path, "wb");
+    if ((data == NULL) || (fp == NULL) || (fwrite (data, BLOCK_SIZE, NBLOCKS, fp) != NBLOCKS)) {
+        fprintf (stderr, "gpt: cannot prepare the image.\n");
+        if (fp != NULL) {
+            fclose (fp);
+        }
+        free (data);
+        return 1;
+    }
+    fclose (fp);
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? (c >> 1) ^ 0xEDB88320u : (c >> 1);
+        }
+        _bench_table[i] = c;
+    }
+
+    ret |= bench_case ("read_image", NULL, _bench_op_read, (void *) path, NULL);
+    ret |= bench_case ("crc32_16k_slice8", NULL, _bench_op_crc32, data + 2 * BLOCK_SIZE, NULL);
+    ret |= bench_case ("crc32_16k_bytewise", NULL, _bench_op_crc32_bytewise, data + 2 * BLOCK_SIZE, NULL);
+
+    remove (path);
+    free (data);
+    return bench_finish () | ret;
+}
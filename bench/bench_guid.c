@@ -0,0 +1,130 @@
+/**
+ * @file bench_guid.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file compares ast_guid_parse and ast_guid_format against sscanf and snprintf.
+ *
+ * The sscanf version is what code usually does with a GUID string; note that it does not even reject
+ * trailing garbage or short fields, which ast_guid_parse does.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/firmware/firmware.h"
+#include "../src/guid/guid.h"
+#include "harness.h"
+
+#define NGUIDS 1024
+
+static char         _bench_strs[NGUIDS][AST_GUID_STRLEN + 1];
+static ast_guid     _bench_guids[NGUIDS];
+static unsigned int _bench_checksum;
+
+static int _bench_sscanf (const char *str, ast_guid *guid)
+{
+    unsigned int  d1 = 0;
+    unsigned short d2 = 0, d3 = 0;
+    unsigned char b[8];
+
+    if (sscanf (str, "%8x-%4hx-%4hx-%2hhx%2hhx-%2hhx%2hhx%2hhx%2hhx%2hhx%2hhx",
+                &d1, &d2, &d3, &b[0], &b[1], &b[2], &b[3], &b[4], &b[5], &b[6], &b[7]) != 11) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    guid->b[0] = (uint8_t) d1;
+    guid->b[1] = (uint8_t) (d1 >> 8);
+    guid->b[2] = (uint8_t) (d1 >> 16);
+    guid->b[3] = (uint8_t) (d1 >> 24);
+    guid->b[4] = (uint8_t) d2;
+    guid->b[5] = (uint8_t) (d2 >> 8);
+    guid->b[6] = (uint8_t) d3;
+    guid->b[7] = (uint8_t) (d3 >> 8);
+    memcpy (guid->b + 8, b, 8);
+    return AST_RETURN_SUCCESS;
+}
+
+static void _bench_snprintf (const ast_guid *g, char *str)
+{
+    snprintf (str, AST_GUID_STRLEN + 1, "%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+              g->b[3], g->b[2], g->b[1], g->b[0], g->b[5], g->b[4], g->b[7], g->b[6],
+              g->b[8], g->b[9], g->b[10], g->b[11], g->b[12], g->b[13], g->b[14], g->b[15]);
+}
+
+static int _bench_op_parse (void *arg, size_t i)
+{
+    ast_guid g;
+
+    (void) arg;
+    if (ast_guid_parse (_bench_strs[i % NGUIDS], &g) != AST_RETURN_SUCCESS) {
+        return 1;
+    }
+    _bench_checksum += g.b[i & 15];
+    return 0;
+}
+
+static int _bench_op_sscanf (void *arg, size_t i)
+{
+    ast_guid g;
+
+    (void) arg;
+    if (_bench_sscanf (_bench_strs[i % NGUIDS], &g) != AST_RETURN_SUCCESS) {
+        return 1;
+    }
+    _bench_checksum += g.b[i & 15];
+    return 0;
+}
+
+static int _bench_op_format (void *arg, size_t i)
+{
+    char out[AST_GUID_STRLEN + 1];
+
+    (void) arg;
+    ast_guid_format (&_bench_guids[i % NGUIDS], out);
+    _bench_checksum += (unsigned char) out[i % AST_GUID_STRLEN];
+    return 0;
+}
+
+static int _bench_op_snprintf (void *arg, size_t i)
+{
+    char out[AST_GUID_STRLEN + 1];
+
+    (void) arg;
+    _bench_snprintf (&_bench_guids[i % NGUIDS], out);
+    _bench_checksum += (unsigned char) out[i % AST_GUID_STRLEN];
+    return 0;
+}
+
+int main (void)
+{
+    srand (1);
+    for (int i = 0; i < NGUIDS; i++) {
+        for (int j = 0; j < 16; j++) {
+            _bench_guids[i].b[j] = (uint8_t) rand ();
+        }
+        ast_guid_format (&_bench_guids[i], _bench_strs[i]);
+    }
+
+    // Both sides must agree before their speed means anything.
+    for (int i = 0; i < NGUIDS; i++) {
+        ast_guid g1, g2;
+        char s1[AST_GUID_STRLEN + 1], s2[AST_GUID_STRLEN + 1];
+
+        ast_guid_format (&_bench_guids[i], s1);
+        _bench_snprintf (&_bench_guids[i], s2);
+        if ((ast_guid_parse (_bench_strs[i], &g1) != AST_RETURN_SUCCESS) || (_bench_sscanf (_bench_strs[i], &g2) != AST_RETURN_SUCCESS) ||
+            (memcmp (&g1, &g2, sizeof (g1)) != 0) || (strcmp (s1, s2) != 0)) {
+            fprintf (stderr, "guid: results differ for %s.\n", _bench_strs[i]);
+            return 1;
+        }
+    }
+
+    bench_init ("guid");
+    bench_case ("parse", NULL, _bench_op_parse, NULL, NULL);
+    bench_case ("parse_sscanf", NULL, _bench_op_sscanf, NULL, NULL);
+    bench_case ("format", NULL, _bench_op_format, NULL, NULL);
+    bench_case ("format_snprintf", NULL, _bench_op_snprintf, NULL, NULL);
+    return bench_finish ();
+}
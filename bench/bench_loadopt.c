@@ -0,0 +1,148 @@
+/**
+ * @file bench_loadopt.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file measures how fast load options are encoded and decoded.
+ *
+ * The corpus mimics what machines carry: vendor descriptions of various lengths, device path lists from
+ * a few dozen to a few hundred bytes, and optional data on some entries. Every option is encoded with
+ * ast_load_option_encode into one contiguous buffer, which the decoding case walks through.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/firmware/firmware.h"
+#include "../src/loadopt/loadopt.h"
+#include "harness.h"
+
+#define NOPTIONS 4096
+
+static const char *_bench_descriptions[] = {
+    "Windows Boot Manager",
+    "ubuntu",
+    "UEFI: PXE IPv4 Intel(R) Ethernet Connection I219-LM",
+    "UEFI: SanDisk Cruzer Blade 1.00, Partition 1",
+    "Linux Boot Manager",
+    "EFI Internal Shell",
+    "Boot Linux OS from AST",
+    "Diagnostic Splash Screen"
+};
+
+static uint8_t  _bench_path[512];
+static uint8_t  _bench_extra[64];
+static size_t   *_bench_offsets;
+static uint8_t  *_bench_corpus;
+static size_t   _bench_checksum;
+
+static void _bench_option (size_t i, struct ast_load_option *option)
+{
+    memset (option, 0, sizeof (*option));
+    option->attributes         = AST_LOAD_OPTION_ACTIVE;
+    option->description        = _bench_descriptions[i % 8];
+    option->filePathList       = _bench_path;
+    option->filePathListLength = (uint16_t) (40 + (i * 37) % 400);
+    option->optionalData       = (i % 3 == 0) ? _bench_extra : NULL;
+    option->optionalDataLength = (i % 3 == 0) ? 16 + (i % 48) : 0;
+}
+
+static int _bench_op_encode (void *arg, size_t i)
+{
+    struct ast_load_option option;
+    uint8_t buf[1024];
+    size_t n = 0;
+
+    (void) arg;
+    _bench_option (i % NOPTIONS, &option);
+    if (ast_load_option_encode (&option, buf, sizeof (buf), &n) != AST_RETURN_SUCCESS) {
+        return 1;
+    }
+    _bench_checksum += n;
+    return 0;
+}
+
+static int _bench_op_encode_alloc (void *arg, size_t i)
+{
+    struct ast_load_option option;
+    void *buf = NULL;
+    size_t n = 0;
+
+    (void) arg;
+    _bench_option (i % NOPTIONS, &option);
+    if (ast_load_option_encode_alloc (&option, &buf, &n) != AST_RETURN_SUCCESS) {
+        return 1;
+    }
+    _bench_checksum += n;
+    free (buf);
+    return 0;
+}
+
+static int _bench_op_parse (void *arg, size_t i)
+{
+    struct ast_load_option_view view;
+
+    (void) arg;
+    i %= NOPTIONS;
+    if (ast_load_option_parse (_bench_corpus + _bench_offsets[i], _bench_offsets[i + 1] - _bench_offsets[i], &view) != AST_RETURN_SUCCESS) {
+        return 1;
+    }
+    _bench_checksum += view.descriptionLength + view.filePathListLength + view.optionalDataLength;
+    return 0;
+}
+
+int main (void)
+{
+    size_t corpusSiz = 0;
+    struct bench_stats st;
+
+    _bench_offsets = malloc ((NOPTIONS + 1) * sizeof (size_t));
+    if (_bench_offsets == NULL) {
+        return 1;
+    }
+    for (size_t i = 0; i < sizeof (_bench_path); i++) {
+        _bench_path[i] = (uint8_t) (i * 7);
+    }
+    memset (_bench_extra, 0xA5, sizeof (_bench_extra));
+
+    // Two passes: sizes first, then encoding into the exact total.
+    for (int pass = 0; pass < 2; pass++) {
+        size_t off = 0;
+        for (size_t i = 0; i < NOPTIONS; i++) {
+            struct ast_load_option option;
+            size_t n = 0;
+
+            _bench_option (i, &option);
+            if (pass == 0) {
+                n = ast_load_option_size (&option);
+            } else if (ast_load_option_encode (&option, _bench_corpus + off, corpusSiz - off, &n) != AST_RETURN_SUCCESS) {
+                fprintf (stderr, "ast_load_option_encode failed.\n");
+                return 1;
+            }
+            _bench_offsets[i] = off;
+            off += n;
+        }
+        _bench_offsets[NOPTIONS] = off;
+        if (pass == 0) {
+            corpusSiz = off;
+            _bench_corpus = malloc (corpusSiz);
+            if (_bench_corpus == NULL) {
+                return 1;
+            }
+        }
+    }
+
+    bench_init ("loadopt");
+    bench_case ("encode", NULL, _bench_op_encode, NULL, NULL);
+    bench_case ("encode_alloc", NULL, _bench_op_encode_alloc, NULL, NULL);
+    if (bench_case ("parse", NULL, _bench_op_parse, NULL, &st) == 0) {
+        printf ("loadopt: parse over a %zu-byte corpus of %d options: %.0f MB/s\n",
+                corpusSiz, NOPTIONS, st.opsPerSec * corpusSiz / NOPTIONS / 1e6);
+    }
+
+    free (_bench_corpus);
+    free (_bench_offsets);
+    return bench_finish ();
+}
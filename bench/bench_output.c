@@ -0,0 +1,132 @@
+/**
+ * @file bench_output.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file measures writing variable records as JSON Lines and CBOR, to /dev/null: a boot entry, and a
+ * dbx of NSIGS SHA-256 hashes (about 380 KiB, which goes through the output buffer in pieces). The dbx
+ * is also written as hex with fprintf, a byte at a time, as printf-based reporting would.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/firmware/firmware.h"
+#include "../src/devpath/devpath.h"
+#include "../src/loadopt/loadopt.h"
+#include "../src/output/output.h"
+#include "../src/output/record.h"
+#include "harness.h"
+
+#define NSIGS 8192
+
+/** Argument of _bench_op_record. */
+struct _bench_record {
+    struct ast_output *out;
+    const ast_guid    *guid;
+    const char        *name;
+    const void        *data;
+    size_t            size;
+};
+
+static const ast_guid _bench_global   = AST_GUID_EFI_GLOBAL;
+static const ast_guid _bench_security = AST_GUID_IMAGE_SECURITY_DATABASE;
+static const ast_guid _bench_sha256   = AST_GUID_CERT_SHA256;
+
+static FILE *_bench_null;
+
+static uint8_t *_bench_dbx (size_t *size)
+{
+    uint32_t listSize = 28 + NSIGS * 48, headerSize = 0, sigSize = 48;
+    uint8_t *dbx = malloc (listSize);
+
+    if (dbx == NULL) {
+        return NULL;
+    }
+    memcpy (dbx, &_bench_sha256, 16);
+    memcpy (dbx + 16, &listSize, 4);
+    memcpy (dbx + 20, &headerSize, 4);
+    memcpy (dbx + 24, &sigSize, 4);
+    for (size_t i = 28; i < listSize; i++) {
+        dbx[i] = (uint8_t) (i * 131);
+    }
+    *size = listSize;
+    return dbx;
+}
+
+static int _bench_op_record (void *arg, size_t i)
+{
+    struct _bench_record *r = arg;
+
+    (void) i;
+    ast_output_variable (r->out, r->guid, r->name, AST_EFIVAR_DEFAULT_ATTRIBUTES, r->data, r->size);
+    return r->out->status != AST_RETURN_SUCCESS;
+}
+
+static int _bench_op_fprintf (void *arg, size_t i)
+{
+    const struct _bench_record *r = arg;
+    const uint8_t *p = r->data;
+
+    (void) i;
+    fprintf (_bench_null, "%s: ", r->name);
+    for (size_t j = 0; j < r->size; j++) {
+        fprintf (_bench_null, "%02x", p[j]);
+    }
+    fprintf (_bench_null, "\n");
+    return 0;
+}
+
+int main (void)
+{
+    static struct ast_output json, cbor;
+    uint8_t path[256], option[512];
+    struct ast_devpath_builder builder;
+    struct ast_load_option lo = {0};
+    size_t pathSiz = 0, optionSiz = 0, dbxSiz = 0;
+    uint8_t *dbx = _bench_dbx (&dbxSiz);
+    int ret = 0;
+
+    bench_init ("output");
+
+    _bench_null = fopen ("/dev/null", "wb");
+    ast_devpath_builder_init (&builder, path, sizeof (path));
+    ast_devpath_add_file (&builder, "\\EFI\\BOOT\\BOOTX64.EFI");
+    ast_devpath_add_end (&builder, AST_DEVPATH_END_ENTIRE);
+    lo.attributes         = AST_LOAD_OPTION_ACTIVE;
+    lo.description        = "Linux Boot Manager";
+    lo.filePathList       = path;
+    if ((_bench_null == NULL) || (dbx == NULL) || (ast_devpath_builder_finish (&builder, &pathSiz) != AST_RETURN_SUCCESS)) {
+        fprintf (stderr, "output: cannot prepare the records.\n");
+        free (dbx);
+        return 1;
+    }
+    lo.filePathListLength = (uint16_t) pathSiz;
+    if (ast_load_option_encode (&lo, option, sizeof (option), &optionSiz) != AST_RETURN_SUCCESS) {
+        fprintf (stderr, "output: cannot encode the boot entry.\n");
+        free (dbx);
+        return 1;
+    }
+
+    ast_output_init (&json, _bench_null, AST_OUTPUT_JSON);
+    ast_output_init (&cbor, _bench_null, AST_OUTPUT_CBOR);
+    {
+        struct _bench_record bootJson = {&json, &_bench_global, "Boot0000", option, optionSiz};
+        struct _bench_record bootCbor = {&cbor, &_bench_global, "Boot0000", option, optionSiz};
+        struct _bench_record dbxJson  = {&json, &_bench_security, "dbx", dbx, dbxSiz};
+        struct _bench_record dbxCbor  = {&cbor, &_bench_security, "dbx", dbx, dbxSiz};
+
+        ret |= bench_case ("boot_option_json", NULL, _bench_op_record, &bootJson, NULL);
+        ret |= bench_case ("boot_option_cbor", NULL, _bench_op_record, &bootCbor, NULL);
+        ret |= bench_case ("dbx_json", NULL, _bench_op_record, &dbxJson, NULL);
+        ret |= bench_case ("dbx_cbor", NULL, _bench_op_record, &dbxCbor, NULL);
+        ret |= bench_case ("dbx_fprintf", NULL, _bench_op_fprintf, &dbxJson, NULL);
+    }
+    ret |= (ast_output_flush (&json) != AST_RETURN_SUCCESS) || (ast_output_flush (&cbor) != AST_RETURN_SUCCESS);
+
+    fclose (_bench_null);
+    free (dbx);
+    return bench_finish () | ret;
+}
@@ -0,0 +1,120 @@
+/**
+ * @file bench_pe.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file measures the Authenticode digest of a signed PE32+ image of NSECTIONS sections and IMAGE_SIZE
+ * bytes in all, in memory and from a file, with each SHA-256 engine available.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/crypto/sha256.h"
+#include "../src/pe/pe.h"
+#include "../src/firmware/firmware.h"
+#include "harness.h"
+
+#define IMAGE_SIZE   (4 << 20)
+#define NSECTIONS    4
+#define HEADERS_SIZE 0x400
+#define CERT_SIZE    0x1000
+
+/** Argument of the cases. */
+struct _bench_image {
+    const uint8_t *data;
+    const char    *path;
+};
+
+static uint8_t *_bench_image (void)
+{
+    uint8_t *p = calloc (1, IMAGE_SIZE);
+    uint32_t sectionSize = (IMAGE_SIZE - HEADERS_SIZE - CERT_SIZE) / NSECTIONS;
+    uint32_t v = 0;
+    size_t opt = 0x80 + 24, table = opt + 240;
+
+    if (p == NULL) {
+        return NULL;
+    }
+    for (size_t i = HEADERS_SIZE; i < IMAGE_SIZE; i++) {
+        p[i] = (uint8_t) (i * 2654435761u >> 24);
+    }
+    p[0] = 'M';
+    p[1] = 'Z';
+    v = 0x80;
+    memcpy (p + 0x3c, &v, 4);
+    memcpy (p + 0x80, "PE\0\0", 4);
+    p[0x80 + 6]  = NSECTIONS;
+    p[0x80 + 20] = 240;                // SizeOfOptionalHeader: PE32+ with 16 data directories
+    p[opt]     = 0x0b;
+    p[opt + 1] = 0x02;
+    v = HEADERS_SIZE;
+    memcpy (p + opt + 60, &v, 4);
+    v = 16;
+    memcpy (p + opt + 108, &v, 4);
+    v = IMAGE_SIZE - CERT_SIZE;        // Certificate Table, at the end of the file
+    memcpy (p + opt + 112 + 32, &v, 4);
+    v = CERT_SIZE;
+    memcpy (p + opt + 112 + 36, &v, 4);
+    for (uint32_t i = 0; i < NSECTIONS; i++) {
+        uint32_t offset = HEADERS_SIZE + i * sectionSize;
+
+        memcpy (p + table + 40 * i + 16, &sectionSize, 4);
+        memcpy (p + table + 40 * i + 20, &offset, 4);
+    }
+    return p;
+}
+
+static int _bench_op_memory (void *arg, size_t i)
+{
+    const struct _bench_image *img = arg;
+    uint8_t digest[AST_SHA256_SIZE];
+
+    (void) i;
+    return ast_pe_hash (img->data, IMAGE_SIZE, digest);
+}
+
+static int _bench_op_file (void *arg, size_t i)
+{
+    const struct _bench_image *img = arg;
+    uint8_t digest[AST_SHA256_SIZE];
+
+    (void) i;
+    return ast_pe_hash_file (img->path, digest);
+}
+
+int main (void)
+{
+    struct _bench_image img = {NULL, "bench_pe.img"};
+    uint8_t *data = _bench_image ();
+    FILE *fp = NULL;
+    int ret = 0;
+
+    bench_init ("pe");
+
+    fp = fopen (img.path, "wb");
+    if ((data == NULL) || (fp == NULL) || (fwrite (data, 1, IMAGE_SIZE, fp) != IMAGE_SIZE)) {
+        fprintf (stderr, "pe: cannot prepare the image.\n");
+        if (fp != NULL) {
+            fclose (fp);
+        }
+        free (data);
+        return 1;
+    }
+    fclose (fp);
+    img.data = data;
+
+    if (ast_sha256_select (1) == AST_RETURN_SUCCESS) {
+        ret |= bench_case ("authenticode_4m_sha_ni", NULL, _bench_op_memory, &img, NULL);
+        ret |= bench_case ("authenticode_4m_file_sha_ni", NULL, _bench_op_file, &img, NULL);
+    }
+    ast_sha256_select (0);
+    ret |= bench_case ("authenticode_4m_portable", NULL, _bench_op_memory, &img, NULL);
+    ret |= bench_case ("authenticode_4m_file_portable", NULL, _bench_op_file, &img, NULL);
+
+    remove (img.path);
+    free (data);
+    return bench_finish () | ret;
+}
@@ -0,0 +1,134 @@
+/**
+ * @file bench_sigdb.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file measures looking a SHA-256 digest up in a dbx of NSIGS hashes: through an ast_sigdb index
+ * (hits and misses), and by scanning the lists as a reader without an index would. Indexing the whole
+ * dbx is measured too.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/sigdb/sigdb.h"
+#include "harness.h"
+
+#define NSIGS 8192
+
+/** Argument of the cases. */
+struct _bench_lookup {
+    const uint8_t          *dbx;
+    size_t                 size;
+    const struct ast_sigdb *index;
+    uint8_t                missing[AST_SHA256_SIZE];
+};
+
+static const ast_guid _bench_sha256 = AST_GUID_CERT_SHA256;
+
+static uint8_t *_bench_dbx (size_t *size)
+{
+    uint32_t listSize = 28 + NSIGS * 48, headerSize = 0, sigSize = 48;
+    uint8_t *dbx = malloc (listSize);
+    uint64_t x = 0x9e3779b97f4a7c15ULL;
+
+    if (dbx == NULL) {
+        return NULL;
+    }
+    memcpy (dbx, &_bench_sha256, 16);
+    memcpy (dbx + 16, &listSize, 4);
+    memcpy (dbx + 20, &headerSize, 4);
+    memcpy (dbx + 24, &sigSize, 4);
+    // Pseudo-random (xorshift) owners and digests, all distinct as in a real dbx.
+    for (size_t i = 28; i < listSize; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        dbx[i] = (uint8_t) x;
+    }
+    *size = listSize;
+    return dbx;
+}
+
+static const uint8_t *_bench_digest (const struct _bench_lookup *l, size_t i)
+{
+    return l->dbx + 28 + (i % NSIGS) * 48 + 16;
+}
+
+static int _bench_op_build (void *arg, size_t i)
+{
+    const struct _bench_lookup *l = arg;
+    struct ast_sigdb index;
+    int ret = 0;
+
+    (void) i;
+    ast_sigdb_init (&index);
+    ret = ast_sigdb_add (&index, l->dbx, l->size);
+    ast_sigdb_free (&index);
+    return ret;
+}
+
+static int _bench_op_hit (void *arg, size_t i)
+{
+    const struct _bench_lookup *l = arg;
+
+    return !ast_sigdb_has_sha256 (l->index, _bench_digest (l, i * 7919));
+}
+
+static int _bench_op_miss (void *arg, size_t i)
+{
+    const struct _bench_lookup *l = arg;
+
+    (void) i;
+    return ast_sigdb_has_sha256 (l->index, l->missing);
+}
+
+static int _bench_op_scan (void *arg, size_t i)
+{
+    const struct _bench_lookup *l = arg;
+    struct ast_siglist_iter iter;
+    struct ast_siglist list;
+
+    (void) i;
+    ast_siglist_iter_init (&iter, l->dbx, l->size);
+    while (ast_siglist_next (&iter, &list) > 0) {
+        for (size_t e = 0; e < list.nEntries; e++) {
+            if (memcmp (list.entries + e * list.entrySize + 16, l->missing, AST_SHA256_SIZE) == 0) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main (void)
+{
+    struct _bench_lookup lookup = {0};
+    struct ast_sigdb index;
+    uint8_t *dbx = NULL;
+    int ret = 0;
+
+    bench_init ("sigdb");
+
+    ast_sigdb_init (&index);
+    dbx = _bench_dbx (&(lookup.size));
+    if ((dbx == NULL) || (ast_sigdb_add (&index, dbx, lookup.size) != AST_RETURN_SUCCESS) || (index.count != NSIGS)) {
+        fprintf (stderr, "sigdb: cannot index the dbx.\n");
+        free (dbx);
+        return 1;
+    }
+    lookup.dbx   = dbx;
+    lookup.index = &index;
+    memset (lookup.missing, 0xa5, sizeof (lookup.missing));
+
+    ret |= bench_case ("index_dbx", NULL, _bench_op_build, &lookup, NULL);
+    ret |= bench_case ("lookup_hit", NULL, _bench_op_hit, &lookup, NULL);
+    ret |= bench_case ("lookup_miss", NULL, _bench_op_miss, &lookup, NULL);
+    ret |= bench_case ("scan_miss", NULL, _bench_op_scan, &lookup, NULL);
+
+    ast_sigdb_free (&index);
+    free (dbx);
+    return bench_finish () | ret;
+}
@@ -0,0 +1,245 @@
+/**
+ * @file bench_snapshot.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file measures snapshots: capturing an emulated store, opening the file, looking variables up,
+ * serving reads and enumeration through the snapshot backend, and comparing two captures of about 1 MiB
+ * each, once unchanged and once after a few variables were modified, added and removed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../src/firmware/firmware.h"
+#include "../src/firmware/backend.h"
+#include "../src/snapshot/snapshot.h"
+#include "../src/snapshot/diff.h"
+#include "harness.h"
+
+#define NVARS   1024
+#define MAXSIZE 2048
+#define NCHANGES 16
+
+static const ast_guid _bench_vendor = AST_GUID_INIT (0x5ee1b4c3, 0x2f6a, 0x4d1e, 0x9a, 0x5b, 0x41, 0x53, 0x54, 0x42, 0x45, 0x4e);
+
+/** Argument of _bench_op_diff. */
+struct _bench_diff {
+    const struct ast_snapshot *a;
+    const struct ast_snapshot *b;
+    unsigned int              flags;
+    size_t                    nChanges; /**< Expected number of changes */
+};
+
+static char   _bench_names[NVARS][16];
+static size_t _bench_checksum;
+
+static int _bench_populate (void)
+{
+    uint8_t value[MAXSIZE];
+
+    for (int i = 0; i < MAXSIZE; i++) {
+        value[i] = (uint8_t) (i * 7);
+    }
+    for (int i = 0; i < NVARS; i++) {
+        snprintf (_bench_names[i], sizeof (_bench_names[i]), "Bench%04X", i);
+        if (ast_write_efivar_guid (value, 8 + (size_t) (i * 37) % (MAXSIZE - 8), &_bench_vendor, _bench_names[i],
+                                   AST_EFIVAR_DEFAULT_ATTRIBUTES) != AST_RETURN_SUCCESS) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int _bench_change (void)
+{
+    uint8_t value[64];
+
+    // Modify, remove and add NCHANGES variables each.
+    memset (value, 0xA5, sizeof (value));
+    for (int i = 0; i < NCHANGES; i++) {
+        char name[16];
+
+        snprintf (name, sizeof (name), "Added%04X", i);
+        if ((ast_write_efivar_guid (value, sizeof (value), &_bench_vendor, _bench_names[i * 7], AST_EFIVAR_DEFAULT_ATTRIBUTES) != AST_RETURN_SUCCESS) ||
+            (ast_write_efivar_guid (NULL, 0, &_bench_vendor, _bench_names[i * 7 + 1], AST_EFIVAR_DEFAULT_ATTRIBUTES) != AST_RETURN_SUCCESS) ||
+            (ast_write_efivar_guid (value, sizeof (value), &_bench_vendor, name, AST_EFIVAR_DEFAULT_ATTRIBUTES) != AST_RETURN_SUCCESS)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int _bench_op_capture (void *arg, size_t i)
+{
+    size_t n = 0;
+
+    (void) i;
+    if (ast_snapshot_capture (arg, &n) != AST_RETURN_SUCCESS) {
+        return 1;
+    }
+    return n != NVARS;
+}
+
+static int _bench_op_open (void *arg, size_t i)
+{
+    struct ast_snapshot *snap = NULL;
+
+    (void) i;
+    if (ast_snapshot_open (arg, 0, &snap) != AST_RETURN_SUCCESS) {
+        return 1;
+    }
+    _bench_checksum += ast_snapshot_count (snap);
+    ast_snapshot_close (snap);
+    return 0;
+}
+
+static int _bench_op_open_verify (void *arg, size_t i)
+{
+    struct ast_snapshot *snap = NULL;
+
+    (void) i;
+    if (ast_snapshot_open (arg, AST_SNAPSHOT_VERIFY, &snap) != AST_RETURN_SUCCESS) {
+        return 1;
+    }
+    _bench_checksum += ast_snapshot_count (snap);
+    ast_snapshot_close (snap);
+    return 0;
+}
+
+static int _bench_op_diff (void *arg, size_t i)
+{
+    const struct _bench_diff *d = arg;
+    struct ast_snapshot_diff diff;
+    int ret = 0;
+
+    (void) i;
+    if (ast_snapshot_diff (d->a, d->b, d->flags, &diff) != AST_RETURN_SUCCESS) {
+        return 1;
+    }
+    ret = (diff.nChanges != d->nChanges);
+    ast_snapshot_diff_free (&diff);
+    return ret;
+}
+
+static int _bench_op_find (void *arg, size_t i)
+{
+    struct ast_snapshot_var var;
+
+    if (ast_snapshot_find (arg, &_bench_vendor, _bench_names[i % NVARS], &var) != AST_RETURN_SUCCESS) {
+        return 1;
+    }
+    _bench_checksum += var.size;
+    return 0;
+}
+
+static int _bench_op_read (void *arg, size_t i)
+{
+    uint8_t buf[MAXSIZE];
+    size_t n = 0;
+
+    (void) arg;
+    if (ast_read_efivar_guid (buf, sizeof (buf), &_bench_vendor, _bench_names[i % NVARS], &n, NULL) != AST_RETURN_SUCCESS) {
+        return 1;
+    }
+    _bench_checksum += n;
+    return 0;
+}
+
+static int _bench_op_enumerate (void *arg, size_t i)
+{
+    struct ast_efivar_iter *iter = NULL;
+    struct ast_efivar_info infos[32];
+    size_t n = 0, total = 0;
+
+    (void) arg;
+    (void) i;
+    if (ast_efivar_iter_open (&iter, AST_EFIVAR_ITER_ATTRIBUTES) != AST_RETURN_SUCCESS) {
+        return 1;
+    }
+    do {
+        if (ast_efivar_iter_next (iter, infos, 32, &n) != AST_RETURN_SUCCESS) {
+            ast_efivar_iter_close (iter);
+            return 1;
+        }
+        total += n;
+    } while (n != 0);
+    ast_efivar_iter_close (iter);
+    _bench_checksum += total;
+    return total != NVARS;
+}
+
+int main (void)
+{
+    struct ast_efivar_backend *backend = NULL;
+    struct ast_efivar_emu_config config = {0};
+    struct ast_snapshot *snap = NULL, *changed = NULL;
+    char path[] = "/tmp/ast-bench-XXXXXX";
+    char pathChanged[] = "/tmp/ast-bench-XXXXXX";
+    int fd = -1, fdChanged = -1;
+    int ret = 0;
+
+    bench_init ("snapshot");
+
+    fd = mkstemp (path);
+    fdChanged = mkstemp (pathChanged);
+    if ((fd < 0) || (fdChanged < 0)) {
+        fprintf (stderr, "snapshot: cannot create temporary files.\n");
+        return 1;
+    }
+    close (fd);
+    close (fdChanged);
+
+    config.storeSiz = 4 * 1024 * 1024;
+    backend = ast_efivar_backend_emu_new (NULL, &config);
+    ast_efivar_backend_set (backend);
+    if ((backend == NULL) || (_bench_populate () != 0)) {
+        fprintf (stderr, "snapshot: cannot fill an emulated store.\n");
+        ret = 1;
+    } else {
+        bench_case ("capture", "emu", _bench_op_capture, path, NULL);
+        if ((_bench_change () != 0) || (ast_snapshot_capture (pathChanged, NULL) != AST_RETURN_SUCCESS)) {
+            fprintf (stderr, "snapshot: cannot capture a changed store.\n");
+            ret = 1;
+        }
+    }
+    ast_efivar_backend_set (NULL);
+    ast_efivar_backend_free (backend);
+
+    if (ret == 0) {
+        bench_case ("open", NULL, _bench_op_open, path, NULL);
+        bench_case ("open_verify", NULL, _bench_op_open_verify, path, NULL);
+        if ((ast_snapshot_open (path, 0, &snap) == AST_RETURN_SUCCESS) && (ast_snapshot_open (pathChanged, 0, &changed) == AST_RETURN_SUCCESS)) {
+            struct _bench_diff same = {snap, snap, 0, 0};
+            struct _bench_diff diff = {snap, changed, 0, 3 * NCHANGES};
+            struct _bench_diff trust = {snap, changed, AST_SNAPSHOT_DIFF_TRUST_HASH, 3 * NCHANGES};
+
+            bench_case ("find", NULL, _bench_op_find, snap, NULL);
+            bench_case ("diff_same", NULL, _bench_op_diff, &same, NULL);
+            bench_case ("diff", NULL, _bench_op_diff, &diff, NULL);
+            bench_case ("diff_trust_hash", NULL, _bench_op_diff, &trust, NULL);
+        } else {
+            ret = 1;
+        }
+        ast_snapshot_close (changed);
+        ast_snapshot_close (snap);
+
+        backend = ast_efivar_backend_snapshot_new (path);
+        ast_efivar_backend_set (backend);
+        if (backend != NULL) {
+            bench_case ("read", "snapshot", _bench_op_read, NULL, NULL);
+            bench_case ("enumerate_attr", "snapshot", _bench_op_enumerate, NULL, NULL);
+        } else {
+            ret = 1;
+        }
+        ast_efivar_backend_set (NULL);
+        ast_efivar_backend_free (backend);
+    }
+
+    unlink (path);
+    unlink (pathChanged);
+    return bench_finish () | ret;
+}
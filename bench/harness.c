@@ -0,0 +1,168 @@
+/**
+ * @file harness.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements harness.h.
+ *
+ * Allocations are counted by wrapping the allocator at link time (`-Wl,--wrap=malloc` and friends, see the
+ * Makefile), so only calls made by the library and the benchmarks are seen, not the C library's own.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "harness.h"
+
+#define BENCH_GROUP_NS    2000    // Time groups of calls lasting at least this long
+#define BENCH_MAX_SAMPLES 200000
+#define BENCH_MIN_SAMPLES 200
+
+void *__real_malloc (size_t size);
+void *__real_calloc (size_t n, size_t size);
+void *__real_realloc (void *p, size_t size);
+char *__real_strdup (const char *s);
+
+static unsigned long _bench_nallocs;
+static const char    *_bench_suite = "";
+static FILE          *_bench_out;
+static double        _bench_budget = 0.2;
+static int           _bench_failed;
+static double        _bench_samples[BENCH_MAX_SAMPLES];
+
+static double _bench_now (void)
+{
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int _bench_cmp (const void *a, const void *b)
+{
+    double x = *(const double *) a;
+    double y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+void *__wrap_malloc (size_t size)
+{
+    __atomic_fetch_add (&_bench_nallocs, 1, __ATOMIC_RELAXED);
+    return __real_malloc (size);
+}
+
+void *__wrap_calloc (size_t n, size_t size)
+{
+    __atomic_fetch_add (&_bench_nallocs, 1, __ATOMIC_RELAXED);
+    return __real_calloc (n, size);
+}
+
+void *__wrap_realloc (void *p, size_t size)
+{
+    __atomic_fetch_add (&_bench_nallocs, 1, __ATOMIC_RELAXED);
+    return __real_realloc (p, size);
+}
+
+char *__wrap_strdup (const char *s)
+{
+    __atomic_fetch_add (&_bench_nallocs, 1, __ATOMIC_RELAXED);
+    return __real_strdup (s);
+}
+
+unsigned long bench_allocs (void)
+{
+    return __atomic_load_n (&_bench_nallocs, __ATOMIC_RELAXED);
+}
+
+void bench_init (const char *suite)
+{
+    const char *path = getenv ("AST_BENCH_OUT");
+    const char *ms   = getenv ("AST_BENCH_TIME");
+
+    _bench_suite = suite;
+    if ((ms != NULL) && (atof (ms) > 0)) {
+        _bench_budget = atof (ms) / 1e3;
+    }
+    if ((path != NULL) && (path[0] != '\0')) {
+        _bench_out = fopen (path, "a");
+        if (_bench_out == NULL) {
+            fprintf (stderr, "%s: cannot open %s.\n", suite, path);
+            _bench_failed = 1;
+        }
+    }
+}
+
+int bench_case (const char *name, const char *backend, bench_op op, void *arg, struct bench_stats *stats)
+{
+    struct bench_stats st;
+    size_t group = 1;
+    size_t nSamples = 0;
+    size_t i = 0;
+    double start = 0, end = 0, total = 0;
+    unsigned long allocs = 0;
+
+    memset (&st, 0, sizeof (st));
+
+    // Warm up, and find how many calls make a group long enough to time.
+    start = _bench_now ();
+    if (op (arg, i++) != 0) {
+        goto fail;
+    }
+    end = _bench_now ();
+    if (end - start < BENCH_GROUP_NS) {
+        group = (size_t) (BENCH_GROUP_NS / ((end - start > 1) ? end - start : 1)) + 1;
+    }
+
+    allocs = bench_allocs ();
+    while ((nSamples < BENCH_MAX_SAMPLES) && ((total < _bench_budget * 1e9) || (nSamples < BENCH_MIN_SAMPLES))) {
+        start = _bench_now ();
+        for (size_t k = 0; k < group; k++) {
+            if (op (arg, i++) != 0) {
+                goto fail;
+            }
+        }
+        end = _bench_now ();
+        _bench_samples[nSamples++] = (end - start) / group;
+        total += end - start;
+    }
+    allocs = bench_allocs () - allocs;
+
+    qsort (_bench_samples, nSamples, sizeof (double), _bench_cmp);
+    st.ops         = nSamples * group;
+    st.p50Ns       = _bench_samples[nSamples / 2];
+    st.p99Ns       = _bench_samples[(nSamples * 99) / 100];
+    st.meanNs      = total / st.ops;
+    st.opsPerSec   = st.ops / (total / 1e9);
+    st.allocsPerOp = (double) allocs / st.ops;
+
+    printf ("%s/%s%s%s%s: p50 %.1f ns, p99 %.1f ns, %.0f ops/s, %.2f allocs/op\n",
+            _bench_suite, name, (backend != NULL) ? " [" : "", (backend != NULL) ? backend : "", (backend != NULL) ? "]" : "",
+            st.p50Ns, st.p99Ns, st.opsPerSec, st.allocsPerOp);
+    if (_bench_out != NULL) {
+        fprintf (_bench_out, "{\"suite\":\"%s\",\"case\":\"%s\",\"backend\":\"%s\",\"ops\":%zu,\"p50_ns\":%.1f,\"p99_ns\":%.1f,"
+                 "\"mean_ns\":%.1f,\"ops_per_sec\":%.1f,\"allocs_per_op\":%.3f}\n",
+                 _bench_suite, name, (backend != NULL) ? backend : "", st.ops, st.p50Ns, st.p99Ns, st.meanNs, st.opsPerSec, st.allocsPerOp);
+    }
+    if (stats != NULL) {
+        *stats = st;
+    }
+    return 0;
+
+fail:
+    fprintf (stderr, "%s/%s: operation %zu failed.\n", _bench_suite, name, i - 1);
+    _bench_failed = 1;
+    return 1;
+}
+
+int bench_finish (void)
+{
+    if ((_bench_out != NULL) && (fclose (_bench_out) != 0)) {
+        _bench_failed = 1;
+    }
+    _bench_out = NULL;
+    return _bench_failed;
+}
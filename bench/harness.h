@@ -0,0 +1,80 @@
+/**
+ * @file harness.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares the measuring loop shared by the benchmarks.
+ *
+ * A case is a function performing one operation. The harness calls it until the time budget is spent,
+ * timing groups of calls, and reports the median and 99th percentile time per operation, throughput, and
+ * the number of heap allocations the library made per operation. Operations shorter than a few microseconds
+ * are timed in groups, so their percentiles are those of group averages.
+ *
+ * Each case prints one line. If `AST_BENCH_OUT` names a file, it also appends one JSON object per line:
+ *
+ *     {"suite":"efivar","case":"read","backend":"emu","ops":...,"p50_ns":...,"p99_ns":...,"mean_ns":...,
+ *      "ops_per_sec":...,"allocs_per_op":...}
+ *
+ * `AST_BENCH_TIME` sets the budget per case in milliseconds (default 200).
+ */
+
+#ifndef _AST_BENCH_HARNESS_H
+#define _AST_BENCH_HARNESS_H
+
+#include <stddef.h>
+
+/**
+ * One operation of a case.
+ *
+ * @param arg [in] Argument given to bench_case.
+ * @param i   [in] Index of the call, to walk through test data.
+ * @return 0, or nonzero to abort the case.
+ */
+typedef int (*bench_op) (void *arg, size_t i);
+
+/**
+ * Measurements of one case.
+ */
+struct bench_stats {
+    size_t ops;         /**< Operations run */
+    double p50Ns;       /**< Median time per operation */
+    double p99Ns;       /**< 99th percentile time per operation */
+    double meanNs;      /**< Mean time per operation */
+    double opsPerSec;   /**< Throughput */
+    double allocsPerOp; /**< malloc, calloc, realloc and strdup calls made by the library per operation */
+};
+
+/**
+ * Start a suite. Call once, before any case.
+ *
+ * @param suite [in] Suite name, e.g. "guid".
+ */
+void bench_init (const char *suite);
+
+/**
+ * Measure one case and report it.
+ *
+ * @param name    [in]  Case name.
+ * @param backend [in]  Variable store the case runs against, or NULL if none.
+ * @param op      [in]  Operation.
+ * @param arg     [in]  Passed to op.
+ * @param stats   [out] Measurements. May be NULL.
+ * @return 0, or nonzero if op failed.
+ */
+int bench_case (const char *name, const char *backend, bench_op op, void *arg, struct bench_stats *stats);
+
+/**
+ * Number of allocations counted so far.
+ */
+unsigned long bench_allocs (void);
+
+/**
+ * End the suite.
+ *
+ * @return 0, or nonzero if any case failed or the output file could not be written.
+ */
+int bench_finish (void);
+
+#endif /* end of include guard: _AST_BENCH_HARNESS_H */
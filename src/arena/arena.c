@@ -0,0 +1,144 @@
+/**
+ * @file arena.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements arena.h.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "arena.h"
+
+#define AST_ARENA_ROUND(n) (((n) + (AST_ARENA_ALIGN - 1)) & ~(size_t) (AST_ARENA_ALIGN - 1))
+
+struct ast_arena_chunk {
+    struct ast_arena_chunk *next;
+    size_t size; // Bytes in data
+    size_t used;
+    _Alignas (AST_ARENA_ALIGN) unsigned char data[];
+};
+
+static struct ast_arena_chunk *_ast_arena_chunk_new (struct ast_arena *arena, size_t size);
+
+
+
+
+
+void ast_arena_init (struct ast_arena *arena, size_t chunkSiz)
+{
+    arena->head     = NULL;
+    arena->reserved = NULL;
+    arena->chunkSiz = chunkSiz;
+    arena->nChunks  = 0;
+}
+
+
+
+
+
+void *ast_arena_alloc (struct ast_arena *arena, size_t size)
+{
+    size_t avail = 0;
+    void *p = ast_arena_reserve (arena, size, &avail);
+
+    if (p != NULL) {
+        ast_arena_commit (arena, size);
+    }
+    return p;
+}
+
+
+
+
+
+void *ast_arena_reserve (struct ast_arena *arena, size_t size, size_t *avail)
+{
+    size_t chunkSiz = (arena->chunkSiz == 0) ? AST_ARENA_DEFAULT_CHUNK : arena->chunkSiz;
+    struct ast_arena_chunk *c = arena->head;
+
+    if (size > SIZE_MAX / 2) {
+        return NULL;
+    }
+
+    if ((c != NULL) && (c->size - c->used >= size)) {
+        arena->reserved = c;
+    } else if (size > chunkSiz / 4) {
+        // Big block: give it its own chunk and keep the current one for small allocations.
+        c = _ast_arena_chunk_new (arena, AST_ARENA_ROUND (size));
+        if (c == NULL) {
+            return NULL;
+        }
+        if (arena->head != NULL) {
+            c->next = arena->head->next;
+            arena->head->next = c;
+        } else {
+            arena->head = c;
+        }
+        arena->reserved = c;
+    } else {
+        c = _ast_arena_chunk_new (arena, chunkSiz);
+        if (c == NULL) {
+            return NULL;
+        }
+        c->next = arena->head;
+        arena->head = c;
+        arena->reserved = c;
+    }
+
+    *avail = c->size - c->used;
+    return c->data + c->used;
+}
+
+
+
+
+
+void ast_arena_commit (struct ast_arena *arena, size_t size)
+{
+    struct ast_arena_chunk *c = arena->reserved;
+    size_t rounded = AST_ARENA_ROUND (size);
+
+    // Rounding may run past the end of an exactly sized chunk; the chunk is full then.
+    c->used = (rounded > c->size - c->used) ? c->size : c->used + rounded;
+}
+
+
+
+
+
+void ast_arena_free (struct ast_arena *arena)
+{
+    struct ast_arena_chunk *c = arena->head;
+
+    while (c != NULL) {
+        struct ast_arena_chunk *next = c->next;
+        free (c);
+        c = next;
+    }
+    arena->head     = NULL;
+    arena->reserved = NULL;
+}
+
+
+
+
+
+static struct ast_arena_chunk *_ast_arena_chunk_new (struct ast_arena *arena, size_t size)
+{
+    struct ast_arena_chunk *c = NULL;
+
+    if (size > SIZE_MAX - sizeof (struct ast_arena_chunk)) {
+        return NULL;
+    }
+    c = malloc (sizeof (struct ast_arena_chunk) + size);
+    if (c != NULL) {
+        c->next = NULL;
+        c->size = size;
+        c->used = 0;
+        arena->nChunks++;
+    }
+    return c;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file arena.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares a bump allocator for per-session data.
+ *
+ * Allocations are carved from large chunks and are never freed one by one; ast_arena_free releases
+ * everything at once. Reading a variable whose size is not known yet uses ast_arena_reserve to get
+ * the free tail of the current chunk, then ast_arena_commit to keep only the bytes actually stored.
+ */
+
+#ifndef _AST_ARENA_H
+#define _AST_ARENA_H
+
+#include <stddef.h>
+
+/** Default chunk size. */
+#define AST_ARENA_DEFAULT_CHUNK 16384
+
+/** Alignment of every allocation. */
+#define AST_ARENA_ALIGN 16
+
+struct ast_arena_chunk;
+
+/**
+ * Bump allocator. Zero-initialize it or use ast_arena_init.
+ */
+struct ast_arena {
+    struct ast_arena_chunk *head;     /**< Chunk small allocations come from. */
+    struct ast_arena_chunk *reserved; /**< Chunk of the last reservation. */
+    size_t chunkSiz;                  /**< Size of new chunks; 0 means AST_ARENA_DEFAULT_CHUNK. */
+    size_t nChunks;                   /**< Number of chunks allocated so far (i.e. malloc calls). */
+};
+
+/**
+ * Initialize an arena.
+ *
+ * @param arena    [out] Arena to initialize.
+ * @param chunkSiz [in]  Size of each chunk, or 0 for AST_ARENA_DEFAULT_CHUNK.
+ */
+void ast_arena_init (struct ast_arena *arena, size_t chunkSiz);
+
+/**
+ * Allocate memory from an arena.
+ *
+ * @param arena [in] Arena.
+ * @param size  [in] Number of bytes.
+ * @return Pointer aligned to AST_ARENA_ALIGN, or NULL if out of memory.
+ */
+void *ast_arena_alloc (struct ast_arena *arena, size_t size);
+
+/**
+ * Get at least size bytes of free space without allocating them yet.
+ *
+ * The space stays valid until the next call on the arena. Follow with ast_arena_commit to keep part of it.
+ *
+ * @param arena [in]  Arena.
+ * @param size  [in]  Minimum number of bytes.
+ * @param avail [out] Number of bytes actually available at the returned pointer (>= size).
+ * @return Pointer aligned to AST_ARENA_ALIGN, or NULL if out of memory.
+ */
+void *ast_arena_reserve (struct ast_arena *arena, size_t size, size_t *avail);
+
+/**
+ * Allocate the first size bytes of the last reservation.
+ *
+ * @param arena [in] Arena.
+ * @param size  [in] Number of bytes to keep, at most the reserved amount.
+ */
+void ast_arena_commit (struct ast_arena *arena, size_t size);
+
+/**
+ * Free every allocation of an arena at once. The arena may be used again afterwards.
+ *
+ * @param arena [in] Arena.
+ */
+void ast_arena_free (struct ast_arena *arena);
+
+#endif /* end of include guard: _AST_ARENA_H */
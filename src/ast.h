@@ -15,8 +15,27 @@
 #ifndef _AST_H
 #define _AST_H
 
+#include "guid/guid.h"
 #include "firmware/firmware.h"
 #include "privilege/privilege.h"
-#include "firmware/readefivar.c"
+#include "firmware/readefivar.h"
+#include "unicode/unicode.h"
+#include "devpath/devpath.h"
+#include "loadopt/loadopt.h"
+#include "loadopt/slot.h"
+#include "trace/trace.h"
+#include "snapshot/snapshot.h"
+#include "snapshot/diff.h"
+#include "stats/stats.h"
+#include "watch/watch.h"
+#include "output/output.h"
+#include "output/record.h"
+#include "crypto/sha256.h"
+#include "sigdb/sigdb.h"
+#include "pe/pe.h"
+#include "crypto/crc32.h"
+#include "gpt/gpt.h"
+#include "gpt/disk.h"
+#include "fat/fat.h"
 
 #endif /* end of include guard: _AST_H */
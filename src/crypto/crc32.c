@@ -0,0 +1,77 @@
+/**
+ * @file crc32.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements crc32.h.
+ */
+
+#include <string.h>
+#include "crc32.h"
+#include "../thread/thread.h"
+
+/**
+ * _ast_crc32_table[0] is the usual byte table; _ast_crc32_table[k][b] is the CRC of byte b followed by k
+ * zero bytes, so that eight bytes can be looked up independently and combined.
+ */
+static uint32_t _ast_crc32_table[8][256];
+
+static ast_once _ast_crc32_once = AST_ONCE_INIT;
+
+static void _ast_crc32_init (void);
+
+
+
+
+
+uint32_t ast_crc32 (uint32_t crc, const void *data, size_t size)
+{
+    const uint8_t *p = data;
+
+    ast_once_run (&_ast_crc32_once, _ast_crc32_init);
+
+    crc = ~crc;
+    // Byte by byte up to an 8-byte boundary, 8 bytes at a time, then the tail byte by byte.
+    for (; (size > 0) && (((uintptr_t) p & 7) != 0); size--) {
+        crc = _ast_crc32_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+    for (; size >= 8; size -= 8, p += 8) {
+        uint32_t lo = crc ^ ((uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24));
+        uint32_t hi = (uint32_t) p[4] | ((uint32_t) p[5] << 8) | ((uint32_t) p[6] << 16) | ((uint32_t) p[7] << 24);
+
+        crc = _ast_crc32_table[7][lo & 0xff] ^ _ast_crc32_table[6][(lo >> 8) & 0xff] ^
+              _ast_crc32_table[5][(lo >> 16) & 0xff] ^ _ast_crc32_table[4][lo >> 24] ^
+              _ast_crc32_table[3][hi & 0xff] ^ _ast_crc32_table[2][(hi >> 8) & 0xff] ^
+              _ast_crc32_table[1][(hi >> 16) & 0xff] ^ _ast_crc32_table[0][hi >> 24];
+    }
+    for (; size > 0; size--) {
+        crc = _ast_crc32_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+
+
+
+
+/**
+ * Build the tables, once: concurrent first callers wait for them.
+ */
+static void _ast_crc32_init (void)
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? (c >> 1) ^ 0xEDB88320u : (c >> 1);
+        }
+        _ast_crc32_table[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            _ast_crc32_table[k][i] = (_ast_crc32_table[k - 1][i] >> 8) ^ _ast_crc32_table[0][_ast_crc32_table[k - 1][i] & 0xff];
+        }
+    }
+}
@@ -0,0 +1,31 @@
+/**
+ * @file crc32.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares the CRC-32 of GPT headers, partition entry arrays and snapshot files: the
+ * reflected IEEE 802.3 polynomial, as zlib computes it.
+ *
+ * Eight bytes are folded per step through eight tables (slicing-by-8), instead of one byte per step
+ * through one table.
+ */
+
+#ifndef _AST_CRC32_H
+#define _AST_CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Compute or continue a CRC-32.
+ *
+ * @param crc  [in] 0 to start, or the CRC-32 of the bytes before data to continue.
+ * @param data [in] Bytes.
+ * @param size [in] Size of data.
+ * @return The CRC-32 of everything so far.
+ */
+uint32_t ast_crc32 (uint32_t crc, const void *data, size_t size);
+
+#endif /* end of include guard: _AST_CRC32_H */
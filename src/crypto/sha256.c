@@ -0,0 +1,317 @@
+/**
+ * @file sha256.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements sha256.h.
+ */
+
+#include <string.h>
+#include "sha256.h"
+#include "../firmware/firmware.h"
+
+#if !defined (AST_NO_SHA_NI) && (defined (__x86_64__) || defined (__i386__)) && defined (__GNUC__)
+#define AST_SHA256_HAVE_NI 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+/**
+ * Hash nBlocks whole blocks into state.
+ */
+typedef void (*_ast_sha256_blocks_fn) (uint32_t *state, const uint8_t *data, size_t nBlocks);
+
+static const uint32_t _ast_sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t _ast_sha256_iv[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+/** Engine in use; NULL until the first hash picks one. */
+static _ast_sha256_blocks_fn _ast_sha256_blocks;
+
+static _ast_sha256_blocks_fn _ast_sha256_pick (void);
+static int  _ast_sha256_have_ni (void);
+static void _ast_sha256_blocks_c (uint32_t *state, const uint8_t *data, size_t nBlocks);
+#ifdef AST_SHA256_HAVE_NI
+static void _ast_sha256_blocks_ni (uint32_t *state, const uint8_t *data, size_t nBlocks);
+#endif
+
+
+
+
+
+void ast_sha256_init (struct ast_sha256 *ctx)
+{
+    memcpy (ctx->state, _ast_sha256_iv, sizeof (ctx->state));
+    ctx->length = 0;
+    ctx->used   = 0;
+}
+
+
+
+
+
+void ast_sha256_update (struct ast_sha256 *ctx, const void *data, size_t size)
+{
+    _ast_sha256_blocks_fn blocks = _ast_sha256_pick ();
+    const uint8_t *p = data;
+
+    ctx->length += size;
+    if (ctx->used != 0) {
+        size_t n = AST_SHA256_BLOCK_SIZE - ctx->used;
+
+        if (n > size) {
+            n = size;
+        }
+        memcpy (ctx->block + ctx->used, p, n);
+        ctx->used += n;
+        p    += n;
+        size -= n;
+        if (ctx->used < AST_SHA256_BLOCK_SIZE) {
+            return;
+        }
+        blocks (ctx->state, ctx->block, 1);
+        ctx->used = 0;
+    }
+    if (size >= AST_SHA256_BLOCK_SIZE) {
+        blocks (ctx->state, p, size / AST_SHA256_BLOCK_SIZE);
+        p    += size & ~(size_t) (AST_SHA256_BLOCK_SIZE - 1);
+        size &= AST_SHA256_BLOCK_SIZE - 1;
+    }
+    memcpy (ctx->block, p, size);
+    ctx->used = size;
+}
+
+
+
+
+
+void ast_sha256_final (struct ast_sha256 *ctx, uint8_t *digest)
+{
+    _ast_sha256_blocks_fn blocks = _ast_sha256_pick ();
+    uint64_t bits = ctx->length * 8;
+
+    // Padding: 0x80, zeroes up to 56 bytes into a block, then the length in bits, big endian.
+    ctx->block[ctx->used++] = 0x80;
+    if (ctx->used > AST_SHA256_BLOCK_SIZE - 8) {
+        memset (ctx->block + ctx->used, 0, AST_SHA256_BLOCK_SIZE - ctx->used);
+        blocks (ctx->state, ctx->block, 1);
+        ctx->used = 0;
+    }
+    memset (ctx->block + ctx->used, 0, AST_SHA256_BLOCK_SIZE - 8 - ctx->used);
+    for (int i = 0; i < 8; i++) {
+        ctx->block[AST_SHA256_BLOCK_SIZE - 1 - i] = (uint8_t) (bits >> (8 * i));
+    }
+    blocks (ctx->state, ctx->block, 1);
+
+    for (int i = 0; i < 8; i++) {
+        digest[4 * i]     = (uint8_t) (ctx->state[i] >> 24);
+        digest[4 * i + 1] = (uint8_t) (ctx->state[i] >> 16);
+        digest[4 * i + 2] = (uint8_t) (ctx->state[i] >> 8);
+        digest[4 * i + 3] = (uint8_t) ctx->state[i];
+    }
+}
+
+
+
+
+
+void ast_sha256 (const void *data, size_t size, uint8_t *digest)
+{
+    struct ast_sha256 ctx;
+
+    ast_sha256_init (&ctx);
+    ast_sha256_update (&ctx, data, size);
+    ast_sha256_final (&ctx, digest);
+}
+
+
+
+
+
+int ast_sha256_select (int hardware)
+{
+    if (!hardware) {
+        __atomic_store_n (&_ast_sha256_blocks, _ast_sha256_blocks_c, __ATOMIC_RELAXED);
+        return AST_RETURN_SUCCESS;
+    }
+#ifdef AST_SHA256_HAVE_NI
+    if (_ast_sha256_have_ni ()) {
+        __atomic_store_n (&_ast_sha256_blocks, _ast_sha256_blocks_ni, __ATOMIC_RELAXED);
+        return AST_RETURN_SUCCESS;
+    }
+#endif
+    return AST_RETURN_NOT_SUPPORTED;
+}
+
+
+
+
+
+const char *ast_sha256_engine (void)
+{
+    return (_ast_sha256_pick () == _ast_sha256_blocks_c) ? "portable" : "sha-ni";
+}
+
+
+
+
+
+/**
+ * Get the engine, picking it on first use. Threads racing here all pick the same one.
+ */
+static _ast_sha256_blocks_fn _ast_sha256_pick (void)
+{
+    _ast_sha256_blocks_fn blocks = __atomic_load_n (&_ast_sha256_blocks, __ATOMIC_RELAXED);
+
+    if (blocks == NULL) {
+        blocks = _ast_sha256_blocks_c;
+#ifdef AST_SHA256_HAVE_NI
+        if (_ast_sha256_have_ni ()) {
+            blocks = _ast_sha256_blocks_ni;
+        }
+#endif
+        __atomic_store_n (&_ast_sha256_blocks, blocks, __ATOMIC_RELAXED);
+    }
+    return blocks;
+}
+
+
+
+
+
+static int _ast_sha256_have_ni (void)
+{
+#ifdef AST_SHA256_HAVE_NI
+    unsigned int a = 0, b = 0, c = 0, d = 0;
+
+    // SSSE3 and SSE4.1 (leaf 1, ECX bits 9 and 19) for the shuffles, SHA (leaf 7, EBX bit 29).
+    if (!__get_cpuid (1, &a, &b, &c, &d) || !(c & (1u << 9)) || !(c & (1u << 19))) {
+        return 0;
+    }
+    if (!__get_cpuid_count (7, 0, &a, &b, &c, &d)) {
+        return 0;
+    }
+    return (b & (1u << 29)) != 0;
+#else
+    return 0;
+#endif
+}
+
+
+
+
+
+#define AST_SHA256_ROR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void _ast_sha256_blocks_c (uint32_t *state, const uint8_t *data, size_t nBlocks)
+{
+    for (; nBlocks > 0; nBlocks--, data += AST_SHA256_BLOCK_SIZE) {
+        uint32_t w[64];
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+        for (int t = 0; t < 16; t++) {
+            w[t] = ((uint32_t) data[4 * t] << 24) | ((uint32_t) data[4 * t + 1] << 16) |
+                   ((uint32_t) data[4 * t + 2] << 8) | (uint32_t) data[4 * t + 3];
+        }
+        for (int t = 16; t < 64; t++) {
+            uint32_t s0 = AST_SHA256_ROR (w[t - 15], 7) ^ AST_SHA256_ROR (w[t - 15], 18) ^ (w[t - 15] >> 3);
+            uint32_t s1 = AST_SHA256_ROR (w[t - 2], 17) ^ AST_SHA256_ROR (w[t - 2], 19) ^ (w[t - 2] >> 10);
+
+            w[t] = w[t - 16] + s0 + w[t - 7] + s1;
+        }
+        for (int t = 0; t < 64; t++) {
+            uint32_t s1 = AST_SHA256_ROR (e, 6) ^ AST_SHA256_ROR (e, 11) ^ AST_SHA256_ROR (e, 25);
+            uint32_t ch = (e & f) ^ (~e & g);
+            uint32_t t1 = h + s1 + ch + _ast_sha256_k[t] + w[t];
+            uint32_t s0 = AST_SHA256_ROR (a, 2) ^ AST_SHA256_ROR (a, 13) ^ AST_SHA256_ROR (a, 22);
+            uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+            uint32_t t2 = s0 + maj;
+
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+
+
+
+
+#ifdef AST_SHA256_HAVE_NI
+/**
+ * SHA-NI keeps the state as two vectors, ABEF and CDGH, and does two rounds per SHA256RNDS2. Each group of
+ * four message words is computed from the previous four groups with SHA256MSG1 and SHA256MSG2.
+ */
+__attribute__ ((target ("sha,sse4.1")))
+static void _ast_sha256_blocks_ni (uint32_t *state, const uint8_t *data, size_t nBlocks)
+{
+    const __m128i mask = _mm_set_epi64x (0x0c0d0e0f08090a0bLL, 0x0405060700010203LL);
+    __m128i abef, cdgh, tmp;
+
+    // Load DCBA and HGFE, reorder into ABEF and CDGH.
+    tmp  = _mm_shuffle_epi32 (_mm_loadu_si128 ((const __m128i *) &(state[0])), 0xb1);
+    cdgh = _mm_shuffle_epi32 (_mm_loadu_si128 ((const __m128i *) &(state[4])), 0x1b);
+    abef = _mm_alignr_epi8 (tmp, cdgh, 8);
+    cdgh = _mm_blend_epi16 (cdgh, tmp, 0xf0);
+
+    for (; nBlocks > 0; nBlocks--, data += AST_SHA256_BLOCK_SIZE) {
+        __m128i abefSave = abef, cdghSave = cdgh;
+        __m128i m[4];
+
+        // Unrolled, m[] is four registers.
+#pragma GCC unroll 16
+        for (int i = 0; i < 16; i++) {
+            __m128i k;
+
+            if (i < 4) {
+                m[i] = _mm_shuffle_epi8 (_mm_loadu_si128 ((const __m128i *) (data + 16 * i)), mask);
+            } else {
+                // W[t] = s1(W[t-2]) + W[t-7] + s0(W[t-15]) + W[t-16], four at a time.
+                tmp      = _mm_add_epi32 (_mm_sha256msg1_epu32 (m[i & 3], m[(i + 1) & 3]), _mm_alignr_epi8 (m[(i + 3) & 3], m[(i + 2) & 3], 4));
+                m[i & 3] = _mm_sha256msg2_epu32 (tmp, m[(i + 3) & 3]);
+            }
+            k    = _mm_add_epi32 (m[i & 3], _mm_loadu_si128 ((const __m128i *) &(_ast_sha256_k[4 * i])));
+            cdgh = _mm_sha256rnds2_epu32 (cdgh, abef, k);
+            abef = _mm_sha256rnds2_epu32 (abef, cdgh, _mm_shuffle_epi32 (k, 0x0e));
+        }
+        abef = _mm_add_epi32 (abef, abefSave);
+        cdgh = _mm_add_epi32 (cdgh, cdghSave);
+    }
+
+    // Back to DCBA and HGFE.
+    tmp  = _mm_shuffle_epi32 (abef, 0x1b);
+    cdgh = _mm_shuffle_epi32 (cdgh, 0xb1);
+    abef = _mm_blend_epi16 (tmp, cdgh, 0xf0);
+    cdgh = _mm_alignr_epi8 (cdgh, tmp, 8);
+    _mm_storeu_si128 ((__m128i *) &(state[0]), abef);
+    _mm_storeu_si128 ((__m128i *) &(state[4]), cdgh);
+}
+#endif
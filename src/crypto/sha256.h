@@ -0,0 +1,85 @@
+/**
+ * @file sha256.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares a streaming SHA-256 (FIPS 180-4).
+ *
+ * Whole blocks are hashed straight from the caller's buffer; only a partial block is copied. On x86
+ * processors with the SHA extensions, blocks go through the SHA-NI instructions, otherwise through
+ * portable C. The engine is picked on first use; build with `-DAST_NO_SHA_NI` to leave SHA-NI out.
+ */
+
+#ifndef _AST_SHA256_H
+#define _AST_SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Size of a SHA-256 digest. */
+#define AST_SHA256_SIZE 32
+
+/** Size of a SHA-256 block. */
+#define AST_SHA256_BLOCK_SIZE 64
+
+/**
+ * Hash state. Initialize with ast_sha256_init; it can live on the stack.
+ */
+struct ast_sha256 {
+    uint32_t state[8];                      /**< Intermediate hash value. */
+    uint64_t length;                        /**< Bytes hashed so far. */
+    uint8_t  block[AST_SHA256_BLOCK_SIZE];  /**< Partial block. */
+    size_t   used;                          /**< Bytes in block. */
+};
+
+/**
+ * Start a hash.
+ *
+ * @param ctx [out] Hash state.
+ */
+void ast_sha256_init (struct ast_sha256 *ctx);
+
+/**
+ * Hash more bytes.
+ *
+ * @param ctx  [in] Hash state.
+ * @param data [in] Bytes.
+ * @param size [in] Size of data.
+ */
+void ast_sha256_update (struct ast_sha256 *ctx, const void *data, size_t size);
+
+/**
+ * Finish a hash. The state must be initialized again before it is reused.
+ *
+ * @param ctx    [in]  Hash state.
+ * @param digest [out] AST_SHA256_SIZE bytes.
+ */
+void ast_sha256_final (struct ast_sha256 *ctx, uint8_t *digest);
+
+/**
+ * Hash a buffer in one call.
+ *
+ * @param data   [in]  Bytes.
+ * @param size   [in]  Size of data.
+ * @param digest [out] AST_SHA256_SIZE bytes.
+ */
+void ast_sha256 (const void *data, size_t size, uint8_t *digest);
+
+/**
+ * Choose the engine, e.g. to compare them.
+ *
+ * @param hardware [in] Nonzero for SHA-NI, zero for portable C.
+ * @return AST_RETURN_SUCCESS, or AST_RETURN_NOT_SUPPORTED if SHA-NI is asked for but unavailable.
+ */
+int ast_sha256_select (int hardware);
+
+/**
+ * Name the engine in use.
+ *
+ * @return "sha-ni" or "portable".
+ */
+const char *ast_sha256_engine (void);
+
+#endif /* end of include guard: _AST_SHA256_H */
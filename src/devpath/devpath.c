@@ -0,0 +1,681 @@
+/**
+ * @file devpath.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements devpath.h.
+ *
+ * Node fields are little endian and unaligned, so they are assembled byte by byte.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include "devpath.h"
+#include "../firmware/firmware.h"
+#include "../unicode/unicode.h"
+
+#define AST_DEVPATH_EISA_PNP0A03 0x0A0341D0 // PCI root bridge
+#define AST_DEVPATH_EISA_PNP0A08 0x0A0841D0 // PCI Express root bridge
+
+struct _ast_text {
+    char   *buf;
+    size_t siz;
+    size_t len;
+};
+
+static uint16_t _ast_le16 (const uint8_t *p);
+static uint32_t _ast_le32 (const uint8_t *p);
+static uint64_t _ast_le64 (const uint8_t *p);
+static void     _ast_put16 (uint8_t *p, uint16_t v);
+static void     _ast_put32 (uint8_t *p, uint32_t v);
+static void     _ast_put64 (uint8_t *p, uint64_t v);
+static int      _ast_devpath_is (const struct ast_devpath_node *node, uint8_t type, uint8_t subType, size_t minLength);
+static uint8_t *_ast_devpath_node_begin (struct ast_devpath_builder *builder, uint8_t type, uint8_t subType, size_t dataSiz);
+static void     _ast_text_printf (struct _ast_text *t, const char *format, ...);
+static void     _ast_text_guid (struct _ast_text *t, const uint8_t *guid);
+static void     _ast_text_hex (struct _ast_text *t, const uint8_t *data, size_t size);
+static void     _ast_text_eisa (struct _ast_text *t, uint32_t id);
+static void     _ast_text_node (struct _ast_text *t, const struct ast_devpath_node *node);
+
+
+
+
+
+void ast_devpath_iter_init (struct ast_devpath_iter *iter, const void *data, size_t size)
+{
+    iter->p    = data;
+    iter->left = (data == NULL) ? 0 : size;
+    iter->done = 0;
+}
+
+
+
+
+
+int ast_devpath_next (struct ast_devpath_iter *iter, struct ast_devpath_node *node)
+{
+    uint16_t length = 0;
+
+    if (iter->done || (iter->left == 0)) {
+        return 0;
+    }
+    if (iter->left < AST_DEVPATH_HEADER_SIZE) {
+        iter->done = 1;
+        return -1;
+    }
+
+    length = _ast_le16 (iter->p + 2);
+    if ((length < AST_DEVPATH_HEADER_SIZE) || (length > iter->left)) {
+        iter->done = 1;
+        return -1;
+    }
+
+    node->type    = iter->p[0];
+    node->subType = iter->p[1];
+    node->length  = length;
+    node->data    = iter->p + AST_DEVPATH_HEADER_SIZE;
+    node->dataSiz = length - AST_DEVPATH_HEADER_SIZE;
+
+    iter->p    += length;
+    iter->left -= length;
+    if ((node->type == AST_DEVPATH_TYPE_END) && (node->subType == AST_DEVPATH_END_ENTIRE)) {
+        iter->done = 1;
+    }
+    return 1;
+}
+
+
+
+
+
+size_t ast_devpath_size (const void *data, size_t size)
+{
+    struct ast_devpath_iter iter;
+    struct ast_devpath_node node;
+    size_t total = 0;
+
+    ast_devpath_iter_init (&iter, data, size);
+    while (ast_devpath_next (&iter, &node) == 1) {
+        total += node.length;
+        if ((node.type == AST_DEVPATH_TYPE_END) && (node.subType == AST_DEVPATH_END_ENTIRE)) {
+            return total;
+        }
+    }
+
+    return 0;
+}
+
+
+
+
+
+int ast_devpath_decode_pci (const struct ast_devpath_node *node, struct ast_devpath_pci *pci)
+{
+    if (!_ast_devpath_is (node, AST_DEVPATH_TYPE_HARDWARE, AST_DEVPATH_HW_PCI, 6)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    pci->function = node->data[0];
+    pci->device   = node->data[1];
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+int ast_devpath_decode_acpi (const struct ast_devpath_node *node, struct ast_devpath_acpi *acpi)
+{
+    if (!_ast_devpath_is (node, AST_DEVPATH_TYPE_ACPI, AST_DEVPATH_ACPI_ACPI, 12)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    acpi->hid = _ast_le32 (node->data);
+    acpi->uid = _ast_le32 (node->data + 4);
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+int ast_devpath_decode_scsi (const struct ast_devpath_node *node, struct ast_devpath_scsi *scsi)
+{
+    if (!_ast_devpath_is (node, AST_DEVPATH_TYPE_MESSAGING, AST_DEVPATH_MSG_SCSI, 8)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    scsi->pun = _ast_le16 (node->data);
+    scsi->lun = _ast_le16 (node->data + 2);
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+int ast_devpath_decode_usb (const struct ast_devpath_node *node, struct ast_devpath_usb *usb)
+{
+    if (!_ast_devpath_is (node, AST_DEVPATH_TYPE_MESSAGING, AST_DEVPATH_MSG_USB, 6)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    usb->parentPort = node->data[0];
+    usb->interface  = node->data[1];
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+int ast_devpath_decode_mac (const struct ast_devpath_node *node, struct ast_devpath_mac *mac)
+{
+    if (!_ast_devpath_is (node, AST_DEVPATH_TYPE_MESSAGING, AST_DEVPATH_MSG_MAC, 37)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    memcpy (mac->address, node->data, 32);
+    mac->ifType = node->data[32];
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+int ast_devpath_decode_sata (const struct ast_devpath_node *node, struct ast_devpath_sata *sata)
+{
+    if (!_ast_devpath_is (node, AST_DEVPATH_TYPE_MESSAGING, AST_DEVPATH_MSG_SATA, 10)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    sata->hbaPort = _ast_le16 (node->data);
+    sata->pmPort  = _ast_le16 (node->data + 2);
+    sata->lun     = _ast_le16 (node->data + 4);
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+int ast_devpath_decode_nvme (const struct ast_devpath_node *node, struct ast_devpath_nvme *nvme)
+{
+    if (!_ast_devpath_is (node, AST_DEVPATH_TYPE_MESSAGING, AST_DEVPATH_MSG_NVME, 16)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    nvme->nsid = _ast_le32 (node->data);
+    memcpy (nvme->eui64, node->data + 4, 8);
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+int ast_devpath_decode_hd (const struct ast_devpath_node *node, struct ast_devpath_hd *hd)
+{
+    if (!_ast_devpath_is (node, AST_DEVPATH_TYPE_MEDIA, AST_DEVPATH_MEDIA_HD, 42)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    hd->partitionNumber = _ast_le32 (node->data);
+    hd->partitionStart  = _ast_le64 (node->data + 4);
+    hd->partitionSize   = _ast_le64 (node->data + 12);
+    memcpy (hd->signature, node->data + 20, 16);
+    hd->partitionFormat = node->data[36];
+    hd->signatureType   = node->data[37];
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+int ast_devpath_decode_file (const struct ast_devpath_node *node, struct ast_devpath_file *file)
+{
+    if (!_ast_devpath_is (node, AST_DEVPATH_TYPE_MEDIA, AST_DEVPATH_MEDIA_FILE_PATH, AST_DEVPATH_HEADER_SIZE)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    file->path    = node->data;
+    file->pathSiz = node->dataSiz;
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+int ast_devpath_decode_fv (const struct ast_devpath_node *node, struct ast_devpath_fv *fv)
+{
+    if (!_ast_devpath_is (node, AST_DEVPATH_TYPE_MEDIA, AST_DEVPATH_MEDIA_FV_FILE, 20)
+        && !_ast_devpath_is (node, AST_DEVPATH_TYPE_MEDIA, AST_DEVPATH_MEDIA_FV, 20)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    memcpy (fv->guid, node->data, 16);
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+void ast_devpath_builder_init (struct ast_devpath_builder *builder, void *buf, size_t bufSiz)
+{
+    builder->buf    = buf;
+    builder->bufSiz = (buf == NULL) ? 0 : bufSiz;
+    builder->len    = 0;
+    builder->error  = 0;
+}
+
+
+
+
+
+void ast_devpath_add_node (struct ast_devpath_builder *builder, uint8_t type, uint8_t subType, const void *data, size_t dataSiz)
+{
+    uint8_t *p = _ast_devpath_node_begin (builder, type, subType, dataSiz);
+
+    if ((p != NULL) && (dataSiz != 0)) {
+        memcpy (p, data, dataSiz);
+    }
+}
+
+
+
+
+
+void ast_devpath_add_pci (struct ast_devpath_builder *builder, const struct ast_devpath_pci *pci)
+{
+    uint8_t *p = _ast_devpath_node_begin (builder, AST_DEVPATH_TYPE_HARDWARE, AST_DEVPATH_HW_PCI, 2);
+
+    if (p != NULL) {
+        p[0] = pci->function;
+        p[1] = pci->device;
+    }
+}
+
+
+
+
+
+void ast_devpath_add_acpi (struct ast_devpath_builder *builder, const struct ast_devpath_acpi *acpi)
+{
+    uint8_t *p = _ast_devpath_node_begin (builder, AST_DEVPATH_TYPE_ACPI, AST_DEVPATH_ACPI_ACPI, 8);
+
+    if (p != NULL) {
+        _ast_put32 (p, acpi->hid);
+        _ast_put32 (p + 4, acpi->uid);
+    }
+}
+
+
+
+
+
+void ast_devpath_add_sata (struct ast_devpath_builder *builder, const struct ast_devpath_sata *sata)
+{
+    uint8_t *p = _ast_devpath_node_begin (builder, AST_DEVPATH_TYPE_MESSAGING, AST_DEVPATH_MSG_SATA, 6);
+
+    if (p != NULL) {
+        _ast_put16 (p, sata->hbaPort);
+        _ast_put16 (p + 2, sata->pmPort);
+        _ast_put16 (p + 4, sata->lun);
+    }
+}
+
+
+
+
+
+void ast_devpath_add_nvme (struct ast_devpath_builder *builder, const struct ast_devpath_nvme *nvme)
+{
+    uint8_t *p = _ast_devpath_node_begin (builder, AST_DEVPATH_TYPE_MESSAGING, AST_DEVPATH_MSG_NVME, 12);
+
+    if (p != NULL) {
+        _ast_put32 (p, nvme->nsid);
+        memcpy (p + 4, nvme->eui64, 8);
+    }
+}
+
+
+
+
+
+void ast_devpath_add_hd (struct ast_devpath_builder *builder, const struct ast_devpath_hd *hd)
+{
+    uint8_t *p = _ast_devpath_node_begin (builder, AST_DEVPATH_TYPE_MEDIA, AST_DEVPATH_MEDIA_HD, 38);
+
+    if (p != NULL) {
+        _ast_put32 (p, hd->partitionNumber);
+        _ast_put64 (p + 4, hd->partitionStart);
+        _ast_put64 (p + 12, hd->partitionSize);
+        memcpy (p + 20, hd->signature, 16);
+        p[36] = hd->partitionFormat;
+        p[37] = hd->signatureType;
+    }
+}
+
+
+
+
+
+void ast_devpath_add_file (struct ast_devpath_builder *builder, const char *path)
+{
+    size_t  units = ast_utf16_units (path);
+    uint8_t *p = NULL;
+
+    if (units == SIZE_MAX) {
+        builder->error = 1;
+        return;
+    }
+
+    p = _ast_devpath_node_begin (builder, AST_DEVPATH_TYPE_MEDIA, AST_DEVPATH_MEDIA_FILE_PATH, (units + 1) * 2);
+    if (p != NULL) {
+        p += ast_utf16_encode (p, path);
+        p[0] = 0;
+        p[1] = 0;
+    }
+}
+
+
+
+
+
+void ast_devpath_add_end (struct ast_devpath_builder *builder, uint8_t subType)
+{
+    _ast_devpath_node_begin (builder, AST_DEVPATH_TYPE_END, subType, 0);
+}
+
+
+
+
+
+int ast_devpath_builder_finish (const struct ast_devpath_builder *builder, size_t *nBytes)
+{
+    if (builder->error) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    if (nBytes != NULL) {
+        *nBytes = builder->len;
+    }
+    return (builder->len > builder->bufSiz) ? AST_RETURN_BUFFER_TOO_SMALL : AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+size_t ast_devpath_to_text (const void *data, size_t size, char *text, size_t textSiz)
+{
+    struct _ast_text t = { text, (text == NULL) ? 0 : textSiz, 0 };
+    struct ast_devpath_iter iter;
+    struct ast_devpath_node node;
+    int first = 1;
+    int ret = 0;
+
+    if (t.siz != 0) {
+        t.buf[0] = '\0';
+    }
+
+    ast_devpath_iter_init (&iter, data, size);
+    while ((ret = ast_devpath_next (&iter, &node)) == 1) {
+        if (node.type == AST_DEVPATH_TYPE_END) {
+            if (node.subType == AST_DEVPATH_END_INSTANCE) {
+                _ast_text_printf (&t, ",");
+                first = 1;
+            }
+            continue;
+        }
+        if (!first) {
+            _ast_text_printf (&t, "/");
+        }
+        _ast_text_node (&t, &node);
+        first = 0;
+    }
+    if (ret < 0) {
+        _ast_text_printf (&t, "%s<malformed>", first ? "" : "/");
+    }
+
+    return t.len;
+}
+
+
+
+
+
+static uint16_t _ast_le16 (const uint8_t *p)
+{
+    return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+
+
+
+
+static uint32_t _ast_le32 (const uint8_t *p)
+{
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+
+
+
+
+static uint64_t _ast_le64 (const uint8_t *p)
+{
+    return (uint64_t) _ast_le32 (p) | ((uint64_t) _ast_le32 (p + 4) << 32);
+}
+
+
+
+
+
+static void _ast_put16 (uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t) v;
+    p[1] = (uint8_t) (v >> 8);
+}
+
+
+
+
+
+static void _ast_put32 (uint8_t *p, uint32_t v)
+{
+    _ast_put16 (p, (uint16_t) v);
+    _ast_put16 (p + 2, (uint16_t) (v >> 16));
+}
+
+
+
+
+
+static void _ast_put64 (uint8_t *p, uint64_t v)
+{
+    _ast_put32 (p, (uint32_t) v);
+    _ast_put32 (p + 4, (uint32_t) (v >> 32));
+}
+
+
+
+
+
+static int _ast_devpath_is (const struct ast_devpath_node *node, uint8_t type, uint8_t subType, size_t minLength)
+{
+    return (node != NULL) && (node->type == type) && (node->subType == subType) && (node->length >= minLength);
+}
+
+
+
+
+
+static uint8_t *_ast_devpath_node_begin (struct ast_devpath_builder *builder, uint8_t type, uint8_t subType, size_t dataSiz)
+{
+    // Returns where the node data goes, or NULL if the node is only counted.
+    size_t  length = AST_DEVPATH_HEADER_SIZE + dataSiz;
+    uint8_t *p = NULL;
+
+    if (dataSiz > UINT16_MAX - AST_DEVPATH_HEADER_SIZE) {
+        builder->error = 1;
+        return NULL;
+    }
+
+    // Once a node has not fit, len exceeds bufSiz and no later node is written.
+    if ((builder->buf != NULL) && (builder->len + length <= builder->bufSiz)) {
+        p = builder->buf + builder->len;
+        p[0] = type;
+        p[1] = subType;
+        _ast_put16 (p + 2, (uint16_t) length);
+        p += AST_DEVPATH_HEADER_SIZE;
+    }
+    builder->len += length;
+    return p;
+}
+
+
+
+
+
+static void _ast_text_printf (struct _ast_text *t, const char *format, ...)
+{
+    va_list ap;
+    int n = 0;
+
+    va_start (ap, format);
+    if (t->len < t->siz) {
+        n = vsnprintf (t->buf + t->len, t->siz - t->len, format, ap);
+    } else {
+        n = vsnprintf (NULL, 0, format, ap);
+    }
+    va_end (ap);
+
+    if (n > 0) {
+        t->len += (size_t) n;
+    }
+}
+
+
+
+
+
+static void _ast_text_guid (struct _ast_text *t, const uint8_t *guid)
+{
+    _ast_text_printf (t, "%08x-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+                      (unsigned int) _ast_le32 (guid), (unsigned int) _ast_le16 (guid + 4), (unsigned int) _ast_le16 (guid + 6),
+                      guid[8], guid[9], guid[10], guid[11], guid[12], guid[13], guid[14], guid[15]);
+}
+
+
+
+
+
+static void _ast_text_hex (struct _ast_text *t, const uint8_t *data, size_t size)
+{
+    for (size_t i = 0; i < size; i++) {
+        _ast_text_printf (t, "%02X", data[i]);
+    }
+}
+
+
+
+
+
+static void _ast_text_eisa (struct _ast_text *t, uint32_t id)
+{
+    // Compressed EISA id: three 5-bit letters in the low word, product number in the high word.
+    _ast_text_printf (t, "%c%c%c%04X",
+                      (char) ('@' + ((id >> 10) & 0x1F)), (char) ('@' + ((id >> 5) & 0x1F)), (char) ('@' + (id & 0x1F)),
+                      (unsigned int) (id >> 16));
+}
+
+
+
+
+
+static void _ast_text_node (struct _ast_text *t, const struct ast_devpath_node *node)
+{
+    union {
+        struct ast_devpath_pci  pci;
+        struct ast_devpath_acpi acpi;
+        struct ast_devpath_scsi scsi;
+        struct ast_devpath_usb  usb;
+        struct ast_devpath_mac  mac;
+        struct ast_devpath_sata sata;
+        struct ast_devpath_nvme nvme;
+        struct ast_devpath_hd   hd;
+        struct ast_devpath_file file;
+        struct ast_devpath_fv   fv;
+    } u;
+
+    if (ast_devpath_decode_pci (node, &u.pci) == AST_RETURN_SUCCESS) {
+        _ast_text_printf (t, "Pci(0x%X,0x%X)", u.pci.device, u.pci.function);
+    } else if (ast_devpath_decode_acpi (node, &u.acpi) == AST_RETURN_SUCCESS) {
+        if (u.acpi.hid == AST_DEVPATH_EISA_PNP0A03) {
+            _ast_text_printf (t, "PciRoot(0x%X)", (unsigned int) u.acpi.uid);
+        } else if (u.acpi.hid == AST_DEVPATH_EISA_PNP0A08) {
+            _ast_text_printf (t, "PcieRoot(0x%X)", (unsigned int) u.acpi.uid);
+        } else {
+            _ast_text_printf (t, "Acpi(");
+            _ast_text_eisa (t, u.acpi.hid);
+            _ast_text_printf (t, ",0x%X)", (unsigned int) u.acpi.uid);
+        }
+    } else if (ast_devpath_decode_scsi (node, &u.scsi) == AST_RETURN_SUCCESS) {
+        _ast_text_printf (t, "Scsi(0x%X,0x%X)", u.scsi.pun, u.scsi.lun);
+    } else if (ast_devpath_decode_usb (node, &u.usb) == AST_RETURN_SUCCESS) {
+        _ast_text_printf (t, "USB(0x%X,0x%X)", u.usb.parentPort, u.usb.interface);
+    } else if (ast_devpath_decode_mac (node, &u.mac) == AST_RETURN_SUCCESS) {
+        _ast_text_printf (t, "MAC(");
+        _ast_text_hex (t, u.mac.address, (u.mac.ifType <= 1) ? 6 : 32);
+        _ast_text_printf (t, ",0x%X)", u.mac.ifType);
+    } else if (ast_devpath_decode_sata (node, &u.sata) == AST_RETURN_SUCCESS) {
+        _ast_text_printf (t, "Sata(0x%X,0x%X,0x%X)", u.sata.hbaPort, u.sata.pmPort, u.sata.lun);
+    } else if (ast_devpath_decode_nvme (node, &u.nvme) == AST_RETURN_SUCCESS) {
+        _ast_text_printf (t, "NVMe(0x%X,%02X-%02X-%02X-%02X-%02X-%02X-%02X-%02X)", (unsigned int) u.nvme.nsid,
+                          u.nvme.eui64[0], u.nvme.eui64[1], u.nvme.eui64[2], u.nvme.eui64[3],
+                          u.nvme.eui64[4], u.nvme.eui64[5], u.nvme.eui64[6], u.nvme.eui64[7]);
+    } else if ((node->type == AST_DEVPATH_TYPE_MESSAGING) && (node->subType == AST_DEVPATH_MSG_IPV4) && (node->dataSiz >= 8)) {
+        const uint8_t *ip = node->data + 4; // Remote address
+        _ast_text_printf (t, "IPv4(%u.%u.%u.%u)", ip[0], ip[1], ip[2], ip[3]);
+    } else if ((node->type == AST_DEVPATH_TYPE_MESSAGING) && (node->subType == AST_DEVPATH_MSG_URI)) {
+        _ast_text_printf (t, "Uri(");
+        for (size_t i = 0; i < node->dataSiz; i++) {
+            char ch = (char) node->data[i];
+            _ast_text_printf (t, "%c", ((ch >= 0x20) && (ch < 0x7F)) ? ch : '?');
+        }
+        _ast_text_printf (t, ")");
+    } else if (ast_devpath_decode_hd (node, &u.hd) == AST_RETURN_SUCCESS) {
+        _ast_text_printf (t, "HD(%u,", (unsigned int) u.hd.partitionNumber);
+        if (u.hd.signatureType == AST_DEVPATH_HD_SIGNATURE_GUID) {
+            _ast_text_printf (t, "GPT,");
+            _ast_text_guid (t, u.hd.signature);
+        } else if (u.hd.signatureType == AST_DEVPATH_HD_SIGNATURE_MBR) {
+            _ast_text_printf (t, "MBR,0x%08X", (unsigned int) _ast_le32 (u.hd.signature));
+        } else {
+            _ast_text_printf (t, "%u,0", u.hd.signatureType);
+        }
+        _ast_text_printf (t, ",0x%llX,0x%llX)", (unsigned long long) u.hd.partitionStart, (unsigned long long) u.hd.partitionSize);
+    } else if ((node->type == AST_DEVPATH_TYPE_MEDIA) && (node->subType == AST_DEVPATH_MEDIA_CDROM) && (node->dataSiz >= 20)) {
+        _ast_text_printf (t, "CDROM(0x%X,0x%llX,0x%llX)", (unsigned int) _ast_le32 (node->data),
+                          (unsigned long long) _ast_le64 (node->data + 4), (unsigned long long) _ast_le64 (node->data + 12));
+    } else if (ast_devpath_decode_file (node, &u.file) == AST_RETURN_SUCCESS) {
+        size_t n = ast_utf16_decode (u.file.path, u.file.pathSiz, (t->len < t->siz) ? t->buf + t->len : NULL,
+                                     (t->len < t->siz) ? t->siz - t->len : 0);
+        t->len += n;
+    } else if (ast_devpath_decode_fv (node, &u.fv) == AST_RETURN_SUCCESS) {
+        _ast_text_printf (t, (node->subType == AST_DEVPATH_MEDIA_FV) ? "Fv(" : "FvFile(");
+        _ast_text_guid (t, u.fv.guid);
+        _ast_text_printf (t, ")");
+    } else if (((node->type == AST_DEVPATH_TYPE_HARDWARE) && (node->subType == AST_DEVPATH_HW_VENDOR) && (node->dataSiz >= 16))
+               || ((node->type == AST_DEVPATH_TYPE_MEDIA) && (node->subType == AST_DEVPATH_MEDIA_VENDOR) && (node->dataSiz >= 16))) {
+        _ast_text_printf (t, (node->type == AST_DEVPATH_TYPE_HARDWARE) ? "VenHw(" : "VenMedia(");
+        _ast_text_guid (t, node->data);
+        if (node->dataSiz > 16) {
+            _ast_text_printf (t, ",");
+            _ast_text_hex (t, node->data + 16, node->dataSiz - 16);
+        }
+        _ast_text_printf (t, ")");
+    } else {
+        // Anything else, or a known node that is too short, in the generic form.
+        _ast_text_printf (t, "Path(%u,%u,", node->type, node->subType);
+        _ast_text_hex (t, node->data, node->dataSiz);
+        _ast_text_printf (t, ")");
+    }
+}
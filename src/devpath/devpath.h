@@ -0,0 +1,281 @@
+/**
+ * @file devpath.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares the device path iterator, decoders, builder and text renderer.
+ *
+ * A device path (UEFI specification 2.6: 9.2 EFI Device Path Protocol) is a packed sequence of nodes,
+ * each a 4-byte header (Type, SubType, 16-bit little endian Length) followed by Length - 4 bytes of data.
+ * End Instance nodes separate instances; an End Entire node closes the path.
+ *
+ * Device paths come from variables, i.e. from anywhere, so nothing here trusts a length: every node is
+ * checked against the span it lives in, and typed decoders check the node is long enough for its type.
+ * Nothing here allocates.
+ */
+
+#ifndef _AST_DEVPATH_H
+#define _AST_DEVPATH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @defgroup DevicePathTypes Device path node types and subtypes
+ * @{
+ */
+#define AST_DEVPATH_TYPE_HARDWARE   0x01
+#define AST_DEVPATH_TYPE_ACPI       0x02
+#define AST_DEVPATH_TYPE_MESSAGING  0x03
+#define AST_DEVPATH_TYPE_MEDIA      0x04
+#define AST_DEVPATH_TYPE_BBS        0x05
+#define AST_DEVPATH_TYPE_END        0x7F
+
+#define AST_DEVPATH_HW_PCI          0x01
+#define AST_DEVPATH_HW_VENDOR       0x04
+
+#define AST_DEVPATH_ACPI_ACPI       0x01
+
+#define AST_DEVPATH_MSG_SCSI        0x02
+#define AST_DEVPATH_MSG_USB         0x05
+#define AST_DEVPATH_MSG_MAC         0x0B
+#define AST_DEVPATH_MSG_IPV4        0x0C
+#define AST_DEVPATH_MSG_SATA        0x12
+#define AST_DEVPATH_MSG_NVME        0x17
+#define AST_DEVPATH_MSG_URI         0x18
+
+#define AST_DEVPATH_MEDIA_HD        0x01
+#define AST_DEVPATH_MEDIA_CDROM     0x02
+#define AST_DEVPATH_MEDIA_VENDOR    0x03
+#define AST_DEVPATH_MEDIA_FILE_PATH 0x04
+#define AST_DEVPATH_MEDIA_FV_FILE   0x06
+#define AST_DEVPATH_MEDIA_FV        0x07
+
+#define AST_DEVPATH_END_INSTANCE    0x01
+#define AST_DEVPATH_END_ENTIRE      0xFF
+/** @} */
+
+/**
+ * Size of a node header.
+ */
+#define AST_DEVPATH_HEADER_SIZE 4
+
+/**
+ * Values of the HD node's PartitionFormat field.
+ */
+#define AST_DEVPATH_HD_FORMAT_MBR 0x01
+#define AST_DEVPATH_HD_FORMAT_GPT 0x02
+
+/**
+ * Values of the HD node's SignatureType field.
+ */
+#define AST_DEVPATH_HD_SIGNATURE_NONE 0x00
+#define AST_DEVPATH_HD_SIGNATURE_MBR  0x01
+#define AST_DEVPATH_HD_SIGNATURE_GUID 0x02
+
+/**
+ * One node, as found by ast_devpath_next. data points into the iterated span.
+ */
+struct ast_devpath_node {
+    uint8_t       type;    /**< AST_DEVPATH_TYPE_* */
+    uint8_t       subType; /**< Subtype, meaning depends on type */
+    uint16_t      length;  /**< Length of the whole node, header included */
+    const uint8_t *data;   /**< Node data after the header */
+    size_t        dataSiz; /**< length - AST_DEVPATH_HEADER_SIZE */
+};
+
+/**
+ * Node iterator over a byte span. Initialize with ast_devpath_iter_init; it can live on the stack.
+ */
+struct ast_devpath_iter {
+    const uint8_t *p;    /**< Next node */
+    size_t        left;  /**< Bytes left in the span */
+    int           done;  /**< Set after End Entire or an error */
+};
+
+/** PCI node (Hardware, subtype 1). */
+struct ast_devpath_pci {
+    uint8_t function;
+    uint8_t device;
+};
+
+/** ACPI node (ACPI, subtype 1). */
+struct ast_devpath_acpi {
+    uint32_t hid; /**< Compressed EISA id, e.g. 0x0A0341D0 for PNP0A03 */
+    uint32_t uid;
+};
+
+/** SCSI node (Messaging, subtype 2). */
+struct ast_devpath_scsi {
+    uint16_t pun;
+    uint16_t lun;
+};
+
+/** USB node (Messaging, subtype 5). */
+struct ast_devpath_usb {
+    uint8_t parentPort;
+    uint8_t interface;
+};
+
+/** MAC address node (Messaging, subtype 11). */
+struct ast_devpath_mac {
+    uint8_t address[32];
+    uint8_t ifType; /**< RFC 3232 interface type; 0 or 1 means the address is 6 bytes */
+};
+
+/** SATA node (Messaging, subtype 18). */
+struct ast_devpath_sata {
+    uint16_t hbaPort;
+    uint16_t pmPort; /**< 0xFFFF if the device is directly connected */
+    uint16_t lun;
+};
+
+/** NVMe namespace node (Messaging, subtype 23). */
+struct ast_devpath_nvme {
+    uint32_t nsid;
+    uint8_t  eui64[8];
+};
+
+/** Hard drive media node (Media, subtype 1). */
+struct ast_devpath_hd {
+    uint32_t partitionNumber;
+    uint64_t partitionStart;    /**< In LBAs */
+    uint64_t partitionSize;     /**< In LBAs */
+    uint8_t  signature[16];     /**< GPT unique partition GUID (raw bytes) or MBR signature in the first 4 bytes */
+    uint8_t  partitionFormat;   /**< AST_DEVPATH_HD_FORMAT_* */
+    uint8_t  signatureType;     /**< AST_DEVPATH_HD_SIGNATURE_* */
+};
+
+/** File path media node (Media, subtype 4). The path is UTF-16 LE inside the node; see ast_utf16_decode. */
+struct ast_devpath_file {
+    const uint8_t *path;
+    size_t        pathSiz; /**< Size in bytes, terminator included if present */
+};
+
+/** Firmware volume and firmware file media nodes (Media, subtypes 6 and 7). */
+struct ast_devpath_fv {
+    uint8_t guid[16]; /**< Raw GUID bytes */
+};
+
+/**
+ * Builder writing a device path into a caller buffer. Once the buffer is full, further nodes are only
+ * counted, so the required size is known after one pass.
+ */
+struct ast_devpath_builder {
+    uint8_t *buf;   /**< Caller buffer */
+    size_t  bufSiz; /**< Size of buf */
+    size_t  len;    /**< Bytes the path needs so far */
+    int     error;  /**< Set if a node was invalid (e.g. too long) */
+};
+
+/**
+ * Start iterating the nodes of a device path.
+ *
+ * @param iter [out] Iterator.
+ * @param data [in]  Device path bytes.
+ * @param size [in]  Size of data.
+ */
+void ast_devpath_iter_init (struct ast_devpath_iter *iter, const void *data, size_t size);
+
+/**
+ * Get the next node. The End Entire node is returned too; iteration stops after it.
+ *
+ * @param iter [in]  Iterator.
+ * @param node [out] Next node.
+ * @return 1 if a node was stored, 0 at the end of the path, or -1 if the next node is malformed.
+ */
+int ast_devpath_next (struct ast_devpath_iter *iter, struct ast_devpath_node *node);
+
+/**
+ * Get the size of a device path up to and including its End Entire node.
+ *
+ * @param data [in] Device path bytes.
+ * @param size [in] Size of data.
+ * @return Size in bytes, or 0 if the path is malformed or has no End Entire node within size.
+ */
+size_t ast_devpath_size (const void *data, size_t size);
+
+/**
+ * @defgroup DevicePathDecoders Typed node decoders
+ *
+ * Each returns AST_RETURN_SUCCESS, or AST_RETURN_INVALID_PARAMETER if the node has another type or is too
+ * short for its type.
+ * @{
+ */
+int ast_devpath_decode_pci (const struct ast_devpath_node *node, struct ast_devpath_pci *pci);
+int ast_devpath_decode_acpi (const struct ast_devpath_node *node, struct ast_devpath_acpi *acpi);
+int ast_devpath_decode_scsi (const struct ast_devpath_node *node, struct ast_devpath_scsi *scsi);
+int ast_devpath_decode_usb (const struct ast_devpath_node *node, struct ast_devpath_usb *usb);
+int ast_devpath_decode_mac (const struct ast_devpath_node *node, struct ast_devpath_mac *mac);
+int ast_devpath_decode_sata (const struct ast_devpath_node *node, struct ast_devpath_sata *sata);
+int ast_devpath_decode_nvme (const struct ast_devpath_node *node, struct ast_devpath_nvme *nvme);
+int ast_devpath_decode_hd (const struct ast_devpath_node *node, struct ast_devpath_hd *hd);
+int ast_devpath_decode_file (const struct ast_devpath_node *node, struct ast_devpath_file *file);
+int ast_devpath_decode_fv (const struct ast_devpath_node *node, struct ast_devpath_fv *fv);
+/** @} */
+
+/**
+ * Start building a device path.
+ *
+ * @param builder [out] Builder.
+ * @param buf     [out] Buffer for the path. May be NULL to only compute the size.
+ * @param bufSiz  [in]  Size of buf.
+ */
+void ast_devpath_builder_init (struct ast_devpath_builder *builder, void *buf, size_t bufSiz);
+
+/**
+ * Append a node with arbitrary data.
+ *
+ * @param builder [in] Builder.
+ * @param type    [in] Node type.
+ * @param subType [in] Node subtype.
+ * @param data    [in] Node data, without header.
+ * @param dataSiz [in] Size of data; header plus data must fit in 16 bits.
+ */
+void ast_devpath_add_node (struct ast_devpath_builder *builder, uint8_t type, uint8_t subType, const void *data, size_t dataSiz);
+
+/**
+ * @defgroup DevicePathBuilders Typed node builders
+ * @{
+ */
+void ast_devpath_add_pci (struct ast_devpath_builder *builder, const struct ast_devpath_pci *pci);
+void ast_devpath_add_acpi (struct ast_devpath_builder *builder, const struct ast_devpath_acpi *acpi);
+void ast_devpath_add_sata (struct ast_devpath_builder *builder, const struct ast_devpath_sata *sata);
+void ast_devpath_add_nvme (struct ast_devpath_builder *builder, const struct ast_devpath_nvme *nvme);
+void ast_devpath_add_hd (struct ast_devpath_builder *builder, const struct ast_devpath_hd *hd);
+
+/** Append a file path node; path is UTF-8 and is stored as NUL terminated UTF-16. */
+void ast_devpath_add_file (struct ast_devpath_builder *builder, const char *path);
+
+/** Append an End node: AST_DEVPATH_END_INSTANCE between instances, AST_DEVPATH_END_ENTIRE at the end. */
+void ast_devpath_add_end (struct ast_devpath_builder *builder, uint8_t subType);
+/** @} */
+
+/**
+ * Finish building.
+ *
+ * @param builder [in]  Builder.
+ * @param nBytes  [out] Size of the path, also set on AST_RETURN_BUFFER_TOO_SMALL. May be NULL.
+ * @return AST_RETURN_SUCCESS, AST_RETURN_BUFFER_TOO_SMALL, or AST_RETURN_INVALID_PARAMETER if a node
+ *         could not be encoded.
+ */
+int ast_devpath_builder_finish (const struct ast_devpath_builder *builder, size_t *nBytes);
+
+/**
+ * Render a device path as text, in the format of the UEFI DevicePathToText protocol (display only,
+ * shortcuts allowed), e.g. `PciRoot(0x0)/Pci(0x1F,0x2)/Sata(0x0,0xFFFF,0x0)/HD(1,GPT,...)/\EFI\BOOT\BOOTX64.EFI`.
+ *
+ * Nodes are separated by '/', instances by ','. Malformed data ends the text with "/<malformed>".
+ *
+ * @param data   [in]  Device path bytes.
+ * @param size   [in]  Size of data.
+ * @param text   [out] Buffer for the NUL terminated text. May be NULL if textSiz is 0.
+ * @param textSiz [in] Size of text.
+ * @return Length of the full text, without the terminator. The text is truncated if this is not less
+ *         than textSiz.
+ */
+size_t ast_devpath_to_text (const void *data, size_t size, char *text, size_t textSiz);
+
+#endif /* end of include guard: _AST_DEVPATH_H */
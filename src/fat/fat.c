@@ -0,0 +1,673 @@
+/**
+ * @file fat.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements fat.h, after the FAT specification (Microsoft, "FAT: General Overview of On-Disk
+ * Format", 1.03), which the UEFI specification refers to for the EFI system partition.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fat.h"
+#include "../gpt/disk.h"
+#include "../arena/arena.h"
+#include "../firmware/firmware.h"
+#include "../unicode/unicode.h"
+
+/** Size of a directory entry. */
+#define AST_FAT_DIRENT_SIZE 32
+
+/** Largest directory: 65536 entries. */
+#define AST_FAT_MAX_DIR_SIZE (65536 * AST_FAT_DIRENT_SIZE)
+
+/** Bytes of file contents read at once, at least one cluster. */
+#define AST_FAT_READ_SIZE (256 * 1024)
+
+/** Long name entries of a name: 255 code units, 13 per entry. */
+#define AST_FAT_LFN_MAX 20
+
+/** Next cluster of the last cluster of a chain, in ast_fat.next. A free, bad or out of range link is 0. */
+#define AST_FAT_END 0xffffffffu
+
+/**
+ * A parsed directory entry.
+ */
+struct _ast_fat_dirent {
+    const char *name;          /**< Long name, or NULL if it has none. */
+    char       shortName[13];  /**< 8.3 name, lower-cased as the NT flags say. */
+    uint32_t   cluster;
+    uint32_t   size;
+    uint8_t    attributes;
+};
+
+/**
+ * A directory read and parsed once.
+ */
+struct _ast_fat_dir {
+    uint32_t               cluster;  /**< First cluster; 0 for the FAT12/16 root directory. */
+    size_t                 nEntries;
+    struct _ast_fat_dirent *entries; /**< In the arena. */
+};
+
+/**
+ * Directory contents gathered from a cluster chain.
+ */
+struct _ast_fat_raw {
+    uint8_t *data;
+    size_t  size;
+    size_t  cap;
+};
+
+struct ast_fat {
+    struct ast_disk     disk;
+    int                 type;         /**< 12, 16 or 32. */
+    uint32_t            clusterSize;  /**< In bytes. */
+    uint32_t            nClusters;    /**< Clusters 2 to nClusters + 1 hold data. */
+    uint32_t            rootCluster;  /**< FAT32 root directory; 0 on FAT12/16. */
+    uint64_t            rootOffset;   /**< FAT12/16 root directory, from the start of the disk. */
+    uint32_t            rootSize;     /**< In bytes, whole sectors. */
+    uint64_t            dataOffset;   /**< Cluster 2, from the start of the disk. */
+    uint32_t            *next;        /**< The FAT: next cluster of each cluster, or AST_FAT_END. */
+    struct _ast_fat_dir *dirs;        /**< Directories read so far. */
+    size_t              nDirs;
+    size_t              capDirs;
+    uint8_t             *buf;         /**< Read buffer, a whole number of clusters. */
+    size_t              bufSize;
+    struct ast_arena    arena;        /**< Names and parsed directories. */
+};
+
+static int  _ast_fat_load (struct ast_fat *fat, uint64_t offset, uint64_t size);
+static int  _ast_fat_walk (struct ast_fat *fat, uint32_t cluster, uint64_t size, ast_fat_sink sink, void *arg);
+static int  _ast_fat_append (void *arg, const void *data, size_t size);
+static int  _ast_fat_dir (struct ast_fat *fat, uint32_t cluster, const struct _ast_fat_dir **dir);
+static int  _ast_fat_parse (struct ast_fat *fat, const uint8_t *data, size_t size, struct _ast_fat_dir *dir);
+static void _ast_fat_short_name (const uint8_t *e, char *name);
+static uint8_t _ast_fat_checksum (const uint8_t *e);
+static int  _ast_fat_match (const char *component, size_t len, const char *name);
+static uint32_t _ast_fat_u32 (const uint8_t *p);
+static uint16_t _ast_fat_u16 (const uint8_t *p);
+
+
+
+
+
+int ast_fat_open (const char *path, uint64_t offset, uint64_t size, struct ast_fat **fat)
+{
+    struct ast_fat *f = NULL;
+    int ret = AST_RETURN_SUCCESS;
+
+    if ((path == NULL) || (fat == NULL)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    *fat = NULL;
+    f = calloc (1, sizeof (*f));
+    if (f == NULL) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+    ret = ast_disk_open (path, &(f->disk));
+    if (ret != AST_RETURN_SUCCESS) {
+        free (f);
+        return ret;
+    }
+    ast_arena_init (&(f->arena), 0);
+
+    if (offset > f->disk.size) {
+        ret = AST_RETURN_INVALID_PARAMETER;
+    } else {
+        if ((size == 0) || (size > f->disk.size - offset)) {
+            size = f->disk.size - offset;
+        }
+        ret = _ast_fat_load (f, offset, size);
+    }
+    if (ret != AST_RETURN_SUCCESS) {
+        ast_fat_close (f);
+        return ret;
+    }
+    *fat = f;
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+int ast_fat_type (const struct ast_fat *fat)
+{
+    return fat->type;
+}
+
+
+
+
+
+int ast_fat_lookup (struct ast_fat *fat, const char *path, struct ast_fat_entry *entry)
+{
+    const char *p = path;
+
+    if ((fat == NULL) || (path == NULL) || (entry == NULL)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    memset (entry, 0, sizeof (*entry));
+    entry->cluster    = fat->rootCluster;
+    entry->attributes = AST_FAT_ATTR_DIRECTORY;
+
+    while (*p != '\0') {
+        const struct _ast_fat_dir *dir = NULL;
+        const struct _ast_fat_dirent *found = NULL;
+        size_t len = 0;
+        int ret = AST_RETURN_SUCCESS;
+
+        if ((*p == '\\') || (*p == '/')) {
+            p++;
+            continue;
+        }
+        while ((p[len] != '\0') && (p[len] != '\\') && (p[len] != '/')) {
+            len++;
+        }
+        if ((len == 1) && (p[0] == '.')) {
+            p += len;
+            continue;
+        }
+        if (!(entry->attributes & AST_FAT_ATTR_DIRECTORY)) {
+            return AST_RETURN_NOT_FOUND;
+        }
+
+        ret = _ast_fat_dir (fat, entry->cluster, &dir);
+        if (ret != AST_RETURN_SUCCESS) {
+            return ret;
+        }
+        for (size_t i = 0; i < dir->nEntries; i++) {
+            const struct _ast_fat_dirent *e = &(dir->entries[i]);
+
+            if (((e->name != NULL) && _ast_fat_match (p, len, e->name)) || _ast_fat_match (p, len, e->shortName)) {
+                found = e;
+                break;
+            }
+        }
+        if (found == NULL) {
+            return AST_RETURN_NOT_FOUND;
+        }
+
+        snprintf (entry->name, sizeof (entry->name), "%s", (found->name != NULL) ? found->name : found->shortName);
+        entry->attributes = found->attributes;
+        entry->cluster    = found->cluster;
+        entry->size       = (found->attributes & AST_FAT_ATTR_DIRECTORY) ? 0 : found->size;
+        // ".." of a directory in the root says cluster 0.
+        if ((found->attributes & AST_FAT_ATTR_DIRECTORY) && (found->cluster == 0)) {
+            entry->cluster = fat->rootCluster;
+        }
+        p += len;
+    }
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+int ast_fat_read (struct ast_fat *fat, const struct ast_fat_entry *entry, ast_fat_sink sink, void *arg)
+{
+    if ((fat == NULL) || (entry == NULL) || (sink == NULL) || (entry->attributes & AST_FAT_ATTR_DIRECTORY)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    if (entry->size == 0) {
+        return AST_RETURN_SUCCESS;
+    }
+    return _ast_fat_walk (fat, entry->cluster, entry->size, sink, arg);
+}
+
+
+
+
+
+void ast_fat_close (struct ast_fat *fat)
+{
+    if (fat == NULL) {
+        return;
+    }
+    ast_disk_close (&(fat->disk));
+    ast_arena_free (&(fat->arena));
+    free (fat->dirs);
+    free (fat->next);
+    free (fat->buf);
+    free (fat);
+}
+
+
+
+
+
+/**
+ * Check the boot sector, lay out the volume and read the FAT into memory.
+ */
+static int _ast_fat_load (struct ast_fat *fat, uint64_t offset, uint64_t size)
+{
+    uint32_t readSize = (fat->disk.blockSize > 512) ? fat->disk.blockSize : 512;
+    uint8_t *b = NULL, *table = NULL;
+    uint32_t bytesPerSector = 0, sectorsPerCluster = 0, reserved = 0, nFats = 0, rootEntries = 0;
+    uint32_t totalSectors = 0, fatSectors = 0, rootSectors = 0, active = 0;
+    uint64_t metaSectors = 0;
+    size_t fatBytes = 0;
+    int ret = AST_RETURN_SUCCESS;
+
+    if ((size < readSize) || (readSize > 4096)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    b = malloc (readSize);
+    if (b == NULL) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+    ret = ast_disk_read (&(fat->disk), offset, b, readSize);
+    if (ret != AST_RETURN_SUCCESS) {
+        free (b);
+        return ret;
+    }
+
+    bytesPerSector    = _ast_fat_u16 (b + 11);
+    sectorsPerCluster = b[13];
+    reserved          = _ast_fat_u16 (b + 14);
+    nFats             = b[16];
+    rootEntries       = _ast_fat_u16 (b + 17);
+    totalSectors      = (_ast_fat_u16 (b + 19) != 0) ? _ast_fat_u16 (b + 19) : _ast_fat_u32 (b + 32);
+    fatSectors        = (_ast_fat_u16 (b + 22) != 0) ? _ast_fat_u16 (b + 22) : _ast_fat_u32 (b + 36);
+    if (((b[0] != 0xeb) && (b[0] != 0xe9)) || (b[510] != 0x55) || (b[511] != 0xaa) ||
+        (bytesPerSector < 512) || (bytesPerSector > 4096) || ((bytesPerSector & (bytesPerSector - 1)) != 0) ||
+        ((fat->disk.blockSize != 0) && (bytesPerSector % fat->disk.blockSize != 0)) ||
+        (sectorsPerCluster == 0) || ((sectorsPerCluster & (sectorsPerCluster - 1)) != 0) ||
+        (reserved == 0) || (nFats == 0) || (fatSectors == 0) || ((uint64_t) totalSectors * bytesPerSector > size)) {
+        free (b);
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    // The count of clusters alone tells the FAT type.
+    rootSectors = (rootEntries * AST_FAT_DIRENT_SIZE + bytesPerSector - 1) / bytesPerSector;
+    metaSectors = reserved + (uint64_t) nFats * fatSectors + rootSectors;
+    if (metaSectors >= totalSectors) {
+        free (b);
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    fat->nClusters   = (uint32_t) ((totalSectors - metaSectors) / sectorsPerCluster);
+    fat->type        = (fat->nClusters < 4085) ? 12 : (fat->nClusters < 65525) ? 16 : 32;
+    fat->clusterSize = bytesPerSector * sectorsPerCluster;
+    fat->rootOffset  = offset + (reserved + (uint64_t) nFats * fatSectors) * bytesPerSector;
+    fat->rootSize    = rootSectors * bytesPerSector;
+    fat->dataOffset  = fat->rootOffset + fat->rootSize;
+    if (fat->type == 32) {
+        uint16_t extFlags = _ast_fat_u16 (b + 40);
+
+        fat->rootCluster = _ast_fat_u32 (b + 44);
+        // With mirroring off, only the active FAT is up to date.
+        active = (extFlags & 0x80) ? (extFlags & 0x0f) : 0;
+        if ((rootEntries != 0) || (fat->nClusters > 0x0ffffff5) || (active >= nFats) ||
+            (fat->rootCluster < 2) || (fat->rootCluster > fat->nClusters + 1)) {
+            free (b);
+            return AST_RETURN_INVALID_PARAMETER;
+        }
+    } else if (rootEntries == 0) {
+        free (b);
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    free (b);
+
+    // Only the part of the FAT that maps clusters is read, a whole number of sectors.
+    fatBytes = (fat->type == 12) ? ((size_t) (fat->nClusters + 2) * 3 + 1) / 2 : (size_t) (fat->nClusters + 2) * (size_t) (fat->type / 8);
+    fatBytes = (fatBytes + bytesPerSector - 1) / bytesPerSector * bytesPerSector;
+    if ((fatBytes > (uint64_t) fatSectors * bytesPerSector) || (fatBytes > AST_FAT_MAX_FAT_SIZE)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    table     = malloc (fatBytes);
+    fat->next = calloc ((size_t) fat->nClusters + 2, sizeof (uint32_t));
+    fat->bufSize = (fat->clusterSize > AST_FAT_READ_SIZE) ? fat->clusterSize : AST_FAT_READ_SIZE / fat->clusterSize * fat->clusterSize;
+    fat->buf     = malloc (fat->bufSize);
+    if ((table == NULL) || (fat->next == NULL) || (fat->buf == NULL)) {
+        free (table);
+        return AST_RETURN_OPERATION_FAILED;
+    }
+    ret = ast_disk_read (&(fat->disk), offset + (reserved + (uint64_t) active * fatSectors) * bytesPerSector, table, fatBytes);
+    if (ret != AST_RETURN_SUCCESS) {
+        free (table);
+        return ret;
+    }
+
+    // Unpack every link to 32 bits once, so that following a chain is one load per cluster.
+    for (uint32_t i = 2; i < fat->nClusters + 2; i++) {
+        uint32_t v = 0, end = 0;
+
+        switch (fat->type) {
+            case 12:
+                v   = _ast_fat_u16 (table + i + i / 2);
+                v   = (i & 1) ? (v >> 4) : (v & 0x0fff);
+                end = 0x0ff8;
+                break;
+            case 16:
+                v   = _ast_fat_u16 (table + 2 * (size_t) i);
+                end = 0xfff8;
+                break;
+            default:
+                v   = _ast_fat_u32 (table + 4 * (size_t) i) & 0x0fffffff;
+                end = 0x0ffffff8;
+                break;
+        }
+        fat->next[i] = (v >= end) ? AST_FAT_END : ((v >= 2) && (v < fat->nClusters + 2)) ? v : 0;
+    }
+    free (table);
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+/**
+ * Read a cluster chain, runs of consecutive clusters at once, and hand it to a sink: size bytes, which
+ * must take the whole chain, or up to the end of the chain for UINT64_MAX.
+ */
+static int _ast_fat_walk (struct ast_fat *fat, uint32_t cluster, uint64_t size, ast_fat_sink sink, void *arg)
+{
+    uint64_t left = size;
+    uint32_t visited = 0;
+
+    while (left > 0) {
+        uint32_t first = cluster, n = 0;
+        size_t chunk = 0;
+        int ret = AST_RETURN_SUCCESS;
+
+        if (cluster == AST_FAT_END) {
+            return (size == UINT64_MAX) ? AST_RETURN_SUCCESS : AST_RETURN_INVALID_PARAMETER;
+        }
+        if ((cluster < 2) || (cluster >= fat->nClusters + 2)) {
+            return AST_RETURN_INVALID_PARAMETER;
+        }
+        do {
+            // A chain longer than the volume loops.
+            if (++visited > fat->nClusters) {
+                return AST_RETURN_INVALID_PARAMETER;
+            }
+            cluster = fat->next[first + n];
+            n++;
+        } while ((cluster == first + n) && ((size_t) (n + 1) * fat->clusterSize <= fat->bufSize) && ((uint64_t) n * fat->clusterSize < left));
+
+        chunk = (size_t) n * fat->clusterSize;
+        ret = ast_disk_read (&(fat->disk), fat->dataOffset + (uint64_t) (first - 2) * fat->clusterSize, fat->buf, chunk);
+        if (ret != AST_RETURN_SUCCESS) {
+            return ret;
+        }
+        if (chunk > left) {
+            chunk = (size_t) left;
+        }
+        ret = sink (arg, fat->buf, chunk);
+        if (ret != AST_RETURN_SUCCESS) {
+            return ret;
+        }
+        left -= chunk;
+    }
+    // A chain going on past the size of its file is damaged too, or loops.
+    return (cluster == AST_FAT_END) ? AST_RETURN_SUCCESS : AST_RETURN_INVALID_PARAMETER;
+}
+
+
+
+
+
+static int _ast_fat_append (void *arg, const void *data, size_t size)
+{
+    struct _ast_fat_raw *raw = arg;
+
+    if (size > AST_FAT_MAX_DIR_SIZE - raw->size) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    if (raw->size + size > raw->cap) {
+        size_t cap = (raw->cap != 0) ? raw->cap : 4096;
+        uint8_t *data = NULL;
+
+        while (cap < raw->size + size) {
+            cap *= 2;
+        }
+        data = realloc (raw->data, cap);
+        if (data == NULL) {
+            return AST_RETURN_OPERATION_FAILED;
+        }
+        raw->data = data;
+        raw->cap  = cap;
+    }
+    memcpy (raw->data + raw->size, data, size);
+    raw->size += size;
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+/**
+ * Get a directory, reading and parsing it the first time.
+ */
+static int _ast_fat_dir (struct ast_fat *fat, uint32_t cluster, const struct _ast_fat_dir **dir)
+{
+    struct _ast_fat_raw raw = {NULL, 0, 0};
+    struct _ast_fat_dir parsed;
+    int ret = AST_RETURN_SUCCESS;
+
+    for (size_t i = 0; i < fat->nDirs; i++) {
+        if (fat->dirs[i].cluster == cluster) {
+            *dir = &(fat->dirs[i]);
+            return AST_RETURN_SUCCESS;
+        }
+    }
+
+    if (cluster == 0) {
+        raw.data = malloc ((fat->rootSize != 0) ? fat->rootSize : 1);
+        if (raw.data == NULL) {
+            return AST_RETURN_OPERATION_FAILED;
+        }
+        raw.size = fat->rootSize;
+        ret = ast_disk_read (&(fat->disk), fat->rootOffset, raw.data, raw.size);
+    } else {
+        ret = _ast_fat_walk (fat, cluster, UINT64_MAX, _ast_fat_append, &raw);
+    }
+    if (ret == AST_RETURN_SUCCESS) {
+        parsed.cluster = cluster;
+        ret = _ast_fat_parse (fat, raw.data, raw.size, &parsed);
+    }
+    free (raw.data);
+    if (ret != AST_RETURN_SUCCESS) {
+        return ret;
+    }
+
+    if (fat->nDirs == fat->capDirs) {
+        size_t cap = (fat->capDirs != 0) ? fat->capDirs * 2 : 16;
+        struct _ast_fat_dir *dirs = realloc (fat->dirs, cap * sizeof (*dirs));
+
+        if (dirs == NULL) {
+            return AST_RETURN_OPERATION_FAILED;
+        }
+        fat->dirs    = dirs;
+        fat->capDirs = cap;
+    }
+    fat->dirs[fat->nDirs] = parsed;
+    *dir = &(fat->dirs[fat->nDirs++]);
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+/**
+ * Parse directory entries: each short entry, with the long name of the entries before it if their
+ * ordinals run down to 1 and their checksums match it.
+ */
+static int _ast_fat_parse (struct ast_fat *fat, const uint8_t *data, size_t size, struct _ast_fat_dir *dir)
+{
+    uint8_t lfn[AST_FAT_LFN_MAX * 26];
+    unsigned int lfnNext = 0, lfnCount = 0;
+    uint8_t lfnSum = 0;
+    size_t n = 0;
+
+    // Count first, to allocate the entries at once.
+    for (size_t off = 0; (off + AST_FAT_DIRENT_SIZE <= size) && (data[off] != 0x00); off += AST_FAT_DIRENT_SIZE) {
+        n += (data[off] != 0xe5) && ((data[off + 11] & 0x3f) != 0x0f) && !(data[off + 11] & AST_FAT_ATTR_VOLUME_ID);
+    }
+    dir->nEntries = 0;
+    dir->entries  = ast_arena_alloc (&(fat->arena), (n != 0) ? n * sizeof (struct _ast_fat_dirent) : 1);
+    if (dir->entries == NULL) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+
+    for (size_t off = 0; (off + AST_FAT_DIRENT_SIZE <= size) && (data[off] != 0x00); off += AST_FAT_DIRENT_SIZE) {
+        const uint8_t *e = data + off;
+        struct _ast_fat_dirent *d = NULL;
+
+        if (e[0] == 0xe5) {
+            lfnNext = lfnCount = 0;
+            continue;
+        }
+        if ((e[11] & 0x3f) == 0x0f) {
+            unsigned int ord = e[0] & 0x3f;
+
+            if (e[0] & 0x40) {
+                lfnCount = lfnNext = ord;
+                lfnSum   = e[13];
+            }
+            if ((ord == 0) || (ord > AST_FAT_LFN_MAX) || (ord != lfnNext) || (e[13] != lfnSum)) {
+                lfnNext = lfnCount = 0;
+                continue;
+            }
+            // 13 UTF-16 code units: 5 at 1, 6 at 14, 2 at 28.
+            memcpy (lfn + (ord - 1) * 26, e + 1, 10);
+            memcpy (lfn + (ord - 1) * 26 + 10, e + 14, 12);
+            memcpy (lfn + (ord - 1) * 26 + 22, e + 28, 4);
+            lfnNext--;
+            continue;
+        }
+        if (e[11] & AST_FAT_ATTR_VOLUME_ID) {
+            lfnNext = lfnCount = 0;
+            continue;
+        }
+
+        d = &(dir->entries[dir->nEntries++]);
+        memset (d, 0, sizeof (*d));
+        _ast_fat_short_name (e, d->shortName);
+        d->attributes = e[11];
+        d->cluster    = ((fat->type == 32) ? ((uint32_t) _ast_fat_u16 (e + 20) << 16) : 0) | _ast_fat_u16 (e + 26);
+        d->size       = _ast_fat_u32 (e + 28);
+        if ((lfnCount != 0) && (lfnNext == 0) && (_ast_fat_checksum (e) == lfnSum)) {
+            size_t len = ast_utf16_decode (lfn, lfnCount * 26, NULL, 0);
+            char *name = ast_arena_alloc (&(fat->arena), len + 1);
+
+            if (name == NULL) {
+                return AST_RETURN_OPERATION_FAILED;
+            }
+            ast_utf16_decode (lfn, lfnCount * 26, name, len + 1);
+            d->name = name;
+        }
+        lfnNext = lfnCount = 0;
+    }
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+/**
+ * Format an 8.3 name as "NAME.EXT", honouring the lower case flags Windows NT keeps in byte 12.
+ */
+static void _ast_fat_short_name (const uint8_t *e, char *name)
+{
+    size_t len = 0;
+    int base = 8, ext = 11;
+
+    while ((base > 0) && (e[base - 1] == ' ')) {
+        base--;
+    }
+    while ((ext > 8) && (e[ext - 1] == ' ')) {
+        ext--;
+    }
+    for (int i = 0; i < ext; i++) {
+        uint8_t c = ((i == 0) && (e[0] == 0x05)) ? 0xe5 : e[i];
+
+        if ((i >= base) && (i < 8)) {
+            i = 7;
+            continue;
+        }
+        if (i == 8) {
+            name[len++] = '.';
+        }
+        if ((c >= 'A') && (c <= 'Z') && (e[12] & ((i < 8) ? 0x08 : 0x10))) {
+            c += 'a' - 'A';
+        }
+        // Bytes above 0x7f are in an OEM code page this reader does not know.
+        name[len++] = (c < 0x80) ? (char) c : '?';
+    }
+    name[len] = '\0';
+}
+
+
+
+
+
+static uint8_t _ast_fat_checksum (const uint8_t *e)
+{
+    uint8_t sum = 0;
+
+    for (int i = 0; i < 11; i++) {
+        sum = (uint8_t) (((sum & 1) << 7) + (sum >> 1) + e[i]);
+    }
+    return sum;
+}
+
+
+
+
+
+/**
+ * Compare a path component with a name, folding ASCII and Latin-1 letters as the EDK II English
+ * collation does; other letters must match exactly.
+ */
+static int _ast_fat_match (const char *component, size_t len, const char *name)
+{
+    for (size_t i = 0; i < len; i++) {
+        unsigned char a = (unsigned char) component[i], b = (unsigned char) name[i];
+
+        if (b == '\0') {
+            return 0;
+        }
+        if ((a >= 'a') && (a <= 'z')) {
+            a -= 'a' - 'A';
+        } else if ((i > 0) && ((unsigned char) component[i - 1] == 0xc3) && (a >= 0xa0) && (a <= 0xbe) && (a != 0xb7)) {
+            a -= 0x20;  // U+00E0 to U+00FE, but U+00F7, are C3 A0 to C3 BE in UTF-8.
+        }
+        if ((b >= 'a') && (b <= 'z')) {
+            b -= 'a' - 'A';
+        } else if ((i > 0) && ((unsigned char) name[i - 1] == 0xc3) && (b >= 0xa0) && (b <= 0xbe) && (b != 0xb7)) {
+            b -= 0x20;
+        }
+        if (a != b) {
+            return 0;
+        }
+    }
+    return name[len] == '\0';
+}
+
+
+
+
+
+static uint32_t _ast_fat_u32 (const uint8_t *p)
+{
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+
+
+
+
+static uint16_t _ast_fat_u16 (const uint8_t *p)
+{
+    return (uint16_t) (p[0] | (p[1] << 8));
+}
@@ -0,0 +1,124 @@
+/**
+ * @file fat.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares a read-only FAT12/16/32 reader working on a byte range of a disk or image,
+ * such as the EFI system partition found with ast_gpt_read, so that boot files can be checked without
+ * mounting anything:
+ *
+ *     struct ast_fat *fat = NULL;
+ *     struct ast_fat_entry entry;
+ *
+ *     if (ast_fat_open ("/dev/sda", esp->firstLba * gpt.blockSize, (esp->lastLba - esp->firstLba + 1) * gpt.blockSize, &fat) == AST_RETURN_SUCCESS) {
+ *         if (ast_fat_lookup (fat, "\\EFI\\AST\\astg2x64.efi", &entry) == AST_RETURN_SUCCESS) {
+ *             printf ("%llu bytes\n", (unsigned long long) entry.size);
+ *         }
+ *         ast_fat_close (fat);
+ *     }
+ *
+ * The FAT is read once, when the volume is opened, and kept in memory; each directory is read and
+ * parsed the first time a path goes through it, so checking many paths costs one read per directory
+ * and per file, not per path. Names are compared case-insensitively, for ASCII and Latin-1 letters as
+ * the EDK II FAT driver does, against the long name and the 8.3 name of each entry.
+ */
+
+#ifndef _AST_FAT_H
+#define _AST_FAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct ast_fat;
+
+/** Size of a name: 255 UTF-16 code units as UTF-8, and a NUL. */
+#define AST_FAT_NAME_MAX 766
+
+/** Largest FAT read into memory: 2^28 FAT32 clusters need 1 GiB, an ESP needs well under 4 MiB. */
+#define AST_FAT_MAX_FAT_SIZE (64 * 1024 * 1024)
+
+/**
+ * Directory entry attributes (ast_fat_entry.attributes).
+ */
+enum AST_FAT_ATTRIBUTE {
+    AST_FAT_ATTR_READ_ONLY = 0x01,
+    AST_FAT_ATTR_HIDDEN    = 0x02,
+    AST_FAT_ATTR_SYSTEM    = 0x04,
+    AST_FAT_ATTR_VOLUME_ID = 0x08,
+    AST_FAT_ATTR_DIRECTORY = 0x10,
+    AST_FAT_ATTR_ARCHIVE   = 0x20
+};
+
+/**
+ * A file or directory found by ast_fat_lookup.
+ */
+struct ast_fat_entry {
+    char     name[AST_FAT_NAME_MAX]; /**< Long name, or the 8.3 name if it has none; empty for the root. */
+    uint32_t cluster;                /**< First cluster, 0 for an empty file or the FAT12/16 root directory. */
+    uint64_t size;                   /**< Size in bytes; 0 for a directory. */
+    uint8_t  attributes;             /**< AST_FAT_ATTR_* */
+};
+
+/**
+ * Receives the contents of a file, in order.
+ *
+ * @param arg  [in] Argument given to ast_fat_read.
+ * @param data [in] Next bytes of the file.
+ * @param size [in] Size of data.
+ * @return AST_RETURN_SUCCESS to go on, or another AST_RETURN code to stop, which ast_fat_read returns.
+ */
+typedef int (*ast_fat_sink) (void *arg, const void *data, size_t size);
+
+/**
+ * Open a FAT volume.
+ *
+ * @param path   [in]  Block device or image file (see ast_disk_open).
+ * @param offset [in]  Start of the volume in bytes, e.g. of a partition; a multiple of the block size.
+ * @param size   [in]  Size of the volume in bytes, or 0 for the rest of the disk.
+ * @param fat    [out] Volume, to close with ast_fat_close.
+ * @return AST_RETURN_SUCCESS, AST_RETURN_INVALID_PARAMETER if there is no valid FAT file system there, or
+ *         another AST_RETURN code.
+ */
+int ast_fat_open (const char *path, uint64_t offset, uint64_t size, struct ast_fat **fat);
+
+/**
+ * Get the FAT type of a volume.
+ *
+ * @param fat [in] Volume.
+ * @return 12, 16 or 32.
+ */
+int ast_fat_type (const struct ast_fat *fat);
+
+/**
+ * Look up a file or directory.
+ *
+ * @param fat   [in]  Volume.
+ * @param path  [in]  Path from the root; `\` and `/` both separate, as in a file path device path node.
+ * @param entry [out] What was found.
+ * @return AST_RETURN_SUCCESS, AST_RETURN_NOT_FOUND if a component does not exist (or a file is used as a
+ *         directory), AST_RETURN_INVALID_PARAMETER if a directory is damaged, or another AST_RETURN code.
+ */
+int ast_fat_lookup (struct ast_fat *fat, const char *path, struct ast_fat_entry *entry);
+
+/**
+ * Stream the contents of a file, a few clusters at a time.
+ *
+ * @param fat   [in] Volume.
+ * @param entry [in] File, from ast_fat_lookup.
+ * @param sink  [in] Receives the contents.
+ * @param arg   [in] Argument of sink.
+ * @return AST_RETURN_SUCCESS, AST_RETURN_INVALID_PARAMETER if entry is a directory or its cluster chain is
+ *         damaged, what sink returned if it stopped, or another AST_RETURN code.
+ */
+int ast_fat_read (struct ast_fat *fat, const struct ast_fat_entry *entry, ast_fat_sink sink, void *arg);
+
+/**
+ * Close a volume.
+ *
+ * @param fat [in] Volume. May be NULL.
+ */
+void ast_fat_close (struct ast_fat *fat);
+
+#endif /* end of include guard: _AST_FAT_H */
@@ -0,0 +1,162 @@
+/**
+ * @file backend.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares the variable store backend interface behind firmware.h.
+ *
+ * A backend is a table of operations plus a private context. firmware.c dispatches every variable
+ * access to the backend selected with ast_efivar_backend_set, so the same code path serves the
+ * Win32 API, Linux efivarfs, or anything else that can store variables.
+ */
+
+#ifndef _AST_BACKEND_H
+#define _AST_BACKEND_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "firmware.h"
+
+/**
+ * Variable store backend.
+ *
+ * All operations return an AST_RETURN code. GUIDs are binary, so backends never parse them.
+ */
+struct ast_efivar_backend {
+    const char *name; /**< Human readable backend name. */
+    void       *ctx;  /**< Backend private data, passed to every operation. */
+
+    /**
+     * Read a variable into buf. On AST_RETURN_BUFFER_TOO_SMALL, *nBytes is set to the required size
+     * if the backend knows it. attr may be NULL.
+     */
+    int  (*read)       (void *ctx, const ast_guid *guid, const char *name, void *buf, size_t bufSiz, size_t *nBytes, uint32_t *attr);
+
+    /**
+     * Read n variables, filling results. Optional: when NULL, firmware.c calls read for each item.
+     * Returns a code other than AST_RETURN_SUCCESS only if the batch could not be started.
+     */
+    int  (*read_batch) (void *ctx, const ast_var_request *reqs, size_t n, ast_var_result *results);
+
+    /** Write a variable. Writing zero bytes deletes the variable. */
+    int  (*write)      (void *ctx, const ast_guid *guid, const char *name, const void *buf, size_t bufSiz, uint32_t attr);
+
+    /** Start enumerating; *it is the backend's iterator state. Optional: NULL if the backend cannot enumerate. */
+    int  (*iter_open)  (void *ctx, unsigned int flags, void **it);
+
+    /** Fill up to cap records; *n == 0 at the end. */
+    int  (*iter_next)  (void *ctx, void *it, struct ast_efivar_info *infos, size_t cap, size_t *n);
+
+    /** Release an iterator. */
+    void (*iter_close) (void *ctx, void *it);
+
+    /** Release ctx and the backend itself. */
+    void (*destroy)    (struct ast_efivar_backend *backend);
+};
+
+#ifdef _WIN32
+/**
+ * Create a backend calling GetFirmwareEnvironmentVariable and friends.
+ *
+ * @return The backend, or NULL on allocation failure.
+ */
+struct ast_efivar_backend *ast_efivar_backend_win32_new (void);
+#else
+/**
+ * Default efivarfs mount point on Linux.
+ */
+#define AST_EFIVARFS_DEFAULT_DIR "/sys/firmware/efi/efivars"
+
+/**
+ * statfs(2) f_type of efivarfs.
+ */
+#define AST_EFIVARFS_MAGIC 0xde5e81e4
+
+/**
+ * Create a backend reading and writing an efivarfs directory.
+ *
+ * Each variable is a file named `Name-xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx` holding the 4-byte attributes
+ * followed by the payload. Any directory laid out this way (e.g. a copy of efivarfs) works.
+ *
+ * @param dir [in] Directory to use, or NULL for AST_EFIVARFS_DEFAULT_DIR.
+ * @return The backend, or NULL if the directory cannot be opened.
+ */
+struct ast_efivar_backend *ast_efivar_backend_efivarfs_new (const char *dir);
+
+/**
+ * Get the directory of an efivarfs backend, e.g. to watch it for changes.
+ *
+ * @param backend [in] Backend.
+ * @return The directory given to ast_efivar_backend_efivarfs_new, or NULL if backend is not an efivarfs backend.
+ */
+const char *ast_efivar_backend_efivarfs_dir (const struct ast_efivar_backend *backend);
+
+/**
+ * Default size of an emulated variable store, header included: a typical 64 KiB NVRAM region.
+ */
+#define AST_EMU_DEFAULT_STORE_SIZE (64 * 1024)
+
+/**
+ * Settings of an emulated variable store. Zero-initialize for an instant 64 KiB store.
+ */
+struct ast_efivar_emu_config {
+    size_t   storeSiz;       /**< Store size in bytes, or 0 for AST_EMU_DEFAULT_STORE_SIZE. An existing store keeps its own. */
+    uint32_t readLatencyNs;  /**< Time spent in every read, and per variable enumerated. */
+    uint32_t writeLatencyNs; /**< Time spent in every write (SMI plus flash programming). */
+    uint32_t maxVariableSiz; /**< Largest name plus data of one variable, or 0 for no limit but the store. */
+};
+
+/**
+ * Counters of an emulated variable store.
+ *
+ * @see ast_efivar_backend_emu_stats
+ */
+struct ast_efivar_emu_stats {
+    unsigned long      reads;           /**< read calls */
+    unsigned long      writes;          /**< write calls, including those that changed nothing */
+    unsigned long      nextNames;       /**< Variables returned by enumeration (GetNextVariableName calls) */
+    unsigned long      reclaims;        /**< Times the store was garbage collected */
+    unsigned long long bytesProgrammed; /**< Bytes written to the store, reclaims included: the wear */
+    size_t             storeSiz;        /**< Store size */
+    size_t             usedSiz;         /**< Bytes up to the end of the last record */
+    size_t             liveSiz;         /**< Bytes a reclaim would keep */
+    size_t             nVariables;      /**< Number of variables */
+};
+
+/**
+ * Create a backend emulating firmware over a variable store in a file.
+ *
+ * The file holds an EDK II authenticated variable store: a store header, then every variable as a header,
+ * its UTF-16 name and its data. Updates append and mark the previous record deleted; when the store is
+ * full, it is reclaimed. As on firmware, a write is refused once live variables fill the store, and the
+ * attributes of an existing variable cannot change. Authenticated writes are stored as given; no signature
+ * is checked. Every call takes the configured latency, serialized across threads.
+ *
+ * @param path   [in] Store file, created and formatted if missing or empty; NULL for a store in memory.
+ * @param config [in] Settings, or NULL for the defaults.
+ * @return The backend, or NULL if the file cannot be used.
+ */
+struct ast_efivar_backend *ast_efivar_backend_emu_new (const char *path, const struct ast_efivar_emu_config *config);
+
+/**
+ * Read the counters of an emulated variable store.
+ *
+ * @param backend [in]  Backend created by ast_efivar_backend_emu_new.
+ * @param stats   [out] Counters since the backend was created.
+ * @return AST_RETURN_SUCCESS, or AST_RETURN_INVALID_PARAMETER if backend is not an emulator.
+ */
+int ast_efivar_backend_emu_stats (struct ast_efivar_backend *backend, struct ast_efivar_emu_stats *stats);
+#endif
+
+/**
+ * Destroy a backend created by one of the constructors above.
+ *
+ * The default backend (see ast_efivar_backend_get) is not created again once it has been destroyed.
+ *
+ * @param backend [in] Backend to destroy. May be NULL.
+ */
+void ast_efivar_backend_free (struct ast_efivar_backend *backend);
+
+#endif /* end of include guard: _AST_BACKEND_H */
@@ -0,0 +1,468 @@
+/**
+ * @file backend_efivarfs.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements the efivarfs variable store backend declared in backend.h.
+ *
+ * Every variable is a file `Name-guid` in the efivarfs directory. The file holds the 4-byte attributes
+ * followed by the payload. efivarfs goes to firmware on each read(2), so a read is done with one
+ * preadv(2) from offset 0, the attributes into a local and the payload straight into the caller's
+ * buffer. The size is taken from fstat(2), which does not touch firmware; a second fstat(2) after a
+ * read that fills the buffer catches a variable that grew in between. See
+ * Documentation/filesystems/efivarfs.rst in the Linux source tree.
+ *
+ * Enumeration is readdir(3) over the same directory. Sizes come from fstatat(2); attributes cost one
+ * 4-byte read each and are only fetched when asked for.
+ */
+
+#ifndef _WIN32
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/ioctl.h>
+#include <sys/vfs.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+#include "firmware.h"
+#include "backend.h"
+
+struct _ast_efivarfs_ctx {
+    int  dirfd;
+    int  isEfivarfs; // 0 for a plain directory laid out like efivarfs
+    char *dir;
+};
+
+struct _ast_efivarfs_iter {
+    DIR          *dir;
+    unsigned int flags;
+};
+
+static int  _ast_efivarfs_read (void *ctx, const ast_guid *guid, const char *name, void *buf, size_t bufSiz, size_t *nBytes, uint32_t *attr);
+static int  _ast_efivarfs_write (void *ctx, const ast_guid *guid, const char *name, const void *buf, size_t bufSiz, uint32_t attr);
+static int  _ast_efivarfs_iter_open (void *ctx, unsigned int flags, void **it);
+static int  _ast_efivarfs_iter_next (void *ctx, void *it, struct ast_efivar_info *infos, size_t cap, size_t *n);
+static void _ast_efivarfs_iter_close (void *ctx, void *it);
+static void _ast_efivarfs_destroy (struct ast_efivar_backend *backend);
+static int  _ast_efivarfs_split_name (const char *fileName, struct ast_efivar_info *info);
+static int  _ast_efivarfs_file_name (char *fileName, size_t fileNameSiz, const ast_guid *guid, const char *name);
+static void _ast_efivarfs_make_mutable (int dirfd, const char *fileName);
+static int  _ast_efivarfs_error (const char *func, int err);
+
+
+
+
+
+struct ast_efivar_backend *ast_efivar_backend_efivarfs_new (const char *dir)
+{
+    struct ast_efivar_backend *backend = NULL;
+    struct _ast_efivarfs_ctx *ctx = NULL;
+    struct statfs fs;
+
+    if (dir == NULL) {
+        dir = AST_EFIVARFS_DEFAULT_DIR;
+    }
+
+    backend = calloc (1, sizeof (struct ast_efivar_backend));
+    ctx     = calloc (1, sizeof (struct _ast_efivarfs_ctx));
+    if ((backend == NULL) || (ctx == NULL) || ((ctx->dir = strdup (dir)) == NULL)) {
+        goto fail;
+    }
+
+    ctx->dirfd = open (dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (ctx->dirfd < 0) {
+        fprintf (stderr, " ** Cannot open efivarfs directory %s: %s.\n", dir, strerror (errno));
+        goto fail;
+    }
+    ctx->isEfivarfs = (fstatfs (ctx->dirfd, &fs) == 0) && ((unsigned long) fs.f_type == AST_EFIVARFS_MAGIC);
+
+    backend->name       = "efivarfs";
+    backend->ctx        = ctx;
+    backend->read       = _ast_efivarfs_read;
+    backend->read_batch = NULL; // Nothing to share between reads; firmware.c loops over read
+    backend->write      = _ast_efivarfs_write;
+    backend->iter_open  = _ast_efivarfs_iter_open;
+    backend->iter_next  = _ast_efivarfs_iter_next;
+    backend->iter_close = _ast_efivarfs_iter_close;
+    backend->destroy    = _ast_efivarfs_destroy;
+    return backend;
+
+fail:
+    if (ctx != NULL) {
+        free (ctx->dir);
+    }
+    free (ctx);
+    free (backend);
+    return NULL;
+}
+
+
+
+
+
+const char *ast_efivar_backend_efivarfs_dir (const struct ast_efivar_backend *backend)
+{
+    if ((backend == NULL) || (backend->destroy != _ast_efivarfs_destroy)) {
+        return NULL;
+    }
+    return ((const struct _ast_efivarfs_ctx *) backend->ctx)->dir;
+}
+
+
+
+
+
+static int _ast_efivarfs_read (void *ctx, const ast_guid *guid, const char *name, void *buf, size_t bufSiz, size_t *nBytes, uint32_t *attr)
+{
+    struct _ast_efivarfs_ctx *c = ctx;
+    char     fileName[NAME_MAX + 1];
+    struct   stat st;
+    uint32_t attributes = 0;
+    struct   iovec iov[2];
+    ssize_t  n  = 0;
+    int      fd = -1;
+
+    if (_ast_efivarfs_file_name (fileName, sizeof (fileName), guid, name) != AST_RETURN_SUCCESS) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    fd = openat (c->dirfd, fileName, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return _ast_efivarfs_error ("open", errno);
+    }
+
+    // The inode size is attributes + payload and is known without asking firmware.
+    if ((fstat (fd, &st) == 0) && (st.st_size >= (off_t) sizeof (uint32_t))) {
+        size_t dataSiz = (size_t) st.st_size - sizeof (uint32_t);
+        if (dataSiz > bufSiz) {
+            close (fd);
+            if (nBytes != NULL) {
+                *nBytes = dataSiz;
+            }
+            return AST_RETURN_BUFFER_TOO_SMALL;
+        }
+    }
+
+    // Every read(2) on efivarfs is a firmware call, so attributes and payload come in the same one.
+    iov[0].iov_base = &attributes;
+    iov[0].iov_len  = sizeof (attributes);
+    iov[1].iov_base = buf;
+    iov[1].iov_len  = bufSiz;
+    n = preadv (fd, iov, 2, 0);
+    if (n < (ssize_t) sizeof (attributes)) {
+        int err = (n < 0) ? errno : EIO;
+        close (fd);
+        return _ast_efivarfs_error ("read", err);
+    }
+    n -= (ssize_t) sizeof (attributes);
+    // A full buffer may hide a variable written larger between the fstat and the read; efivarfs
+    //   updates the inode size on write, so asking again costs no firmware call.
+    if (((size_t) n == bufSiz) && (fstat (fd, &st) == 0) && ((uint64_t) st.st_size > bufSiz + sizeof (uint32_t))) {
+        close (fd);
+        if (nBytes != NULL) {
+            *nBytes = (size_t) st.st_size - sizeof (uint32_t);
+        }
+        return AST_RETURN_BUFFER_TOO_SMALL;
+    }
+    close (fd);
+
+    if (nBytes != NULL) {
+        *nBytes = (size_t) n;
+    }
+    if (attr != NULL) {
+        *attr = attributes;
+    }
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static int _ast_efivarfs_write (void *ctx, const ast_guid *guid, const char *name, const void *buf, size_t bufSiz, uint32_t attr)
+{
+    struct _ast_efivarfs_ctx *c = ctx;
+    char    fileName[NAME_MAX + 1];
+    uint8_t stackBuf[1024];
+    uint8_t *data = stackBuf;
+    size_t  dataSiz = sizeof (uint32_t) + bufSiz;
+    ssize_t n  = 0;
+    int     fd = -1;
+    int     flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+    int     ret = AST_RETURN_SUCCESS;
+
+    if (_ast_efivarfs_file_name (fileName, sizeof (fileName), guid, name) != AST_RETURN_SUCCESS) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    // Appending nothing leaves the variable as it is, as SetVariable does.
+    if ((bufSiz == 0) && (attr & AST_EFIVAR_APPEND_WRITE)) {
+        return AST_RETURN_SUCCESS;
+    }
+
+    // Deleting a variable is unlinking its file.
+    if (bufSiz == 0) {
+        if (unlinkat (c->dirfd, fileName, 0) != 0) {
+            if (errno == EPERM) {
+                _ast_efivarfs_make_mutable (c->dirfd, fileName);
+                if (unlinkat (c->dirfd, fileName, 0) == 0) {
+                    return AST_RETURN_SUCCESS;
+                }
+            }
+            return _ast_efivarfs_error ("unlink", errno);
+        }
+        return AST_RETURN_SUCCESS;
+    }
+
+    if (!c->isEfivarfs) {
+        // A plain file keeps stale bytes unless truncated; efivarfs replaces the variable on write.
+        if (attr & AST_EFIVAR_APPEND_WRITE) {
+            return AST_RETURN_NOT_SUPPORTED;
+        }
+        flags |= O_TRUNC;
+    }
+
+    // efivarfs wants attributes and payload in a single write(2).
+    if (dataSiz > sizeof (stackBuf)) {
+        data = malloc (dataSiz);
+        if (data == NULL) {
+            return AST_RETURN_OPERATION_FAILED;
+        }
+    }
+    memcpy (data, &attr, sizeof (uint32_t));
+    memcpy (data + sizeof (uint32_t), buf, bufSiz);
+
+    fd = openat (c->dirfd, fileName, flags, 0644);
+    if ((fd < 0) && (errno == EPERM)) {
+        // Most efivarfs files are immutable to protect against `rm -rf`.
+        _ast_efivarfs_make_mutable (c->dirfd, fileName);
+        fd = openat (c->dirfd, fileName, flags, 0644);
+    }
+
+    if (fd < 0) {
+        ret = _ast_efivarfs_error ("open", errno);
+    } else {
+        n = write (fd, data, dataSiz);
+        if (n != (ssize_t) dataSiz) {
+            ret = _ast_efivarfs_error ("write", (n < 0) ? errno : EIO);
+        }
+        close (fd);
+    }
+
+    if (data != stackBuf) {
+        free (data);
+    }
+    return ret;
+}
+
+
+
+
+
+static int _ast_efivarfs_iter_open (void *ctx, unsigned int flags, void **it)
+{
+    struct _ast_efivarfs_ctx *c = ctx;
+    struct _ast_efivarfs_iter *i = calloc (1, sizeof (struct _ast_efivarfs_iter));
+    int fd = -1;
+
+    if (i == NULL) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+
+    // fdopendir takes the descriptor over, so give it its own; c->dirfd keeps serving reads.
+    fd = openat (c->dirfd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if ((fd < 0) || ((i->dir = fdopendir (fd)) == NULL)) {
+        int err = errno;
+        if (fd >= 0) {
+            close (fd);
+        }
+        free (i);
+        return _ast_efivarfs_error ("opendir", err);
+    }
+    i->flags = flags;
+
+    *it = i;
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static int _ast_efivarfs_iter_next (void *ctx, void *it, struct ast_efivar_info *infos, size_t cap, size_t *n)
+{
+    struct _ast_efivarfs_iter *i = it;
+    struct dirent *ent = NULL;
+    struct stat st;
+    int dfd = dirfd (i->dir);
+
+    (void) ctx;
+    *n = 0;
+    while (*n < cap) {
+        struct ast_efivar_info *info = &infos[*n];
+
+        errno = 0;
+        ent = readdir (i->dir);
+        if (ent == NULL) {
+            if (errno != 0) {
+                return _ast_efivarfs_error ("readdir", errno);
+            }
+            break;
+        }
+
+        if (_ast_efivarfs_split_name (ent->d_name, info) != AST_RETURN_SUCCESS) {
+            continue; // ".", ".." or a stray file
+        }
+        if ((fstatat (dfd, ent->d_name, &st, 0) != 0) || (st.st_size < (off_t) sizeof (uint32_t))) {
+            continue; // Deleted under us, or not a variable
+        }
+        info->size = (size_t) st.st_size - sizeof (uint32_t);
+        info->attr = 0;
+        info->data = NULL;
+
+        if (i->flags & AST_EFIVAR_ITER_ATTRIBUTES) {
+            int fd = openat (dfd, ent->d_name, O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                continue;
+            }
+            if (pread (fd, &(info->attr), sizeof (uint32_t), 0) != (ssize_t) sizeof (uint32_t)) {
+                close (fd);
+                continue;
+            }
+            close (fd);
+        }
+
+        (*n)++;
+    }
+
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static void _ast_efivarfs_iter_close (void *ctx, void *it)
+{
+    struct _ast_efivarfs_iter *i = it;
+
+    (void) ctx;
+    closedir (i->dir);
+    free (i);
+}
+
+
+
+
+
+static void _ast_efivarfs_destroy (struct ast_efivar_backend *backend)
+{
+    struct _ast_efivarfs_ctx *c = backend->ctx;
+
+    close (c->dirfd);
+    free (c->dir);
+    free (c);
+    free (backend);
+}
+
+
+
+
+
+static int _ast_efivarfs_file_name (char *fileName, size_t fileNameSiz, const ast_guid *guid, const char *name)
+{
+    size_t nameLen = (name == NULL) ? 0 : strlen (name);
+
+    if ((guid == NULL) || (nameLen == 0) || (strchr (name, '/') != NULL) || (nameLen + 1 + AST_GUID_STRLEN + 1 > fileNameSiz)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    memcpy (fileName, name, nameLen);
+    fileName[nameLen] = '-';
+    ast_guid_format (guid, fileName + nameLen + 1);
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static int _ast_efivarfs_split_name (const char *fileName, struct ast_efivar_info *info)
+{
+    // The inverse of _ast_efivarfs_file_name: "Name-xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx".
+    size_t len = strlen (fileName);
+    const char *guid = NULL;
+    size_t nameLen = 0;
+
+    if (len < 1 + 1 + AST_GUID_STRLEN) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    nameLen = len - 1 - AST_GUID_STRLEN;
+    guid    = fileName + nameLen + 1;
+    if ((fileName[nameLen] != '-') || (nameLen >= sizeof (info->name))) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    if (ast_guid_parse_n (guid, &(info->guid)) != AST_RETURN_SUCCESS) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    memcpy (info->name, fileName, nameLen);
+    info->name[nameLen] = '\0';
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static void _ast_efivarfs_make_mutable (int dirfd, const char *fileName)
+{
+#if defined (FS_IOC_GETFLAGS) && defined (FS_IOC_SETFLAGS)
+    int fd = openat (dirfd, fileName, O_RDONLY | O_CLOEXEC);
+    int flags = 0;
+
+    if (fd < 0) {
+        return;
+    }
+    if ((ioctl (fd, FS_IOC_GETFLAGS, &flags) == 0) && (flags & FS_IMMUTABLE_FL)) {
+        flags &= ~FS_IMMUTABLE_FL;
+        ioctl (fd, FS_IOC_SETFLAGS, &flags);
+    }
+    close (fd);
+#else
+    (void) dirfd;
+    (void) fileName;
+#endif
+}
+
+
+
+
+
+static int _ast_efivarfs_error (const char *func, int err)
+{
+    switch (err) {
+        case ENOENT:
+            return AST_RETURN_NOT_FOUND;
+        case EACCES: // fall through
+        case EPERM:
+            return AST_RETURN_ACCESS_DENIED;
+        default:
+            fprintf (stderr, " ** efivarfs %s failed with error %d (%s).\n", func, err, strerror (err));
+            return AST_RETURN_OPERATION_FAILED;
+    }
+}
+
+#endif /* _WIN32 */
@@ -0,0 +1,858 @@
+/**
+ * @file backend_emu.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements the emulated variable store backend declared in backend.h.
+ *
+ * The store is laid out as the authenticated variable store of EDK II (MdeModulePkg/Include/Guid/VariableFormat.h):
+ * a VARIABLE_STORE_HEADER, then AUTHENTICATED_VARIABLE_HEADERs each followed by the UTF-16 name and the data,
+ * every header aligned to 4 bytes, and erased (0xFF) space after the last one. As on flash, a record is never
+ * rewritten: an update appends a new record and clears State bits of the old one (ADDED, then IN_DELETED_TRANSITION,
+ * then DELETED). Once the free space runs out, a reclaim copies the live records to the front of the store.
+ *
+ * Lookups go through an in-memory hash index of record offsets, so the emulator itself stays cheap next to
+ * the configured latency. Every call holds the store lock while it waits, the way an SMI stops the whole machine.
+ */
+
+#ifndef _WIN32
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "firmware.h"
+#include "backend.h"
+#include "../thread/thread.h"
+#include "../unicode/unicode.h"
+#include "../util/hash.h"
+
+// VARIABLE_STORE_HEADER
+#define AST_EMU_STORE_HEADER_SIZE 28
+#define AST_EMU_STORE_FORMATTED   0x5a
+#define AST_EMU_STORE_HEALTHY     0xfe
+
+// AUTHENTICATED_VARIABLE_HEADER
+#define AST_EMU_VAR_HEADER_SIZE   60
+#define AST_EMU_VAR_START_ID      0x55aa
+#define AST_EMU_OFF_STATE         2
+#define AST_EMU_OFF_ATTRIBUTES    4
+#define AST_EMU_OFF_NAME_SIZE     36
+#define AST_EMU_OFF_DATA_SIZE     40
+#define AST_EMU_OFF_VENDOR_GUID   44
+
+// Variable states. Flash bits only go from 1 to 0, so a state is reached by clearing bits.
+#define AST_EMU_VAR_HEADER_VALID_ONLY     0x7f
+#define AST_EMU_VAR_ADDED                 0x3f
+#define AST_EMU_VAR_IN_DELETED_TRANSITION 0xfe
+#define AST_EMU_VAR_DELETED               0xfd
+
+#define AST_EMU_ALIGN(x) (((x) + 3) & ~((size_t) 3))
+
+/** Spin instead of sleeping below this many nanoseconds; the scheduler cannot do better. */
+#define AST_EMU_SPIN_MAX 100000
+
+/** EDK II gEfiAuthenticatedVariableGuid, the signature of an authenticated variable store. */
+static const ast_guid _ast_emu_signature = AST_GUID_INIT (0xaaf32c78, 0x947b, 0x439a, 0xa1, 0x80, 0x2e, 0x14, 0x4e, 0xc3, 0x77, 0x92);
+
+struct _ast_emu_slot {
+    uint32_t off;  // Record offset; 0 for an empty slot (no record lives inside the store header)
+    uint32_t hash;
+};
+
+struct _ast_emu_key {
+    const ast_guid *guid;
+    uint8_t  name[2 * AST_EFIVAR_NAME_MAX]; // UTF-16 LE with its terminator, as stored
+    uint32_t nameSiz;
+    uint32_t hash;
+};
+
+struct _ast_emu_ctx {
+    ast_mutex lock;
+    int       fd;        // -1 for a store in anonymous memory
+    uint8_t   *store;
+    size_t    mapSiz;
+    size_t    storeSiz;  // From the store header; at most mapSiz
+    size_t    end;       // First erased byte
+    size_t    liveSiz;   // Bytes of live records, what a reclaim keeps
+    size_t    nVars;
+    struct _ast_emu_slot *index;
+    size_t    nSlots;    // Power of two
+    struct ast_efivar_emu_config config;
+    struct ast_efivar_emu_stats  stats;
+};
+
+struct _ast_emu_iter {
+    size_t off;
+};
+
+static int  _ast_emu_read (void *ctx, const ast_guid *guid, const char *name, void *buf, size_t bufSiz, size_t *nBytes, uint32_t *attr);
+static int  _ast_emu_write (void *ctx, const ast_guid *guid, const char *name, const void *buf, size_t bufSiz, uint32_t attr);
+static int  _ast_emu_iter_open (void *ctx, unsigned int flags, void **it);
+static int  _ast_emu_iter_next (void *ctx, void *it, struct ast_efivar_info *infos, size_t cap, size_t *n);
+static void _ast_emu_iter_close (void *ctx, void *it);
+static void _ast_emu_destroy (struct ast_efivar_backend *backend);
+
+static int      _ast_emu_key_make (struct _ast_emu_key *key, const ast_guid *guid, const char *name);
+static uint32_t _ast_emu_hash (const uint8_t *guid, const uint8_t *name, size_t nameSiz);
+static uint32_t _ast_emu_find (struct _ast_emu_ctx *c, const struct _ast_emu_key *key, size_t *slot);
+static int      _ast_emu_index_put (struct _ast_emu_ctx *c, uint32_t off, uint32_t hash);
+static void     _ast_emu_index_remove (struct _ast_emu_ctx *c, size_t slot);
+static int      _ast_emu_index_rebuild (struct _ast_emu_ctx *c, size_t nSlots);
+static int      _ast_emu_scan (struct _ast_emu_ctx *c);
+static int      _ast_emu_reclaim (struct _ast_emu_ctx *c, uint32_t skip);
+static uint32_t _ast_emu_append (struct _ast_emu_ctx *c, const struct _ast_emu_key *key, uint32_t attr, const void *data, size_t dataSiz);
+static size_t   _ast_emu_record_size (const uint8_t *rec);
+static int      _ast_emu_is_live (const uint8_t *rec);
+static void     _ast_emu_delay (uint32_t ns);
+static uint32_t _ast_emu_le32 (const uint8_t *p);
+static void     _ast_emu_put32 (uint8_t *p, uint32_t v);
+
+
+
+
+
+struct ast_efivar_backend *ast_efivar_backend_emu_new (const char *path, const struct ast_efivar_emu_config *config)
+{
+    struct ast_efivar_backend *backend = NULL;
+    struct _ast_emu_ctx *c = NULL;
+    struct stat st;
+    int fresh = 1;
+
+    backend = calloc (1, sizeof (struct ast_efivar_backend));
+    c       = calloc (1, sizeof (struct _ast_emu_ctx));
+    if ((backend == NULL) || (c == NULL)) {
+        goto fail;
+    }
+    c->fd = -1;
+    if (config != NULL) {
+        c->config = *config;
+    }
+    if (c->config.storeSiz == 0) {
+        c->config.storeSiz = AST_EMU_DEFAULT_STORE_SIZE;
+    }
+    c->storeSiz = c->config.storeSiz;
+
+    if (path != NULL) {
+        c->fd = open (path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if ((c->fd < 0) || (fstat (c->fd, &st) != 0)) {
+            fprintf (stderr, " ** Cannot open variable store %s: %s.\n", path, strerror (errno));
+            goto fail;
+        }
+        if (st.st_size != 0) {
+            // An existing store keeps its size.
+            c->storeSiz = (size_t) st.st_size;
+            fresh = 0;
+        }
+    }
+
+    if ((c->storeSiz < AST_EMU_STORE_HEADER_SIZE + AST_EMU_VAR_HEADER_SIZE) || (c->storeSiz > UINT32_MAX)) {
+        fprintf (stderr, " ** Variable store size %zu is out of range.\n", c->storeSiz);
+        goto fail;
+    }
+
+    if (c->fd >= 0) {
+        if (fresh && (ftruncate (c->fd, (off_t) c->storeSiz) != 0)) {
+            fprintf (stderr, " ** Cannot size variable store %s: %s.\n", path, strerror (errno));
+            goto fail;
+        }
+        c->store = mmap (NULL, c->storeSiz, PROT_READ | PROT_WRITE, MAP_SHARED, c->fd, 0);
+    } else {
+        c->store = mmap (NULL, c->storeSiz, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    c->mapSiz = c->storeSiz;
+    if (c->store == MAP_FAILED) {
+        c->store = NULL;
+        fprintf (stderr, " ** Cannot map variable store: %s.\n", strerror (errno));
+        goto fail;
+    }
+
+    if (fresh) {
+        // Erased flash, then the store header.
+        memset (c->store, 0xff, c->storeSiz);
+        memcpy (c->store, _ast_emu_signature.b, sizeof (_ast_emu_signature.b));
+        _ast_emu_put32 (c->store + 16, (uint32_t) c->storeSiz);
+        c->store[20] = AST_EMU_STORE_FORMATTED;
+        c->store[21] = AST_EMU_STORE_HEALTHY;
+        memset (c->store + 22, 0, 6);
+    } else {
+        size_t hdrSiz = _ast_emu_le32 (c->store + 16);
+
+        if ((memcmp (c->store, _ast_emu_signature.b, sizeof (_ast_emu_signature.b)) != 0) ||
+            (c->store[20] != AST_EMU_STORE_FORMATTED) || (c->store[21] != AST_EMU_STORE_HEALTHY) ||
+            (hdrSiz < AST_EMU_STORE_HEADER_SIZE + AST_EMU_VAR_HEADER_SIZE) || (hdrSiz > c->storeSiz)) {
+            fprintf (stderr, " ** %s is not an authenticated variable store.\n", path);
+            goto fail;
+        }
+        c->storeSiz = hdrSiz;
+    }
+
+    if (_ast_emu_scan (c) != AST_RETURN_SUCCESS) {
+        goto fail;
+    }
+    ast_mutex_init (&(c->lock));
+
+    backend->name       = "emu";
+    backend->ctx        = c;
+    backend->read       = _ast_emu_read;
+    backend->read_batch = NULL;
+    backend->write      = _ast_emu_write;
+    backend->iter_open  = _ast_emu_iter_open;
+    backend->iter_next  = _ast_emu_iter_next;
+    backend->iter_close = _ast_emu_iter_close;
+    backend->destroy    = _ast_emu_destroy;
+    return backend;
+
+fail:
+    if (c != NULL) {
+        if (c->store != NULL) {
+            munmap (c->store, c->mapSiz);
+        }
+        if (c->fd >= 0) {
+            close (c->fd);
+        }
+        free (c->index);
+    }
+    free (c);
+    free (backend);
+    return NULL;
+}
+
+
+
+
+
+int ast_efivar_backend_emu_stats (struct ast_efivar_backend *backend, struct ast_efivar_emu_stats *stats)
+{
+    struct _ast_emu_ctx *c = NULL;
+
+    if ((backend == NULL) || (backend->destroy != _ast_emu_destroy) || (stats == NULL)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    c = backend->ctx;
+    ast_mutex_lock (&(c->lock));
+    *stats = c->stats;
+    stats->storeSiz   = c->storeSiz;
+    stats->usedSiz    = c->end;
+    stats->liveSiz    = AST_EMU_STORE_HEADER_SIZE + c->liveSiz;
+    stats->nVariables = c->nVars;
+    ast_mutex_unlock (&(c->lock));
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static int _ast_emu_read (void *ctx, const ast_guid *guid, const char *name, void *buf, size_t bufSiz, size_t *nBytes, uint32_t *attr)
+{
+    struct _ast_emu_ctx *c = ctx;
+    struct _ast_emu_key key;
+    const uint8_t *rec = NULL;
+    uint32_t off = 0;
+    size_t   dataSiz = 0;
+    int      ret = AST_RETURN_SUCCESS;
+
+    if (_ast_emu_key_make (&key, guid, name) != AST_RETURN_SUCCESS) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    ast_mutex_lock (&(c->lock));
+    _ast_emu_delay (c->config.readLatencyNs);
+    c->stats.reads++;
+
+    off = _ast_emu_find (c, &key, NULL);
+    if (off == 0) {
+        ret = AST_RETURN_NOT_FOUND;
+        goto out;
+    }
+    rec     = c->store + off;
+    dataSiz = _ast_emu_le32 (rec + AST_EMU_OFF_DATA_SIZE);
+    if (nBytes != NULL) {
+        *nBytes = dataSiz;
+    }
+    if (dataSiz > bufSiz) {
+        ret = AST_RETURN_BUFFER_TOO_SMALL;
+        goto out;
+    }
+    memcpy (buf, rec + AST_EMU_VAR_HEADER_SIZE + key.nameSiz, dataSiz);
+    if (attr != NULL) {
+        *attr = _ast_emu_le32 (rec + AST_EMU_OFF_ATTRIBUTES);
+    }
+
+out:
+    ast_mutex_unlock (&(c->lock));
+    return ret;
+}
+
+
+
+
+
+static int _ast_emu_write (void *ctx, const ast_guid *guid, const char *name, const void *buf, size_t bufSiz, uint32_t attr)
+{
+    struct _ast_emu_ctx *c = ctx;
+    struct _ast_emu_key key;
+    uint8_t  *old = NULL;
+    uint8_t  *joined = NULL;
+    const void *data = buf;
+    size_t   dataSiz = bufSiz;
+    size_t   oldRecSiz = 0;
+    size_t   recSiz = 0;
+    size_t   slot = 0;
+    uint32_t off = 0;
+    int      ret = AST_RETURN_SUCCESS;
+
+    if (_ast_emu_key_make (&key, guid, name) != AST_RETURN_SUCCESS) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    // SetVariable rejects runtime access without boot service access.
+    if ((attr & AST_EFIVAR_RUNTIME_ACCESS) && !(attr & AST_EFIVAR_BOOTSERVICE_ACCESS)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    ast_mutex_lock (&(c->lock));
+    _ast_emu_delay (c->config.writeLatencyNs);
+    c->stats.writes++;
+
+    off = _ast_emu_find (c, &key, &slot);
+    if (off != 0) {
+        old       = c->store + off;
+        oldRecSiz = _ast_emu_record_size (old);
+    }
+
+    // Appending nothing leaves the variable as it is, as SetVariable does; otherwise zero bytes or zero
+    // attributes delete it.
+    if ((bufSiz == 0) && (attr & AST_EFIVAR_APPEND_WRITE)) {
+        goto out;
+    }
+    if ((bufSiz == 0) || (attr == 0)) {
+        if (off == 0) {
+            ret = AST_RETURN_NOT_FOUND;
+            goto out;
+        }
+        old[AST_EMU_OFF_STATE] &= AST_EMU_VAR_DELETED;
+        c->stats.bytesProgrammed++;
+        _ast_emu_index_remove (c, slot);
+        c->liveSiz -= oldRecSiz;
+        c->nVars--;
+        goto out;
+    }
+
+    if (off != 0) {
+        uint32_t oldAttr = _ast_emu_le32 (old + AST_EMU_OFF_ATTRIBUTES);
+        size_t   oldSiz  = _ast_emu_le32 (old + AST_EMU_OFF_DATA_SIZE);
+        const uint8_t *oldData = old + AST_EMU_VAR_HEADER_SIZE + key.nameSiz;
+
+        // An existing variable keeps its attributes.
+        if ((oldAttr ^ attr) & ~((uint32_t) AST_EFIVAR_APPEND_WRITE)) {
+            ret = AST_RETURN_INVALID_PARAMETER;
+            goto out;
+        }
+
+        if (attr & AST_EFIVAR_APPEND_WRITE) {
+            joined = malloc (oldSiz + bufSiz);
+            if (joined == NULL) {
+                ret = AST_RETURN_OPERATION_FAILED;
+                goto out;
+            }
+            memcpy (joined, oldData, oldSiz);
+            memcpy (joined + oldSiz, buf, bufSiz);
+            data    = joined;
+            dataSiz = oldSiz + bufSiz;
+        } else if ((oldSiz == bufSiz) && (memcmp (oldData, buf, bufSiz) == 0)) {
+            // Same value: the firmware does not touch flash.
+            goto out;
+        }
+    }
+    attr &= ~((uint32_t) AST_EFIVAR_APPEND_WRITE);
+
+    if ((c->config.maxVariableSiz != 0) && (key.nameSiz + dataSiz > c->config.maxVariableSiz)) {
+        ret = AST_RETURN_INVALID_PARAMETER;
+        goto out;
+    }
+
+    recSiz = AST_EMU_ALIGN (AST_EMU_VAR_HEADER_SIZE + key.nameSiz + dataSiz);
+    if (c->end + recSiz > c->storeSiz) {
+        // Out of erased space. A reclaim drops the old record along with every other dead one.
+        if (AST_EMU_STORE_HEADER_SIZE + c->liveSiz - oldRecSiz + recSiz > c->storeSiz) {
+            ret = AST_RETURN_OPERATION_FAILED;
+            goto out;
+        }
+        ret = _ast_emu_reclaim (c, off);
+        if (ret != AST_RETURN_SUCCESS) {
+            goto out;
+        }
+        off = 0;
+    } else if (off != 0) {
+        old[AST_EMU_OFF_STATE] &= AST_EMU_VAR_IN_DELETED_TRANSITION;
+        c->stats.bytesProgrammed++;
+        _ast_emu_index_remove (c, slot);
+    }
+
+    if (_ast_emu_append (c, &key, attr, data, dataSiz) == 0) {
+        ret = AST_RETURN_OPERATION_FAILED;
+        goto out;
+    }
+
+    if (off != 0) {
+        old[AST_EMU_OFF_STATE] &= AST_EMU_VAR_DELETED;
+        c->stats.bytesProgrammed++;
+        c->liveSiz -= oldRecSiz;
+        c->nVars--;
+    }
+
+out:
+    ast_mutex_unlock (&(c->lock));
+    free (joined);
+    return ret;
+}
+
+
+
+
+
+static int _ast_emu_iter_open (void *ctx, unsigned int flags, void **it)
+{
+    struct _ast_emu_iter *i = malloc (sizeof (struct _ast_emu_iter));
+
+    (void) ctx;
+    (void) flags; // Attributes sit in the record header and are always filled in
+    if (i == NULL) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+    i->off = AST_EMU_STORE_HEADER_SIZE;
+    *it = i;
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static int _ast_emu_iter_next (void *ctx, void *it, struct ast_efivar_info *infos, size_t cap, size_t *n)
+{
+    struct _ast_emu_ctx *c = ctx;
+    struct _ast_emu_iter *i = it;
+
+    *n = 0;
+    ast_mutex_lock (&(c->lock));
+    // A reclaim since the last call moves records towards the front; some may then be missed, as on firmware.
+    while ((*n < cap) && (i->off < c->end)) {
+        const uint8_t *rec = c->store + i->off;
+        struct ast_efivar_info *info = &infos[*n];
+        size_t nameSiz = _ast_emu_le32 (rec + AST_EMU_OFF_NAME_SIZE);
+
+        i->off += _ast_emu_record_size (rec);
+        if (!_ast_emu_is_live (rec)) {
+            continue;
+        }
+        // One GetNextVariableName call per variable.
+        _ast_emu_delay (c->config.readLatencyNs);
+        c->stats.nextNames++;
+
+        if (ast_utf16_decode (rec + AST_EMU_VAR_HEADER_SIZE, nameSiz, info->name, sizeof (info->name)) >= sizeof (info->name)) {
+            continue;
+        }
+        memcpy (info->guid.b, rec + AST_EMU_OFF_VENDOR_GUID, sizeof (info->guid.b));
+        info->attr = _ast_emu_le32 (rec + AST_EMU_OFF_ATTRIBUTES);
+        info->size = _ast_emu_le32 (rec + AST_EMU_OFF_DATA_SIZE);
+        info->data = rec + AST_EMU_VAR_HEADER_SIZE + nameSiz; // The mapping never moves
+        (*n)++;
+    }
+    ast_mutex_unlock (&(c->lock));
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static void _ast_emu_iter_close (void *ctx, void *it)
+{
+    (void) ctx;
+    free (it);
+}
+
+
+
+
+
+static void _ast_emu_destroy (struct ast_efivar_backend *backend)
+{
+    struct _ast_emu_ctx *c = backend->ctx;
+
+    if (c->fd >= 0) {
+        msync (c->store, c->mapSiz, MS_SYNC);
+        close (c->fd);
+    }
+    munmap (c->store, c->mapSiz);
+    ast_mutex_destroy (&(c->lock));
+    free (c->index);
+    free (c);
+    free (backend);
+}
+
+
+
+
+
+static int _ast_emu_key_make (struct _ast_emu_key *key, const ast_guid *guid, const char *name)
+{
+    size_t units = 0;
+
+    if ((guid == NULL) || (name == NULL) || (name[0] == '\0') || (strlen (name) >= AST_EFIVAR_NAME_MAX)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    units = ast_utf16_units (name);
+    if (units == SIZE_MAX) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    // A UTF-16 name never has more code units than its UTF-8 form has bytes, so it fits.
+    ast_utf16_encode (key->name, name);
+    key->name[2 * units]     = 0;
+    key->name[2 * units + 1] = 0;
+    key->nameSiz = (uint32_t) (2 * units + 2);
+    key->guid    = guid;
+    key->hash    = _ast_emu_hash (guid->b, key->name, key->nameSiz);
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static uint32_t _ast_emu_hash (const uint8_t *guid, const uint8_t *name, size_t nameSiz)
+{
+    // FNV-1a over the GUID and the UTF-16 name, exactly as both sit in a record.
+    return ast_fnv1a32 (ast_fnv1a32 (AST_FNV1A32_INIT, guid, 16), name, nameSiz);
+}
+
+
+
+
+
+static uint32_t _ast_emu_find (struct _ast_emu_ctx *c, const struct _ast_emu_key *key, size_t *slot)
+{
+    size_t mask = c->nSlots - 1;
+
+    for (size_t s = key->hash & mask; c->index[s].off != 0; s = (s + 1) & mask) {
+        const uint8_t *rec = c->store + c->index[s].off;
+
+        if ((c->index[s].hash == key->hash) &&
+            (_ast_emu_le32 (rec + AST_EMU_OFF_NAME_SIZE) == key->nameSiz) &&
+            (memcmp (rec + AST_EMU_OFF_VENDOR_GUID, key->guid->b, 16) == 0) &&
+            (memcmp (rec + AST_EMU_VAR_HEADER_SIZE, key->name, key->nameSiz) == 0)) {
+            if (slot != NULL) {
+                *slot = s;
+            }
+            return c->index[s].off;
+        }
+    }
+    return 0;
+}
+
+
+
+
+
+static int _ast_emu_index_put (struct _ast_emu_ctx *c, uint32_t off, uint32_t hash)
+{
+    size_t mask = 0;
+    size_t s = 0;
+
+    // Keep the load factor at or below one half.
+    if (2 * (c->nVars + 1) > c->nSlots) {
+        if (_ast_emu_index_rebuild (c, 2 * c->nSlots) != AST_RETURN_SUCCESS) {
+            return AST_RETURN_OPERATION_FAILED;
+        }
+    }
+
+    mask = c->nSlots - 1;
+    for (s = hash & mask; c->index[s].off != 0; s = (s + 1) & mask) {
+    }
+    c->index[s].off  = off;
+    c->index[s].hash = hash;
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static void _ast_emu_index_remove (struct _ast_emu_ctx *c, size_t slot)
+{
+    // Linear probing without tombstones: shift later entries of the cluster back into the hole.
+    size_t mask = c->nSlots - 1;
+    size_t hole = slot;
+
+    for (size_t s = (slot + 1) & mask; c->index[s].off != 0; s = (s + 1) & mask) {
+        size_t home = c->index[s].hash & mask;
+
+        // Move s into the hole unless its home lies cyclically in (hole, s].
+        if (((s - home) & mask) >= ((s - hole) & mask)) {
+            c->index[hole] = c->index[s];
+            hole = s;
+        }
+    }
+    c->index[hole].off  = 0;
+    c->index[hole].hash = 0;
+}
+
+
+
+
+
+static int _ast_emu_index_rebuild (struct _ast_emu_ctx *c, size_t nSlots)
+{
+    struct _ast_emu_slot *old = c->index;
+    size_t oldSlots = c->nSlots;
+
+    c->index = calloc (nSlots, sizeof (struct _ast_emu_slot));
+    if (c->index == NULL) {
+        c->index = old;
+        return AST_RETURN_OPERATION_FAILED;
+    }
+    c->nSlots = nSlots;
+
+    for (size_t s = 0; s < oldSlots; s++) {
+        if (old[s].off != 0) {
+            size_t mask = nSlots - 1;
+            size_t t = old[s].hash & mask;
+
+            while (c->index[t].off != 0) {
+                t = (t + 1) & mask;
+            }
+            c->index[t] = old[s];
+        }
+    }
+    free (old);
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static int _ast_emu_scan (struct _ast_emu_ctx *c)
+{
+    size_t off = AST_EMU_STORE_HEADER_SIZE;
+
+    c->end     = off;
+    c->liveSiz = 0;
+    c->nVars   = 0;
+    free (c->index);
+    c->index  = NULL;
+    c->nSlots = 0;
+    if (_ast_emu_index_rebuild (c, 64) != AST_RETURN_SUCCESS) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+
+    while (off + AST_EMU_VAR_HEADER_SIZE <= c->storeSiz) {
+        uint8_t  *rec = c->store + off;
+        size_t   nameSiz = _ast_emu_le32 (rec + AST_EMU_OFF_NAME_SIZE);
+        size_t   dataSiz = _ast_emu_le32 (rec + AST_EMU_OFF_DATA_SIZE);
+        size_t   recSiz  = AST_EMU_ALIGN (AST_EMU_VAR_HEADER_SIZE + nameSiz + dataSiz);
+        uint32_t hash = 0;
+        size_t   slot = 0;
+        uint32_t dup  = 0;
+
+        if ((rec[0] != (AST_EMU_VAR_START_ID & 0xff)) || (rec[1] != (AST_EMU_VAR_START_ID >> 8))) {
+            break; // Erased space
+        }
+        if ((nameSiz < 2) || (nameSiz % 2 != 0) || (nameSiz > 2 * AST_EFIVAR_NAME_MAX) || (recSiz > c->storeSiz - off)) {
+            fprintf (stderr, " ** Variable store is corrupted at offset %zu; ignoring the rest.\n", off);
+            break;
+        }
+        off += recSiz;
+        c->end = off;
+
+        if (!_ast_emu_is_live (rec)) {
+            continue;
+        }
+
+        // An update interrupted between adding the new record and deleting the old one leaves both.
+        // The added record wins; a lone record in transition is still the variable.
+        {
+            struct _ast_emu_key key;
+
+            memcpy (key.name, rec + AST_EMU_VAR_HEADER_SIZE, nameSiz);
+            key.nameSiz = (uint32_t) nameSiz;
+            key.guid    = (const ast_guid *) (rec + AST_EMU_OFF_VENDOR_GUID);
+            key.hash    = _ast_emu_hash (rec + AST_EMU_OFF_VENDOR_GUID, key.name, nameSiz);
+            hash = key.hash;
+            dup  = _ast_emu_find (c, &key, &slot);
+        }
+        if (dup != 0) {
+            uint8_t *other = c->store + dup;
+
+            if (rec[AST_EMU_OFF_STATE] != AST_EMU_VAR_ADDED) {
+                rec[AST_EMU_OFF_STATE] &= AST_EMU_VAR_DELETED;
+                continue;
+            }
+            other[AST_EMU_OFF_STATE] &= AST_EMU_VAR_DELETED;
+            _ast_emu_index_remove (c, slot);
+            c->liveSiz -= _ast_emu_record_size (other);
+            c->nVars--;
+        }
+
+        if (_ast_emu_index_put (c, (uint32_t) (rec - c->store), hash) != AST_RETURN_SUCCESS) {
+            return AST_RETURN_OPERATION_FAILED;
+        }
+        c->liveSiz += recSiz;
+        c->nVars++;
+    }
+
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static int _ast_emu_reclaim (struct _ast_emu_ctx *c, uint32_t skip)
+{
+    uint8_t *tmp = malloc (c->storeSiz);
+    size_t  out = AST_EMU_STORE_HEADER_SIZE;
+
+    if (tmp == NULL) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+
+    // Copy the live records to a fresh image, then write it over the store: erase plus reprogram.
+    memcpy (tmp, c->store, AST_EMU_STORE_HEADER_SIZE);
+    for (size_t off = AST_EMU_STORE_HEADER_SIZE; off < c->end; ) {
+        const uint8_t *rec = c->store + off;
+        size_t recSiz = _ast_emu_record_size (rec);
+
+        if ((off != skip) && _ast_emu_is_live (rec)) {
+            memcpy (tmp + out, rec, recSiz);
+            tmp[out + AST_EMU_OFF_STATE] = AST_EMU_VAR_ADDED;
+            out += recSiz;
+        }
+        off += recSiz;
+    }
+    memset (tmp + out, 0xff, c->storeSiz - out);
+    memcpy (c->store, tmp, c->storeSiz);
+    free (tmp);
+
+    c->stats.reclaims++;
+    c->stats.bytesProgrammed += out;
+    return _ast_emu_scan (c);
+}
+
+
+
+
+
+static uint32_t _ast_emu_append (struct _ast_emu_ctx *c, const struct _ast_emu_key *key, uint32_t attr, const void *data, size_t dataSiz)
+{
+    uint8_t *rec = c->store + c->end;
+    size_t  recSiz = AST_EMU_ALIGN (AST_EMU_VAR_HEADER_SIZE + key->nameSiz + dataSiz);
+    uint32_t off = (uint32_t) c->end;
+
+    // Program the header as valid-only, then name and data, then mark the record added.
+    rec[0] = AST_EMU_VAR_START_ID & 0xff;
+    rec[1] = AST_EMU_VAR_START_ID >> 8;
+    rec[AST_EMU_OFF_STATE] = AST_EMU_VAR_HEADER_VALID_ONLY;
+    rec[3] = 0;
+    _ast_emu_put32 (rec + AST_EMU_OFF_ATTRIBUTES, attr);
+    memset (rec + 8, 0, AST_EMU_OFF_NAME_SIZE - 8); // MonotonicCount, TimeStamp, PubKeyIndex
+    _ast_emu_put32 (rec + AST_EMU_OFF_NAME_SIZE, key->nameSiz);
+    _ast_emu_put32 (rec + AST_EMU_OFF_DATA_SIZE, (uint32_t) dataSiz);
+    memcpy (rec + AST_EMU_OFF_VENDOR_GUID, key->guid->b, 16);
+    memcpy (rec + AST_EMU_VAR_HEADER_SIZE, key->name, key->nameSiz);
+    memcpy (rec + AST_EMU_VAR_HEADER_SIZE + key->nameSiz, data, dataSiz);
+    rec[AST_EMU_OFF_STATE] &= AST_EMU_VAR_ADDED;
+
+    if (_ast_emu_index_put (c, off, key->hash) != AST_RETURN_SUCCESS) {
+        rec[AST_EMU_OFF_STATE] &= AST_EMU_VAR_DELETED;
+        c->end += recSiz;
+        return 0;
+    }
+    c->end += recSiz;
+    c->liveSiz += recSiz;
+    c->nVars++;
+    c->stats.bytesProgrammed += recSiz;
+    return off;
+}
+
+
+
+
+
+static size_t _ast_emu_record_size (const uint8_t *rec)
+{
+    return AST_EMU_ALIGN (AST_EMU_VAR_HEADER_SIZE + _ast_emu_le32 (rec + AST_EMU_OFF_NAME_SIZE) + _ast_emu_le32 (rec + AST_EMU_OFF_DATA_SIZE));
+}
+
+
+
+
+
+static int _ast_emu_is_live (const uint8_t *rec)
+{
+    uint8_t state = rec[AST_EMU_OFF_STATE];
+
+    return (state == AST_EMU_VAR_ADDED) || (state == (AST_EMU_VAR_ADDED & AST_EMU_VAR_IN_DELETED_TRANSITION));
+}
+
+
+
+
+
+static void _ast_emu_delay (uint32_t ns)
+{
+    struct timespec start;
+    struct timespec now;
+
+    if (ns == 0) {
+        return;
+    }
+
+    if (ns >= AST_EMU_SPIN_MAX) {
+        struct timespec req = { ns / 1000000000u, ns % 1000000000u };
+
+        while ((nanosleep (&req, &req) != 0) && (errno == EINTR)) {
+        }
+        return;
+    }
+
+    // An SMI keeps the CPU busy too.
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    do {
+        clock_gettime (CLOCK_MONOTONIC, &now);
+    } while ((uint64_t) ((now.tv_sec - start.tv_sec) * 1000000000LL + (now.tv_nsec - start.tv_nsec)) < ns);
+}
+
+
+
+
+
+static uint32_t _ast_emu_le32 (const uint8_t *p)
+{
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+
+
+
+
+static void _ast_emu_put32 (uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t) v;
+    p[1] = (uint8_t) (v >> 8);
+    p[2] = (uint8_t) (v >> 16);
+    p[3] = (uint8_t) (v >> 24);
+}
+
+#endif /* _WIN32 */
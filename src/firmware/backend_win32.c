@@ -0,0 +1,420 @@
+/**
+ * @file backend_win32.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements the Win32 variable store backend declared in backend.h.
+ *
+ * Variables are accessed with [GetFirmwareEnvironmentVariable](https://msdn.microsoft.com/en-us/library/windows/desktop/ms724325(v=vs.85).aspx)
+ * and [SetFirmwareEnvironmentVariable](https://msdn.microsoft.com/en-us/library/windows/desktop/ms724934(v=vs.85).aspx),
+ * which need SE_SYSTEM_ENVIRONMENT. The `Ex` variants (Windows 8 and later) are used when present so that
+ * attributes can be read and written.
+ *
+ * Enumeration uses NtEnumerateSystemEnvironmentValuesEx from ntdll, which has no Win32 counterpart. It
+ * returns every variable, value included, in one buffer; the iterator walks that buffer in place, so
+ * lazy payload reads after enumeration cost no further firmware calls.
+ */
+
+#ifdef _WIN32
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <windows.h>
+#include "firmware.h"
+#include "backend.h"
+#include "../privilege/privilege.h"
+
+typedef DWORD (WINAPI *_ast_get_fw_env_ex_fn) (LPCSTR, LPCSTR, PVOID, DWORD, PDWORD);
+typedef BOOL  (WINAPI *_ast_set_fw_env_ex_fn) (LPCSTR, LPCSTR, PVOID, DWORD, DWORD);
+
+typedef LONG  (NTAPI *_ast_nt_enum_env_fn) (ULONG, PVOID, PULONG);
+
+#define AST_NT_SYSTEM_ENVIRONMENT_VALUE_INFORMATION 2
+#define AST_NT_STATUS_BUFFER_TOO_SMALL              ((LONG) 0xC0000023)
+#define AST_NT_STATUS_NOT_IMPLEMENTED               ((LONG) 0xC0000002)
+
+// VARIABLE_NAME_AND_VALUE, as returned for SystemEnvironmentValueInformation.
+typedef struct _ast_nt_variable {
+    ULONG NextEntryOffset;
+    ULONG ValueOffset;
+    ULONG ValueLength;
+    ULONG Attributes;
+    GUID  VendorGuid;
+    WCHAR Name[1];
+} _ast_nt_variable;
+
+struct _ast_win32_ctx {
+    _ast_get_fw_env_ex_fn getEx;   // NULL before Windows 8
+    _ast_set_fw_env_ex_fn setEx;   // NULL before Windows 8
+    _ast_nt_enum_env_fn   enumEnv; // NULL if ntdll does not export it
+};
+
+struct _ast_win32_iter {
+    uint8_t *buf;
+    ULONG   bufSiz;
+    ULONG   pos;  // Offset of the next entry
+    int     done;
+};
+
+static int  _ast_win32_read (void *ctx, const ast_guid *guid, const char *name, void *buf, size_t bufSiz, size_t *nBytes, uint32_t *attr);
+static int  _ast_win32_read_batch (void *ctx, const ast_var_request *reqs, size_t n, ast_var_result *results);
+static int  _ast_win32_read_one (struct _ast_win32_ctx *c, const ast_guid *guid, const char *name, void *buf, size_t bufSiz, size_t *nBytes, uint32_t *attr);
+static int  _ast_win32_write (void *ctx, const ast_guid *guid, const char *name, const void *buf, size_t bufSiz, uint32_t attr);
+static int  _ast_win32_iter_open (void *ctx, unsigned int flags, void **it);
+static int  _ast_win32_iter_next (void *ctx, void *it, struct ast_efivar_info *infos, size_t cap, size_t *n);
+static void _ast_win32_iter_close (void *ctx, void *it);
+static void _ast_win32_destroy (struct ast_efivar_backend *backend);
+static int  _ast_win32_name (const WCHAR *src, size_t srcLen, char *dst, size_t dstSiz);
+static int  _ast_win32_error (const char *func, DWORD err);
+
+
+
+
+
+struct ast_efivar_backend *ast_efivar_backend_win32_new (void)
+{
+    struct ast_efivar_backend *backend = calloc (1, sizeof (struct ast_efivar_backend));
+    struct _ast_win32_ctx *ctx = calloc (1, sizeof (struct _ast_win32_ctx));
+    HMODULE kernel32 = GetModuleHandle ("Kernel32.dll");
+    HMODULE ntdll    = GetModuleHandle ("ntdll.dll");
+
+    if ((backend == NULL) || (ctx == NULL)) {
+        free (backend);
+        free (ctx);
+        return NULL;
+    }
+
+    // NOTE: Directly using the Ex functions can make program being not able to run on lower version of Windows.
+    if (kernel32 != NULL) {
+        ctx->getEx = (_ast_get_fw_env_ex_fn) GetProcAddress (kernel32, "GetFirmwareEnvironmentVariableExA");
+        ctx->setEx = (_ast_set_fw_env_ex_fn) GetProcAddress (kernel32, "SetFirmwareEnvironmentVariableExA");
+    }
+    if (ntdll != NULL) {
+        ctx->enumEnv = (_ast_nt_enum_env_fn) GetProcAddress (ntdll, "NtEnumerateSystemEnvironmentValuesEx");
+    }
+
+    backend->name       = "win32";
+    backend->ctx        = ctx;
+    backend->read       = _ast_win32_read;
+    backend->read_batch = _ast_win32_read_batch;
+    backend->write      = _ast_win32_write;
+    backend->iter_open  = (ctx->enumEnv != NULL) ? _ast_win32_iter_open : NULL;
+    backend->iter_next  = _ast_win32_iter_next;
+    backend->iter_close = _ast_win32_iter_close;
+    backend->destroy    = _ast_win32_destroy;
+    return backend;
+}
+
+
+
+
+
+static int _ast_win32_read (void *ctx, const ast_guid *guid, const char *name, void *buf, size_t bufSiz, size_t *nBytes, uint32_t *attr)
+{
+    if (ast_privilege_obtain (SE_SYSTEM_ENVIRONMENT_NAME) != EXIT_SUCCESS) {
+        fprintf (stderr, " ** Cannot obtain sufficient privilege. Failed to read efivar.\n");
+        return AST_RETURN_ACCESS_DENIED;
+    }
+
+    return _ast_win32_read_one (ctx, guid, name, buf, bufSiz, nBytes, attr);
+}
+
+
+
+
+
+static int _ast_win32_read_batch (void *ctx, const ast_var_request *reqs, size_t n, ast_var_result *results)
+{
+    // Adjust the token once for the whole batch instead of once per variable.
+    if (ast_privilege_obtain (SE_SYSTEM_ENVIRONMENT_NAME) != EXIT_SUCCESS) {
+        fprintf (stderr, " ** Cannot obtain sufficient privilege. Failed to read efivars.\n");
+        return AST_RETURN_ACCESS_DENIED;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        results[i].nBytes = 0;
+        results[i].attr   = 0;
+        results[i].status = _ast_win32_read_one (ctx, reqs[i].guid, reqs[i].name, reqs[i].buf, reqs[i].bufSiz,
+                                                 &results[i].nBytes, reqs[i].withAttr ? &results[i].attr : NULL);
+    }
+
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static int _ast_win32_read_one (struct _ast_win32_ctx *c, const ast_guid *guid, const char *name, void *buf, size_t bufSiz, size_t *nBytes, uint32_t *attr)
+{
+    char  braced[AST_GUID_STRLEN + 3];
+    DWORD nBytesStored = 0;
+    DWORD attributes   = 0;
+
+    if (guid == NULL) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    ast_guid_format_braced (guid, braced);
+    if (bufSiz > MAXDWORD) {
+        bufSiz = MAXDWORD;
+    }
+
+    // A variable may legally be empty, in which case the return value is 0 without an error.
+    SetLastError (ERROR_SUCCESS);
+    if ((attr != NULL) && (c->getEx != NULL)) {
+        nBytesStored = c->getEx (name, braced, buf, (DWORD) bufSiz, &attributes);
+    } else {
+        nBytesStored = GetFirmwareEnvironmentVariable (name, braced, buf, (DWORD) bufSiz);
+        attributes   = AST_EFIVAR_DEFAULT_ATTRIBUTES; // XXX: Not available before Windows 8
+    }
+
+    if ((nBytesStored == 0) && (GetLastError () != ERROR_SUCCESS)) {
+        return _ast_win32_error ("GetFirmwareEnvironmentVariable", GetLastError ());
+    }
+
+    if (nBytes != NULL) {
+        *nBytes = nBytesStored;
+    }
+    if (attr != NULL) {
+        *attr = attributes;
+    }
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static int _ast_win32_write (void *ctx, const ast_guid *guid, const char *name, const void *buf, size_t bufSiz, uint32_t attr)
+{
+    struct _ast_win32_ctx *c = ctx;
+    char braced[AST_GUID_STRLEN + 3];
+    BOOL bRet = FALSE;
+
+    if ((guid == NULL) || (bufSiz > MAXDWORD)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    ast_guid_format_braced (guid, braced);
+
+    if (ast_privilege_obtain (SE_SYSTEM_ENVIRONMENT_NAME) != EXIT_SUCCESS) {
+        fprintf (stderr, " ** Cannot obtain sufficient privilege. Failed to write efivar.\n");
+        return AST_RETURN_ACCESS_DENIED;
+    }
+
+    if (c->setEx != NULL) {
+        bRet = c->setEx (name, braced, (PVOID) buf, (DWORD) bufSiz, attr);
+    } else {
+        // Without the Ex variant the firmware uses NV + BS + RT.
+        bRet = SetFirmwareEnvironmentVariable (name, braced, (PVOID) buf, (DWORD) bufSiz);
+    }
+
+    if (!bRet) {
+        return _ast_win32_error ("SetFirmwareEnvironmentVariable", GetLastError ());
+    }
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static int _ast_win32_iter_open (void *ctx, unsigned int flags, void **it)
+{
+    struct _ast_win32_ctx *c = ctx;
+    struct _ast_win32_iter *i = NULL;
+    ULONG bufSiz = 64 * 1024;
+    LONG  status = 0;
+
+    (void) flags; // Attributes come with every entry anyway
+    if (ast_privilege_obtain (SE_SYSTEM_ENVIRONMENT_NAME) != EXIT_SUCCESS) {
+        fprintf (stderr, " ** Cannot obtain sufficient privilege. Failed to enumerate efivars.\n");
+        return AST_RETURN_ACCESS_DENIED;
+    }
+
+    i = calloc (1, sizeof (struct _ast_win32_iter));
+    if (i == NULL) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+
+    // The required size is reported back on STATUS_BUFFER_TOO_SMALL; the store may grow in between.
+    for (;;) {
+        uint8_t *buf = realloc (i->buf, bufSiz);
+        if (buf == NULL) {
+            free (i->buf);
+            free (i);
+            return AST_RETURN_OPERATION_FAILED;
+        }
+        i->buf = buf;
+        i->bufSiz = bufSiz;
+
+        status = c->enumEnv (AST_NT_SYSTEM_ENVIRONMENT_VALUE_INFORMATION, i->buf, &bufSiz);
+        if ((status != AST_NT_STATUS_BUFFER_TOO_SMALL) || (bufSiz <= i->bufSiz)) {
+            break;
+        }
+    }
+
+    if (status < 0) {
+        free (i->buf);
+        free (i);
+        if (status == AST_NT_STATUS_NOT_IMPLEMENTED) {
+            return AST_RETURN_NOT_SUPPORTED; // Not a UEFI machine
+        }
+        fprintf (stderr, " ** NtEnumerateSystemEnvironmentValuesEx failed with status 0x%08lx.\n", (unsigned long) status);
+        return AST_RETURN_OPERATION_FAILED;
+    }
+    i->bufSiz = bufSiz;
+    i->done = (bufSiz < sizeof (_ast_nt_variable));
+
+    *it = i;
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static int _ast_win32_iter_next (void *ctx, void *it, struct ast_efivar_info *infos, size_t cap, size_t *n)
+{
+    struct _ast_win32_iter *i = it;
+
+    (void) ctx;
+    *n = 0;
+    while ((*n < cap) && !i->done) {
+        const _ast_nt_variable *var = (const _ast_nt_variable *) (i->buf + i->pos);
+        ULONG entrySiz = 0;
+        ULONG nameOff  = offsetof (_ast_nt_variable, Name);
+        struct ast_efivar_info *info = &infos[*n];
+
+        // Never trust offsets beyond the entry they belong to.
+        if (i->bufSiz - i->pos < sizeof (_ast_nt_variable)) {
+            i->done = 1;
+            break;
+        }
+        entrySiz = (var->NextEntryOffset != 0) ? var->NextEntryOffset : (i->bufSiz - i->pos);
+        if ((entrySiz < sizeof (_ast_nt_variable)) || (entrySiz > i->bufSiz - i->pos)
+            || (var->ValueOffset < nameOff) || (var->ValueOffset > entrySiz) || (var->ValueLength > entrySiz - var->ValueOffset)) {
+            fprintf (stderr, " ** NtEnumerateSystemEnvironmentValuesEx returned a malformed entry.\n");
+            i->done = 1;
+            return AST_RETURN_OPERATION_FAILED;
+        }
+
+        if (var->NextEntryOffset == 0) {
+            i->done = 1;
+        } else {
+            i->pos += var->NextEntryOffset;
+        }
+
+        if (_ast_win32_name (var->Name, (var->ValueOffset - nameOff) / sizeof (WCHAR), info->name, sizeof (info->name)) != AST_RETURN_SUCCESS) {
+            continue; // Name too long for ast_efivar_info
+        }
+        memcpy (info->guid.b, &(var->VendorGuid), sizeof (info->guid.b)); // Same layout as EFI_GUID
+        info->attr = var->Attributes;
+        info->size = var->ValueLength;
+        info->data = (const uint8_t *) var + var->ValueOffset;
+        (*n)++;
+    }
+
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static void _ast_win32_iter_close (void *ctx, void *it)
+{
+    struct _ast_win32_iter *i = it;
+
+    (void) ctx;
+    free (i->buf);
+    free (i);
+}
+
+
+
+
+
+static void _ast_win32_destroy (struct ast_efivar_backend *backend)
+{
+    free (backend->ctx);
+    free (backend);
+}
+
+
+
+
+
+static int _ast_win32_name (const WCHAR *src, size_t srcLen, char *dst, size_t dstSiz)
+{
+    // UTF-16 to UTF-8; the name may or may not be NUL terminated within srcLen.
+    size_t d = 0;
+
+    for (size_t s = 0; (s < srcLen) && (src[s] != 0); s++) {
+        uint32_t cp = src[s];
+        if ((cp >= 0xD800) && (cp < 0xDC00) && (s + 1 < srcLen) && (src[s + 1] >= 0xDC00) && (src[s + 1] < 0xE000)) {
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (src[++s] - 0xDC00);
+        }
+
+        if (cp < 0x80) {
+            if (d + 1 >= dstSiz) {
+                return AST_RETURN_BUFFER_TOO_SMALL;
+            }
+            dst[d++] = (char) cp;
+        } else if (cp < 0x800) {
+            if (d + 2 >= dstSiz) {
+                return AST_RETURN_BUFFER_TOO_SMALL;
+            }
+            dst[d++] = (char) (0xC0 | (cp >> 6));
+            dst[d++] = (char) (0x80 | (cp & 0x3F));
+        } else if (cp < 0x10000) {
+            if (d + 3 >= dstSiz) {
+                return AST_RETURN_BUFFER_TOO_SMALL;
+            }
+            dst[d++] = (char) (0xE0 | (cp >> 12));
+            dst[d++] = (char) (0x80 | ((cp >> 6) & 0x3F));
+            dst[d++] = (char) (0x80 | (cp & 0x3F));
+        } else {
+            if (d + 4 >= dstSiz) {
+                return AST_RETURN_BUFFER_TOO_SMALL;
+            }
+            dst[d++] = (char) (0xF0 | (cp >> 18));
+            dst[d++] = (char) (0x80 | ((cp >> 12) & 0x3F));
+            dst[d++] = (char) (0x80 | ((cp >> 6) & 0x3F));
+            dst[d++] = (char) (0x80 | (cp & 0x3F));
+        }
+    }
+
+    dst[d] = '\0';
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static int _ast_win32_error (const char *func, DWORD err)
+{
+    switch (err) {
+        case ERROR_ENVVAR_NOT_FOUND:
+            return AST_RETURN_NOT_FOUND;
+        case ERROR_INSUFFICIENT_BUFFER:
+            return AST_RETURN_BUFFER_TOO_SMALL;
+        case ERROR_PRIVILEGE_NOT_HELD: // fall through
+        case ERROR_ACCESS_DENIED:
+            return AST_RETURN_ACCESS_DENIED;
+        case ERROR_INVALID_FUNCTION:
+            // Not a UEFI machine.
+            return AST_RETURN_NOT_SUPPORTED;
+        case ERROR_INVALID_PARAMETER:
+            return AST_RETURN_INVALID_PARAMETER;
+        default:
+            fprintf (stderr, " ** %s failed with error %lu.\n", func, err);
+            return AST_RETURN_OPERATION_FAILED;
+    }
+}
+
+#endif /* _WIN32 */
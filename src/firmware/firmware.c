@@ -10,13 +10,54 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
 #include <windows.h>
 #include <versionhelpers.h>
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/vfs.h>
+#endif
 #include "firmware.h"
+#include "backend.h"
+#include "../arena/arena.h"
 #include "../privilege/privilege.h"
-
+#include "../snapshot/snapshot.h"
+#include "../stats/stats.h"
+#include "../thread/thread.h"
+
+#ifndef AST_FIRMWARE_SYSFS
+/** Where Linux describes the firmware; only there when booted through UEFI. */
+#define AST_FIRMWARE_SYSFS "/sys/firmware/efi"
+#endif
+
+static int _ast_firmware_detect (struct ast_firmware_info *info);
+static int _ast_firmware_read_flag (const char *name, int *value);
+#ifdef _WIN32
 static int _ast_get_firmware_type_on_win8_or_greater (enum AST_FIRMWARE_TYPE *T);
 static int _ast_get_firmware_type_on_win8_lesser (enum AST_FIRMWARE_TYPE *T);
+#else
+static int _ast_firmware_runtime_services (const char *dir);
+#endif
+
+struct ast_efivar_iter {
+    struct ast_efivar_backend *backend;
+    void *it;
+};
+
+static struct ast_firmware_info _ast_firmware;                            // Detected once
+static int                      _ast_firmware_status = AST_RETURN_SUCCESS;
+static int                      _ast_firmware_ready  = 0;                  // Set (release) once the two above are final
+static ast_mutex                _ast_firmware_lock   = AST_MUTEX_INIT;
+
+static struct ast_efivar_backend *_ast_backend         = NULL; // Selected by the user
+static struct ast_efivar_backend *_ast_backend_default = NULL; // Created on first use
+static ast_once                   _ast_backend_once    = AST_ONCE_INIT;
+
+static void _ast_backend_default_new (void);
+static int  _ast_backend_read (struct ast_efivar_backend *backend, const ast_guid *guid, const char *name, void *buf, size_t bufSiz, size_t *nBytes, uint32_t *attr);
 
 
 
@@ -24,59 +65,504 @@ static int _ast_get_firmware_type_on_win8_lesser (enum AST_FIRMWARE_TYPE *T);
 
 int ast_get_firmware_type (enum AST_FIRMWARE_TYPE *type)
 {
-    // NOTE: Since Windows 8, there's a WinAPI called GetFirmwareType
-    //   (https://msdn.microsoft.com/en-us/library/windows/desktop/hh848321(v=vs.85).aspx),
-    //   which can quickly determine the computer's firmware.
-    //
-    //   Use GetFirmwareType on newer Windows, or the traditional way -- passing dummy UUID
-    //   and variable name to GetFirmwareEnvironmentVariable and check return value.
-    if (IsWindows8OrGreater () == TRUE) {
-        if (_ast_get_firmware_type_on_win8_or_greater (type) == EXIT_SUCCESS) {
-            return EXIT_SUCCESS;
-        } else {
-            fprintf (stderr, " ** cannot get firmware type.\n");
-            return EXIT_FAILURE;
+    struct ast_firmware_info info;
+    int ret = ast_get_firmware_info (&info);
+
+    if (ret == AST_RETURN_SUCCESS) {
+        *type = info.type;
+    }
+    return ret;
+}
+
+
+
+
+
+int ast_get_firmware_info (struct ast_firmware_info *info)
+{
+    // Double-checked: after the first call this is one acquire load and a copy.
+    if (!__atomic_load_n (&_ast_firmware_ready, __ATOMIC_ACQUIRE)) {
+        ast_mutex_lock (&_ast_firmware_lock);
+        if (!_ast_firmware_ready) {
+            _ast_firmware_status = _ast_firmware_detect (&_ast_firmware);
+            if (_ast_firmware_status != AST_RETURN_SUCCESS) {
+                fprintf (stderr, " ** cannot get firmware type.\n");
+            }
+            __atomic_store_n (&_ast_firmware_ready, 1, __ATOMIC_RELEASE);
         }
+        ast_mutex_unlock (&_ast_firmware_lock);
+    }
+
+    if (_ast_firmware_status == AST_RETURN_SUCCESS) {
+        *info = _ast_firmware;
+    }
+    return _ast_firmware_status;
+}
+
+
+
+
+
+int ast_efivar_backend_set (struct ast_efivar_backend *backend)
+{
+    _ast_backend = backend;
+    return EXIT_SUCCESS;
+}
+
+
+
+
+
+struct ast_efivar_backend *ast_efivar_backend_get (void)
+{
+    if (_ast_backend != NULL) {
+        return _ast_backend;
+    }
+
+    // Threads racing on the first call must not each create (and leak) a default backend.
+    ast_once_run (&_ast_backend_once, _ast_backend_default_new);
+    return _ast_backend_default;
+}
+
+
+
+
+
+void ast_efivar_backend_free (struct ast_efivar_backend *backend)
+{
+    if (backend == NULL) {
+        return;
+    }
+    if (backend == _ast_backend) {
+        _ast_backend = NULL;
+    }
+    if (backend == _ast_backend_default) {
+        _ast_backend_default = NULL;
+    }
+    backend->destroy (backend);
+}
+
+
+
+
+
+int ast_read_efivar (char *var, size_t bufSiz, char *guid, char *name)
+{
+    size_t nBytesStored = 0;
+    int ret = ast_read_efivar_ex (var, bufSiz, guid, name, &nBytesStored, NULL);
+
+    if (ret != AST_RETURN_SUCCESS) {
+        fprintf (stderr, " ** Failed to read efivar %s (error %d).\n", name, ret);
+    }
+    return ret;
+}
+
+
+
+
+
+int ast_read_efivar_ex (void *buf, size_t bufSiz, const char *guid, const char *name, size_t *nBytes, uint32_t *attr)
+{
+    ast_guid g;
+
+    if (ast_guid_parse (guid, &g) != AST_RETURN_SUCCESS) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    return ast_read_efivar_guid (buf, bufSiz, &g, name, nBytes, attr);
+}
+
+
+
+
+
+int ast_read_efivar_guid (void *buf, size_t bufSiz, const ast_guid *guid, const char *name, size_t *nBytes, uint32_t *attr)
+{
+    struct ast_efivar_backend *backend = ast_efivar_backend_get ();
+
+    if (backend == NULL) {
+        return AST_RETURN_NOT_SUPPORTED;
+    }
+    if ((guid == NULL) || ((buf == NULL) && (bufSiz != 0))) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    return _ast_backend_read (backend, guid, name, buf, bufSiz, nBytes, attr);
+}
+
+
+
+
+
+int ast_read_efivars_batch (const ast_var_request *reqs, size_t n, ast_var_result *results)
+{
+    struct ast_efivar_backend *backend = ast_efivar_backend_get ();
+    int ret = AST_RETURN_SUCCESS;
+
+    if ((n != 0) && ((reqs == NULL) || (results == NULL))) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    if (backend == NULL) {
+        ret = AST_RETURN_NOT_SUPPORTED;
+    } else if (backend->read_batch != NULL) {
+        AST_STATS_BEGIN (t);
+        ret = backend->read_batch (backend->ctx, reqs, n, results);
+        AST_STATS_END (AST_STATS_OP_READ_BATCH, NULL, NULL, ret, t);
+        AST_STATS_ADD (AST_STATS_COUNTER_BATCH_ITEMS, n);
     } else {
-        if (_ast_get_firmware_type_on_win8_lesser (type) == EXIT_SUCCESS) {
-            return EXIT_SUCCESS;
+        for (size_t i = 0; i < n; i++) {
+            results[i].nBytes = 0;
+            results[i].attr   = 0;
+            results[i].status = _ast_backend_read (backend, reqs[i].guid, reqs[i].name, reqs[i].buf, reqs[i].bufSiz,
+                                                   &results[i].nBytes, reqs[i].withAttr ? &results[i].attr : NULL);
+        }
+    }
+
+    if (ret != AST_RETURN_SUCCESS) {
+        // The batch never started; every item shares the reason.
+        for (size_t i = 0; i < n; i++) {
+            results[i].status = ret;
+            results[i].nBytes = 0;
+            results[i].attr   = 0;
+            results[i].data   = NULL;
+        }
+        return ret;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        results[i].data = reqs[i].buf;
+        if ((backend->read_batch != NULL) && (results[i].status == AST_RETURN_SUCCESS)) {
+            AST_STATS_ADD (AST_STATS_COUNTER_READ_BYTES, results[i].nBytes); // Unbatched reads count their own
+        }
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (results[i].status != AST_RETURN_SUCCESS) {
+            return AST_RETURN_OPERATION_FAILED;
+        }
+    }
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+int ast_read_efivar_alloc (struct ast_arena *arena, const ast_guid *guid, const char *name, void **data, size_t *nBytes, uint32_t *attr)
+{
+    struct ast_efivar_backend *backend = ast_efivar_backend_get ();
+    size_t want  = 256; // Any variable fits in the chunk's free tail most of the time
+    size_t avail = 0;
+    size_t n     = 0;
+    void   *p    = NULL;
+    int    ret   = AST_RETURN_SUCCESS;
+
+    if (backend == NULL) {
+        return AST_RETURN_NOT_SUPPORTED;
+    }
+    if ((arena == NULL) || (guid == NULL) || (data == NULL) || (nBytes == NULL)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    for (;;) {
+        p = ast_arena_reserve (arena, want, &avail);
+        if (p == NULL) {
+            return AST_RETURN_OPERATION_FAILED;
+        }
+
+        n = 0;
+        ret = _ast_backend_read (backend, guid, name, p, avail, &n, attr);
+        if (ret != AST_RETURN_BUFFER_TOO_SMALL) {
+            break;
+        }
+
+        // Exact size if the backend told us, otherwise grow geometrically.
+        want = (n > avail) ? n : 2 * avail;
+        if (want > AST_EFIVAR_MAX_SIZE) {
+            fprintf (stderr, " ** efivar %s is larger than %d bytes.\n", name, AST_EFIVAR_MAX_SIZE);
+            return AST_RETURN_BUFFER_TOO_SMALL;
+        }
+    }
+
+    if (ret == AST_RETURN_SUCCESS) {
+        ast_arena_commit (arena, n);
+        *data   = p;
+        *nBytes = n;
+    }
+    return ret;
+}
+
+
+
+
+
+int ast_read_efivars_batch_arena (struct ast_arena *arena, const ast_var_request *reqs, size_t n, ast_var_result *results)
+{
+    int ret = AST_RETURN_SUCCESS;
+    size_t i = 0;
+
+    if ((n != 0) && ((reqs == NULL) || (results == NULL))) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    while (i < n) {
+        if (reqs[i].buf == NULL) {
+            results[i].nBytes = 0;
+            results[i].attr   = 0;
+            results[i].data   = NULL;
+            results[i].status = ast_read_efivar_alloc (arena, reqs[i].guid, reqs[i].name, &results[i].data,
+                                                       &results[i].nBytes, reqs[i].withAttr ? &results[i].attr : NULL);
+            if (results[i].status != AST_RETURN_SUCCESS) {
+                ret = AST_RETURN_OPERATION_FAILED;
+            }
+            i++;
         } else {
-            fprintf(stderr, " ** cannot get firmware type.\n");
+            // Hand each run of requests with buffers to the backend as one batch.
+            size_t j = i;
+            int    r = AST_RETURN_SUCCESS;
+
+            while ((j < n) && (reqs[j].buf != NULL)) {
+                j++;
+            }
+            r = ast_read_efivars_batch (reqs + i, j - i, results + i);
+            if (r != AST_RETURN_SUCCESS) {
+                // Per-item statuses are set even if the batch could not start.
+                ret = AST_RETURN_OPERATION_FAILED;
+            }
+            i = j;
         }
     }
 
-    // Whatever.
-    return EXIT_FAILURE;
+    return ret;
 }
 
 
 
 
 
-int ast_read_efivar (char *var, size_t bufSiz, char *guid, char *name)
+int ast_efivar_iter_open (struct ast_efivar_iter **iter, unsigned int flags)
 {
-    DWORD nBytesStored = 0;
-    if (ast_privilege_obtain (SE_SYSTEM_ENVIRONMENT_NAME) == EXIT_SUCCESS) {
-        // "If the function succeeds, the return value is the number of bytes stored in the pBuffer buffer."
-        //   -- https://msdn.microsoft.com/en-us/library/windows/desktop/ms724325(v=vs.85).aspx
-        nBytesStored = GetFirmwareEnvironmentVariable (name, guid, var, bufSiz);
-        if (nBytesStored != 0) {
-            if (nBytesStored <= bufSiz) {
-                return EXIT_SUCCESS;
-            } else {
-                // Memory overflows???
-                fprintf (stderr, " ** Warning: nBytesStored > bufSiz.\n");
-                return EXIT_SUCCESS; // XXX
+    struct ast_efivar_backend *backend = ast_efivar_backend_get ();
+    struct ast_efivar_iter *i = NULL;
+    int ret = AST_RETURN_SUCCESS;
+
+    if (iter == NULL) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    if ((backend == NULL) || (backend->iter_open == NULL)) {
+        return AST_RETURN_NOT_SUPPORTED;
+    }
+
+    i = calloc (1, sizeof (struct ast_efivar_iter));
+    if (i == NULL) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+    i->backend = backend;
+
+    AST_STATS_BEGIN (t);
+    ret = backend->iter_open (backend->ctx, flags, &(i->it));
+    AST_STATS_END (AST_STATS_OP_ITER_OPEN, NULL, NULL, ret, t);
+    if (ret != AST_RETURN_SUCCESS) {
+        free (i);
+        return ret;
+    }
+
+    *iter = i;
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+int ast_efivar_iter_next (struct ast_efivar_iter *iter, struct ast_efivar_info *infos, size_t cap, size_t *n)
+{
+    int ret = AST_RETURN_SUCCESS;
+
+    if ((iter == NULL) || (n == NULL) || ((infos == NULL) && (cap != 0))) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    *n = 0;
+    if (cap == 0) {
+        return AST_RETURN_SUCCESS;
+    }
+
+    AST_STATS_BEGIN (t);
+    ret = iter->backend->iter_next (iter->backend->ctx, iter->it, infos, cap, n);
+    AST_STATS_END (AST_STATS_OP_ITER_NEXT, NULL, NULL, ret, t);
+    AST_STATS_ADD (AST_STATS_COUNTER_VARS_ENUMERATED, *n);
+    return ret;
+}
+
+
+
+
+
+int ast_efivar_iter_read (struct ast_efivar_iter *iter, const struct ast_efivar_info *info, void *buf, size_t bufSiz, size_t *nBytes)
+{
+    if ((iter == NULL) || (info == NULL)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    if (info->data != NULL) {
+        // Already in memory: no firmware access.
+        if (info->size > bufSiz) {
+            if (nBytes != NULL) {
+                *nBytes = info->size;
             }
+            return AST_RETURN_BUFFER_TOO_SMALL;
+        }
+        memcpy (buf, info->data, info->size);
+        if (nBytes != NULL) {
+            *nBytes = info->size;
+        }
+        return AST_RETURN_SUCCESS;
+    }
+
+    return _ast_backend_read (iter->backend, &(info->guid), info->name, buf, bufSiz, nBytes, NULL);
+}
+
+
+
+
+
+void ast_efivar_iter_close (struct ast_efivar_iter *iter)
+{
+    if (iter == NULL) {
+        return;
+    }
+    iter->backend->iter_close (iter->backend->ctx, iter->it);
+    free (iter);
+}
+
+
+
+
+
+int ast_write_efivar (char *value, char *guid, char *name)
+{
+    ast_guid g;
+    int ret = AST_RETURN_SUCCESS;
+
+    if ((value == NULL) || (ast_guid_parse (guid, &g) != AST_RETURN_SUCCESS)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    ret = ast_update_efivar_guid (value, strlen (value), &g, name, AST_EFIVAR_DEFAULT_ATTRIBUTES, NULL);
+    if (ret != AST_RETURN_SUCCESS) {
+        fprintf (stderr, " ** Failed to write efivar %s (error %d).\n", name, ret);
+    }
+    return ret;
+}
+
+
+
+
+
+int ast_write_efivar_ex (const void *buf, size_t bufSiz, const char *guid, const char *name, uint32_t attr)
+{
+    ast_guid g;
+
+    if (ast_guid_parse (guid, &g) != AST_RETURN_SUCCESS) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    return ast_write_efivar_guid (buf, bufSiz, &g, name, attr);
+}
+
+
+
+
+
+int ast_write_efivar_guid (const void *buf, size_t bufSiz, const ast_guid *guid, const char *name, uint32_t attr)
+{
+    struct ast_efivar_backend *backend = ast_efivar_backend_get ();
+    int ret = AST_RETURN_SUCCESS;
+
+    if (backend == NULL) {
+        return AST_RETURN_NOT_SUPPORTED;
+    }
+    if ((guid == NULL) || ((buf == NULL) && (bufSiz != 0))) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    AST_STATS_BEGIN (t);
+    ret = backend->write (backend->ctx, guid, name, buf, bufSiz, attr);
+    AST_STATS_END (AST_STATS_OP_WRITE, guid, name, ret, t);
+    if (ret == AST_RETURN_SUCCESS) {
+        AST_STATS_ADD (AST_STATS_COUNTER_WRITE_BYTES, bufSiz);
+    }
+    return ret;
+}
+
+
+
+
+
+int ast_update_efivar_guid (const void *buf, size_t bufSiz, const ast_guid *guid, const char *name, uint32_t attr, int *changed)
+{
+    uint8_t  stackBuf[1024];
+    uint8_t  *cur = stackBuf;
+    size_t   curSiz = 0;
+    uint32_t curAttr = 0;
+    int      same = 0;
+    int      ret = AST_RETURN_SUCCESS;
+
+    if (changed != NULL) {
+        *changed = 0;
+    }
+    if ((guid == NULL) || ((buf == NULL) && (bufSiz != 0))) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    if (!(attr & (AST_EFIVAR_APPEND_WRITE | AST_EFIVAR_AUTHENTICATED_WRITE_ACCESS | AST_EFIVAR_TIME_BASED_AUTHENTICATED_WRITE_ACCESS))) {
+        // One byte more than the new value: a longer current value then shows up as a size mismatch.
+        if (bufSiz + 1 > sizeof (stackBuf)) {
+            cur = malloc (bufSiz + 1);
+            if (cur == NULL) {
+                return AST_RETURN_OPERATION_FAILED;
+            }
+        }
+
+        ret = ast_read_efivar_guid (cur, bufSiz + 1, guid, name, &curSiz, (bufSiz == 0) ? NULL : &curAttr);
+        if (bufSiz == 0) {
+            same = (ret == AST_RETURN_NOT_FOUND); // Already deleted
         } else {
-            // GetFirmwareEnvironmentVariable failed
-            fprintf (stderr, " ** GetFirmwareEnvironmentVariable failed with error %lu.\n", GetLastError ());
-            return EXIT_FAILURE;
+            same = (ret == AST_RETURN_SUCCESS) && (curSiz == bufSiz) && (curAttr == attr) && (memcmp (cur, buf, bufSiz) == 0);
         }
+
+        if (cur != stackBuf) {
+            free (cur);
+        }
+        if (same) {
+            AST_STATS_ADD (AST_STATS_COUNTER_WRITES_SKIPPED, 1);
+            return AST_RETURN_SUCCESS;
+        }
+    }
+
+    ret = ast_write_efivar_guid (buf, bufSiz, guid, name, attr);
+    if ((ret == AST_RETURN_SUCCESS) && (changed != NULL)) {
+        *changed = 1;
+    }
+    return ret;
+}
+
+
+
+
+
+static void _ast_backend_default_new (void)
+{
+    if (getenv ("AST_EFIVAR_SNAPSHOT") != NULL) {
+        _ast_backend_default = ast_efivar_backend_snapshot_new (getenv ("AST_EFIVAR_SNAPSHOT"));
     } else {
-        // ast_privilege_obtain failed
-        fprintf (stderr, " ** Cannot obtain sufficient privilege. Failed to read efivar.\n");
-        return EXIT_FAILURE;
+#ifdef _WIN32
+        _ast_backend_default = ast_efivar_backend_win32_new ();
+#else
+        if (getenv ("AST_EFIVAR_EMU") != NULL) {
+            _ast_backend_default = ast_efivar_backend_emu_new (getenv ("AST_EFIVAR_EMU"), NULL);
+        } else {
+            _ast_backend_default = ast_efivar_backend_efivarfs_new (getenv ("AST_EFIVARFS_DIR"));
+        }
+#endif
     }
 }
 
@@ -84,22 +570,124 @@ int ast_read_efivar (char *var, size_t bufSiz, char *guid, char *name)
 
 
 
-int ast_write_efivar (char *value, char *guid, char *name)
+static int _ast_backend_read (struct ast_efivar_backend *backend, const ast_guid *guid, const char *name, void *buf, size_t bufSiz, size_t *nBytes, uint32_t *attr)
 {
-    return EXIT_FAILURE;
+    int ret = AST_RETURN_SUCCESS;
+
+    AST_STATS_BEGIN (t);
+    ret = backend->read (backend->ctx, guid, name, buf, bufSiz, nBytes, attr);
+    AST_STATS_END (AST_STATS_OP_READ, guid, name, ret, t);
+    if ((ret == AST_RETURN_SUCCESS) && (nBytes != NULL)) {
+        AST_STATS_ADD (AST_STATS_COUNTER_READ_BYTES, *nBytes);
+    }
+    return ret;
+}
+
+
+
+
+
+/**
+ * Ask the platform what the firmware is. Called once; see ast_get_firmware_info.
+ */
+static int _ast_firmware_detect (struct ast_firmware_info *info)
+{
+    int value = 0;
+    int ret = AST_RETURN_SUCCESS;
+
+    info->type            = AST_FIRMWARE_TYPE_BIOS;
+    info->bitness         = 0;
+    info->runtimeServices = 0;
+    info->secureBoot      = 0;
+    info->setupMode       = AST_FIRMWARE_UNKNOWN;
+
+#ifdef _WIN32
+    // NOTE: Since Windows 8, there's a WinAPI called GetFirmwareType
+    //   (https://msdn.microsoft.com/en-us/library/windows/desktop/hh848321(v=vs.85).aspx),
+    //   which can quickly determine the computer's firmware.
+    //
+    //   Use GetFirmwareType on newer Windows, or the traditional way -- passing dummy UUID
+    //   and variable name to GetFirmwareEnvironmentVariable and check return value.
+    if (IsWindows8OrGreater () == TRUE) {
+        ret = _ast_get_firmware_type_on_win8_or_greater (&(info->type));
+    } else {
+        ret = _ast_get_firmware_type_on_win8_lesser (&(info->type));
+    }
+    if (ret != EXIT_SUCCESS) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+    if (info->type != AST_FIRMWARE_TYPE_UEFI) {
+        return AST_RETURN_SUCCESS;
+    }
+
+    // Windows only boots from UEFI of its own word size, so a 32-bit process asks WOW64.
+#ifdef _WIN64
+    info->bitness = 64;
+#else
+    {
+        BOOL wow64 = FALSE;
+
+        info->bitness = (IsWow64Process (GetCurrentProcess (), &wow64) && wow64) ? 64 : 32;
+    }
+#endif
+    if (ast_privilege_obtain (SE_SYSTEM_ENVIRONMENT_NAME) != EXIT_SUCCESS) {
+        info->runtimeServices = AST_FIRMWARE_UNKNOWN;
+        info->secureBoot      = AST_FIRMWARE_UNKNOWN;
+        return AST_RETURN_SUCCESS;
+    }
+    info->runtimeServices = 1;
+#else
+    // NOTE: The kernel creates /sys/firmware/efi only when booted through EFI.
+    if (access (AST_FIRMWARE_SYSFS, F_OK) != 0) {
+        return AST_RETURN_SUCCESS;
+    }
+    info->type = AST_FIRMWARE_TYPE_UEFI;
+
+    // fw_platform_size appeared in Linux 4.0; older kernels leave the bitness unknown.
+    {
+        FILE *fp = fopen (AST_FIRMWARE_SYSFS "/fw_platform_size", "r");
+        unsigned int bitness = 0;
+
+        if (fp != NULL) {
+            if ((fscanf (fp, "%u", &bitness) == 1) && ((bitness == 32) || (bitness == 64))) {
+                info->bitness = bitness;
+            }
+            fclose (fp);
+        }
+    }
+    info->runtimeServices = _ast_firmware_runtime_services (AST_FIRMWARE_SYSFS "/efivars");
+    if (info->runtimeServices != 1) {
+        info->secureBoot = AST_FIRMWARE_UNKNOWN;
+        return AST_RETURN_SUCCESS;
+    }
+#endif
+
+    // Firmware without Secure Boot has no SecureBoot variable.
+    ret = _ast_firmware_read_flag ("SecureBoot", &value);
+    if (ret == AST_RETURN_NOT_SUPPORTED) {
+        info->runtimeServices = 0;
+        info->secureBoot      = AST_FIRMWARE_UNKNOWN;
+        return AST_RETURN_SUCCESS;
+    }
+    info->secureBoot = (ret == AST_RETURN_SUCCESS) ? value : (ret == AST_RETURN_NOT_FOUND) ? 0 : AST_FIRMWARE_UNKNOWN;
+    if (_ast_firmware_read_flag ("SetupMode", &value) == AST_RETURN_SUCCESS) {
+        info->setupMode = value;
+    }
+    return AST_RETURN_SUCCESS;
 }
 
 
 
 
 
+#ifdef _WIN32
 static int _ast_get_firmware_type_on_win8_or_greater (enum AST_FIRMWARE_TYPE *T)
 {
     // NOTE: Directly using GetFirmwareType can make program being not able to run on lower version of Windows.
-    BOOL (*func)() = NULL;
+    BOOL (WINAPI *func) (PFIRMWARE_TYPE) = NULL;
     FIRMWARE_TYPE type = FirmwareTypeUnknown;
 
-    func = (BOOL (*)()) GetProcAddress (GetModuleHandle ("Kernel32.dll"), "GetFirmwareType");
+    func = (BOOL (WINAPI *) (PFIRMWARE_TYPE)) GetProcAddress (GetModuleHandle ("Kernel32.dll"), "GetFirmwareType");
     if (func != NULL) {
         if (func (&type)) {
             // AST_FIRMWARE_TYPE declares the same values as FIRMWARE_TYPE
@@ -123,14 +711,15 @@ static int _ast_get_firmware_type_on_win8_or_greater (enum AST_FIRMWARE_TYPE *T)
 
 static int _ast_get_firmware_type_on_win8_lesser (enum AST_FIRMWARE_TYPE *T)
 {
-    static const char *EFIDummyGUID = "{000000000-0000-0000-0000-000000000000}";
+    static const char *EFIDummyGUID = "{00000000-0000-0000-0000-000000000000}";
     static const char *EFIDummyName = "";
-    void *buffer = malloc (1);
-    DWORD ret = 0;
+    uint8_t buffer = 0;
 
     if (ast_privilege_obtain (SE_SYSTEM_ENVIRONMENT_NAME) == EXIT_SUCCESS) {
-        ret = GetFirmwareEnvironmentVariable (EFIDummyName, EFIDummyGUID, buffer, 1);
-        if (ret == ERROR_INVALID_FUNCTION) {
+        // The call returns the size read, 0 on failure; only the error tells BIOS from UEFI (where
+        // the dummy variable is merely not found).
+        if ((GetFirmwareEnvironmentVariable (EFIDummyName, EFIDummyGUID, &buffer, sizeof (buffer)) == 0) &&
+            (GetLastError () == ERROR_INVALID_FUNCTION)) {
             // Not a UEFI machine. XXX: Currently returns BIOS.
             *T = AST_FIRMWARE_TYPE_BIOS;
             return EXIT_SUCCESS;
@@ -146,3 +735,90 @@ static int _ast_get_firmware_type_on_win8_lesser (enum AST_FIRMWARE_TYPE *T)
 
     return EXIT_FAILURE;
 }
+
+
+
+
+
+/**
+ * Read a one-byte global variable straight from the firmware, whatever the selected backend.
+ */
+static int _ast_firmware_read_flag (const char *name, int *value)
+{
+    static const char *EFIGlobalGUID = "{8be4df61-93ca-11d2-aa0d-00e098032b8c}";
+    uint8_t flag = 0;
+
+    if (GetFirmwareEnvironmentVariable (name, EFIGlobalGUID, &flag, sizeof (flag)) == sizeof (flag)) {
+        *value = flag;
+        return AST_RETURN_SUCCESS;
+    }
+    switch (GetLastError ()) {
+        case ERROR_ENVVAR_NOT_FOUND:
+            return AST_RETURN_NOT_FOUND;
+        case ERROR_INVALID_FUNCTION:
+            return AST_RETURN_NOT_SUPPORTED;
+        default:
+            return AST_RETURN_OPERATION_FAILED;
+    }
+}
+#else
+/**
+ * Read a one-byte global variable straight from efivarfs (four bytes of attributes, then the value),
+ * whatever the selected backend.
+ */
+static int _ast_firmware_read_flag (const char *name, int *value)
+{
+    char path[128];
+    uint8_t buf[5];
+    size_t n = 0;
+    FILE *fp = NULL;
+
+    snprintf (path, sizeof (path), AST_FIRMWARE_SYSFS "/efivars/%s-8be4df61-93ca-11d2-aa0d-00e098032b8c", name);
+    fp = fopen (path, "rb");
+    if (fp == NULL) {
+        return (errno == ENOENT) ? AST_RETURN_NOT_FOUND : AST_RETURN_OPERATION_FAILED;
+    }
+    n = fread (buf, 1, sizeof (buf), fp);
+    fclose (fp);
+    if (n != sizeof (buf)) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+    *value = buf[4];
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+/**
+ * Whether runtime services work, judged from the efivarfs mount point: the kernel only creates it when
+ * the firmware offers variable services, and only fills efivarfs when they work. An empty directory
+ * with nothing mounted on it says nothing either way.
+ */
+static int _ast_firmware_runtime_services (const char *dir)
+{
+    DIR *d = NULL;
+    struct dirent *ent = NULL;
+    struct statfs fs;
+    int used = 0;
+
+    if (statfs (dir, &fs) != 0) {
+        return (errno == ENOENT) ? 0 : AST_FIRMWARE_UNKNOWN;
+    }
+    if ((unsigned long) fs.f_type != AST_EFIVARFS_MAGIC) {
+        return AST_FIRMWARE_UNKNOWN;
+    }
+    if ((d = opendir (dir)) == NULL) {
+        return AST_FIRMWARE_UNKNOWN;
+    }
+    while ((ent = readdir (d)) != NULL) {
+        if ((strcmp (ent->d_name, ".") != 0) && (strcmp (ent->d_name, "..") != 0)) {
+            used = 1;
+            break;
+        }
+    }
+    closedir (d);
+    return used;
+}
+#endif /* _WIN32 */
@@ -6,13 +6,111 @@
  * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
  *
  * This header file declares interfaces to operate PC firmwares like EFI.
+ *
+ * Variable access is routed through a pluggable backend (see backend.h). On Windows the default backend
+ * calls [GetFirmwareEnvironmentVariable](https://msdn.microsoft.com/en-us/library/windows/desktop/ms724325(v=vs.85).aspx),
+ * on Linux it reads efivarfs (`/sys/firmware/efi/efivars`).
  */
 
 #ifndef _AST_FIRMWARE_H
 #define _AST_FIRMWARE_H
 
 #include <stdio.h>
-#include <windows.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../guid/guid.h"
+
+/**
+ * Enumeration of return codes used by firmware functions.
+ *
+ * AST_RETURN_SUCCESS and AST_RETURN_OPERATION_FAILED are equal to EXIT_SUCCESS and EXIT_FAILURE,
+ * so callers comparing against those keep working.
+ */
+enum AST_RETURN {
+    AST_RETURN_SUCCESS          = EXIT_SUCCESS, /**< The operation succeeded. */
+    AST_RETURN_OPERATION_FAILED = EXIT_FAILURE, /**< The operation failed for an unspecified reason. */
+    AST_RETURN_ACCESS_DENIED,                   /**< Insufficient privilege to access the variable. */
+    AST_RETURN_NOT_FOUND,                       /**< The variable does not exist. */
+    AST_RETURN_BUFFER_TOO_SMALL,                /**< The supplied buffer cannot hold the variable. */
+    AST_RETURN_NOT_SUPPORTED,                   /**< The firmware or backend does not support the operation. */
+    AST_RETURN_INVALID_PARAMETER                /**< An argument is malformed. */
+};
+
+/**
+ * @name EFI variable attributes
+ *
+ * See UEFI specification 2.6: 7.2 Variable Services.
+ * @{
+ */
+#define AST_EFIVAR_NON_VOLATILE                          0x00000001
+#define AST_EFIVAR_BOOTSERVICE_ACCESS                    0x00000002
+#define AST_EFIVAR_RUNTIME_ACCESS                        0x00000004
+#define AST_EFIVAR_HARDWARE_ERROR_RECORD                 0x00000008
+#define AST_EFIVAR_AUTHENTICATED_WRITE_ACCESS            0x00000010
+#define AST_EFIVAR_TIME_BASED_AUTHENTICATED_WRITE_ACCESS 0x00000020
+#define AST_EFIVAR_APPEND_WRITE                          0x00000040
+/** Attributes of an ordinary boot manager variable (NV + BS + RT). */
+#define AST_EFIVAR_DEFAULT_ATTRIBUTES (AST_EFIVAR_NON_VOLATILE | AST_EFIVAR_BOOTSERVICE_ACCESS | AST_EFIVAR_RUNTIME_ACCESS)
+/** @} */
+
+/**
+ * Largest variable the allocating read functions will grow a buffer to.
+ */
+#define AST_EFIVAR_MAX_SIZE (16 * 1024 * 1024)
+
+/**
+ * Longest variable name, in bytes including the terminating NUL, that enumeration reports.
+ */
+#define AST_EFIVAR_NAME_MAX 256
+
+/**
+ * Flag for ast_efivar_iter_open: also report attributes (an extra firmware access per variable on efivarfs).
+ */
+#define AST_EFIVAR_ITER_ATTRIBUTES 0x00000001
+
+struct ast_efivar_backend;
+struct ast_efivar_iter;
+struct ast_efivar_txn;
+struct ast_arena;
+
+/**
+ * One variable reported by enumeration.
+ *
+ * @see ast_efivar_iter_next
+ */
+struct ast_efivar_info {
+    ast_guid   guid;                      /**< GUID namespace. */
+    char       name[AST_EFIVAR_NAME_MAX]; /**< Variable name (UTF-8). */
+    uint32_t   attr;                      /**< Attributes, or 0 if not requested. */
+    size_t     size;                      /**< Size of the value in bytes. */
+    const void *data;                     /**< Value if the backend already holds it (valid until the iterator is closed), or NULL. */
+};
+
+/**
+ * Descriptor of one variable to read in a batch.
+ *
+ * @see ast_read_efivars_batch
+ */
+typedef struct ast_var_request {
+    const ast_guid *guid; /**< GUID namespace. */
+    const char *name;     /**< Variable name. */
+    void       *buf;      /**< Buffer to put variable value, or NULL to allocate from an arena (see ast_read_efivars_batch_arena). */
+    size_t     bufSiz;    /**< Size of the buffer. */
+    int        withAttr;  /**< Nonzero to fetch attributes too (an extra firmware access on efivarfs). */
+} ast_var_request;
+
+/**
+ * Result of one variable read in a batch.
+ *
+ * @see ast_read_efivars_batch
+ */
+typedef struct ast_var_result {
+    int      status;  /**< AST_RETURN code of this item. */
+    size_t   nBytes;  /**< Bytes stored, or bytes needed on AST_RETURN_BUFFER_TOO_SMALL if known. */
+    uint32_t attr;    /**< Variable attributes if withAttr was set, 0 otherwise. */
+    void     *data;   /**< Where the value was stored: the request's buffer, or arena memory. */
+} ast_var_result;
 
 /**
  * Enumeration to mark firmware types.
@@ -28,14 +126,78 @@ enum AST_FIRMWARE_TYPE {
     AST_FIRMWARE_TYPE_NOTIMPL = 3  /**< Not implemented. */
 };
 
+/**
+ * Value of a struct ast_firmware_info field that could not be determined.
+ */
+#define AST_FIRMWARE_UNKNOWN (-1)
+
+/**
+ * What the platform firmware is and what it offers the operating system.
+ *
+ * @see ast_get_firmware_info
+ */
+struct ast_firmware_info {
+    enum AST_FIRMWARE_TYPE type;    /**< Firmware type. */
+    unsigned int bitness;           /**< Word size of the UEFI firmware, 32 or 64; 0 if unknown or not UEFI. */
+    int          runtimeServices;   /**< 1 if the operating system can use UEFI variable services, 0 if not, or AST_FIRMWARE_UNKNOWN. */
+    int          secureBoot;        /**< SecureBoot variable: 1 if enabled, 0 if disabled or unsupported, or AST_FIRMWARE_UNKNOWN. */
+    int          setupMode;         /**< SetupMode variable: 1 if no platform key is enrolled, 0 if one is, or AST_FIRMWARE_UNKNOWN. */
+};
+
 /**
  * Function to get firmware type.
  *
  * @param *type [out] Pointer to an AST_FIRMWARE_TYPE enumeration, which will contain the obtained firmware type.
  * @return EXIT_SUCCESS if operation succeeded, or particular return code may return.
+ * @see ast_get_firmware_info
  */
 int ast_get_firmware_type (enum AST_FIRMWARE_TYPE *type);
 
+/**
+ * Get the firmware type, UEFI bitness, runtime services availability and Secure Boot state.
+ *
+ * The platform is asked once per process, on the first call of this function or ast_get_firmware_type,
+ * whichever thread makes it; every later call copies the cached answer. On Linux the answer comes from
+ * `/sys/firmware/efi` (only there when booted through UEFI), its `fw_platform_size`, and the efivarfs
+ * mount under it, which the kernel leaves empty without runtime services. On Windows it comes from
+ * GetFirmwareType (or probing GetFirmwareEnvironmentVariable before Windows 8), then from reading
+ * SecureBoot and SetupMode with the system environment privilege.
+ *
+ * Both variables are those of the real firmware, whatever the selected backend (see ast_efivar_backend_set).
+ * SetupMode can change while the system runs (when a platform key is enrolled); the cached value is the one
+ * read on the first call.
+ *
+ * @param info [out] Firmware information.
+ * @return AST_RETURN_SUCCESS, or AST_RETURN_OPERATION_FAILED if the firmware type cannot be determined
+ *         (every later call fails the same way).
+ */
+int ast_get_firmware_info (struct ast_firmware_info *info);
+
+/**
+ * Select the variable store backend used by all variable functions.
+ *
+ * The backend is not copied; it must stay valid until it is replaced. Passing NULL restores
+ * the platform default backend.
+ *
+ * @param backend [in] Backend to use, or NULL.
+ * @return EXIT_SUCCESS.
+ * @see ast_efivar_backend_get
+ */
+int ast_efivar_backend_set (struct ast_efivar_backend *backend);
+
+/**
+ * Get the variable store backend currently in use.
+ *
+ * On first use the platform default backend is created: the Win32 backend on Windows, and the efivarfs
+ * backend on Linux. The efivarfs directory may be overridden with the `AST_EFIVARFS_DIR` environment variable;
+ * `AST_EFIVAR_EMU` names a store file for the emulator backend instead (see backend.h). On any platform,
+ * `AST_EFIVAR_SNAPSHOT` names a snapshot file to serve read-only instead (see snapshot.h). Threads calling
+ * this together for the first time all get the same default backend.
+ *
+ * @return The current backend, or NULL if no backend is available on this platform.
+ */
+struct ast_efivar_backend *ast_efivar_backend_get (void);
+
 /**
  * Function to read EFI variable.
  *
@@ -48,16 +210,140 @@ int ast_get_firmware_type (enum AST_FIRMWARE_TYPE *type);
  * @param name   [in]  Variable name.
  * @return EXIT_SUCCESS if operation succeeded, or particular return code may return.
  *
- * @see ast_write_efivar
+ * @see ast_read_efivar_ex, ast_write_efivar
  */
 int ast_read_efivar (char *var, size_t bufSiz, char *guid, char *name);
 
+/**
+ * Function to read EFI variable, reporting its size and attributes.
+ *
+ * The variable is read straight into the buffer. If the buffer is too small, AST_RETURN_BUFFER_TOO_SMALL is
+ * returned and, where the backend can tell, *nBytes holds the size needed.
+ *
+ * @param buf    [out] Buffer to put variable value.
+ * @param bufSiz [in]  Size of the buffer.
+ * @param guid   [in]  GUID namespace, with or without braces.
+ * @param name   [in]  Variable name.
+ * @param nBytes [out] Number of bytes stored in the buffer. May be NULL.
+ * @param attr   [out] Variable attributes. May be NULL, which can save a firmware access on some backends.
+ * @return AST_RETURN_SUCCESS if operation succeeded, or another AST_RETURN code.
+ * @see ast_read_efivar_guid
+ */
+int ast_read_efivar_ex (void *buf, size_t bufSiz, const char *guid, const char *name, size_t *nBytes, uint32_t *attr);
+
+/**
+ * Function to read EFI variable by binary GUID. Same as ast_read_efivar_ex without parsing the GUID.
+ *
+ * @param buf    [out] Buffer to put variable value.
+ * @param bufSiz [in]  Size of the buffer.
+ * @param guid   [in]  GUID namespace.
+ * @param name   [in]  Variable name.
+ * @param nBytes [out] Number of bytes stored in the buffer. May be NULL.
+ * @param attr   [out] Variable attributes. May be NULL.
+ * @return AST_RETURN_SUCCESS if operation succeeded, or another AST_RETURN code.
+ */
+int ast_read_efivar_guid (void *buf, size_t bufSiz, const ast_guid *guid, const char *name, size_t *nBytes, uint32_t *attr);
+
+/**
+ * Function to read several EFI variables in one pass.
+ *
+ * Privileges are acquired once for the whole batch, and the backend may service the batch together.
+ * A failing item does not stop the others; check results[i].status.
+ *
+ * @param reqs    [in]  Array of n variable descriptors.
+ * @param n       [in]  Number of descriptors.
+ * @param results [out] Array of n results, one per descriptor.
+ * @return AST_RETURN_SUCCESS if every item was read, AST_RETURN_OPERATION_FAILED if at least one item failed,
+ *         or another AST_RETURN code if the batch could not be started at all (results are then all set to it).
+ */
+int ast_read_efivars_batch (const ast_var_request *reqs, size_t n, ast_var_result *results);
+
+/**
+ * Function to read EFI variable of unknown size into arena memory.
+ *
+ * The value is first read into the free space of the arena's current chunk. If that is too small, the exact
+ * size (from fstat(2) on efivarfs) is used for a second try, or the buffer is doubled where the backend cannot
+ * tell the size (ERROR_INSUFFICIENT_BUFFER on Windows). Only the bytes stored stay allocated.
+ *
+ * @param arena  [in]  Arena to allocate from; the value lives until the arena is freed.
+ * @param guid   [in]  GUID namespace.
+ * @param name   [in]  Variable name.
+ * @param data   [out] Pointer to the value.
+ * @param nBytes [out] Size of the value.
+ * @param attr   [out] Variable attributes. May be NULL.
+ * @return AST_RETURN_SUCCESS if operation succeeded, or another AST_RETURN code.
+ */
+int ast_read_efivar_alloc (struct ast_arena *arena, const ast_guid *guid, const char *name, void **data, size_t *nBytes, uint32_t *attr);
+
+/**
+ * Function to read several EFI variables in one pass, allocating values of unknown size from an arena.
+ *
+ * Works as ast_read_efivars_batch, except that requests whose buf is NULL are read as with
+ * ast_read_efivar_alloc; results[i].data then points into the arena. Consecutive requests with buffers
+ * are passed to the backend as one batch.
+ *
+ * @param arena   [in]  Arena for requests without a buffer.
+ * @param reqs    [in]  Array of n variable descriptors.
+ * @param n       [in]  Number of descriptors.
+ * @param results [out] Array of n results, one per descriptor.
+ * @return AST_RETURN_SUCCESS if every item was read, AST_RETURN_OPERATION_FAILED otherwise.
+ */
+int ast_read_efivars_batch_arena (struct ast_arena *arena, const ast_var_request *reqs, size_t n, ast_var_result *results);
+
+/**
+ * Start enumerating every variable in the store.
+ *
+ * Variables are produced in chunks by ast_efivar_iter_next, so the whole store is never materialised
+ * by this library (the Windows API does return all variables at once, in one buffer).
+ *
+ * @param iter  [out] New iterator.
+ * @param flags [in]  AST_EFIVAR_ITER_* flags.
+ * @return AST_RETURN_SUCCESS if operation succeeded, or another AST_RETURN code.
+ * @see ast_efivar_iter_next, ast_efivar_iter_close
+ */
+int ast_efivar_iter_open (struct ast_efivar_iter **iter, unsigned int flags);
+
+/**
+ * Get the next chunk of variables.
+ *
+ * @param iter  [in]  Iterator.
+ * @param infos [out] Caller-supplied array of cap records.
+ * @param cap   [in]  Capacity of infos.
+ * @param n     [out] Number of records stored; 0 once every variable has been reported.
+ * @return AST_RETURN_SUCCESS if operation succeeded, or another AST_RETURN code.
+ */
+int ast_efivar_iter_next (struct ast_efivar_iter *iter, struct ast_efivar_info *infos, size_t cap, size_t *n);
+
+/**
+ * Read the value of an enumerated variable.
+ *
+ * The value is copied from memory if the backend already holds it, and read from the store otherwise.
+ *
+ * @param iter   [in]  Iterator info came from.
+ * @param info   [in]  Record returned by ast_efivar_iter_next.
+ * @param buf    [out] Buffer to put variable value.
+ * @param bufSiz [in]  Size of the buffer.
+ * @param nBytes [out] Number of bytes stored. May be NULL.
+ * @return AST_RETURN_SUCCESS if operation succeeded, or another AST_RETURN code.
+ */
+int ast_efivar_iter_read (struct ast_efivar_iter *iter, const struct ast_efivar_info *info, void *buf, size_t bufSiz, size_t *nBytes);
+
+/**
+ * Finish enumerating and release the iterator.
+ *
+ * @param iter [in] Iterator. May be NULL.
+ */
+void ast_efivar_iter_close (struct ast_efivar_iter *iter);
+
 /**
  * Function to write EFI variable.
  *
  * This function automatically gains its necessary privileges. If it fails to gain privileges,
  * it will return AST_RETURN_ACCESS_DENIED.
  *
+ * The string (without its NUL) is written with AST_EFIVAR_DEFAULT_ATTRIBUTES, and only if it differs
+ * from the current value; see ast_update_efivar_guid.
+ *
  * __NOTE:__ This function does not guarantee its effect. If the firmware fails, this function simply
  * returns AST_RETURN_OPERATION_FAILED and you should take measures to save the firmware.
  *
@@ -70,4 +356,107 @@ int ast_read_efivar (char *var, size_t bufSiz, char *guid, char *name);
  */
 int ast_write_efivar (char *value, char *guid, char *name);
 
+/**
+ * Function to write EFI variable through the current backend as-is.
+ *
+ * Writing zero bytes deletes the variable.
+ *
+ * @param buf    [in] Value to be put into the specified EFI variable.
+ * @param bufSiz [in] Size of the value.
+ * @param guid   [in] GUID namespace, with or without braces.
+ * @param name   [in] Variable name.
+ * @param attr   [in] Variable attributes, usually AST_EFIVAR_DEFAULT_ATTRIBUTES.
+ * @return AST_RETURN_SUCCESS if operation succeeded, or another AST_RETURN code.
+ * @see ast_write_efivar_guid
+ */
+int ast_write_efivar_ex (const void *buf, size_t bufSiz, const char *guid, const char *name, uint32_t attr);
+
+/**
+ * Function to write EFI variable by binary GUID. Same as ast_write_efivar_ex without parsing the GUID.
+ *
+ * @param buf    [in] Value to be put into the specified EFI variable.
+ * @param bufSiz [in] Size of the value.
+ * @param guid   [in] GUID namespace.
+ * @param name   [in] Variable name.
+ * @param attr   [in] Variable attributes, usually AST_EFIVAR_DEFAULT_ATTRIBUTES.
+ * @return AST_RETURN_SUCCESS if operation succeeded, or another AST_RETURN code.
+ */
+int ast_write_efivar_guid (const void *buf, size_t bufSiz, const ast_guid *guid, const char *name, uint32_t attr);
+
+/**
+ * Function to write EFI variable only if that changes it.
+ *
+ * The current value and attributes are read first (one read, no larger than the new value plus one byte);
+ * if they are identical, nothing is written. Every skipped write saves an NVRAM erase cycle and an SMI.
+ * Deleting a variable that does not exist is skipped too. Appending and authenticated writes always go
+ * through, since their payload is not the resulting value.
+ *
+ * @param buf     [in]  Value to be put into the specified EFI variable.
+ * @param bufSiz  [in]  Size of the value; 0 deletes the variable.
+ * @param guid    [in]  GUID namespace.
+ * @param name    [in]  Variable name.
+ * @param attr    [in]  Variable attributes, usually AST_EFIVAR_DEFAULT_ATTRIBUTES.
+ * @param changed [out] 1 if the store was written, 0 if the write was skipped. May be NULL.
+ * @return AST_RETURN_SUCCESS if operation succeeded, or another AST_RETURN code.
+ */
+int ast_update_efivar_guid (const void *buf, size_t bufSiz, const ast_guid *guid, const char *name, uint32_t attr, int *changed);
+
+/**
+ * Start a transaction: a set of writes applied together by ast_efivar_txn_commit.
+ *
+ * Nothing touches the store before commit. Values are copied, so callers' buffers may be reused at once.
+ *
+ * @param txn [out] New transaction.
+ * @return AST_RETURN_SUCCESS if operation succeeded, or another AST_RETURN code.
+ */
+int ast_efivar_txn_begin (struct ast_efivar_txn **txn);
+
+/**
+ * Add a write to a transaction. A later put or delete of the same variable replaces this one.
+ *
+ * @param txn    [in] Transaction.
+ * @param buf    [in] Value.
+ * @param bufSiz [in] Size of the value; 0 is the same as ast_efivar_txn_delete.
+ * @param guid   [in] GUID namespace.
+ * @param name   [in] Variable name.
+ * @param attr   [in] Variable attributes.
+ * @return AST_RETURN_SUCCESS if operation succeeded, or another AST_RETURN code.
+ */
+int ast_efivar_txn_put (struct ast_efivar_txn *txn, const void *buf, size_t bufSiz, const ast_guid *guid, const char *name, uint32_t attr);
+
+/**
+ * Add a deletion to a transaction.
+ *
+ * @param txn  [in] Transaction.
+ * @param guid [in] GUID namespace.
+ * @param name [in] Variable name.
+ * @return AST_RETURN_SUCCESS if operation succeeded, or another AST_RETURN code.
+ */
+int ast_efivar_txn_delete (struct ast_efivar_txn *txn, const ast_guid *guid, const char *name);
+
+/**
+ * Apply a transaction and release it.
+ *
+ * The current value of every variable involved is saved first; if that fails, nothing is written.
+ * Writes are then ordered so that nothing ever refers to a missing load option: new `Boot####`,
+ * `Driver####` and `SysPrep####` are written before other variables (BootOrder, BootNext...), and are
+ * deleted after them. Unchanged values are skipped as in ast_update_efivar_guid. If a write fails, the
+ * ones already made are undone in reverse order from the saved images.
+ *
+ * Authenticated variables cannot be restored without their signer, so a transaction should not mix
+ * them with other writes.
+ *
+ * @param txn      [in]  Transaction; freed whatever the outcome.
+ * @param nWritten [out] Number of variables actually written (0 after a rollback). May be NULL.
+ * @return AST_RETURN_SUCCESS if every write succeeded, or the AST_RETURN code of the failing one.
+ */
+int ast_efivar_txn_commit (struct ast_efivar_txn *txn, size_t *nWritten);
+
+/**
+ * Discard a transaction without writing anything.
+ *
+ * @param txn [in] Transaction. May be NULL.
+ */
+void ast_efivar_txn_abort (struct ast_efivar_txn *txn);
+
 #endif /* end of include guard: _AST_FIRMWARE_H */
@@ -1,5 +1,5 @@
 /**
- * @file firmware.c
+ * @file readefivar.c
  * @version 0.3
  * @author Junde Yhi <lmy441900@gmail.com>
  * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
@@ -12,84 +12,60 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
-#include <windows.h>
+#include <string.h>
+#include "firmware.h"
+#include "readefivar.h"
+#include "../arena/arena.h"
 #include "../privilege/privilege.h"
 
-int ast_read_efivar_standard (void);
+static const ast_guid efiGlobalGuid = AST_GUID_EFI_GLOBAL;
 
 int ast_read_efivar_standard (void)
 {
     uint16_t efiBootCurrent   = 0;
     uint16_t efiBootNext      = 0;
     uint16_t efiTimeout       = 0;
-    uint16_t *efiBootOrder    = NULL;
     uint8_t  efiSecureBoot    = 0;
-    char     *efiPlatformLang = NULL;
-    DWORD    nBytesStored     = 0;
+    struct   ast_arena arena;
 
-    if (ast_privilege_obtain (SE_SYSTEM_ENVIRONMENT_NAME) == EXIT_SUCCESS) {
-        nBytesStored = GetFirmwareEnvironmentVariable ("BootCurrent", "{8be4df61-93ca-11d2-aa0d-00e098032b8c}", &efiBootCurrent, sizeof (efiBootCurrent));
-        if (nBytesStored != 0) {
-            printf ("BootCurrent: %x\n", efiBootCurrent);
-        } else {
-            fprintf (stderr, "Failed to read BootCurrent with err %lu.\n", GetLastError ());
-        }
+    // All six variables are fetched in one pass, so privileges are acquired once. BootOrder and
+    // PlatformLang have no fixed size; they are read at their exact size into the arena.
+    const ast_var_request reqs[] = {
+        { &efiGlobalGuid, "BootCurrent",  &efiBootCurrent, sizeof (efiBootCurrent), 0 },
+        { &efiGlobalGuid, "BootNext",     &efiBootNext,    sizeof (efiBootNext),    0 },
+        { &efiGlobalGuid, "Timeout",      &efiTimeout,     sizeof (efiTimeout),     0 },
+        { &efiGlobalGuid, "SecureBoot",   &efiSecureBoot,  sizeof (efiSecureBoot),  0 },
+        { &efiGlobalGuid, "BootOrder",    NULL,            0,                       0 },
+        { &efiGlobalGuid, "PlatformLang", NULL,            0,                       0 }
+    };
+    ast_var_result results[sizeof (reqs) / sizeof (reqs[0])];
 
-        nBytesStored = GetFirmwareEnvironmentVariable ("BootNext", "{8be4df61-93ca-11d2-aa0d-00e098032b8c}", &efiBootNext, sizeof (efiBootNext));
-        if (nBytesStored != 0) {
-            printf ("BootNext: %x\n", efiBootNext);
-        } else {
-            fprintf (stderr, "Failed to read BootNext with err %lu.\n", GetLastError ());
-        }
+    ast_arena_init (&arena, 0);
+    ast_read_efivars_batch_arena (&arena, reqs, sizeof (reqs) / sizeof (reqs[0]), results);
 
-        nBytesStored = GetFirmwareEnvironmentVariable ("Timeout", "{8be4df61-93ca-11d2-aa0d-00e098032b8c}", &efiTimeout, sizeof (efiTimeout));
-        if (nBytesStored != 0) {
-            printf ("Timeout: %x\n", efiTimeout);
-        } else {
-            fprintf (stderr, "Failed to read Timeout with err %lu.\n", GetLastError ());
+    for (size_t i = 0; i < sizeof (reqs) / sizeof (reqs[0]); i++) {
+        if (results[i].status != AST_RETURN_SUCCESS) {
+            fprintf (stderr, "Failed to read %s with err %d.\n", reqs[i].name, results[i].status);
+            continue;
         }
 
-        // Initialize efiBootOrder first.
-        // XXX: Fixed length
-        efiBootOrder = calloc (256, sizeof (uint16_t));
-        if (efiBootOrder == NULL) {
-            abort ();
-        }
-        nBytesStored = GetFirmwareEnvironmentVariable ("BootOrder", "{8be4df61-93ca-11d2-aa0d-00e098032b8c}", efiBootOrder, 256 * sizeof (uint16_t));
-        if (nBytesStored != 0) {
+        if (strcmp (reqs[i].name, "BootOrder") == 0) {
+            const uint8_t *efiBootOrder = results[i].data;
             printf ("BootOrder: ");
-            for (int i = 0; efiBootOrder[i] != '\0'; i++) {
-                printf ("%x, ", efiBootOrder[i]);
+            for (size_t j = 0; j + 1 < results[i].nBytes; j += sizeof (uint16_t)) {
+                printf ("%x, ", efiBootOrder[j] | (efiBootOrder[j + 1] << 8));
             }
             printf ("(end)\n");
-        } else {
-            fprintf (stderr, "Failed to read BootCurrent with err %lu.\n", GetLastError ());
-        }
-        free (efiBootOrder);
-
-        nBytesStored = GetFirmwareEnvironmentVariable ("SecureBoot", "{8be4df61-93ca-11d2-aa0d-00e098032b8c}", &efiSecureBoot, sizeof (efiSecureBoot));
-        if (nBytesStored != 0) {
+        } else if (strcmp (reqs[i].name, "PlatformLang") == 0) {
+            const char *efiPlatformLang = results[i].data;
+            printf ("PlatformLang: %.*s\n", (int) strnlen (efiPlatformLang, results[i].nBytes), efiPlatformLang);
+        } else if (reqs[i].buf == &efiSecureBoot) {
             printf ("SecureBoot: %d\n", efiSecureBoot);
         } else {
-            fprintf (stderr, "Failed to read BootCurrent with err %lu.\n", GetLastError ());
-        }
-
-        // Initialize efiPlatformLang first.
-        efiPlatformLang = calloc (4096, sizeof (char));
-        if (efiPlatformLang == NULL) {
-            abort ();
-        }
-        nBytesStored = GetFirmwareEnvironmentVariable ("PlatformLang", "{8be4df61-93ca-11d2-aa0d-00e098032b8c}", efiPlatformLang, 4096);
-        if (nBytesStored != 0) {
-            printf ("PlatformLang: %s\n", efiPlatformLang);
-        } else {
-            fprintf (stderr, "Failed to read BootCurrent with err %lu.\n", GetLastError ());
+            printf ("%s: %x\n", reqs[i].name, *(uint16_t *) reqs[i].buf);
         }
-        free (efiPlatformLang);
-    } else {
-        fprintf (stderr, "Cannot obtain sufficient privilege. Abort.");
-        abort ();
     }
 
+    ast_arena_free (&arena);
     return 1; // True
 }
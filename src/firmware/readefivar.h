@@ -0,0 +1,22 @@
+/**
+ * @file readefivar.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares functions to read some EFI variables according to the standard UEFI specification.
+ */
+
+#ifndef _AST_READEFIVAR_H
+#define _AST_READEFIVAR_H
+
+/**
+ * Read and print the standard boot manager variables (BootCurrent, BootNext, Timeout, BootOrder,
+ * SecureBoot and PlatformLang).
+ *
+ * @return 1 (true).
+ */
+int ast_read_efivar_standard (void);
+
+#endif /* end of include guard: _AST_READEFIVAR_H */
@@ -0,0 +1,278 @@
+/**
+ * @file txn.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements the variable write transactions declared in firmware.h.
+ *
+ * Operations, copies of their values and the undo images all live in one arena owned by the transaction.
+ * Commit runs in three passes: save the undo images, apply in dependency order the operations that change
+ * what was saved, and on failure restore the applied operations backwards.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "firmware.h"
+#include "../arena/arena.h"
+#include "../loadopt/slot.h"
+#include "../stats/stats.h"
+
+/** Commit passes; an operation runs in the pass matching its kind. */
+enum _AST_TXN_PASS {
+    _AST_TXN_PUT_OPTION,   // Write a load option before anything can point at it
+    _AST_TXN_PUT_OTHER,
+    _AST_TXN_DELETE_OTHER, // Drop references...
+    _AST_TXN_DELETE_OPTION,// ...before what they refer to
+    _AST_TXN_PASSES
+};
+
+struct _ast_txn_op {
+    struct _ast_txn_op *next;  // Insertion order
+    struct _ast_txn_op *undo;  // Applied operations, most recent first
+    ast_guid    guid;
+    char        *name;
+    const void  *buf;          // NULL means delete
+    size_t      bufSiz;
+    uint32_t    attr;
+    int         pass;
+
+    const void  *oldBuf;       // Undo image; NULL if the variable did not exist
+    size_t      oldSiz;
+    uint32_t    oldAttr;
+};
+
+struct ast_efivar_txn {
+    struct ast_arena   arena;
+    struct _ast_txn_op *head;
+    struct _ast_txn_op *tail;
+};
+
+static int  _ast_txn_add (struct ast_efivar_txn *txn, const void *buf, size_t bufSiz, const ast_guid *guid, const char *name, uint32_t attr);
+static int  _ast_txn_unchanged (const struct _ast_txn_op *op);
+static void _ast_txn_rollback (struct _ast_txn_op *applied);
+
+
+
+
+
+int ast_efivar_txn_begin (struct ast_efivar_txn **txn)
+{
+    if (txn == NULL) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    *txn = calloc (1, sizeof (struct ast_efivar_txn));
+    if (*txn == NULL) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+    ast_arena_init (&((*txn)->arena), 0);
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+int ast_efivar_txn_put (struct ast_efivar_txn *txn, const void *buf, size_t bufSiz, const ast_guid *guid, const char *name, uint32_t attr)
+{
+    if ((buf == NULL) && (bufSiz != 0)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    return _ast_txn_add (txn, (bufSiz == 0) ? NULL : buf, bufSiz, guid, name, attr);
+}
+
+
+
+
+
+int ast_efivar_txn_delete (struct ast_efivar_txn *txn, const ast_guid *guid, const char *name)
+{
+    return _ast_txn_add (txn, NULL, 0, guid, name, 0);
+}
+
+
+
+
+
+int ast_efivar_txn_commit (struct ast_efivar_txn *txn, size_t *nWritten)
+{
+    struct _ast_txn_op *op = NULL;
+    struct _ast_txn_op *applied = NULL;
+    size_t nChanged = 0;
+    int    ret = AST_RETURN_SUCCESS;
+
+    if (nWritten != NULL) {
+        *nWritten = 0;
+    }
+    if (txn == NULL) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    // Save the current state of everything we are about to touch. Nothing is written yet, so a
+    // failure here leaves the store as it was.
+    for (op = txn->head; op != NULL; op = op->next) {
+        void *old = NULL;
+
+        ret = ast_read_efivar_alloc (&(txn->arena), &(op->guid), op->name, &old, &(op->oldSiz), &(op->oldAttr));
+        if (ret == AST_RETURN_NOT_FOUND) {
+            op->oldBuf = NULL;
+            ret = AST_RETURN_SUCCESS;
+        } else if (ret == AST_RETURN_SUCCESS) {
+            op->oldBuf = old;
+        } else {
+            fprintf (stderr, " ** Transaction aborted: cannot save %s (error %d).\n", op->name, ret);
+            goto out;
+        }
+    }
+
+    for (int pass = 0; pass < _AST_TXN_PASSES; pass++) {
+        for (op = txn->head; op != NULL; op = op->next) {
+            if (op->pass != pass) {
+                continue;
+            }
+
+            // The undo image is the current value: no need to read it again to skip a no-op.
+            if (_ast_txn_unchanged (op)) {
+                AST_STATS_ADD (AST_STATS_COUNTER_WRITES_SKIPPED, 1);
+                continue;
+            }
+
+            ret = ast_write_efivar_guid (op->buf, op->bufSiz, &(op->guid), op->name, op->attr);
+            if (ret != AST_RETURN_SUCCESS) {
+                fprintf (stderr, " ** Transaction failed writing %s (error %d), rolling back.\n", op->name, ret);
+                _ast_txn_rollback (applied);
+                nChanged = 0;
+                goto out;
+            }
+            op->undo = applied;
+            applied = op;
+            nChanged++;
+        }
+    }
+
+out:
+    if (nWritten != NULL) {
+        *nWritten = nChanged;
+    }
+    ast_efivar_txn_abort (txn);
+    return ret;
+}
+
+
+
+
+
+void ast_efivar_txn_abort (struct ast_efivar_txn *txn)
+{
+    if (txn != NULL) {
+        ast_arena_free (&(txn->arena));
+        free (txn);
+    }
+}
+
+
+
+
+
+static int _ast_txn_add (struct ast_efivar_txn *txn, const void *buf, size_t bufSiz, const ast_guid *guid, const char *name, uint32_t attr)
+{
+    static const ast_guid globalGuid = AST_GUID_EFI_GLOBAL;
+    struct _ast_txn_op *op = NULL;
+    enum AST_LOAD_OPTION_CLASS cls = AST_LOAD_OPTION_BOOT;
+    uint16_t slot = 0;
+    size_t nameLen = 0;
+    int    option = 0;
+
+    if ((txn == NULL) || (guid == NULL) || (name == NULL)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    nameLen = strlen (name);
+    if ((nameLen == 0) || (nameLen >= AST_EFIVAR_NAME_MAX) || (bufSiz > AST_EFIVAR_MAX_SIZE)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    // A variable is written once per transaction: the last operation on it wins.
+    for (op = txn->head; op != NULL; op = op->next) {
+        if (ast_guid_equal (&(op->guid), guid) && (strcmp (op->name, name) == 0)) {
+            break;
+        }
+    }
+    if (op == NULL) {
+        op = ast_arena_alloc (&(txn->arena), sizeof (struct _ast_txn_op));
+        if (op == NULL) {
+            return AST_RETURN_OPERATION_FAILED;
+        }
+        memset (op, 0, sizeof (struct _ast_txn_op));
+        op->guid = *guid;
+        op->name = ast_arena_alloc (&(txn->arena), nameLen + 1);
+        if (op->name == NULL) {
+            return AST_RETURN_OPERATION_FAILED;
+        }
+        memcpy (op->name, name, nameLen + 1);
+
+        if (txn->tail == NULL) {
+            txn->head = op;
+        } else {
+            txn->tail->next = op;
+        }
+        txn->tail = op;
+    }
+
+    op->buf = NULL;
+    if (buf != NULL) {
+        void *copy = ast_arena_alloc (&(txn->arena), bufSiz);
+
+        if (copy == NULL) {
+            return AST_RETURN_OPERATION_FAILED;
+        }
+        memcpy (copy, buf, bufSiz);
+        op->buf = copy;
+    }
+    op->bufSiz = bufSiz;
+    op->attr   = attr;
+
+    option = ast_guid_equal (guid, &globalGuid) && (ast_slot_parse_name (name, &cls, &slot) == AST_RETURN_SUCCESS);
+    if (buf != NULL) {
+        op->pass = option ? _AST_TXN_PUT_OPTION : _AST_TXN_PUT_OTHER;
+    } else {
+        op->pass = option ? _AST_TXN_DELETE_OPTION : _AST_TXN_DELETE_OTHER;
+    }
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static int _ast_txn_unchanged (const struct _ast_txn_op *op)
+{
+    // As ast_update_efivar_guid: appends and authenticated writes are never no-ops.
+    if (op->attr & (AST_EFIVAR_APPEND_WRITE | AST_EFIVAR_AUTHENTICATED_WRITE_ACCESS | AST_EFIVAR_TIME_BASED_AUTHENTICATED_WRITE_ACCESS)) {
+        return 0;
+    }
+    if (op->buf == NULL) {
+        return op->oldBuf == NULL; // Already deleted
+    }
+    return (op->oldBuf != NULL) && (op->oldSiz == op->bufSiz) && (op->oldAttr == op->attr) &&
+           (memcmp (op->oldBuf, op->buf, op->bufSiz) == 0);
+}
+
+
+
+
+
+static void _ast_txn_rollback (struct _ast_txn_op *applied)
+{
+    int ret = AST_RETURN_SUCCESS;
+
+    for (struct _ast_txn_op *op = applied; op != NULL; op = op->undo) {
+        ret = ast_write_efivar_guid (op->oldBuf, (op->oldBuf == NULL) ? 0 : op->oldSiz, &(op->guid), op->name, op->oldAttr);
+        if (ret != AST_RETURN_SUCCESS) {
+            // Keep going: restoring the rest still narrows the damage.
+            fprintf (stderr, " ** Failed to restore %s (error %d).\n", op->name, ret);
+        }
+    }
+}
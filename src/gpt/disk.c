@@ -0,0 +1,138 @@
+/**
+ * @file disk.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements disk.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#include <winioctl.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+#endif
+#include "disk.h"
+#include "../firmware/firmware.h"
+
+
+
+
+
+int ast_disk_open (const char *path, struct ast_disk *disk)
+{
+    memset (disk, 0, sizeof (*disk));
+#ifdef _WIN32
+    {
+        DISK_GEOMETRY_EX geometry;
+        LARGE_INTEGER size;
+        DWORD n = 0;
+
+        disk->handle = CreateFileA (path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (disk->handle == INVALID_HANDLE_VALUE) {
+            return (GetLastError () == ERROR_FILE_NOT_FOUND) ? AST_RETURN_NOT_FOUND : AST_RETURN_ACCESS_DENIED;
+        }
+        // \\.\PhysicalDriveN reports its geometry; a file does not.
+        if (DeviceIoControl (disk->handle, IOCTL_DISK_GET_DRIVE_GEOMETRY_EX, NULL, 0, &geometry, sizeof (geometry), &n, NULL)) {
+            disk->size      = (uint64_t) geometry.DiskSize.QuadPart;
+            disk->blockSize = geometry.Geometry.BytesPerSector;
+        } else if (GetFileSizeEx (disk->handle, &size)) {
+            disk->size = (uint64_t) size.QuadPart;
+        } else {
+            CloseHandle (disk->handle);
+            return AST_RETURN_OPERATION_FAILED;
+        }
+    }
+#else
+    {
+        struct stat st;
+
+        disk->fd = open (path, O_RDONLY | O_CLOEXEC);
+        if (disk->fd < 0) {
+            return (errno == ENOENT) ? AST_RETURN_NOT_FOUND : AST_RETURN_ACCESS_DENIED;
+        }
+        if (fstat (disk->fd, &st) != 0) {
+            close (disk->fd);
+            return AST_RETURN_OPERATION_FAILED;
+        }
+        disk->size = (uint64_t) st.st_size;
+#ifdef __linux__
+        if (S_ISBLK (st.st_mode)) {
+            int blockSize = 0;
+
+            if ((ioctl (disk->fd, BLKGETSIZE64, &(disk->size)) != 0) || (ioctl (disk->fd, BLKSSZGET, &blockSize) != 0)) {
+                close (disk->fd);
+                return AST_RETURN_OPERATION_FAILED;
+            }
+            disk->blockSize = (uint32_t) blockSize;
+        }
+#endif
+    }
+#endif
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+void ast_disk_close (struct ast_disk *disk)
+{
+#ifdef _WIN32
+    CloseHandle (disk->handle);
+#else
+    close (disk->fd);
+#endif
+}
+
+
+
+
+
+int ast_disk_read (struct ast_disk *disk, uint64_t offset, void *buf, size_t size)
+{
+    uint8_t *p = buf;
+
+    if ((offset > disk->size) || (disk->size - offset < size)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    while (size > 0) {
+#ifdef _WIN32
+        OVERLAPPED at;
+        DWORD n = 0;
+
+        memset (&at, 0, sizeof (at));
+        at.Offset     = (DWORD) offset;
+        at.OffsetHigh = (DWORD) (offset >> 32);
+        if (!ReadFile (disk->handle, p, (size > 0x40000000) ? 0x40000000 : (DWORD) size, &n, &at) || (n == 0)) {
+            fprintf (stderr, " ** Cannot read the disk at %llu (error %lu).\n", (unsigned long long) offset, GetLastError ());
+            return AST_RETURN_OPERATION_FAILED;
+        }
+#else
+        ssize_t n = pread (disk->fd, p, size, (off_t) offset);
+
+        if ((n < 0) && (errno == EINTR)) {
+            continue;
+        }
+        if (n <= 0) {
+            fprintf (stderr, " ** Cannot read the disk at %llu: %s.\n", (unsigned long long) offset, (n < 0) ? strerror (errno) : "end of file");
+            return AST_RETURN_OPERATION_FAILED;
+        }
+#endif
+        p      += n;
+        offset += (uint64_t) n;
+        size   -= (size_t) n;
+    }
+    return AST_RETURN_SUCCESS;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file disk.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares raw reads from a disk (`/dev/sda`, `\\.\PhysicalDrive0`) or a disk image
+ * file, shared by the GPT and FAT readers. A device reports its logical block size; reads of a device
+ * should be aligned to it (Windows refuses others).
+ */
+
+#ifndef _AST_DISK_H
+#define _AST_DISK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+/**
+ * An open disk or image.
+ */
+struct ast_disk {
+#ifdef _WIN32
+    HANDLE   handle;
+#else
+    int      fd;
+#endif
+    uint64_t size;      /**< In bytes. */
+    uint32_t blockSize; /**< Reported by the device, or 0 for an image file. */
+};
+
+/**
+ * Open a disk or disk image for reading.
+ *
+ * @param path [in]  Block device or image file.
+ * @param disk [out] Disk, to close with ast_disk_close.
+ * @return AST_RETURN_SUCCESS, AST_RETURN_NOT_FOUND if there is no such file, AST_RETURN_ACCESS_DENIED if it
+ *         cannot be opened, or AST_RETURN_OPERATION_FAILED if its size cannot be told.
+ */
+int ast_disk_open (const char *path, struct ast_disk *disk);
+
+/**
+ * Read bytes of a disk, all of them or fail.
+ *
+ * @param disk   [in]  Disk.
+ * @param offset [in]  Offset in bytes.
+ * @param buf    [out] Destination.
+ * @param size   [in]  Number of bytes.
+ * @return AST_RETURN_SUCCESS, AST_RETURN_INVALID_PARAMETER if the range is outside the disk, or
+ *         AST_RETURN_OPERATION_FAILED if a read fails.
+ */
+int ast_disk_read (struct ast_disk *disk, uint64_t offset, void *buf, size_t size);
+
+/**
+ * Close a disk.
+ *
+ * @param disk [in] Disk.
+ */
+void ast_disk_close (struct ast_disk *disk);
+
+#endif /* end of include guard: _AST_DISK_H */
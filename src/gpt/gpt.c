@@ -0,0 +1,370 @@
+/**
+ * @file gpt.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements gpt.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gpt.h"
+#include "disk.h"
+#include "../firmware/firmware.h"
+#include "../crypto/crc32.h"
+#include "../unicode/unicode.h"
+
+/** Size of the GPT header fields covered by HeaderSize in revision 1.0. */
+#define AST_GPT_HEADER_SIZE 92
+
+/** Size of a partition entry in revision 1.0; SizeOfPartitionEntry is this times a power of two. */
+#define AST_GPT_ENTRY_SIZE 128
+
+/**
+ * The fields of a GPT header this reader uses.
+ */
+struct _ast_gpt_header {
+    uint64_t myLba;
+    uint64_t alternateLba;
+    uint64_t firstUsableLba;
+    uint64_t lastUsableLba;
+    ast_guid diskGuid;
+    uint64_t entryLba;
+    uint32_t nEntries;
+    uint32_t entrySize;
+    uint32_t entryCrc;
+};
+
+static const ast_guid _ast_gpt_unused = AST_GUID_ZERO;
+
+static int  _ast_gpt_pmbr (const uint8_t *mbr);
+static int  _ast_gpt_header (const uint8_t *block, uint32_t blockSize, uint64_t lba, uint64_t nBlocks, struct _ast_gpt_header *h);
+static int  _ast_gpt_array (struct ast_disk *disk, const uint8_t *head, size_t headSize, uint32_t blockSize,
+                            const struct _ast_gpt_header *h, uint8_t **buf, const uint8_t **array);
+static int  _ast_gpt_fill (struct ast_gpt *gpt, const struct _ast_gpt_header *h, const uint8_t *array);
+static uint64_t _ast_gpt_u64 (const uint8_t *p);
+static uint32_t _ast_gpt_u32 (const uint8_t *p);
+
+
+
+
+
+int ast_gpt_read (const char *path, struct ast_gpt *gpt)
+{
+    static const uint32_t probes[] = { 512, 4096 };
+    struct ast_disk disk;
+    struct _ast_gpt_header primary, backup;
+    uint8_t *head = NULL, *block = NULL, *primaryBuf = NULL, *backupBuf = NULL;
+    const uint8_t *primaryArray = NULL, *backupArray = NULL;
+    size_t headSize = 0;
+    int hasPrimary = 0, hasBackup = 0, seen = 0;
+    int ret = AST_RETURN_SUCCESS;
+
+    if ((path == NULL) || (gpt == NULL)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    memset (gpt, 0, sizeof (*gpt));
+    ret = ast_disk_open (path, &disk);
+    if (ret != AST_RETURN_SUCCESS) {
+        return ret;
+    }
+
+    // One read for the protective MBR, the primary header and (usually) the entry array.
+    headSize = (disk.size < AST_GPT_HEAD_SIZE) ? (size_t) (disk.size & ~(uint64_t) 511) : AST_GPT_HEAD_SIZE;
+    head     = malloc (AST_GPT_HEAD_SIZE);
+    block    = malloc (4096);
+    if ((head == NULL) || (block == NULL)) {
+        ret = AST_RETURN_OPERATION_FAILED;
+        goto out;
+    }
+    if (headSize < 1024) {
+        ret = AST_RETURN_NOT_FOUND;
+        goto out;
+    }
+    ret = ast_disk_read (&disk, 0, head, headSize);
+    if (ret != AST_RETURN_SUCCESS) {
+        goto out;
+    }
+    if (!_ast_gpt_pmbr (head)) {
+        ret = AST_RETURN_NOT_FOUND;
+        goto out;
+    }
+
+    // A device knows its block size; for an image, the header tells, at LBA 1 or at the last LBA.
+    for (size_t i = 0; i < sizeof (probes) / sizeof (probes[0]); i++) {
+        uint32_t bs = (disk.blockSize != 0) ? disk.blockSize : probes[i];
+        uint64_t nBlocks = disk.size / bs;
+        uint64_t backupLba = nBlocks - 1;
+
+        if ((bs > 4096) || (nBlocks < 3)) {
+            break;
+        }
+        if ((headSize >= 2 * (size_t) bs) && _ast_gpt_header (head + bs, bs, 1, nBlocks, &primary)) {
+            hasPrimary = 1;
+            if (primary.alternateLba < nBlocks) {
+                backupLba = primary.alternateLba;
+            }
+        }
+        ret = ast_disk_read (&disk, backupLba * bs, block, bs);
+        if (ret != AST_RETURN_SUCCESS) {
+            goto out;
+        }
+        hasBackup = _ast_gpt_header (block, bs, backupLba, nBlocks, &backup);
+        seen |= ((headSize >= 2 * (size_t) bs) && (memcmp (head + bs, "EFI PART", 8) == 0)) || (memcmp (block, "EFI PART", 8) == 0);
+        if (hasPrimary || hasBackup) {
+            gpt->blockSize = bs;
+            gpt->nBlocks   = nBlocks;
+            break;
+        }
+        if (disk.blockSize != 0) {
+            break;
+        }
+    }
+    if (!hasPrimary && !hasBackup) {
+        ret = seen ? AST_RETURN_INVALID_PARAMETER : AST_RETURN_NOT_FOUND;
+        goto out;
+    }
+
+    if (hasPrimary) {
+        ret = _ast_gpt_array (&disk, head, headSize, gpt->blockSize, &primary, &primaryBuf, &primaryArray);
+        if (ret != AST_RETURN_SUCCESS) {
+            goto out;
+        }
+        if (ast_crc32 (0, primaryArray, (size_t) primary.nEntries * primary.entrySize) == primary.entryCrc) {
+            gpt->valid |= AST_GPT_PRIMARY;
+        }
+    }
+    if (hasBackup) {
+        // The same array CRC over an array of the same shape: the backup array need not be read.
+        if ((gpt->valid & AST_GPT_PRIMARY) && (backup.entryCrc == primary.entryCrc) &&
+            (backup.nEntries == primary.nEntries) && (backup.entrySize == primary.entrySize)) {
+            gpt->valid |= AST_GPT_BACKUP;
+        } else {
+            ret = _ast_gpt_array (&disk, head, headSize, gpt->blockSize, &backup, &backupBuf, &backupArray);
+            if (ret != AST_RETURN_SUCCESS) {
+                goto out;
+            }
+            if (ast_crc32 (0, backupArray, (size_t) backup.nEntries * backup.entrySize) == backup.entryCrc) {
+                gpt->valid |= AST_GPT_BACKUP;
+            }
+        }
+    }
+
+    if (gpt->valid & AST_GPT_PRIMARY) {
+        ret = _ast_gpt_fill (gpt, &primary, primaryArray);
+    } else if (gpt->valid & AST_GPT_BACKUP) {
+        fprintf (stderr, " ** The primary GPT of %s is damaged; using the backup.\n", path);
+        ret = _ast_gpt_fill (gpt, &backup, backupArray);
+    } else {
+        ret = AST_RETURN_INVALID_PARAMETER;
+    }
+
+out:
+    free (backupBuf);
+    free (primaryBuf);
+    free (block);
+    free (head);
+    ast_disk_close (&disk);
+    if (ret != AST_RETURN_SUCCESS) {
+        ast_gpt_free (gpt);
+    }
+    return ret;
+}
+
+
+
+
+
+const struct ast_gpt_partition *ast_gpt_find (const struct ast_gpt *gpt, const ast_guid *type)
+{
+    for (size_t i = 0; i < gpt->nPartitions; i++) {
+        if (ast_guid_equal (&(gpt->partitions[i].type), type)) {
+            return &(gpt->partitions[i]);
+        }
+    }
+    return NULL;
+}
+
+
+
+
+
+void ast_gpt_hd (const struct ast_gpt_partition *part, struct ast_devpath_hd *hd)
+{
+    memset (hd, 0, sizeof (*hd));
+    hd->partitionNumber = part->number;
+    hd->partitionStart  = part->firstLba;
+    hd->partitionSize   = part->lastLba - part->firstLba + 1;
+    memcpy (hd->signature, &(part->unique), sizeof (hd->signature));
+    hd->partitionFormat = AST_DEVPATH_HD_FORMAT_GPT;
+    hd->signatureType   = AST_DEVPATH_HD_SIGNATURE_GUID;
+}
+
+
+
+
+
+void ast_gpt_free (struct ast_gpt *gpt)
+{
+    free (gpt->partitions);
+    gpt->partitions  = NULL;
+    gpt->nPartitions = 0;
+}
+
+
+
+
+
+/**
+ * Whether LBA 0 is a protective MBR: the boot signature, and a partition of type 0xEE (a hybrid MBR has
+ * others too).
+ */
+static int _ast_gpt_pmbr (const uint8_t *mbr)
+{
+    if ((mbr[510] != 0x55) || (mbr[511] != 0xaa)) {
+        return 0;
+    }
+    for (int i = 0; i < 4; i++) {
+        if (mbr[446 + 16 * i + 4] == 0xee) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+
+
+
+/**
+ * Check a GPT header read from an LBA, and extract its fields.
+ */
+static int _ast_gpt_header (const uint8_t *block, uint32_t blockSize, uint64_t lba, uint64_t nBlocks, struct _ast_gpt_header *h)
+{
+    static const uint8_t zero[4] = {0};
+    uint32_t headerSize = _ast_gpt_u32 (block + 12);
+    uint32_t crc = 0;
+    uint64_t arrayBlocks = 0;
+
+    if ((memcmp (block, "EFI PART", 8) != 0) || (headerSize < AST_GPT_HEADER_SIZE) || (headerSize > blockSize)) {
+        return 0;
+    }
+    // HeaderCRC32 is computed with itself zeroed.
+    crc = ast_crc32 (0, block, 16);
+    crc = ast_crc32 (crc, zero, sizeof (zero));
+    crc = ast_crc32 (crc, block + 20, headerSize - 20);
+    if (crc != _ast_gpt_u32 (block + 16)) {
+        return 0;
+    }
+
+    h->myLba          = _ast_gpt_u64 (block + 24);
+    h->alternateLba   = _ast_gpt_u64 (block + 32);
+    h->firstUsableLba = _ast_gpt_u64 (block + 40);
+    h->lastUsableLba  = _ast_gpt_u64 (block + 48);
+    memcpy (&(h->diskGuid), block + 56, sizeof (ast_guid));
+    h->entryLba       = _ast_gpt_u64 (block + 72);
+    h->nEntries       = _ast_gpt_u32 (block + 80);
+    h->entrySize      = _ast_gpt_u32 (block + 84);
+    h->entryCrc       = _ast_gpt_u32 (block + 88);
+
+    if ((h->myLba != lba) || (h->entrySize < AST_GPT_ENTRY_SIZE) || ((h->entrySize & (h->entrySize - 1)) != 0) ||
+        ((uint64_t) h->nEntries * h->entrySize > AST_GPT_MAX_ARRAY_SIZE) || (h->lastUsableLba >= nBlocks) ||
+        (h->firstUsableLba > h->lastUsableLba + 1)) {
+        return 0;
+    }
+    arrayBlocks = ((uint64_t) h->nEntries * h->entrySize + blockSize - 1) / blockSize;
+    if ((h->entryLba < 2) || (h->entryLba >= nBlocks) || (nBlocks - h->entryLba < arrayBlocks) ||
+        ((h->entryLba <= lba) && (lba < h->entryLba + arrayBlocks))) {
+        return 0;
+    }
+    return 1;
+}
+
+
+
+
+
+/**
+ * Get the entry array of a header: inside the first read if it is there, otherwise read into *buf.
+ */
+static int _ast_gpt_array (struct ast_disk *disk, const uint8_t *head, size_t headSize, uint32_t blockSize,
+                           const struct _ast_gpt_header *h, uint8_t **buf, const uint8_t **array)
+{
+    uint64_t offset = h->entryLba * blockSize;
+    size_t size = (size_t) h->nEntries * h->entrySize;
+    size_t aligned = (size + blockSize - 1) / blockSize * blockSize;
+
+    if (offset + size <= headSize) {
+        *array = head + offset;
+        return AST_RETURN_SUCCESS;
+    }
+    *buf = malloc ((aligned != 0) ? aligned : 1);
+    if (*buf == NULL) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+    *array = *buf;
+    return ast_disk_read (disk, offset, *buf, aligned);
+}
+
+
+
+
+
+static int _ast_gpt_fill (struct ast_gpt *gpt, const struct _ast_gpt_header *h, const uint8_t *array)
+{
+    size_t n = 0;
+
+    gpt->diskGuid       = h->diskGuid;
+    gpt->firstUsableLba = h->firstUsableLba;
+    gpt->lastUsableLba  = h->lastUsableLba;
+    for (uint32_t i = 0; i < h->nEntries; i++) {
+        n += memcmp (array + (size_t) i * h->entrySize, &_ast_gpt_unused, sizeof (ast_guid)) != 0;
+    }
+    gpt->partitions = calloc ((n != 0) ? n : 1, sizeof (struct ast_gpt_partition));
+    if (gpt->partitions == NULL) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+
+    for (uint32_t i = 0; i < h->nEntries; i++) {
+        const uint8_t *e = array + (size_t) i * h->entrySize;
+        struct ast_gpt_partition *part = &(gpt->partitions[gpt->nPartitions]);
+
+        if (memcmp (e, &_ast_gpt_unused, sizeof (ast_guid)) == 0) {
+            continue;
+        }
+        part->number = i + 1;
+        memcpy (&(part->type), e, sizeof (ast_guid));
+        memcpy (&(part->unique), e + 16, sizeof (ast_guid));
+        part->firstLba   = _ast_gpt_u64 (e + 32);
+        part->lastLba    = _ast_gpt_u64 (e + 40);
+        part->attributes = _ast_gpt_u64 (e + 48);
+        ast_utf16_decode (e + 56, 72, part->name, sizeof (part->name));
+        if ((part->firstLba > part->lastLba) || (part->lastLba >= gpt->nBlocks)) {
+            fprintf (stderr, " ** GPT partition %u lies outside the disk; ignored.\n", part->number);
+            continue;
+        }
+        gpt->nPartitions++;
+    }
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static uint64_t _ast_gpt_u64 (const uint8_t *p)
+{
+    return (uint64_t) _ast_gpt_u32 (p) | ((uint64_t) _ast_gpt_u32 (p + 4) << 32);
+}
+
+
+
+
+
+static uint32_t _ast_gpt_u32 (const uint8_t *p)
+{
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
@@ -0,0 +1,118 @@
+/**
+ * @file gpt.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares a reader of GUID partition tables, straight from a disk (`/dev/sda`,
+ * `\\.\PhysicalDrive0`) or a disk image file, to fill in the hard drive node of a boot option:
+ *
+ *     struct ast_gpt gpt;
+ *     static const ast_guid espType = AST_GUID_PARTITION_ESP;
+ *
+ *     if (ast_gpt_read ("/dev/sda", &gpt) == AST_RETURN_SUCCESS) {
+ *         const struct ast_gpt_partition *esp = ast_gpt_find (&gpt, &espType);
+ *         if (esp != NULL) {
+ *             ast_gpt_hd (esp, &hd);
+ *         }
+ *         ast_gpt_free (&gpt);
+ *     }
+ *
+ * The protective MBR, the primary header and, on most disks, the partition entry array come in one read
+ * of the first AST_GPT_HEAD_SIZE bytes; the backup header is one more block. Every read is block aligned.
+ * Both headers and their entry arrays are checked with their CRC-32s; the backup array is only read when
+ * its CRC differs from the primary one, or when the primary table is damaged and the backup is used.
+ */
+
+#ifndef _AST_GPT_H
+#define _AST_GPT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../guid/guid.h"
+#include "../devpath/devpath.h"
+
+/** Size of the first read: the protective MBR, the primary header and a 128-entry array, in 4 KiB blocks too. */
+#define AST_GPT_HEAD_SIZE (64 * 1024)
+
+/** Largest partition entry array accepted. */
+#define AST_GPT_MAX_ARRAY_SIZE (4 * 1024 * 1024)
+
+/** Size of a partition name: 36 UTF-16 code units as UTF-8, and a NUL. */
+#define AST_GPT_NAME_MAX 109
+
+/**
+ * Which tables passed their checks (ast_gpt.valid).
+ */
+enum AST_GPT_TABLE {
+    AST_GPT_PRIMARY = 1 << 0, /**< Primary header (LBA 1) and its entry array. */
+    AST_GPT_BACKUP  = 1 << 1  /**< Backup header (last LBA) and its entry array. */
+};
+
+/**
+ * One used partition entry.
+ */
+struct ast_gpt_partition {
+    uint32_t number;                 /**< 1-based index in the entry array, the HD node PartitionNumber. */
+    ast_guid type;                   /**< PartitionTypeGUID, e.g. AST_GUID_PARTITION_ESP. */
+    ast_guid unique;                 /**< UniquePartitionGUID, the HD node PartitionSignature. */
+    uint64_t firstLba;               /**< StartingLBA */
+    uint64_t lastLba;                /**< EndingLBA, inclusive. */
+    uint64_t attributes;             /**< Attributes */
+    char     name[AST_GPT_NAME_MAX]; /**< PartitionName, as UTF-8. */
+};
+
+/**
+ * A partition table. Filled in by ast_gpt_read; free it with ast_gpt_free.
+ */
+struct ast_gpt {
+    uint32_t                 blockSize;      /**< Logical block size in bytes: 512 or 4096 usually. */
+    uint64_t                 nBlocks;        /**< Size of the disk in blocks. */
+    ast_guid                 diskGuid;       /**< DiskGUID */
+    uint64_t                 firstUsableLba; /**< FirstUsableLBA */
+    uint64_t                 lastUsableLba;  /**< LastUsableLBA */
+    unsigned int             valid;          /**< AST_GPT_PRIMARY and/or AST_GPT_BACKUP; the first is used if set. */
+    size_t                   nPartitions;    /**< Number of used entries. */
+    struct ast_gpt_partition *partitions;    /**< Used entries, in entry array order. */
+};
+
+/**
+ * Read the partition table of a disk or disk image.
+ *
+ * The block size comes from the device; for an image file, the header is looked for at 512 and then
+ * 4096 bytes.
+ *
+ * @param path [in]  Block device or image file.
+ * @param gpt  [out] Partition table.
+ * @return AST_RETURN_SUCCESS, AST_RETURN_NOT_FOUND if there is no such file or it has no GPT,
+ *         AST_RETURN_ACCESS_DENIED if it cannot be opened, AST_RETURN_INVALID_PARAMETER if both tables
+ *         are damaged, or AST_RETURN_OPERATION_FAILED if a read fails.
+ */
+int ast_gpt_read (const char *path, struct ast_gpt *gpt);
+
+/**
+ * Find the first partition of a type.
+ *
+ * @param gpt  [in] Partition table.
+ * @param type [in] PartitionTypeGUID.
+ * @return The partition, or NULL if there is none.
+ */
+const struct ast_gpt_partition *ast_gpt_find (const struct ast_gpt *gpt, const ast_guid *type);
+
+/**
+ * Fill in a hard drive device path node for a partition.
+ *
+ * @param part [in]  Partition.
+ * @param hd   [out] Node: number, start, size, GPT unique GUID signature.
+ */
+void ast_gpt_hd (const struct ast_gpt_partition *part, struct ast_devpath_hd *hd);
+
+/**
+ * Free the partitions of a table.
+ *
+ * @param gpt [in] Partition table.
+ */
+void ast_gpt_free (struct ast_gpt *gpt);
+
+#endif /* end of include guard: _AST_GPT_H */
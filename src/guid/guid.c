@@ -0,0 +1,318 @@
+/**
+ * @file guid.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements guid.h.
+ *
+ * Both directions work on the 32 hex digits with the dashes taken out, in text order. The first three
+ * fields are little endian in memory, so their bytes are swapped between text order and ast_guid.
+ *
+ * The hex conversion turns 16 (SSE2) or 32 (AVX2) characters into nibbles at once and validates them
+ * with the same compares, instead of sscanf's per-field parsing.
+ */
+
+#include <string.h>
+#include "guid.h"
+#include "../firmware/firmware.h"
+
+#if defined (__SSE2__)
+#include <emmintrin.h>
+#define AST_GUID_SSE2 1
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+#include <immintrin.h>
+#define AST_GUID_AVX2 1
+#endif
+#endif
+
+// Position in text of each byte, in text order, and where it lands in an ast_guid.
+static const uint8_t _ast_guid_swap[16] = { 3, 2, 1, 0, 5, 4, 7, 6, 8, 9, 10, 11, 12, 13, 14, 15 };
+
+static int  _ast_guid_unhex (const char *hex, uint8_t *bytes);
+static void _ast_guid_tohex (const uint8_t *bytes, char *hex);
+#ifndef AST_GUID_SSE2
+static int  _ast_guid_unhex_scalar (const char *hex, uint8_t *bytes);
+static void _ast_guid_tohex_scalar (const uint8_t *bytes, char *hex);
+#else
+static int  _ast_guid_unhex_sse2 (const char *hex, uint8_t *bytes);
+static void _ast_guid_tohex_sse2 (const uint8_t *bytes, char *hex);
+#endif
+#ifdef AST_GUID_AVX2
+static int  _ast_guid_unhex_avx2 (const char *hex, uint8_t *bytes);
+#endif
+
+
+
+
+
+int ast_guid_parse (const char *str, ast_guid *guid)
+{
+    size_t len = 0;
+
+    if ((str == NULL) || (guid == NULL)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    // Never look past the longest valid form.
+    while ((len < AST_GUID_STRLEN + 3) && (str[len] != '\0')) {
+        len++;
+    }
+
+    if (len == AST_GUID_STRLEN) {
+        return ast_guid_parse_n (str, guid);
+    } else if ((len == AST_GUID_STRLEN + 2) && (str[0] == '{') && (str[AST_GUID_STRLEN + 1] == '}')) {
+        return ast_guid_parse_n (str + 1, guid);
+    }
+
+    return AST_RETURN_INVALID_PARAMETER;
+}
+
+
+
+
+
+int ast_guid_parse_n (const char *str, ast_guid *guid)
+{
+    char    hex[32];
+    uint8_t bytes[16];
+
+    if ((str[8] != '-') || (str[13] != '-') || (str[18] != '-') || (str[23] != '-')) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    memcpy (hex,      str,      8);
+    memcpy (hex + 8,  str + 9,  4);
+    memcpy (hex + 12, str + 14, 4);
+    memcpy (hex + 16, str + 19, 4);
+    memcpy (hex + 20, str + 24, 12);
+    if (_ast_guid_unhex (hex, bytes) != AST_RETURN_SUCCESS) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    for (int i = 0; i < 16; i++) {
+        guid->b[i] = bytes[_ast_guid_swap[i]];
+    }
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+void ast_guid_format (const ast_guid *guid, char *str)
+{
+    char    hex[32];
+    uint8_t bytes[16];
+
+    for (int i = 0; i < 16; i++) {
+        bytes[i] = guid->b[_ast_guid_swap[i]];
+    }
+    _ast_guid_tohex (bytes, hex);
+
+    memcpy (str,      hex,      8);
+    str[8] = '-';
+    memcpy (str + 9,  hex + 8,  4);
+    str[13] = '-';
+    memcpy (str + 14, hex + 12, 4);
+    str[18] = '-';
+    memcpy (str + 19, hex + 16, 4);
+    str[23] = '-';
+    memcpy (str + 24, hex + 20, 12);
+    str[AST_GUID_STRLEN] = '\0';
+}
+
+
+
+
+
+void ast_guid_format_braced (const ast_guid *guid, char *str)
+{
+    str[0] = '{';
+    ast_guid_format (guid, str + 1);
+    str[AST_GUID_STRLEN + 1] = '}';
+    str[AST_GUID_STRLEN + 2] = '\0';
+}
+
+
+
+
+
+int ast_guid_equal (const ast_guid *a, const ast_guid *b)
+{
+    return memcmp (a->b, b->b, sizeof (a->b)) == 0;
+}
+
+
+
+
+
+static int _ast_guid_unhex (const char *hex, uint8_t *bytes)
+{
+#if defined (AST_GUID_AVX2)
+    if (__builtin_cpu_supports ("avx2")) {
+        return _ast_guid_unhex_avx2 (hex, bytes);
+    }
+#endif
+#if defined (AST_GUID_SSE2)
+    return _ast_guid_unhex_sse2 (hex, bytes);
+#else
+    return _ast_guid_unhex_scalar (hex, bytes);
+#endif
+}
+
+
+
+
+
+static void _ast_guid_tohex (const uint8_t *bytes, char *hex)
+{
+#if defined (AST_GUID_SSE2)
+    // 16 bytes become exactly 32 characters: SSE2 already does it in two stores.
+    _ast_guid_tohex_sse2 (bytes, hex);
+#else
+    _ast_guid_tohex_scalar (bytes, hex);
+#endif
+}
+
+
+
+
+
+#ifndef AST_GUID_SSE2
+static int _ast_guid_unhex_scalar (const char *hex, uint8_t *bytes)
+{
+    for (int i = 0; i < 32; i++) {
+        char    ch = hex[i];
+        uint8_t nibble = 0;
+
+        if ((ch >= '0') && (ch <= '9')) {
+            nibble = (uint8_t) (ch - '0');
+        } else if ((ch >= 'a') && (ch <= 'f')) {
+            nibble = (uint8_t) (ch - 'a' + 10);
+        } else if ((ch >= 'A') && (ch <= 'F')) {
+            nibble = (uint8_t) (ch - 'A' + 10);
+        } else {
+            return AST_RETURN_INVALID_PARAMETER;
+        }
+
+        if (i & 1) {
+            bytes[i >> 1] |= nibble;
+        } else {
+            bytes[i >> 1] = (uint8_t) (nibble << 4);
+        }
+    }
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static void _ast_guid_tohex_scalar (const uint8_t *bytes, char *hex)
+{
+    static const char digits[] = "0123456789abcdef";
+
+    for (int i = 0; i < 16; i++) {
+        hex[2 * i]     = digits[bytes[i] >> 4];
+        hex[2 * i + 1] = digits[bytes[i] & 0x0f];
+    }
+}
+#endif /* !AST_GUID_SSE2 */
+
+
+
+
+
+#ifdef AST_GUID_SSE2
+static __m128i _ast_guid_nibbles_sse2 (__m128i v, int *valid)
+{
+    // Signed compares: bytes >= 0x80 are negative and fail both ranges.
+    __m128i lower   = _mm_or_si128 (v, _mm_set1_epi8 (0x20));
+    __m128i isDigit = _mm_and_si128 (_mm_cmpgt_epi8 (v, _mm_set1_epi8 ('0' - 1)), _mm_cmplt_epi8 (v, _mm_set1_epi8 ('9' + 1)));
+    __m128i isAlpha = _mm_and_si128 (_mm_cmpgt_epi8 (lower, _mm_set1_epi8 ('a' - 1)), _mm_cmplt_epi8 (lower, _mm_set1_epi8 ('f' + 1)));
+    __m128i digit   = _mm_and_si128 (isDigit, _mm_sub_epi8 (v, _mm_set1_epi8 ('0')));
+    __m128i alpha   = _mm_and_si128 (isAlpha, _mm_sub_epi8 (lower, _mm_set1_epi8 ('a' - 10)));
+
+    *valid &= (_mm_movemask_epi8 (_mm_or_si128 (isDigit, isAlpha)) == 0xFFFF);
+    return _mm_or_si128 (digit, alpha);
+}
+
+
+
+
+
+static __m128i _ast_guid_pairs_sse2 (__m128i n)
+{
+    // Each 16-bit lane holds two nibbles (high digit first in memory): make it one byte.
+    __m128i b = _mm_or_si128 (_mm_slli_epi16 (n, 4), _mm_srli_epi16 (n, 8));
+    return _mm_and_si128 (b, _mm_set1_epi16 (0x00ff));
+}
+
+
+
+
+
+static int _ast_guid_unhex_sse2 (const char *hex, uint8_t *bytes)
+{
+    int valid = 1;
+    __m128i n0 = _ast_guid_nibbles_sse2 (_mm_loadu_si128 ((const __m128i *) hex), &valid);
+    __m128i n1 = _ast_guid_nibbles_sse2 (_mm_loadu_si128 ((const __m128i *) (hex + 16)), &valid);
+
+    if (!valid) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    _mm_storeu_si128 ((__m128i *) bytes, _mm_packus_epi16 (_ast_guid_pairs_sse2 (n0), _ast_guid_pairs_sse2 (n1)));
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static void _ast_guid_tohex_sse2 (const uint8_t *bytes, char *hex)
+{
+    __m128i b    = _mm_loadu_si128 ((const __m128i *) bytes);
+    __m128i mask = _mm_set1_epi8 (0x0f);
+    __m128i hi   = _mm_and_si128 (_mm_srli_epi16 (b, 4), mask);
+    __m128i lo   = _mm_and_si128 (b, mask);
+    __m128i c0   = _mm_unpacklo_epi8 (hi, lo);
+    __m128i c1   = _mm_unpackhi_epi8 (hi, lo);
+    __m128i nine = _mm_set1_epi8 (9);
+    __m128i gap  = _mm_set1_epi8 ('a' - '0' - 10);
+
+    c0 = _mm_add_epi8 (_mm_add_epi8 (c0, _mm_set1_epi8 ('0')), _mm_and_si128 (_mm_cmpgt_epi8 (c0, nine), gap));
+    c1 = _mm_add_epi8 (_mm_add_epi8 (c1, _mm_set1_epi8 ('0')), _mm_and_si128 (_mm_cmpgt_epi8 (c1, nine), gap));
+    _mm_storeu_si128 ((__m128i *) hex, c0);
+    _mm_storeu_si128 ((__m128i *) (hex + 16), c1);
+}
+#endif /* AST_GUID_SSE2 */
+
+
+
+
+
+#ifdef AST_GUID_AVX2
+__attribute__ ((target ("avx2")))
+static int _ast_guid_unhex_avx2 (const char *hex, uint8_t *bytes)
+{
+    // All 32 digits in one register; same steps as the SSE2 version.
+    __m256i v       = _mm256_loadu_si256 ((const __m256i *) hex);
+    __m256i lower   = _mm256_or_si256 (v, _mm256_set1_epi8 (0x20));
+    __m256i isDigit = _mm256_and_si256 (_mm256_cmpgt_epi8 (v, _mm256_set1_epi8 ('0' - 1)), _mm256_cmpgt_epi8 (_mm256_set1_epi8 ('9' + 1), v));
+    __m256i isAlpha = _mm256_and_si256 (_mm256_cmpgt_epi8 (lower, _mm256_set1_epi8 ('a' - 1)), _mm256_cmpgt_epi8 (_mm256_set1_epi8 ('f' + 1), lower));
+    __m256i n       = _mm256_or_si256 (_mm256_and_si256 (isDigit, _mm256_sub_epi8 (v, _mm256_set1_epi8 ('0'))),
+                                       _mm256_and_si256 (isAlpha, _mm256_sub_epi8 (lower, _mm256_set1_epi8 ('a' - 10))));
+    __m256i pairs   = _mm256_and_si256 (_mm256_or_si256 (_mm256_slli_epi16 (n, 4), _mm256_srli_epi16 (n, 8)), _mm256_set1_epi16 (0x00ff));
+    __m256i packed  = _mm256_packus_epi16 (pairs, pairs);
+
+    if ((uint32_t) _mm256_movemask_epi8 (_mm256_or_si256 (isDigit, isAlpha)) != UINT32_MAX) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    // packus works per 128-bit lane: the bytes are in quadwords 0 and 2.
+    _mm_storeu_si128 ((__m128i *) bytes, _mm256_castsi256_si128 (_mm256_permute4x64_epi64 (packed, 0x08)));
+    return AST_RETURN_SUCCESS;
+}
+#endif /* AST_GUID_AVX2 */
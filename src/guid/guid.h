@@ -0,0 +1,116 @@
+/**
+ * @file guid.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares the binary GUID type and its text conversions.
+ *
+ * An ast_guid has the in-memory layout of EFI_GUID (and of the Windows GUID): Data1, Data2 and Data3 are
+ * little endian, Data4 is a byte array. It can be copied to and from those types with memcpy.
+ *
+ * Well-known GUIDs are available as compile-time initializers, so they never go through the parser:
+ *
+ *     static const ast_guid global = AST_GUID_EFI_GLOBAL;
+ *
+ * The parser and formatter use SSE2 (and AVX2 when the CPU has it) on x86, and plain C elsewhere.
+ */
+
+#ifndef _AST_GUID_H
+#define _AST_GUID_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Length of "xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx", without the terminator.
+ */
+#define AST_GUID_STRLEN 36
+
+/**
+ * A GUID in EFI_GUID layout.
+ */
+typedef struct ast_guid {
+    uint8_t b[16];
+} ast_guid;
+
+/**
+ * Initializer of an ast_guid from its textual fields, e.g.
+ * AST_GUID_INIT (0x8be4df61, 0x93ca, 0x11d2, 0xaa, 0x0d, 0x00, 0xe0, 0x98, 0x03, 0x2b, 0x8c).
+ */
+#define AST_GUID_INIT(d1, d2, d3, b0, b1, b2, b3, b4, b5, b6, b7) { {                   \
+    (uint8_t) ((d1) & 0xff), (uint8_t) (((d1) >> 8) & 0xff),                              \
+    (uint8_t) (((d1) >> 16) & 0xff), (uint8_t) (((d1) >> 24) & 0xff),                     \
+    (uint8_t) ((d2) & 0xff), (uint8_t) (((d2) >> 8) & 0xff),                              \
+    (uint8_t) ((d3) & 0xff), (uint8_t) (((d3) >> 8) & 0xff),                              \
+    (b0), (b1), (b2), (b3), (b4), (b5), (b6), (b7) } }
+
+/**
+ * @defgroup WellKnownGuids Well-known GUIDs
+ * @{
+ */
+/** All zeros. */
+#define AST_GUID_ZERO                      AST_GUID_INIT (0x00000000, 0x0000, 0x0000, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00)
+/** EFI_GLOBAL_VARIABLE: Boot####, BootOrder, SecureBoot, PK, KEK... */
+#define AST_GUID_EFI_GLOBAL                AST_GUID_INIT (0x8be4df61, 0x93ca, 0x11d2, 0xaa, 0x0d, 0x00, 0xe0, 0x98, 0x03, 0x2b, 0x8c)
+/** EFI_IMAGE_SECURITY_DATABASE_GUID: db, dbx, dbt. */
+#define AST_GUID_IMAGE_SECURITY_DATABASE   AST_GUID_INIT (0xd719b2cb, 0x3d3a, 0x4596, 0xa3, 0xbc, 0xda, 0xd0, 0x0e, 0x67, 0x65, 0x6f)
+/** SHIM_LOCK_GUID: MokList, MokListX, SbatLevel. */
+#define AST_GUID_SHIM_LOCK                 AST_GUID_INIT (0x605dab50, 0xe046, 0x4300, 0xab, 0xb6, 0x3d, 0xd8, 0x10, 0xdd, 0x8b, 0x23)
+/** EFI_CERT_SHA256_GUID: signature list of SHA-256 hashes. */
+#define AST_GUID_CERT_SHA256               AST_GUID_INIT (0xc1c41626, 0x504c, 0x4092, 0xac, 0xa9, 0x41, 0xf9, 0x36, 0x93, 0x43, 0x28)
+/** EFI_CERT_SHA1_GUID: signature list of SHA-1 hashes. */
+#define AST_GUID_CERT_SHA1                 AST_GUID_INIT (0x826ca512, 0xcf10, 0x4ac9, 0xb1, 0x87, 0xbe, 0x01, 0x49, 0x66, 0x31, 0xbd)
+/** EFI_CERT_X509_GUID: signature list of DER certificates. */
+#define AST_GUID_CERT_X509                 AST_GUID_INIT (0xa5c059a1, 0x94e4, 0x4aa7, 0x87, 0xb5, 0xab, 0x15, 0x5c, 0x2b, 0xf0, 0x72)
+/** EFI_CERT_TYPE_PKCS7_GUID: authenticated variable payload. */
+#define AST_GUID_CERT_TYPE_PKCS7           AST_GUID_INIT (0x4aafd29d, 0x68df, 0x49ee, 0x8a, 0xa9, 0x34, 0x7d, 0x37, 0x56, 0x65, 0xa7)
+/** EFI partition type of the EFI System Partition. */
+#define AST_GUID_PARTITION_ESP             AST_GUID_INIT (0xc12a7328, 0xf81f, 0x11d2, 0xba, 0x4b, 0x00, 0xa0, 0xc9, 0x3e, 0xc9, 0x3b)
+/** @} */
+
+/**
+ * Parse "xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx", optionally in braces. Hex digits may be in either case.
+ *
+ * The string is validated in the same pass: anything but exactly that form is rejected.
+ *
+ * @param str  [in]  NUL terminated string.
+ * @param guid [out] Parsed GUID.
+ * @return AST_RETURN_SUCCESS, or AST_RETURN_INVALID_PARAMETER.
+ */
+int ast_guid_parse (const char *str, ast_guid *guid);
+
+/**
+ * Parse exactly AST_GUID_STRLEN characters, without braces. str need not be NUL terminated.
+ *
+ * @param str  [in]  AST_GUID_STRLEN characters.
+ * @param guid [out] Parsed GUID.
+ * @return AST_RETURN_SUCCESS, or AST_RETURN_INVALID_PARAMETER.
+ */
+int ast_guid_parse_n (const char *str, ast_guid *guid);
+
+/**
+ * Format a GUID as "xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx" in lower case, as efivarfs names it.
+ *
+ * @param guid [in]  GUID.
+ * @param str  [out] AST_GUID_STRLEN + 1 bytes; NUL terminated.
+ */
+void ast_guid_format (const ast_guid *guid, char *str);
+
+/**
+ * Format a GUID as "{xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx}", as the Win32 API wants it.
+ *
+ * @param guid [in]  GUID.
+ * @param str  [out] AST_GUID_STRLEN + 3 bytes; NUL terminated.
+ */
+void ast_guid_format_braced (const ast_guid *guid, char *str);
+
+/**
+ * Compare two GUIDs.
+ *
+ * @return Nonzero if a and b are the same GUID.
+ */
+int ast_guid_equal (const ast_guid *a, const ast_guid *b);
+
+#endif /* end of include guard: _AST_GUID_H */
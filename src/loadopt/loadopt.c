@@ -0,0 +1,153 @@
+/**
+ * @file loadopt.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements loadopt.h.
+ *
+ * All multi-byte fields are little endian and unaligned, so they are assembled byte by byte.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "loadopt.h"
+#include "../firmware/firmware.h"
+#include "../unicode/unicode.h"
+
+
+
+
+
+size_t ast_load_option_size (const struct ast_load_option *option)
+{
+    size_t units = ast_utf16_units (option->description);
+
+    if (units == SIZE_MAX) {
+        return 0;
+    }
+    return AST_LOAD_OPTION_HEADER_SIZE + (units + 1) * 2 + option->filePathListLength + option->optionalDataLength;
+}
+
+
+
+
+
+int ast_load_option_encode (const struct ast_load_option *option, void *buf, size_t bufSiz, size_t *nBytes)
+{
+    uint8_t *p = buf;
+    size_t  size = 0;
+
+    if (option == NULL) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    if (((option->filePathList == NULL) && (option->filePathListLength != 0))
+        || ((option->optionalData == NULL) && (option->optionalDataLength != 0))) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    size = ast_load_option_size (option);
+    if (size == 0) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    if (nBytes != NULL) {
+        *nBytes = size;
+    }
+    if ((buf == NULL) || (size > bufSiz)) {
+        return AST_RETURN_BUFFER_TOO_SMALL;
+    }
+
+    p[0] = (uint8_t) option->attributes;
+    p[1] = (uint8_t) (option->attributes >> 8);
+    p[2] = (uint8_t) (option->attributes >> 16);
+    p[3] = (uint8_t) (option->attributes >> 24);
+    p[4] = (uint8_t) option->filePathListLength;
+    p[5] = (uint8_t) (option->filePathListLength >> 8);
+    p += AST_LOAD_OPTION_HEADER_SIZE;
+
+    p += ast_utf16_encode (p, option->description);
+    *p++ = 0;
+    *p++ = 0;
+
+    if (option->filePathListLength != 0) {
+        memcpy (p, option->filePathList, option->filePathListLength);
+        p += option->filePathListLength;
+    }
+    if (option->optionalDataLength != 0) {
+        memcpy (p, option->optionalData, option->optionalDataLength);
+    }
+
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+int ast_load_option_encode_alloc (const struct ast_load_option *option, void **buf, size_t *nBytes)
+{
+    size_t size = 0;
+    int ret = AST_RETURN_SUCCESS;
+
+    if ((option == NULL) || (buf == NULL) || (nBytes == NULL)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    size = ast_load_option_size (option);
+    if (size == 0) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    *buf = malloc (size);
+    if (*buf == NULL) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+
+    ret = ast_load_option_encode (option, *buf, size, nBytes);
+    if (ret != AST_RETURN_SUCCESS) {
+        free (*buf);
+        *buf = NULL;
+    }
+    return ret;
+}
+
+
+
+
+
+int ast_load_option_parse (const void *data, size_t size, struct ast_load_option_view *view)
+{
+    const uint8_t *p = data;
+    size_t filePathListLength = 0;
+    size_t i = AST_LOAD_OPTION_HEADER_SIZE;
+
+    if ((data == NULL) || (view == NULL) || (size < AST_LOAD_OPTION_HEADER_SIZE + 2)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    view->attributes   = (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+    filePathListLength = (size_t) p[4] | ((size_t) p[5] << 8);
+
+    // The description ends at the first CHAR16 NUL.
+    for (; i + 1 < size; i += 2) {
+        if ((p[i] | p[i + 1]) == 0) {
+            break;
+        }
+    }
+    if (i + 1 >= size) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    view->descriptionOffset = AST_LOAD_OPTION_HEADER_SIZE;
+    view->descriptionLength = i - AST_LOAD_OPTION_HEADER_SIZE;
+
+    view->filePathListOffset = i + 2;
+    view->filePathListLength = filePathListLength;
+    if (filePathListLength > size - view->filePathListOffset) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    view->optionalDataOffset = view->filePathListOffset + filePathListLength;
+    view->optionalDataLength = size - view->optionalDataOffset;
+    return AST_RETURN_SUCCESS;
+}
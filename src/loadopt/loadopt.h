@@ -0,0 +1,109 @@
+/**
+ * @file loadopt.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares the EFI_LOAD_OPTION encoder and parser.
+ *
+ * An EFI_LOAD_OPTION (UEFI specification 2.6: 3.1.3 Load Options) is a packed, unaligned byte buffer:
+ *
+ *     UINT32   Attributes
+ *     UINT16   FilePathListLength
+ *     CHAR16   Description[]       NUL terminated
+ *     UINT8    FilePathList[]      FilePathListLength bytes of device paths
+ *     UINT8    OptionalData[]      the rest of the variable
+ *
+ * It cannot be described by a C structure with pointers. The encoder computes the exact length first and
+ * writes everything in one pass; the parser returns offsets into the raw bytes and copies nothing.
+ */
+
+#ifndef _AST_LOADOPT_H
+#define _AST_LOADOPT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @defgroup LoadOptionAttributes Load option attributes
+ * @{
+ */
+#define AST_LOAD_OPTION_ACTIVE          0x00000001
+#define AST_LOAD_OPTION_FORCE_RECONNECT 0x00000002
+#define AST_LOAD_OPTION_HIDDEN          0x00000008
+#define AST_LOAD_OPTION_CATEGORY        0x00001F00
+#define AST_LOAD_OPTION_CATEGORY_BOOT   0x00000000
+#define AST_LOAD_OPTION_CATEGORY_APP    0x00000100
+/** @} */
+
+/**
+ * Size of the fixed header: Attributes and FilePathListLength.
+ */
+#define AST_LOAD_OPTION_HEADER_SIZE 6
+
+/**
+ * Fields of a load option to encode. Nothing is copied until ast_load_option_encode.
+ */
+struct ast_load_option {
+    uint32_t   attributes;         /**< AST_LOAD_OPTION_* bits. */
+    const char *description;       /**< Description in UTF-8; stored as UTF-16. NULL means empty. */
+    const void *filePathList;      /**< Packed device paths, ending with an End Entire node. */
+    uint16_t   filePathListLength; /**< Size of filePathList in bytes. */
+    const void *optionalData;      /**< Optional data, or NULL. */
+    size_t     optionalDataLength; /**< Size of optionalData in bytes. */
+};
+
+/**
+ * Where each field of an encoded load option is. Offsets are relative to the start of the variable.
+ */
+struct ast_load_option_view {
+    uint32_t attributes;          /**< Attributes. */
+    size_t   descriptionOffset;   /**< Offset of the UTF-16 description. */
+    size_t   descriptionLength;   /**< Length of the description in bytes, without the terminating NUL. */
+    size_t   filePathListOffset;  /**< Offset of the device path list. */
+    size_t   filePathListLength;  /**< Length of the device path list in bytes. */
+    size_t   optionalDataOffset;  /**< Offset of the optional data. */
+    size_t   optionalDataLength;  /**< Length of the optional data in bytes (0 if none). */
+};
+
+/**
+ * Compute the encoded size of a load option.
+ *
+ * @param option [in] Load option.
+ * @return Size in bytes, or 0 if the description is not valid UTF-8.
+ */
+size_t ast_load_option_size (const struct ast_load_option *option);
+
+/**
+ * Encode a load option into a caller-supplied buffer.
+ *
+ * @param option [in]  Load option.
+ * @param buf    [out] Buffer for the encoded bytes.
+ * @param bufSiz [in]  Size of the buffer.
+ * @param nBytes [out] Encoded size, also set on AST_RETURN_BUFFER_TOO_SMALL. May be NULL.
+ * @return AST_RETURN_SUCCESS if operation succeeded, or another AST_RETURN code.
+ */
+int ast_load_option_encode (const struct ast_load_option *option, void *buf, size_t bufSiz, size_t *nBytes);
+
+/**
+ * Encode a load option into a buffer of exactly the right size, allocated with malloc.
+ *
+ * @param option [in]  Load option.
+ * @param buf    [out] Encoded bytes; free with free.
+ * @param nBytes [out] Encoded size.
+ * @return AST_RETURN_SUCCESS if operation succeeded, or another AST_RETURN code.
+ */
+int ast_load_option_encode_alloc (const struct ast_load_option *option, void **buf, size_t *nBytes);
+
+/**
+ * Locate the fields of an encoded load option without copying.
+ *
+ * @param data [in]  Raw variable bytes.
+ * @param size [in]  Size of data.
+ * @param view [out] Field offsets and lengths.
+ * @return AST_RETURN_SUCCESS, or AST_RETURN_INVALID_PARAMETER if data is not a well formed load option.
+ */
+int ast_load_option_parse (const void *data, size_t size, struct ast_load_option_view *view);
+
+#endif /* end of include guard: _AST_LOADOPT_H */
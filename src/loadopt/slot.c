@@ -0,0 +1,286 @@
+/**
+ * @file slot.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements slot.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "slot.h"
+#include "../firmware/firmware.h"
+
+#define AST_SLOT_SCAN_CHUNK 32
+
+static const ast_guid _ast_slot_global = AST_GUID_EFI_GLOBAL;
+
+static const char *const _ast_slot_prefix[AST_LOAD_OPTION_CLASS_COUNT] = {
+    "Boot",
+    "Driver",
+    "SysPrep"
+};
+
+static void _ast_slot_set (struct ast_slot_map *map, enum AST_LOAD_OPTION_CLASS cls, uint16_t slot);
+static void _ast_slot_clear (struct ast_slot_map *map, enum AST_LOAD_OPTION_CLASS cls, uint16_t slot);
+static int  _ast_slot_find (const struct ast_slot_map *map, enum AST_LOAD_OPTION_CLASS cls, uint16_t first, uint16_t *slot);
+
+
+
+
+
+struct ast_slot_map *ast_slot_map_new (void)
+{
+    struct ast_slot_map *map = calloc (1, sizeof (struct ast_slot_map));
+
+    if (map != NULL) {
+        ast_mutex_init (&(map->lock));
+    }
+    return map;
+}
+
+
+
+
+
+void ast_slot_map_free (struct ast_slot_map *map)
+{
+    if (map == NULL) {
+        return;
+    }
+    ast_mutex_destroy (&(map->lock));
+    free (map);
+}
+
+
+
+
+
+int ast_slot_map_scan (struct ast_slot_map *map)
+{
+    struct ast_efivar_iter *iter = NULL;
+    struct ast_efivar_info infos[AST_SLOT_SCAN_CHUNK];
+    size_t n = 0;
+    int ret = AST_RETURN_SUCCESS;
+
+    if (map == NULL) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    // Sizes and attributes are not needed: only names are looked at.
+    ret = ast_efivar_iter_open (&iter, 0);
+    if (ret != AST_RETURN_SUCCESS) {
+        return ret;
+    }
+    while (((ret = ast_efivar_iter_next (iter, infos, AST_SLOT_SCAN_CHUNK, &n)) == AST_RETURN_SUCCESS) && (n != 0)) {
+        for (size_t i = 0; i < n; i++) {
+            ast_slot_map_add (map, &(infos[i].guid), infos[i].name);
+        }
+    }
+    ast_efivar_iter_close (iter);
+
+    return ret;
+}
+
+
+
+
+
+int ast_slot_map_add (struct ast_slot_map *map, const ast_guid *guid, const char *name)
+{
+    enum AST_LOAD_OPTION_CLASS cls;
+    uint16_t slot = 0;
+
+    if ((guid == NULL) || !ast_guid_equal (guid, &_ast_slot_global)) {
+        return 0;
+    }
+    if ((name == NULL) || (ast_slot_parse_name (name, &cls, &slot) != AST_RETURN_SUCCESS)) {
+        return 0;
+    }
+
+    ast_mutex_lock (&(map->lock));
+    _ast_slot_set (map, cls, slot);
+    ast_mutex_unlock (&(map->lock));
+    return 1;
+}
+
+
+
+
+
+int ast_slot_map_is_taken (struct ast_slot_map *map, enum AST_LOAD_OPTION_CLASS cls, uint16_t slot)
+{
+    int ret = 0;
+
+    if ((unsigned int) cls >= AST_LOAD_OPTION_CLASS_COUNT) {
+        return 0;
+    }
+
+    ast_mutex_lock (&(map->lock));
+    ret = (map->taken[cls][slot >> 6] >> (slot & 63)) & 1;
+    ast_mutex_unlock (&(map->lock));
+    return ret;
+}
+
+
+
+
+
+int ast_slot_map_reserve (struct ast_slot_map *map, enum AST_LOAD_OPTION_CLASS cls, uint16_t first, uint16_t *slot)
+{
+    int ret = AST_RETURN_SUCCESS;
+
+    if ((map == NULL) || (slot == NULL) || ((unsigned int) cls >= AST_LOAD_OPTION_CLASS_COUNT)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    ast_mutex_lock (&(map->lock));
+    ret = _ast_slot_find (map, cls, first, slot);
+    if (ret == AST_RETURN_SUCCESS) {
+        _ast_slot_set (map, cls, *slot);
+        map->reserved[cls][*slot >> 6] |= UINT64_C (1) << (*slot & 63);
+    }
+    ast_mutex_unlock (&(map->lock));
+
+    return ret;
+}
+
+
+
+
+
+int ast_slot_map_release (struct ast_slot_map *map, enum AST_LOAD_OPTION_CLASS cls, uint16_t slot)
+{
+    uint64_t bit = UINT64_C (1) << (slot & 63);
+    int ret = AST_RETURN_INVALID_PARAMETER;
+
+    if ((map == NULL) || ((unsigned int) cls >= AST_LOAD_OPTION_CLASS_COUNT)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    ast_mutex_lock (&(map->lock));
+    if (map->reserved[cls][slot >> 6] & bit) {
+        map->reserved[cls][slot >> 6] &= ~bit;
+        _ast_slot_clear (map, cls, slot);
+        ret = AST_RETURN_SUCCESS;
+    }
+    ast_mutex_unlock (&(map->lock));
+
+    return ret;
+}
+
+
+
+
+
+int ast_slot_name (enum AST_LOAD_OPTION_CLASS cls, uint16_t slot, char *name, size_t nameSiz)
+{
+    int len = 0;
+
+    if (((unsigned int) cls >= AST_LOAD_OPTION_CLASS_COUNT) || (name == NULL)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    len = snprintf (name, nameSiz, "%s%04X", _ast_slot_prefix[cls], (unsigned int) slot);
+    if ((len < 0) || ((size_t) len >= nameSiz)) {
+        return AST_RETURN_BUFFER_TOO_SMALL;
+    }
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+int ast_slot_parse_name (const char *name, enum AST_LOAD_OPTION_CLASS *cls, uint16_t *slot)
+{
+    // "<prefix>XXXX" with exactly four upper case hex digits, as the UEFI specification requires.
+    for (int c = 0; c < AST_LOAD_OPTION_CLASS_COUNT; c++) {
+        size_t   len = strlen (_ast_slot_prefix[c]);
+        uint16_t value = 0;
+
+        if (strncmp (name, _ast_slot_prefix[c], len) != 0) {
+            continue;
+        }
+        for (size_t i = 0; i < 4; i++) {
+            char ch = name[len + i];
+            if ((ch >= '0') && (ch <= '9')) {
+                value = (uint16_t) ((value << 4) | (uint16_t) (ch - '0'));
+            } else if ((ch >= 'A') && (ch <= 'F')) {
+                value = (uint16_t) ((value << 4) | (uint16_t) (ch - 'A' + 10));
+            } else {
+                return AST_RETURN_INVALID_PARAMETER;
+            }
+        }
+        if (name[len + 4] != '\0') {
+            return AST_RETURN_INVALID_PARAMETER;
+        }
+
+        *cls  = (enum AST_LOAD_OPTION_CLASS) c;
+        *slot = value;
+        return AST_RETURN_SUCCESS;
+    }
+
+    return AST_RETURN_INVALID_PARAMETER;
+}
+
+
+
+
+
+static void _ast_slot_set (struct ast_slot_map *map, enum AST_LOAD_OPTION_CLASS cls, uint16_t slot)
+{
+    size_t w = slot >> 6;
+
+    map->taken[cls][w] |= UINT64_C (1) << (slot & 63);
+    if (map->taken[cls][w] == UINT64_MAX) {
+        map->full[cls][w >> 6] |= UINT64_C (1) << (w & 63);
+    }
+}
+
+
+
+
+
+static void _ast_slot_clear (struct ast_slot_map *map, enum AST_LOAD_OPTION_CLASS cls, uint16_t slot)
+{
+    size_t w = slot >> 6;
+
+    map->taken[cls][w] &= ~(UINT64_C (1) << (slot & 63));
+    map->full[cls][w >> 6] &= ~(UINT64_C (1) << (w & 63));
+}
+
+
+
+
+
+static int _ast_slot_find (const struct ast_slot_map *map, enum AST_LOAD_OPTION_CLASS cls, uint16_t first, uint16_t *slot)
+{
+    const uint64_t *taken = map->taken[cls];
+    const uint64_t *full  = map->full[cls];
+    size_t   w    = first >> 6;
+    uint64_t free = ~taken[w] & (UINT64_MAX << (first & 63));
+
+    // The word holding first, then the summary: one bit per word, set when that word is full.
+    if (free != 0) {
+        *slot = (uint16_t) ((w << 6) + (size_t) __builtin_ctzll (free));
+        return AST_RETURN_SUCCESS;
+    }
+
+    for (size_t s = (w + 1) >> 6; s < AST_SLOT_WORDS / 64; s++) {
+        uint64_t notFull = ~full[s];
+        if (s == ((w + 1) >> 6)) {
+            notFull &= UINT64_MAX << ((w + 1) & 63);
+        }
+        if (notFull != 0) {
+            size_t fw = (s << 6) + (size_t) __builtin_ctzll (notFull);
+            *slot = (uint16_t) ((fw << 6) + (size_t) __builtin_ctzll (~taken[fw]));
+            return AST_RETURN_SUCCESS;
+        }
+    }
+
+    return AST_RETURN_NOT_FOUND;
+}
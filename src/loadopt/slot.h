@@ -0,0 +1,142 @@
+/**
+ * @file slot.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares the load option slot allocator.
+ *
+ * Load options live in `Boot####`, `Driver####` and `SysPrep####` variables, where `####` is one of 65536
+ * numbers. A slot map holds one occupancy bit per number and class, filled from a single enumeration of
+ * the variable store. Finding a free number is then a scan over 64-bit words (at most 16 summary words
+ * plus one slot word) instead of a firmware call per candidate. Numbers handed out are reserved until
+ * released, so one session never hands the same number out twice.
+ */
+
+#ifndef _AST_SLOT_H
+#define _AST_SLOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../guid/guid.h"
+#include "../thread/thread.h"
+
+/**
+ * Number of slots per load option class.
+ */
+#define AST_SLOT_COUNT 65536
+
+/**
+ * Number of 64-bit words of a per-class bitmap.
+ */
+#define AST_SLOT_WORDS (AST_SLOT_COUNT / 64)
+
+/**
+ * Load option classes.
+ */
+enum AST_LOAD_OPTION_CLASS {
+    AST_LOAD_OPTION_BOOT    = 0, /**< Boot#### */
+    AST_LOAD_OPTION_DRIVER  = 1, /**< Driver#### */
+    AST_LOAD_OPTION_SYSPREP = 2, /**< SysPrep#### */
+    AST_LOAD_OPTION_CLASS_COUNT
+};
+
+/**
+ * Occupancy of every load option slot.
+ *
+ * A bit is set in taken when the variable exists or the slot is reserved; full has one bit per word of
+ * taken, set when that word has no free slot left. Create it with ast_slot_map_new.
+ */
+struct ast_slot_map {
+    ast_mutex lock;                                                /**< Guards everything below. */
+    uint64_t  taken[AST_LOAD_OPTION_CLASS_COUNT][AST_SLOT_WORDS];    /**< Existing or reserved slots. */
+    uint64_t  reserved[AST_LOAD_OPTION_CLASS_COUNT][AST_SLOT_WORDS]; /**< Slots reserved by this session. */
+    uint64_t  full[AST_LOAD_OPTION_CLASS_COUNT][AST_SLOT_WORDS / 64]; /**< Words of taken with no free bit. */
+};
+
+/**
+ * Create an empty slot map.
+ *
+ * @return The map, or NULL on allocation failure.
+ */
+struct ast_slot_map *ast_slot_map_new (void);
+
+/**
+ * Destroy a slot map.
+ *
+ * @param map [in] Map to destroy. May be NULL.
+ */
+void ast_slot_map_free (struct ast_slot_map *map);
+
+/**
+ * Mark every load option present in the variable store as taken, with one enumeration pass.
+ *
+ * @param map [in] Map to fill.
+ * @return AST_RETURN_SUCCESS if operation succeeded, or another AST_RETURN code.
+ */
+int ast_slot_map_scan (struct ast_slot_map *map);
+
+/**
+ * Mark a variable as taken if its name is a load option (e.g. "Boot0003") of the EFI global namespace.
+ *
+ * @param map  [in] Map to update.
+ * @param guid [in] GUID namespace of the variable.
+ * @param name [in] Name of the variable.
+ * @return 1 if the variable is a load option, 0 otherwise.
+ */
+int ast_slot_map_add (struct ast_slot_map *map, const ast_guid *guid, const char *name);
+
+/**
+ * Tell whether a slot is taken.
+ *
+ * @param map  [in] Map.
+ * @param cls  [in] Load option class.
+ * @param slot [in] Slot number.
+ * @return Nonzero if the slot exists or is reserved.
+ */
+int ast_slot_map_is_taken (struct ast_slot_map *map, enum AST_LOAD_OPTION_CLASS cls, uint16_t slot);
+
+/**
+ * Reserve the lowest free slot not below first.
+ *
+ * @param map   [in]  Map.
+ * @param cls   [in]  Load option class.
+ * @param first [in]  Lowest acceptable slot number.
+ * @param slot  [out] Reserved slot number.
+ * @return AST_RETURN_SUCCESS, or AST_RETURN_NOT_FOUND if every slot from first on is taken.
+ */
+int ast_slot_map_reserve (struct ast_slot_map *map, enum AST_LOAD_OPTION_CLASS cls, uint16_t first, uint16_t *slot);
+
+/**
+ * Give back a slot reserved with ast_slot_map_reserve, e.g. when writing the option failed.
+ *
+ * @param map  [in] Map.
+ * @param cls  [in] Load option class.
+ * @param slot [in] Slot number.
+ * @return AST_RETURN_SUCCESS, or AST_RETURN_INVALID_PARAMETER if the slot was not reserved.
+ */
+int ast_slot_map_release (struct ast_slot_map *map, enum AST_LOAD_OPTION_CLASS cls, uint16_t slot);
+
+/**
+ * Format the variable name of a slot, e.g. "Boot0003".
+ *
+ * @param cls     [in]  Load option class.
+ * @param slot    [in]  Slot number.
+ * @param name    [out] Buffer for the name.
+ * @param nameSiz [in]  Size of the buffer; 12 bytes fit every class.
+ * @return AST_RETURN_SUCCESS, or AST_RETURN_BUFFER_TOO_SMALL.
+ */
+int ast_slot_name (enum AST_LOAD_OPTION_CLASS cls, uint16_t slot, char *name, size_t nameSiz);
+
+/**
+ * Parse the variable name of a slot, e.g. "Boot0003". The four hex digits must be upper case.
+ *
+ * @param name [in]  Variable name.
+ * @param cls  [out] Load option class.
+ * @param slot [out] Slot number.
+ * @return AST_RETURN_SUCCESS, or AST_RETURN_INVALID_PARAMETER if name is not a load option name.
+ */
+int ast_slot_parse_name (const char *name, enum AST_LOAD_OPTION_CLASS *cls, uint16_t *slot);
+
+#endif /* end of include guard: _AST_SLOT_H */
@@ -0,0 +1,629 @@
+/**
+ * @file fleet.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements fleet.h.
+ *
+ * Each machine gets its own backend (efivarfs or snapshot), called through its function table directly:
+ * the library's current backend is process-wide and cannot differ between workers. Values are read into
+ * space reserved on the worker's arena and never committed, so the same space is reused for every read;
+ * only the report keys are allocated.
+ */
+
+#ifndef _WIN32
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "fleet.h"
+#include "../arena/arena.h"
+#include "../devpath/devpath.h"
+#include "../firmware/firmware.h"
+#include "../firmware/backend.h"
+#include "../loadopt/loadopt.h"
+#include "../loadopt/slot.h"
+#include "../sigdb/sigdb.h"
+#include "../snapshot/snapshot.h"
+#include "../thread/pool.h"
+#include "../unicode/unicode.h"
+#include "../util/hash.h"
+
+/** Rows printed per table. */
+#define AST_FLEET_TOP 20
+
+/** Longest report key kept, in bytes including the terminating NUL. */
+#define AST_FLEET_KEY_MAX 512
+
+enum _AST_FLEET_SB {
+    _AST_FLEET_SB_ENABLED = 0,
+    _AST_FLEET_SB_DISABLED,
+    _AST_FLEET_SB_SETUP,
+    _AST_FLEET_SB_UNSUPPORTED,
+    _AST_FLEET_SB_COUNT
+};
+
+enum _AST_FLEET_ANOMALY {
+    _AST_FLEET_UNREADABLE = 0,
+    _AST_FLEET_BAD_LOAD_OPTION,
+    _AST_FLEET_BAD_BOOT_ORDER,
+    _AST_FLEET_DANGLING_BOOT_ORDER,
+    _AST_FLEET_BAD_SIGNATURE_LIST,
+    _AST_FLEET_READ_ERROR,
+    _AST_FLEET_ANOMALY_COUNT
+};
+
+static const char *const _ast_fleet_sb_names[_AST_FLEET_SB_COUNT] = {
+    "enabled", "disabled", "setup mode", "not supported"
+};
+
+static const char *const _ast_fleet_anomaly_names[_AST_FLEET_ANOMALY_COUNT] = {
+    "unreadable dump",
+    "malformed load option",
+    "malformed BootOrder",
+    "BootOrder entry without Boot####",
+    "malformed signature list",
+    "variable read error"
+};
+
+/**
+ * One row of a report table.
+ */
+struct _ast_fleet_count {
+    const char *key;
+    uint64_t   hash;
+    size_t     count;
+};
+
+/**
+ * Open-addressed table of rows, allocated on an arena.
+ */
+struct _ast_fleet_table {
+    struct _ast_fleet_count *slots;
+    size_t                  cap;
+    size_t                  n;
+};
+
+/**
+ * Everything one worker tallies. Workers are allocated separately so that they share no cache line.
+ */
+struct _ast_fleet_worker {
+    struct ast_arena        arena;
+    size_t                  machines;
+    size_t                  secureBoot[_AST_FLEET_SB_COUNT];
+    size_t                  anomalies[_AST_FLEET_ANOMALY_COUNT];
+    const char              *examples[_AST_FLEET_ANOMALY_COUNT];
+    struct _ast_fleet_table paths;
+    struct _ast_fleet_table dbx;
+    uint64_t                bootSeen[AST_SLOT_WORDS];
+};
+
+struct _ast_fleet {
+    char                     **paths;
+    const char               **names;
+    struct _ast_fleet_worker **workers;
+};
+
+static const ast_guid _ast_fleet_global   = AST_GUID_EFI_GLOBAL;
+static const ast_guid _ast_fleet_security = AST_GUID_IMAGE_SECURITY_DATABASE;
+
+static void _ast_fleet_task (void *arg, size_t item, unsigned int worker);
+static struct ast_efivar_backend *_ast_fleet_open (const char *path);
+static int  _ast_fleet_read (struct _ast_fleet_worker *w, struct ast_efivar_backend *backend, const ast_guid *guid, const char *name,
+                             const uint8_t **data, size_t *size);
+static void _ast_fleet_load_option (struct _ast_fleet_worker *w, const uint8_t *data, size_t size, int isBoot, unsigned int *anomalies);
+static void _ast_fleet_secure_boot (struct _ast_fleet_worker *w, struct ast_efivar_backend *backend, unsigned int *anomalies);
+static void _ast_fleet_boot_order (struct _ast_fleet_worker *w, struct ast_efivar_backend *backend, unsigned int *anomalies);
+static int  _ast_fleet_count (struct ast_arena *arena, struct _ast_fleet_table *table, const char *key, size_t n);
+static void _ast_fleet_print_table (FILE *out, const char *title, const char *unit, const struct _ast_fleet_table *table);
+static int  _ast_fleet_row_cmp (const void *a, const void *b);
+static int  _ast_fleet_name_cmp (const void *a, const void *b);
+
+
+
+
+
+int ast_fleet_run (const char *dir, unsigned int nThreads, FILE *out)
+{
+    struct _ast_fleet fleet = {NULL, NULL, NULL};
+    struct _ast_fleet_worker *total = NULL;
+    struct ast_arena arena;
+    struct timespec start, end;
+    struct dirent *ent = NULL;
+    size_t nMachines = 0, cap = 0;
+    double seconds = 0;
+    DIR *d = opendir (dir);
+    int ret = AST_RETURN_SUCCESS;
+
+    if (d == NULL) {
+        fprintf (stderr, " ** Cannot open fleet directory %s.\n", dir);
+        return AST_RETURN_NOT_FOUND;
+    }
+
+    // Every entry is a machine; sorted so that examples do not depend on the directory order.
+    ast_arena_init (&arena, 0);
+    while ((ent = readdir (d)) != NULL) {
+        size_t len = strlen (dir) + strlen (ent->d_name) + 2;
+        char   *path = NULL;
+
+        if (ent->d_name[0] == '.') {
+            continue;
+        }
+        if (nMachines == cap) {
+            char **p = realloc (fleet.paths, (cap ? 2 * cap : 256) * sizeof (char *));
+            if (p == NULL) {
+                ret = AST_RETURN_OPERATION_FAILED;
+                break;
+            }
+            fleet.paths = p;
+            cap = cap ? 2 * cap : 256;
+        }
+        path = ast_arena_alloc (&arena, len);
+        if (path == NULL) {
+            ret = AST_RETURN_OPERATION_FAILED;
+            break;
+        }
+        snprintf (path, len, "%s/%s", dir, ent->d_name);
+        fleet.paths[nMachines++] = path;
+    }
+    closedir (d);
+    if (ret != AST_RETURN_SUCCESS) {
+        goto out;
+    }
+    if (nMachines != 0) {
+        qsort (fleet.paths, nMachines, sizeof (char *), _ast_fleet_name_cmp);
+    }
+
+    if (nThreads == 0) {
+        nThreads = ast_pool_cpu_count ();
+    }
+    if (nThreads > AST_POOL_MAX_WORKERS) {
+        nThreads = AST_POOL_MAX_WORKERS;
+    }
+    fleet.names   = calloc (nMachines + 1, sizeof (char *));
+    fleet.workers = calloc (nThreads, sizeof (struct _ast_fleet_worker *));
+    total         = calloc (1, sizeof (struct _ast_fleet_worker));
+    if ((fleet.names == NULL) || (fleet.workers == NULL) || (total == NULL)) {
+        ret = AST_RETURN_OPERATION_FAILED;
+        goto out;
+    }
+    for (size_t i = 0; i < nMachines; i++) {
+        fleet.names[i] = fleet.paths[i] + strlen (dir) + 1;
+    }
+    for (unsigned int w = 0; w < nThreads; w++) {
+        fleet.workers[w] = calloc (1, sizeof (struct _ast_fleet_worker));
+        if (fleet.workers[w] == NULL) {
+            ret = AST_RETURN_OPERATION_FAILED;
+            goto out;
+        }
+        ast_arena_init (&(fleet.workers[w]->arena), 0);
+    }
+    ast_arena_init (&(total->arena), 0);
+
+    clock_gettime (CLOCK_MONOTONIC, &start);
+    ast_pool_run (nMachines, nThreads, _ast_fleet_task, &fleet);
+    clock_gettime (CLOCK_MONOTONIC, &end);
+    seconds = (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    // The first machine by name is kept as the example of an anomaly, so the report does not depend on thread timing.
+    for (unsigned int w = 0; w < nThreads; w++) {
+        const struct _ast_fleet_worker *src = fleet.workers[w];
+
+        total->machines += src->machines;
+        for (int k = 0; k < _AST_FLEET_SB_COUNT; k++) {
+            total->secureBoot[k] += src->secureBoot[k];
+        }
+        for (int k = 0; k < _AST_FLEET_ANOMALY_COUNT; k++) {
+            total->anomalies[k] += src->anomalies[k];
+            if ((src->examples[k] != NULL) && ((total->examples[k] == NULL) || (strcmp (src->examples[k], total->examples[k]) < 0))) {
+                total->examples[k] = src->examples[k];
+            }
+        }
+        for (size_t s = 0; s < src->paths.cap; s++) {
+            if ((src->paths.slots[s].key != NULL) && (_ast_fleet_count (&(total->arena), &(total->paths), src->paths.slots[s].key, src->paths.slots[s].count) != AST_RETURN_SUCCESS)) {
+                ret = AST_RETURN_OPERATION_FAILED;
+            }
+        }
+        for (size_t s = 0; s < src->dbx.cap; s++) {
+            if ((src->dbx.slots[s].key != NULL) && (_ast_fleet_count (&(total->arena), &(total->dbx), src->dbx.slots[s].key, src->dbx.slots[s].count) != AST_RETURN_SUCCESS)) {
+                ret = AST_RETURN_OPERATION_FAILED;
+            }
+        }
+    }
+
+    fprintf (out, "Fleet report: %zu machines in %s, %.3f s on %u threads (%.0f machines/s)\n\n", nMachines, dir, seconds,
+             (nMachines < nThreads) ? (unsigned int) nMachines : nThreads, (seconds > 0) ? (double) nMachines / seconds : 0.0);
+    fprintf (out, "%-48s %10s\n", "Secure Boot", "machines");
+    for (int k = 0; k < _AST_FLEET_SB_COUNT; k++) {
+        fprintf (out, "  %-46s %10zu %5.1f%%\n", _ast_fleet_sb_names[k], total->secureBoot[k],
+                 total->machines ? 100.0 * (double) total->secureBoot[k] / (double) total->machines : 0.0);
+    }
+    _ast_fleet_print_table (out, "Boot entry paths", "entries", &(total->paths));
+    _ast_fleet_print_table (out, "dbx revisions", "machines", &(total->dbx));
+    fprintf (out, "\n%-48s %10s\n", "Anomalies", "machines");
+    for (int k = 0; k < _AST_FLEET_ANOMALY_COUNT; k++) {
+        fprintf (out, "  %-46s %10zu", _ast_fleet_anomaly_names[k], total->anomalies[k]);
+        if (total->examples[k] != NULL) {
+            fprintf (out, "  e.g. %s", total->examples[k]);
+        }
+        fputc ('\n', out);
+    }
+
+out:
+    if (fleet.workers != NULL) {
+        for (unsigned int w = 0; w < nThreads; w++) {
+            if (fleet.workers[w] != NULL) {
+                ast_arena_free (&(fleet.workers[w]->arena));
+                free (fleet.workers[w]);
+            }
+        }
+    }
+    if (total != NULL) {
+        ast_arena_free (&(total->arena));
+        free (total);
+    }
+    free (fleet.workers);
+    free (fleet.names);
+    free (fleet.paths);
+    ast_arena_free (&arena);
+    return ret;
+}
+
+
+
+
+
+static void _ast_fleet_task (void *arg, size_t item, unsigned int worker)
+{
+    struct _ast_fleet *fleet = arg;
+    struct _ast_fleet_worker *w = fleet->workers[worker];
+    struct ast_efivar_backend *backend = _ast_fleet_open (fleet->paths[item]);
+    struct ast_efivar_info infos[32];
+    unsigned int anomalies = 0;
+    int hasDbx = 0;
+    void *it = NULL;
+    size_t n = 0;
+    int ret = AST_RETURN_SUCCESS;
+
+    if ((backend == NULL) || (backend->iter_open (backend->ctx, 0, &it) != AST_RETURN_SUCCESS)) {
+        anomalies |= 1u << _AST_FLEET_UNREADABLE;
+        goto out;
+    }
+    w->machines++;
+    memset (w->bootSeen, 0, sizeof (w->bootSeen));
+
+    do {
+        ret = backend->iter_next (backend->ctx, it, infos, sizeof (infos) / sizeof (infos[0]), &n);
+        for (size_t i = 0; (ret == AST_RETURN_SUCCESS) && (i < n); i++) {
+            const struct ast_efivar_info *info = &(infos[i]);
+            enum AST_LOAD_OPTION_CLASS cls;
+            uint16_t slot = 0;
+            const uint8_t *data = NULL;
+            size_t size = 0;
+            int isGlobal = ast_guid_equal (&(info->guid), &_ast_fleet_global);
+            int isSecurity = ast_guid_equal (&(info->guid), &_ast_fleet_security);
+            int isLoadOption = isGlobal && (ast_slot_parse_name (info->name, &cls, &slot) == AST_RETURN_SUCCESS);
+            int isSignatureList = (isGlobal && ((strcmp (info->name, "PK") == 0) || (strcmp (info->name, "KEK") == 0))) ||
+                                  (isSecurity && ((strcmp (info->name, "db") == 0) || (strcmp (info->name, "dbx") == 0)));
+
+            if (!isLoadOption && !isSignatureList) {
+                continue;
+            }
+            if (info->data != NULL) {
+                data = info->data;
+                size = info->size;
+            } else if (_ast_fleet_read (w, backend, &(info->guid), info->name, &data, &size) != AST_RETURN_SUCCESS) {
+                anomalies |= 1u << _AST_FLEET_READ_ERROR;
+                continue;
+            }
+
+            if (isLoadOption) {
+                if (cls == AST_LOAD_OPTION_BOOT) {
+                    w->bootSeen[slot >> 6] |= 1ULL << (slot & 63);
+                }
+                _ast_fleet_load_option (w, data, size, cls == AST_LOAD_OPTION_BOOT, &anomalies);
+            } else {
+                size_t nSigs = 0;
+                int valid = ast_siglist_validate (data, size, &nSigs) == AST_RETURN_SUCCESS;
+
+                if (!valid) {
+                    anomalies |= 1u << _AST_FLEET_BAD_SIGNATURE_LIST;
+                }
+                if (isSecurity && (strcmp (info->name, "dbx") == 0)) {
+                    char key[64];
+
+                    // Formatted before counting: the count may allocate over data.
+                    if (!valid) {
+                        snprintf (key, sizeof (key), "malformed");
+                    } else {
+                        snprintf (key, sizeof (key), "%zu signatures, %016llx", nSigs, (unsigned long long) ast_fnv1a64 (AST_FNV1A64_INIT, data, size));
+                    }
+                    _ast_fleet_count (&(w->arena), &(w->dbx), key, 1);
+                    hasDbx = 1;
+                }
+            }
+        }
+    } while ((ret == AST_RETURN_SUCCESS) && (n != 0));
+    backend->iter_close (backend->ctx, it);
+    if (ret != AST_RETURN_SUCCESS) {
+        anomalies |= 1u << _AST_FLEET_READ_ERROR;
+    }
+
+    if (!hasDbx) {
+        _ast_fleet_count (&(w->arena), &(w->dbx), "absent", 1);
+    }
+    _ast_fleet_secure_boot (w, backend, &anomalies);
+    _ast_fleet_boot_order (w, backend, &anomalies);
+
+out:
+    for (int k = 0; k < _AST_FLEET_ANOMALY_COUNT; k++) {
+        if (anomalies & (1u << k)) {
+            w->anomalies[k]++;
+            if ((w->examples[k] == NULL) || (strcmp (fleet->names[item], w->examples[k]) < 0)) {
+                w->examples[k] = fleet->names[item];
+            }
+        }
+    }
+    ast_efivar_backend_free (backend);
+}
+
+
+
+
+
+static struct ast_efivar_backend *_ast_fleet_open (const char *path)
+{
+    struct stat st;
+    char efivars[4096];
+
+    if (stat (path, &st) != 0) {
+        return NULL;
+    }
+    if (!S_ISDIR (st.st_mode)) {
+        return ast_efivar_backend_snapshot_new (path);
+    }
+    // An extracted tarball of the root keeps efivarfs at its usual place.
+    snprintf (efivars, sizeof (efivars), "%s/sys/firmware/efi/efivars", path);
+    if ((stat (efivars, &st) == 0) && S_ISDIR (st.st_mode)) {
+        return ast_efivar_backend_efivarfs_new (efivars);
+    }
+    return ast_efivar_backend_efivarfs_new (path);
+}
+
+
+
+
+
+static int _ast_fleet_read (struct _ast_fleet_worker *w, struct ast_efivar_backend *backend, const ast_guid *guid, const char *name,
+                            const uint8_t **data, size_t *size)
+{
+    size_t avail = 0;
+    void *buf = ast_arena_reserve (&(w->arena), 4096, &avail);
+    int ret = AST_RETURN_SUCCESS;
+
+    if (buf == NULL) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+    ret = backend->read (backend->ctx, guid, name, buf, avail, size, NULL);
+    if (ret == AST_RETURN_BUFFER_TOO_SMALL) {
+        buf = ast_arena_reserve (&(w->arena), *size, &avail);
+        if (buf == NULL) {
+            return AST_RETURN_OPERATION_FAILED;
+        }
+        ret = backend->read (backend->ctx, guid, name, buf, avail, size, NULL);
+    }
+    *data = buf;
+    return ret;
+}
+
+
+
+
+
+static void _ast_fleet_load_option (struct _ast_fleet_worker *w, const uint8_t *data, size_t size, int isBoot, unsigned int *anomalies)
+{
+    struct ast_load_option_view view;
+    struct ast_devpath_iter iter;
+    struct ast_devpath_node node;
+    char key[AST_FLEET_KEY_MAX];
+    size_t len = 0;
+    int r = 0;
+
+    if (ast_load_option_parse (data, size, &view) != AST_RETURN_SUCCESS) {
+        *anomalies |= 1u << _AST_FLEET_BAD_LOAD_OPTION;
+        return;
+    }
+    if (!isBoot) {
+        return;
+    }
+
+    // The file started: every file path node of the first instance, concatenated as the specification says.
+    key[0] = '\0';
+    ast_devpath_iter_init (&iter, data + view.filePathListOffset, view.filePathListLength);
+    while (((r = ast_devpath_next (&iter, &node)) == 1) && (node.type != AST_DEVPATH_TYPE_END)) {
+        struct ast_devpath_file file;
+
+        if ((node.type == AST_DEVPATH_TYPE_MEDIA) && (node.subType == AST_DEVPATH_MEDIA_FILE_PATH) &&
+            (ast_devpath_decode_file (&node, &file) == AST_RETURN_SUCCESS) && (len < sizeof (key) - 1)) {
+            ast_utf16_decode (file.path, file.pathSiz, key + len, sizeof (key) - len);
+            len += strlen (key + len);
+        }
+    }
+    if (r < 0) {
+        *anomalies |= 1u << _AST_FLEET_BAD_LOAD_OPTION;
+        return;
+    }
+    if (len == 0) {
+        // No file (network, removable media, firmware application): the description tells more.
+        key[0] = '[';
+        ast_utf16_decode (data + view.descriptionOffset, view.descriptionLength, key + 1, sizeof (key) - 2);
+        len = strlen (key);
+        key[len] = ']';
+        key[len + 1] = '\0';
+    }
+    _ast_fleet_count (&(w->arena), &(w->paths), key, 1);
+}
+
+
+
+
+
+static void _ast_fleet_secure_boot (struct _ast_fleet_worker *w, struct ast_efivar_backend *backend, unsigned int *anomalies)
+{
+    uint8_t secureBoot = 0, setupMode = 0;
+    size_t n = 0;
+    int ret = backend->read (backend->ctx, &_ast_fleet_global, "SecureBoot", &secureBoot, 1, &n, NULL);
+
+    if (ret != AST_RETURN_SUCCESS) {
+        if (ret != AST_RETURN_NOT_FOUND) {
+            *anomalies |= 1u << _AST_FLEET_READ_ERROR;
+        }
+        w->secureBoot[_AST_FLEET_SB_UNSUPPORTED]++;
+        return;
+    }
+    if ((backend->read (backend->ctx, &_ast_fleet_global, "SetupMode", &setupMode, 1, &n, NULL) == AST_RETURN_SUCCESS) && (setupMode == 1)) {
+        w->secureBoot[_AST_FLEET_SB_SETUP]++;
+    } else {
+        w->secureBoot[(secureBoot == 1) ? _AST_FLEET_SB_ENABLED : _AST_FLEET_SB_DISABLED]++;
+    }
+}
+
+
+
+
+
+static void _ast_fleet_boot_order (struct _ast_fleet_worker *w, struct ast_efivar_backend *backend, unsigned int *anomalies)
+{
+    const uint8_t *data = NULL;
+    size_t size = 0;
+    int ret = _ast_fleet_read (w, backend, &_ast_fleet_global, "BootOrder", &data, &size);
+
+    if (ret == AST_RETURN_NOT_FOUND) {
+        return;
+    }
+    if (ret != AST_RETURN_SUCCESS) {
+        *anomalies |= 1u << _AST_FLEET_READ_ERROR;
+        return;
+    }
+    if ((size & 1) != 0) {
+        *anomalies |= 1u << _AST_FLEET_BAD_BOOT_ORDER;
+        return;
+    }
+    for (size_t i = 0; i < size; i += 2) {
+        uint16_t slot = (uint16_t) (data[i] | (data[i + 1] << 8));
+
+        if (!(w->bootSeen[slot >> 6] & (1ULL << (slot & 63)))) {
+            *anomalies |= 1u << _AST_FLEET_DANGLING_BOOT_ORDER;
+            return;
+        }
+    }
+}
+
+
+
+
+
+static int _ast_fleet_count (struct ast_arena *arena, struct _ast_fleet_table *table, const char *key, size_t n)
+{
+    uint64_t h = ast_fnv1a64_str (AST_FNV1A64_INIT, key);
+    size_t   s = 0;
+    char     *copy = NULL;
+
+    if ((table->n + 1) * 2 > table->cap) {
+        // Grown on the arena too; the old slots are simply left behind.
+        size_t newCap = table->cap ? 2 * table->cap : 64;
+        struct _ast_fleet_count *slots = ast_arena_alloc (arena, newCap * sizeof (struct _ast_fleet_count));
+
+        if (slots == NULL) {
+            return AST_RETURN_OPERATION_FAILED;
+        }
+        memset (slots, 0, newCap * sizeof (struct _ast_fleet_count));
+        for (size_t i = 0; i < table->cap; i++) {
+            if (table->slots[i].key != NULL) {
+                for (s = table->slots[i].hash & (newCap - 1); slots[s].key != NULL; s = (s + 1) & (newCap - 1)) {
+                }
+                slots[s] = table->slots[i];
+            }
+        }
+        table->slots = slots;
+        table->cap   = newCap;
+    }
+
+    for (s = h & (table->cap - 1); table->slots[s].key != NULL; s = (s + 1) & (table->cap - 1)) {
+        if ((table->slots[s].hash == h) && (strcmp (table->slots[s].key, key) == 0)) {
+            table->slots[s].count += n;
+            return AST_RETURN_SUCCESS;
+        }
+    }
+    copy = ast_arena_alloc (arena, strlen (key) + 1);
+    if (copy == NULL) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+    strcpy (copy, key);
+    table->slots[s].key   = copy;
+    table->slots[s].hash  = h;
+    table->slots[s].count = n;
+    table->n++;
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static void _ast_fleet_print_table (FILE *out, const char *title, const char *unit, const struct _ast_fleet_table *table)
+{
+    struct _ast_fleet_count *rows = malloc ((table->n + 1) * sizeof (struct _ast_fleet_count));
+    size_t n = 0;
+
+    fprintf (out, "\n%-48s %10s\n", title, unit);
+    if (rows == NULL) {
+        return;
+    }
+    for (size_t s = 0; s < table->cap; s++) {
+        if (table->slots[s].key != NULL) {
+            rows[n++] = table->slots[s];
+        }
+    }
+    if (n != 0) {
+        qsort (rows, n, sizeof (struct _ast_fleet_count), _ast_fleet_row_cmp);
+    }
+    for (size_t i = 0; (i < n) && (i < AST_FLEET_TOP); i++) {
+        fprintf (out, "  %-46s %10zu\n", rows[i].key, rows[i].count);
+    }
+    if (n > AST_FLEET_TOP) {
+        fprintf (out, "  (%zu more)\n", n - AST_FLEET_TOP);
+    }
+    free (rows);
+}
+
+
+
+
+
+static int _ast_fleet_row_cmp (const void *a, const void *b)
+{
+    const struct _ast_fleet_count *x = a;
+    const struct _ast_fleet_count *y = b;
+
+    if (x->count != y->count) {
+        return (x->count > y->count) ? -1 : 1;
+    }
+    return strcmp (x->key, y->key);
+}
+
+
+
+
+
+static int _ast_fleet_name_cmp (const void *a, const void *b)
+{
+    return strcmp (*(char *const *) a, *(char *const *) b);
+}
+
+#endif /* _WIN32 */
@@ -0,0 +1,36 @@
+/**
+ * @file fleet.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares the offline fleet analysis of the test program (`--fleet DIR`).
+ *
+ * Every entry of DIR is one machine: either a snapshot file (see snapshot.h), or a directory holding an
+ * efivarfs dump, as files `Name-guid` directly or under `sys/firmware/efi/efivars` (an extracted tarball
+ * of the root). Machines are decoded in parallel on a work-stealing pool (see pool.h); each worker keeps
+ * its own arena and tallies, merged once at the end.
+ *
+ * The report counts machines by Secure Boot state, boot entries by the file they start (or by their
+ * description if they have no file path), machines by dbx revision (its signature count and a hash of
+ * its contents, as dbx carries no version of its own), and anomalies: malformed load options, BootOrder
+ * or signature lists, BootOrder entries without a Boot#### variable, and variables that cannot be read.
+ */
+
+#ifndef _AST_FLEET_H
+#define _AST_FLEET_H
+
+#include <stdio.h>
+
+/**
+ * Analyze every machine in a directory and print the report.
+ *
+ * @param dir      [in] Directory of snapshots and efivarfs dumps.
+ * @param nThreads [in] Number of workers, or 0 for one per processor.
+ * @param out      [in] Stream to write the report to.
+ * @return AST_RETURN_SUCCESS, or another AST_RETURN code if the directory cannot be read.
+ */
+int ast_fleet_run (const char *dir, unsigned int nThreads, FILE *out);
+
+#endif /* end of include guard: _AST_FLEET_H */
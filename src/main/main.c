@@ -12,10 +12,31 @@
  * declare methods to do with system special privileges.
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
 #include "../ast.h"
+#include "../firmware/backend.h"
+#include "../privilege/privilege_os.h"
+#include "fleet.h"
 
-int main (void) {
+static const char *_ast_main_flag (int value);
+static int _ast_main_output (const char *format);
+static void _ast_main_watch_print (void *arg, const struct ast_efivar_event *event);
+static void _ast_main_check_image (const char *path);
+static void _ast_main_print_gpt (const char *path);
+static void _ast_main_check_boot_files (const char *path, uint32_t blockSize, const struct ast_gpt_partition *esp);
+
+int main (int argc, char **argv) {
     enum AST_FIRMWARE_TYPE type;
+    struct ast_firmware_info info;
+    struct ast_trace *trace = NULL;
+    struct ast_efivar_backend *traceBackend = NULL;
+    const struct ast_privilege_os *traceOs = NULL;
     // {8be4df61-93ca-11d2-aa0d-00e098032b8c} {global} efi_guid_global EFI Global Variable
     // static char *EFIGlobalVariableNamespace = "{8be4df61-93ca-11d2-aa0d-00e098032b8c}";
     // static char *vars[] = {
@@ -28,50 +49,386 @@ int main (void) {
     // };
     // char *buffer = malloc (4096);
 
-    puts ("========== Your machine's UEFI information is as follows:\n");
-
-    if (ast_get_firmware_type (&type) == EXIT_SUCCESS) {
-        char *firmwareName = malloc (17);
-        switch ((int)type) {
-            case AST_FIRMWARE_TYPE_UNKNOWN:
-                strncpy (firmwareName, "Unknown", 17);
-                break;
-            case AST_FIRMWARE_TYPE_BIOS:
-                strncpy (firmwareName, "BIOS", 17);
-                break;
-            case AST_FIRMWARE_TYPE_UEFI:
-                strncpy (firmwareName, "UEFI", 17);
-                break;
-            case AST_FIRMWARE_TYPE_NOTIMPL: // fall through
-            default:
-                strncpy (firmwareName, "Not Implemented", 17);
-                break;
+#ifndef _WIN32
+    // --fleet DIR [--threads N] analyzes collected snapshots and efivarfs dumps instead of this machine.
+    if ((argc >= 3) && (strcmp (argv[1], "--fleet") == 0)) {
+        unsigned int nThreads = 0;
+
+        if ((argc >= 5) && (strcmp (argv[3], "--threads") == 0)) {
+            nThreads = (unsigned int) strtoul (argv[4], NULL, 10);
+        }
+        return (ast_fleet_run (argv[2], nThreads, stdout) == AST_RETURN_SUCCESS) ? 0 : 1;
+    }
+#else
+    (void) argc;
+    (void) argv;
+#endif
+
+    // AST_TRACE=file records every variable store and privilege call, for ast_trace_replay.
+    if (getenv ("AST_TRACE") != NULL) {
+        trace = ast_trace_open (getenv ("AST_TRACE"));
+        if ((trace != NULL) && (ast_efivar_backend_get () != NULL)) {
+            traceBackend = ast_efivar_backend_trace_new (ast_efivar_backend_get (), trace);
+            ast_efivar_backend_set (traceBackend);
+        }
+#ifdef _WIN32
+        traceOs = ast_privilege_os_trace_new (ast_privilege_os_win32 (), trace);
+#else
+        traceOs = ast_privilege_os_trace_new (ast_privilege_os_stub (), trace);
+#endif
+        ast_privilege_set_os (traceOs);
+    }
+
+    // AST_OUTPUT=json or cbor reports the firmware type and every variable as records (see record.h)
+    // instead of text.
+    if (getenv ("AST_OUTPUT") != NULL) {
+        if (_ast_main_output (getenv ("AST_OUTPUT")) != AST_RETURN_SUCCESS) {
+            return 1;
         }
-        printf ("Firmware type: %s\n", firmwareName);
     } else {
-        printf ("Failed to get firmware type! exit.\n");
-        return 1;
-    }
-
-    // for (int i = 0; i < 6; i++) {
-    //     memset (buffer, '\0', 4096);
-    //     if (ast_read_efivar (buffer, 4096, EFIGlobalVariableNamespace, vars[i]) == EXIT_SUCCESS) {
-    //         if (i < 2) {
-    //             char order = '\0';
-    //             printf ("%s: ", vars[i]);
-    //             for (int j = 0; (order = buffer[j]) != '\0'; j++) {
-    //                 printf ("%#o(%#x), ", (int)order, (int)order);
-    //             }
-    //             printf ("(end)\n");
-    //         } else {
-    //             printf ("%s: %s\n", vars[i], buffer);
-    //         }
-    //     } else {
-    //         fprintf (stderr, "Failed to read %s!\n", vars[i]);
-    //     }
-    // }
-
-    ast_read_efivar_standard ();
+        puts ("========== Your machine's UEFI information is as follows:\n");
+
+        if (ast_get_firmware_type (&type) == EXIT_SUCCESS) {
+            const char *firmwareName = NULL;
+            switch ((int)type) {
+                case AST_FIRMWARE_TYPE_UNKNOWN:
+                    firmwareName = "Unknown";
+                    break;
+                case AST_FIRMWARE_TYPE_BIOS:
+                    firmwareName = "BIOS";
+                    break;
+                case AST_FIRMWARE_TYPE_UEFI:
+                    firmwareName = "UEFI";
+                    break;
+                case AST_FIRMWARE_TYPE_NOTIMPL: // fall through
+                default:
+                    firmwareName = "Not Implemented";
+                    break;
+            }
+            printf ("Firmware type: %s\n", firmwareName);
+            if ((type == AST_FIRMWARE_TYPE_UEFI) && (ast_get_firmware_info (&info) == AST_RETURN_SUCCESS)) {
+                printf ("UEFI: %u-bit, runtime services %s, Secure Boot %s, Setup Mode %s\n", info.bitness,
+                        _ast_main_flag (info.runtimeServices), _ast_main_flag (info.secureBoot), _ast_main_flag (info.setupMode));
+            }
+        } else {
+            printf ("Failed to get firmware type! exit.\n");
+            return 1;
+        }
+
+        // for (int i = 0; i < 6; i++) {
+        //     memset (buffer, '\0', 4096);
+        //     if (ast_read_efivar (buffer, 4096, EFIGlobalVariableNamespace, vars[i]) == EXIT_SUCCESS) {
+        //         if (i < 2) {
+        //             char order = '\0';
+        //             printf ("%s: ", vars[i]);
+        //             for (int j = 0; (order = buffer[j]) != '\0'; j++) {
+        //                 printf ("%#o(%#x), ", (int)order, (int)order);
+        //             }
+        //             printf ("(end)\n");
+        //         } else {
+        //             printf ("%s: %s\n", vars[i], buffer);
+        //         }
+        //     } else {
+        //         fprintf (stderr, "Failed to read %s!\n", vars[i]);
+        //     }
+        // }
+
+        ast_read_efivar_standard ();
+    }
+
+    // AST_SNAPSHOT_SAVE=file saves the whole variable store, to be served later with AST_EFIVAR_SNAPSHOT.
+    if (getenv ("AST_SNAPSHOT_SAVE") != NULL) {
+        size_t nVars = 0;
+        int ret = ast_snapshot_capture (getenv ("AST_SNAPSHOT_SAVE"), &nVars);
+
+        if (ret == AST_RETURN_SUCCESS) {
+            printf ("Saved %zu variables to %s\n", nVars, getenv ("AST_SNAPSHOT_SAVE"));
+        } else {
+            fprintf (stderr, "Failed to save a snapshot (error %d)!\n", ret);
+        }
+
+        // AST_SNAPSHOT_DIFF=file prints what changed since that earlier snapshot.
+        if ((ret == AST_RETURN_SUCCESS) && (getenv ("AST_SNAPSHOT_DIFF") != NULL)) {
+            struct ast_snapshot *before = NULL, *after = NULL;
+            struct ast_snapshot_diff diff;
+
+            if ((ast_snapshot_open (getenv ("AST_SNAPSHOT_DIFF"), 0, &before) == AST_RETURN_SUCCESS) &&
+                (ast_snapshot_open (getenv ("AST_SNAPSHOT_SAVE"), 0, &after) == AST_RETURN_SUCCESS) &&
+                (ast_snapshot_diff (before, after, 0, &diff) == AST_RETURN_SUCCESS)) {
+                printf ("%zu variables changed since %s\n", diff.nChanges, getenv ("AST_SNAPSHOT_DIFF"));
+                ast_snapshot_diff_print (&diff, stdout);
+                ast_snapshot_diff_free (&diff);
+            } else {
+                fprintf (stderr, "Failed to compare with %s!\n", getenv ("AST_SNAPSHOT_DIFF"));
+            }
+            ast_snapshot_close (after);
+            ast_snapshot_close (before);
+        }
+    }
+
+    // AST_WATCH=seconds prints the variables changed while waiting that long.
+    if (getenv ("AST_WATCH") != NULL) {
+        struct ast_efivar_watch *watch = NULL;
+        int ret = ast_efivar_watch_open (&watch, 0);
+
+        if (ret == AST_RETURN_SUCCESS) {
+            printf ("Watching %zu variables (%s)\n", ast_efivar_watch_count (watch), (ast_efivar_watch_fd (watch) >= 0) ? "inotify" : "polling");
+            ret = ast_efivar_watch_wait (watch, atoi (getenv ("AST_WATCH")) * 1000, _ast_main_watch_print, NULL, NULL);
+            ast_efivar_watch_close (watch);
+        }
+        if (ret != AST_RETURN_SUCCESS) {
+            fprintf (stderr, "Failed to watch variables (error %d)!\n", ret);
+        }
+    }
 
+    // AST_BOOT_IMAGE=file prints the Authenticode digest of an EFI image and whether db and dbx allow it.
+    if (getenv ("AST_BOOT_IMAGE") != NULL) {
+        _ast_main_check_image (getenv ("AST_BOOT_IMAGE"));
+    }
+
+    // AST_BOOT_DISK=disk prints the partitions of a disk or disk image, the HD node of its ESP, and whether
+    // the file of each Boot#### on that ESP is there.
+    if (getenv ("AST_BOOT_DISK") != NULL) {
+        _ast_main_print_gpt (getenv ("AST_BOOT_DISK"));
+    }
+
+    // AST_STATS=file writes how long each firmware and privilege call took, as JSON ("-" for stdout).
+    if (getenv ("AST_STATS") != NULL) {
+        struct ast_stats_snapshot snap;
+
+        if (ast_stats_snapshot (&snap) == AST_RETURN_SUCCESS) {
+            FILE *fp = (strcmp (getenv ("AST_STATS"), "-") == 0) ? stdout : fopen (getenv ("AST_STATS"), "w");
+            if (fp != NULL) {
+                ast_stats_dump_json (&snap, fp);
+                if (fp != stdout) {
+                    fclose (fp);
+                }
+            }
+            ast_stats_snapshot_free (&snap);
+        }
+    }
+
+    ast_privilege_release ();
+    if (trace != NULL) {
+        ast_privilege_set_os (NULL);
+        ast_privilege_os_trace_free (traceOs);
+        ast_efivar_backend_free (traceBackend);
+        ast_trace_close (trace);
+    }
     return 0;
 }
+
+
+
+
+
+static const char *_ast_main_flag (int value)
+{
+    return (value == AST_FIRMWARE_UNKNOWN) ? "unknown" : value ? "on" : "off";
+}
+
+
+
+
+
+static int _ast_main_output (const char *format)
+{
+    struct ast_output out;
+    struct ast_firmware_info info;
+    int ret = AST_RETURN_SUCCESS;
+
+    if (strcmp (format, "cbor") == 0) {
+#ifdef _WIN32
+        _setmode (_fileno (stdout), _O_BINARY);
+#endif
+        ast_output_init (&out, stdout, AST_OUTPUT_CBOR);
+    } else if (strcmp (format, "json") == 0) {
+        ast_output_init (&out, stdout, AST_OUTPUT_JSON);
+    } else {
+        fprintf (stderr, "Unknown output format %s (json or cbor)!\n", format);
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    ret = ast_get_firmware_info (&info);
+    if (ret == AST_RETURN_SUCCESS) {
+        ast_output_firmware (&out, &info);
+        ret = ast_output_store (&out, NULL);
+    } else {
+        ast_output_error (&out, NULL, "firmware type", ret);
+    }
+    if (ast_output_flush (&out) != AST_RETURN_SUCCESS) {
+        fprintf (stderr, "Failed to write the output!\n");
+        ret = AST_RETURN_OPERATION_FAILED;
+    }
+    return ret;
+}
+
+
+
+
+
+static void _ast_main_watch_print (void *arg, const struct ast_efivar_event *event)
+{
+    static const char *const types[] = { "added", "removed", "modified" };
+    char guid[AST_GUID_STRLEN + 1];
+
+    (void) arg;
+    ast_guid_format (&(event->guid), guid);
+    printf ("%s-%s %s (%zu bytes, attributes 0x%08x)\n", event->name, guid, types[event->type], event->size, (unsigned int) event->attr);
+}
+
+
+
+
+
+static void _ast_main_check_image (const char *path)
+{
+    static const ast_guid security = AST_GUID_IMAGE_SECURITY_DATABASE;
+    static const char *const verdicts[] = { "not listed in db or dbx", "allowed by db", "forbidden by dbx" };
+    uint8_t digest[AST_SHA256_SIZE];
+    struct ast_sigdb db, dbx;
+    int ret = ast_pe_hash_file (path, digest);
+
+    if (ret != AST_RETURN_SUCCESS) {
+        fprintf (stderr, "Failed to hash %s (error %d)!\n", path, ret);
+        return;
+    }
+    printf ("%s: Authenticode SHA-256 ", path);
+    for (size_t i = 0; i < sizeof (digest); i++) {
+        printf ("%02x", digest[i]);
+    }
+    printf (" (%s)\n", ast_sha256_engine ());
+
+    // A missing db or dbx lists nothing.
+    ast_sigdb_init (&db);
+    ast_sigdb_init (&dbx);
+    ast_sigdb_add_var (&db, &security, "db");
+    ast_sigdb_add_var (&dbx, &security, "dbx");
+    printf ("%s: %s\n", path, verdicts[ast_sigdb_check_sha256 (&db, &dbx, digest)]);
+    ast_sigdb_free (&dbx);
+    ast_sigdb_free (&db);
+}
+
+
+
+
+
+static void _ast_main_print_gpt (const char *path)
+{
+    static const ast_guid espType = AST_GUID_PARTITION_ESP;
+    const struct ast_gpt_partition *esp = NULL;
+    struct ast_gpt gpt;
+    char guid[AST_GUID_STRLEN + 1];
+    int ret = ast_gpt_read (path, &gpt);
+
+    if (ret != AST_RETURN_SUCCESS) {
+        fprintf (stderr, "Failed to read the GPT of %s (error %d)!\n", path, ret);
+        return;
+    }
+    ast_guid_format (&(gpt.diskGuid), guid);
+    printf ("%s: GPT %s, %llu blocks of %u bytes, %s%s\n", path, guid, (unsigned long long) gpt.nBlocks, (unsigned int) gpt.blockSize,
+            (gpt.valid & AST_GPT_PRIMARY) ? "primary" : "primary damaged", (gpt.valid & AST_GPT_BACKUP) ? " and backup" : ", backup damaged");
+    for (size_t i = 0; i < gpt.nPartitions; i++) {
+        ast_guid_format (&(gpt.partitions[i].type), guid);
+        printf ("%4u %12llu %12llu %s %s\n", (unsigned int) gpt.partitions[i].number, (unsigned long long) gpt.partitions[i].firstLba,
+                (unsigned long long) gpt.partitions[i].lastLba, guid, gpt.partitions[i].name);
+    }
+
+    esp = ast_gpt_find (&gpt, &espType);
+    if (esp != NULL) {
+        struct ast_devpath_builder builder;
+        struct ast_devpath_hd hd;
+        uint8_t node[128];
+        char text[256];
+        size_t size = 0;
+
+        ast_gpt_hd (esp, &hd);
+        ast_devpath_builder_init (&builder, node, sizeof (node));
+        ast_devpath_add_hd (&builder, &hd);
+        ast_devpath_add_end (&builder, AST_DEVPATH_END_ENTIRE);
+        if ((ast_devpath_builder_finish (&builder, &size) == AST_RETURN_SUCCESS) && (ast_devpath_to_text (node, size, text, sizeof (text)) < sizeof (text))) {
+            printf ("ESP: %s\n", text);
+        }
+        _ast_main_check_boot_files (path, gpt.blockSize, esp);
+    } else {
+        printf ("No EFI system partition.\n");
+    }
+    ast_gpt_free (&gpt);
+}
+
+
+
+
+
+/**
+ * Look up the file of every Boot#### that starts one from the ESP, reading the ESP directly.
+ */
+static void _ast_main_check_boot_files (const char *path, uint32_t blockSize, const struct ast_gpt_partition *esp)
+{
+    static const ast_guid global = AST_GUID_EFI_GLOBAL;
+    struct ast_slot_map *slots = NULL;
+    struct ast_fat *fat = NULL;
+    struct ast_arena arena;
+    int ret = ast_fat_open (path, esp->firstLba * blockSize, (esp->lastLba - esp->firstLba + 1) * blockSize, &fat);
+
+    if (ret != AST_RETURN_SUCCESS) {
+        fprintf (stderr, "Failed to open the FAT file system of the ESP (error %d)!\n", ret);
+        return;
+    }
+    printf ("ESP: FAT%d\n", ast_fat_type (fat));
+    slots = ast_slot_map_new ();
+    if ((slots == NULL) || (ast_slot_map_scan (slots) != AST_RETURN_SUCCESS)) {
+        fprintf (stderr, "Failed to enumerate Boot####!\n");
+        ast_slot_map_free (slots);
+        ast_fat_close (fat);
+        return;
+    }
+
+    ast_arena_init (&arena, 0);
+    for (size_t w = 0; w < AST_SLOT_WORDS; w++) {
+        for (uint64_t bits = slots->taken[AST_LOAD_OPTION_BOOT][w]; bits != 0; bits &= bits - 1) {
+            uint16_t slot = (uint16_t) (w * 64 + (size_t) __builtin_ctzll (bits));
+            struct ast_load_option_view view;
+            struct ast_devpath_iter iter;
+            struct ast_devpath_node node;
+            struct ast_devpath_hd hd;
+            struct ast_fat_entry entry;
+            char name[9], file[AST_FAT_NAME_MAX];
+            const uint8_t *data = NULL;
+            size_t size = 0, len = 0;
+            int other = 0;
+
+            ast_slot_name (AST_LOAD_OPTION_BOOT, slot, name, sizeof (name));
+            if ((ast_read_efivar_alloc (&arena, &global, name, (void **) &data, &size, NULL) != AST_RETURN_SUCCESS) ||
+                (ast_load_option_parse (data, size, &view) != AST_RETURN_SUCCESS)) {
+                printf ("%s: unreadable\n", name);
+                continue;
+            }
+            // The file path nodes of the first instance make one path; an HD node says which partition.
+            file[0] = '\0';
+            ast_devpath_iter_init (&iter, data + view.filePathListOffset, view.filePathListLength);
+            while ((ast_devpath_next (&iter, &node) == 1) && (node.type != AST_DEVPATH_TYPE_END)) {
+                struct ast_devpath_file path;
+
+                if ((ast_devpath_decode_hd (&node, &hd) == AST_RETURN_SUCCESS) && (hd.signatureType == AST_DEVPATH_HD_SIGNATURE_GUID)) {
+                    other = memcmp (hd.signature, &(esp->unique), sizeof (hd.signature)) != 0;
+                } else if ((ast_devpath_decode_file (&node, &path) == AST_RETURN_SUCCESS) && (len < sizeof (file) - 1)) {
+                    ast_utf16_decode (path.path, path.pathSiz, file + len, sizeof (file) - len);
+                    len += strlen (file + len);
+                }
+            }
+            if (len == 0) {
+                continue;
+            } else if (other) {
+                printf ("%s: %s is on another partition\n", name, file);
+            } else if ((ret = ast_fat_lookup (fat, file, &entry)) == AST_RETURN_SUCCESS) {
+                printf ("%s: %s, %llu bytes\n", name, file, (unsigned long long) entry.size);
+            } else {
+                printf ("%s: %s is %s\n", name, file, (ret == AST_RETURN_NOT_FOUND) ? "missing" : "unreadable");
+            }
+        }
+    }
+    ast_arena_free (&arena);
+    ast_slot_map_free (slots);
+    ast_fat_close (fat);
+}
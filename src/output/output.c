@@ -0,0 +1,448 @@
+/**
+ * @file output.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements output.h.
+ */
+
+#include <string.h>
+#include "output.h"
+#include "../firmware/firmware.h"
+
+/** CBOR major types. */
+#define AST_CBOR_UINT  0
+#define AST_CBOR_NINT  1
+#define AST_CBOR_BYTES 2
+#define AST_CBOR_TEXT  3
+#define AST_CBOR_ARRAY 4
+#define AST_CBOR_MAP   5
+
+/** CBOR simple values and the indefinite length markers. */
+#define AST_CBOR_FALSE        0xf4
+#define AST_CBOR_TRUE         0xf5
+#define AST_CBOR_NULL         0xf6
+#define AST_CBOR_ARRAY_OPEN   0x9f
+#define AST_CBOR_MAP_OPEN     0xbf
+#define AST_CBOR_BREAK        0xff
+
+static uint8_t *_ast_output_room (struct ast_output *out, size_t n);
+static void _ast_output_put (struct ast_output *out, const void *data, size_t size);
+static void _ast_output_item (struct ast_output *out);
+static void _ast_output_cbor_head (struct ast_output *out, unsigned int major, uint64_t value);
+static void _ast_output_json_text (struct ast_output *out, const char *s, size_t len);
+static void _ast_output_open (struct ast_output *out, uint8_t cbor, char json);
+static void _ast_output_close (struct ast_output *out, char json);
+
+
+
+
+
+void ast_output_init (struct ast_output *out, FILE *fp, enum AST_OUTPUT_FORMAT format)
+{
+    out->fp       = fp;
+    out->format   = format;
+    out->status   = AST_RETURN_SUCCESS;
+    out->len      = 0;
+    out->depth    = 0;
+    out->afterKey = 0;
+    memset (out->count, 0, sizeof (out->count));
+}
+
+
+
+
+
+int ast_output_flush (struct ast_output *out)
+{
+    if ((out->len > 0) && (out->status == AST_RETURN_SUCCESS)) {
+        if (fwrite (out->buf, 1, out->len, out->fp) != out->len) {
+            out->status = AST_RETURN_OPERATION_FAILED;
+        }
+    }
+    out->len = 0;
+    if ((out->status == AST_RETURN_SUCCESS) && (fflush (out->fp) != 0)) {
+        out->status = AST_RETURN_OPERATION_FAILED;
+    }
+    return out->status;
+}
+
+
+
+
+
+void ast_output_begin_map (struct ast_output *out)
+{
+    _ast_output_open (out, AST_CBOR_MAP_OPEN, '{');
+}
+
+
+
+
+
+void ast_output_end_map (struct ast_output *out)
+{
+    _ast_output_close (out, '}');
+}
+
+
+
+
+
+void ast_output_begin_array (struct ast_output *out)
+{
+    _ast_output_open (out, AST_CBOR_ARRAY_OPEN, '[');
+}
+
+
+
+
+
+void ast_output_end_array (struct ast_output *out)
+{
+    _ast_output_close (out, ']');
+}
+
+
+
+
+
+void ast_output_key (struct ast_output *out, const char *key)
+{
+    size_t len = strlen (key);
+
+    if (out->format == AST_OUTPUT_CBOR) {
+        _ast_output_cbor_head (out, AST_CBOR_TEXT, len);
+        _ast_output_put (out, key, len);
+    } else {
+        _ast_output_item (out);
+        _ast_output_json_text (out, key, len);
+        _ast_output_put (out, ":", 1);
+        out->afterKey = 1;
+    }
+}
+
+
+
+
+
+void ast_output_string (struct ast_output *out, const char *s, size_t len)
+{
+    if (out->format == AST_OUTPUT_CBOR) {
+        _ast_output_cbor_head (out, AST_CBOR_TEXT, len);
+        _ast_output_put (out, s, len);
+    } else {
+        _ast_output_item (out);
+        _ast_output_json_text (out, s, len);
+    }
+}
+
+
+
+
+
+void ast_output_cstring (struct ast_output *out, const char *s)
+{
+    ast_output_string (out, s, strlen (s));
+}
+
+
+
+
+
+void ast_output_bytes (struct ast_output *out, const void *data, size_t size)
+{
+    static const char hex[] = "0123456789abcdef";
+    const uint8_t *p = data;
+
+    if (out->format == AST_OUTPUT_CBOR) {
+        _ast_output_cbor_head (out, AST_CBOR_BYTES, size);
+        _ast_output_put (out, data, size);
+        return;
+    }
+
+    _ast_output_item (out);
+    _ast_output_put (out, "\"", 1);
+    // Encode as much as fits at a time, however large the value.
+    while (size > 0) {
+        size_t n = size;
+        uint8_t *dst = NULL;
+
+        if (n > AST_OUTPUT_BUFFER_SIZE / 2) {
+            n = AST_OUTPUT_BUFFER_SIZE / 2;
+        }
+        dst = _ast_output_room (out, n * 2);
+        if (dst == NULL) {
+            return;
+        }
+        for (size_t i = 0; i < n; i++) {
+            dst[2 * i]     = (uint8_t) hex[p[i] >> 4];
+            dst[2 * i + 1] = (uint8_t) hex[p[i] & 0xf];
+        }
+        out->len += n * 2;
+        p    += n;
+        size -= n;
+    }
+    _ast_output_put (out, "\"", 1);
+}
+
+
+
+
+
+void ast_output_uint (struct ast_output *out, uint64_t value)
+{
+    if (out->format == AST_OUTPUT_CBOR) {
+        _ast_output_cbor_head (out, AST_CBOR_UINT, value);
+    } else {
+        char text[24];
+        int len = snprintf (text, sizeof (text), "%llu", (unsigned long long) value);
+
+        _ast_output_item (out);
+        _ast_output_put (out, text, (size_t) len);
+    }
+}
+
+
+
+
+
+void ast_output_int (struct ast_output *out, int64_t value)
+{
+    if (out->format == AST_OUTPUT_CBOR) {
+        if (value < 0) {
+            // -1 - n, computed without overflowing on INT64_MIN.
+            _ast_output_cbor_head (out, AST_CBOR_NINT, ~(uint64_t) value);
+        } else {
+            _ast_output_cbor_head (out, AST_CBOR_UINT, (uint64_t) value);
+        }
+    } else {
+        char text[24];
+        int len = snprintf (text, sizeof (text), "%lld", (long long) value);
+
+        _ast_output_item (out);
+        _ast_output_put (out, text, (size_t) len);
+    }
+}
+
+
+
+
+
+void ast_output_bool (struct ast_output *out, int value)
+{
+    if (out->format == AST_OUTPUT_CBOR) {
+        uint8_t b = value ? AST_CBOR_TRUE : AST_CBOR_FALSE;
+
+        _ast_output_put (out, &b, 1);
+    } else {
+        _ast_output_item (out);
+        _ast_output_put (out, value ? "true" : "false", value ? 4 : 5);
+    }
+}
+
+
+
+
+
+void ast_output_null (struct ast_output *out)
+{
+    if (out->format == AST_OUTPUT_CBOR) {
+        uint8_t b = AST_CBOR_NULL;
+
+        _ast_output_put (out, &b, 1);
+    } else {
+        _ast_output_item (out);
+        _ast_output_put (out, "null", 4);
+    }
+}
+
+
+
+
+
+void ast_output_guid (struct ast_output *out, const ast_guid *guid)
+{
+    char text[AST_GUID_STRLEN + 1];
+
+    ast_guid_format (guid, text);
+    ast_output_string (out, text, AST_GUID_STRLEN);
+}
+
+
+
+
+
+/**
+ * Make room for n more bytes (at most AST_OUTPUT_BUFFER_SIZE), writing the buffer out if needed.
+ *
+ * @return Where to put them, or NULL after an error.
+ */
+static uint8_t *_ast_output_room (struct ast_output *out, size_t n)
+{
+    if (out->status != AST_RETURN_SUCCESS) {
+        return NULL;
+    }
+    if (out->len + n > AST_OUTPUT_BUFFER_SIZE) {
+        if (fwrite (out->buf, 1, out->len, out->fp) != out->len) {
+            out->status = AST_RETURN_OPERATION_FAILED;
+            return NULL;
+        }
+        out->len = 0;
+    }
+    return out->buf + out->len;
+}
+
+
+
+
+
+static void _ast_output_put (struct ast_output *out, const void *data, size_t size)
+{
+    const uint8_t *p = data;
+
+    while (size > 0) {
+        size_t n = (size < AST_OUTPUT_BUFFER_SIZE) ? size : AST_OUTPUT_BUFFER_SIZE;
+        uint8_t *dst = _ast_output_room (out, n);
+
+        if (dst == NULL) {
+            return;
+        }
+        memcpy (dst, p, n);
+        out->len += n;
+        p    += n;
+        size -= n;
+    }
+}
+
+
+
+
+
+/**
+ * JSON: separate a value from the one before it, unless it follows its key.
+ */
+static void _ast_output_item (struct ast_output *out)
+{
+    if (out->afterKey) {
+        out->afterKey = 0;
+        return;
+    }
+    if (out->depth > 0) {
+        if (out->count[out->depth - 1]) {
+            _ast_output_put (out, ",", 1);
+        }
+        out->count[out->depth - 1] = 1;
+    }
+}
+
+
+
+
+
+static void _ast_output_cbor_head (struct ast_output *out, unsigned int major, uint64_t value)
+{
+    uint8_t head[9];
+    size_t n = 1;
+
+    if (value < 24) {
+        head[0] = (uint8_t) ((major << 5) | value);
+    } else if (value <= 0xff) {
+        head[0] = (uint8_t) ((major << 5) | 24);
+        n = 2;
+    } else if (value <= 0xffff) {
+        head[0] = (uint8_t) ((major << 5) | 25);
+        n = 3;
+    } else if (value <= 0xffffffff) {
+        head[0] = (uint8_t) ((major << 5) | 26);
+        n = 5;
+    } else {
+        head[0] = (uint8_t) ((major << 5) | 27);
+        n = 9;
+    }
+    // Big endian argument.
+    for (size_t i = n - 1; i > 0; i--) {
+        head[i] = (uint8_t) value;
+        value >>= 8;
+    }
+    _ast_output_put (out, head, n);
+}
+
+
+
+
+
+static void _ast_output_json_text (struct ast_output *out, const char *s, size_t len)
+{
+    static const char hex[] = "0123456789abcdef";
+    size_t run = 0;
+
+    _ast_output_put (out, "\"", 1);
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char) s[i];
+
+        if ((c >= 0x20) && (c != '"') && (c != '\\')) {
+            continue;
+        }
+        // Copy the plain run before the character to escape, then the escape.
+        _ast_output_put (out, s + run, i - run);
+        run = i + 1;
+        if ((c == '"') || (c == '\\')) {
+            char esc[2] = { '\\', (char) c };
+
+            _ast_output_put (out, esc, 2);
+        } else if (c == '\n') {
+            _ast_output_put (out, "\\n", 2);
+        } else {
+            char esc[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 0xf] };
+
+            _ast_output_put (out, esc, 6);
+        }
+    }
+    _ast_output_put (out, s + run, len - run);
+    _ast_output_put (out, "\"", 1);
+}
+
+
+
+
+
+static void _ast_output_open (struct ast_output *out, uint8_t cbor, char json)
+{
+    if (out->depth >= AST_OUTPUT_MAX_DEPTH) {
+        out->status = AST_RETURN_INVALID_PARAMETER;
+        return;
+    }
+    if (out->format == AST_OUTPUT_CBOR) {
+        _ast_output_put (out, &cbor, 1);
+    } else {
+        _ast_output_item (out);
+        _ast_output_put (out, &json, 1);
+    }
+    out->count[out->depth++] = 0;
+}
+
+
+
+
+
+static void _ast_output_close (struct ast_output *out, char json)
+{
+    if (out->depth == 0) {
+        out->status = AST_RETURN_INVALID_PARAMETER;
+        return;
+    }
+    out->depth--;
+    if (out->format == AST_OUTPUT_CBOR) {
+        uint8_t b = AST_CBOR_BREAK;
+
+        _ast_output_put (out, &b, 1);
+    } else {
+        char end[2] = { json, '\n' };
+
+        // A record ends its line.
+        _ast_output_put (out, end, (out->depth == 0) ? 2 : 1);
+    }
+}
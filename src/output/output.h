@@ -0,0 +1,103 @@
+/**
+ * @file output.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares a streaming writer of structured records, as JSON Lines or CBOR.
+ *
+ * A record is a map written at the top level: in JSON it is one object per line, in CBOR one item of a
+ * CBOR sequence (RFC 8742), with maps and arrays of indefinite length so nothing has to be counted ahead.
+ * Values are encoded straight into a buffer inside struct ast_output, which is written out whenever it
+ * fills up: nothing is allocated, and a large value (a dbx of hundreds of KiB) goes through the buffer in
+ * pieces. Byte strings are lower case hex in JSON.
+ *
+ * Writing functions do not return errors: the first one is kept and returned by ast_output_flush, as
+ * stdio does with ferror.
+ */
+
+#ifndef _AST_OUTPUT_H
+#define _AST_OUTPUT_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../guid/guid.h"
+
+/** Size of the buffer records are encoded into. */
+#define AST_OUTPUT_BUFFER_SIZE 16384
+
+/** Deepest nesting of maps and arrays, the record itself included. */
+#define AST_OUTPUT_MAX_DEPTH 16
+
+/**
+ * Encodings.
+ */
+enum AST_OUTPUT_FORMAT {
+    AST_OUTPUT_JSON = 0, /**< JSON Lines: one object per line. */
+    AST_OUTPUT_CBOR      /**< CBOR sequence. */
+};
+
+/**
+ * Writer state. Initialize with ast_output_init; it can live on the stack (it holds the buffer) and be
+ * reused for any number of records.
+ */
+struct ast_output {
+    FILE                   *fp;                               /**< Where the buffer is written. */
+    enum AST_OUTPUT_FORMAT format;                            /**< Encoding. */
+    int                    status;                            /**< First error, or AST_RETURN_SUCCESS. */
+    size_t                 len;                               /**< Bytes waiting in buf. */
+    unsigned int           depth;                             /**< Open maps and arrays. */
+    uint8_t                count[AST_OUTPUT_MAX_DEPTH];       /**< JSON: whether each open level has an item yet. */
+    int                    afterKey;                          /**< JSON: a key was written, its value comes next. */
+    uint8_t                buf[AST_OUTPUT_BUFFER_SIZE];       /**< Encoded bytes not written yet. */
+};
+
+/**
+ * Prepare a writer.
+ *
+ * @param out    [out] Writer.
+ * @param fp     [in]  Stream to write to; opened in binary mode for CBOR.
+ * @param format [in]  Encoding.
+ */
+void ast_output_init (struct ast_output *out, FILE *fp, enum AST_OUTPUT_FORMAT format);
+
+/**
+ * Write out what is buffered.
+ *
+ * @param out [in] Writer.
+ * @return AST_RETURN_SUCCESS, or the first error since ast_output_init: AST_RETURN_OPERATION_FAILED
+ *         if the stream failed, AST_RETURN_INVALID_PARAMETER if maps and arrays were misused.
+ */
+int ast_output_flush (struct ast_output *out);
+
+/**
+ * @defgroup OutputContainers Maps and arrays
+ *
+ * A map at the top level is a record; ending it ends the line in JSON. Inside a map, each value is
+ * preceded by ast_output_key.
+ * @{
+ */
+void ast_output_begin_map (struct ast_output *out);
+void ast_output_end_map (struct ast_output *out);
+void ast_output_begin_array (struct ast_output *out);
+void ast_output_end_array (struct ast_output *out);
+/** @} */
+
+/**
+ * @defgroup OutputValues Values
+ * @{
+ */
+void ast_output_key (struct ast_output *out, const char *key);
+void ast_output_string (struct ast_output *out, const char *s, size_t len); /**< UTF-8 text. */
+void ast_output_cstring (struct ast_output *out, const char *s);            /**< NUL terminated UTF-8 text. */
+void ast_output_bytes (struct ast_output *out, const void *data, size_t size);
+void ast_output_uint (struct ast_output *out, uint64_t value);
+void ast_output_int (struct ast_output *out, int64_t value);
+void ast_output_bool (struct ast_output *out, int value);
+void ast_output_null (struct ast_output *out);
+void ast_output_guid (struct ast_output *out, const ast_guid *guid);        /**< As text, without braces. */
+/** @} */
+
+#endif /* end of include guard: _AST_OUTPUT_H */
@@ -0,0 +1,378 @@
+/**
+ * @file record.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements record.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "record.h"
+#include "../devpath/devpath.h"
+#include "../loadopt/loadopt.h"
+#include "../loadopt/slot.h"
+#include "../sigdb/sigdb.h"
+#include "../unicode/unicode.h"
+
+/** Longest load option description and file path text decoded; longer ones are left to the raw value. */
+#define AST_RECORD_TEXT_MAX 1024
+
+/** Records read from the store per ast_efivar_iter_next call. */
+#define AST_RECORD_ITER_CHUNK 64
+
+/**
+ * How a variable is decoded.
+ */
+enum _AST_RECORD_KIND {
+    _AST_RECORD_RAW = 0,
+    _AST_RECORD_UINT,
+    _AST_RECORD_ORDER,
+    _AST_RECORD_TEXT,
+    _AST_RECORD_LOAD_OPTION,
+    _AST_RECORD_SIGNATURE_LIST
+};
+
+struct _ast_record_name {
+    const char          *name;
+    enum _AST_RECORD_KIND kind;
+};
+
+static const ast_guid _ast_record_global   = AST_GUID_EFI_GLOBAL;
+static const ast_guid _ast_record_sha256   = AST_GUID_CERT_SHA256;
+static const ast_guid _ast_record_sha1     = AST_GUID_CERT_SHA1;
+static const ast_guid _ast_record_x509     = AST_GUID_CERT_X509;
+
+static const struct _ast_record_name _ast_record_global_names[] = {
+    { "BootCurrent",       _AST_RECORD_UINT },
+    { "BootNext",          _AST_RECORD_UINT },
+    { "Timeout",           _AST_RECORD_UINT },
+    { "SecureBoot",        _AST_RECORD_UINT },
+    { "SetupMode",         _AST_RECORD_UINT },
+    { "AuditMode",         _AST_RECORD_UINT },
+    { "DeployedMode",      _AST_RECORD_UINT },
+    { "VendorKeys",        _AST_RECORD_UINT },
+    { "BootOrder",         _AST_RECORD_ORDER },
+    { "DriverOrder",       _AST_RECORD_ORDER },
+    { "SysPrepOrder",      _AST_RECORD_ORDER },
+    { "PlatformLang",      _AST_RECORD_TEXT },
+    { "PlatformLangCodes", _AST_RECORD_TEXT },
+    { "Lang",              _AST_RECORD_TEXT },
+    { "LangCodes",         _AST_RECORD_TEXT }
+};
+
+static const char *const _ast_record_errors[] = {
+    "success", "operation failed", "access denied", "not found", "buffer too small", "not supported", "invalid parameter"
+};
+
+static enum _AST_RECORD_KIND _ast_record_kind (const ast_guid *guid, const char *name);
+static void _ast_record_decode (struct ast_output *out, enum _AST_RECORD_KIND kind, const uint8_t *data, size_t size);
+static void _ast_record_load_option (struct ast_output *out, const uint8_t *data, size_t size);
+static void _ast_record_signature_lists (struct ast_output *out, const uint8_t *data, size_t size);
+
+
+
+
+
+void ast_output_firmware (struct ast_output *out, const struct ast_firmware_info *info)
+{
+    static const char *const names[] = { "Unknown", "BIOS", "UEFI" };
+    const struct {
+        const char *key;
+        int        value;
+    } flags[] = {
+        { "runtimeServices", info->runtimeServices },
+        { "secureBoot",      info->secureBoot },
+        { "setupMode",       info->setupMode }
+    };
+
+    ast_output_begin_map (out);
+    ast_output_key (out, "record");
+    ast_output_cstring (out, "firmware");
+    ast_output_key (out, "type");
+    ast_output_cstring (out, ((unsigned int) info->type < sizeof (names) / sizeof (names[0])) ? names[info->type] : "Not Implemented");
+    if (info->type == AST_FIRMWARE_TYPE_UEFI) {
+        ast_output_key (out, "bitness");
+        if (info->bitness != 0) {
+            ast_output_uint (out, info->bitness);
+        } else {
+            ast_output_null (out);
+        }
+        for (size_t i = 0; i < sizeof (flags) / sizeof (flags[0]); i++) {
+            ast_output_key (out, flags[i].key);
+            if (flags[i].value == AST_FIRMWARE_UNKNOWN) {
+                ast_output_null (out);
+            } else {
+                ast_output_bool (out, flags[i].value);
+            }
+        }
+    }
+    ast_output_end_map (out);
+}
+
+
+
+
+
+void ast_output_variable (struct ast_output *out, const ast_guid *guid, const char *name, uint32_t attr, const void *data, size_t size)
+{
+    enum _AST_RECORD_KIND kind = _ast_record_kind (guid, name);
+
+    ast_output_begin_map (out);
+    ast_output_key (out, "record");
+    ast_output_cstring (out, "variable");
+    ast_output_key (out, "guid");
+    ast_output_guid (out, guid);
+    ast_output_key (out, "name");
+    ast_output_cstring (out, name);
+    ast_output_key (out, "attributes");
+    ast_output_uint (out, attr);
+    ast_output_key (out, "size");
+    ast_output_uint (out, size);
+    ast_output_key (out, "data");
+    ast_output_bytes (out, data, size);
+    _ast_record_decode (out, kind, data, size);
+    ast_output_end_map (out);
+}
+
+
+
+
+
+void ast_output_error (struct ast_output *out, const ast_guid *guid, const char *name, int status)
+{
+    ast_output_begin_map (out);
+    ast_output_key (out, "record");
+    ast_output_cstring (out, "error");
+    if (guid != NULL) {
+        ast_output_key (out, "guid");
+        ast_output_guid (out, guid);
+        ast_output_key (out, "name");
+    } else {
+        ast_output_key (out, "operation");
+    }
+    ast_output_cstring (out, name);
+    ast_output_key (out, "status");
+    ast_output_int (out, status);
+    ast_output_key (out, "error");
+    ast_output_cstring (out, ((unsigned int) status < sizeof (_ast_record_errors) / sizeof (_ast_record_errors[0])) ? _ast_record_errors[status] : "unknown");
+    ast_output_end_map (out);
+}
+
+
+
+
+
+int ast_output_store (struct ast_output *out, size_t *nVars)
+{
+    struct ast_efivar_iter *iter = NULL;
+    struct ast_efivar_info infos[AST_RECORD_ITER_CHUNK];
+    void *buf = NULL;
+    size_t bufSiz = 0, n = 0, count = 0;
+    int ret = ast_efivar_iter_open (&iter, 0);
+
+    if (ret != AST_RETURN_SUCCESS) {
+        ast_output_error (out, NULL, "enumerate", ret);
+        return ret;
+    }
+
+    while (((ret = ast_efivar_iter_next (iter, infos, AST_RECORD_ITER_CHUNK, &n)) == AST_RETURN_SUCCESS) && (n > 0)) {
+        for (size_t i = 0; i < n; i++) {
+            size_t size = 0;
+            uint32_t attr = 0;
+            int status = AST_RETURN_BUFFER_TOO_SMALL;
+
+            // The size from enumeration is a hint: the variable may have grown since.
+            if (infos[i].size <= bufSiz) {
+                status = ast_read_efivar_guid (buf, bufSiz, &(infos[i].guid), infos[i].name, &size, &attr);
+            } else {
+                size = infos[i].size;
+            }
+            if ((status == AST_RETURN_BUFFER_TOO_SMALL) && (size > bufSiz)) {
+                void *grown = realloc (buf, size);
+
+                if (grown == NULL) {
+                    status = AST_RETURN_OPERATION_FAILED;
+                } else {
+                    buf    = grown;
+                    bufSiz = size;
+                    status = ast_read_efivar_guid (buf, bufSiz, &(infos[i].guid), infos[i].name, &size, &attr);
+                }
+            }
+
+            if (status == AST_RETURN_SUCCESS) {
+                ast_output_variable (out, &(infos[i].guid), infos[i].name, attr, buf, size);
+                count++;
+            } else {
+                ast_output_error (out, &(infos[i].guid), infos[i].name, status);
+            }
+        }
+    }
+    if (ret != AST_RETURN_SUCCESS) {
+        ast_output_error (out, NULL, "enumerate", ret);
+    }
+    ast_efivar_iter_close (iter);
+    free (buf);
+
+    if (nVars != NULL) {
+        *nVars = count;
+    }
+    return ret;
+}
+
+
+
+
+
+static enum _AST_RECORD_KIND _ast_record_kind (const ast_guid *guid, const char *name)
+{
+    if (ast_siglist_is_database (guid, name)) {
+        return _AST_RECORD_SIGNATURE_LIST;
+    }
+    if (ast_guid_equal (guid, &_ast_record_global)) {
+        enum AST_LOAD_OPTION_CLASS cls;
+        uint16_t slot = 0;
+
+        if (ast_slot_parse_name (name, &cls, &slot) == AST_RETURN_SUCCESS) {
+            return _AST_RECORD_LOAD_OPTION;
+        }
+        for (size_t i = 0; i < sizeof (_ast_record_global_names) / sizeof (_ast_record_global_names[0]); i++) {
+            if (strcmp (name, _ast_record_global_names[i].name) == 0) {
+                return _ast_record_global_names[i].kind;
+            }
+        }
+    }
+    return _AST_RECORD_RAW;
+}
+
+
+
+
+
+/**
+ * Write the "decoded" key and value, if the value is well formed for its kind.
+ */
+static void _ast_record_decode (struct ast_output *out, enum _AST_RECORD_KIND kind, const uint8_t *data, size_t size)
+{
+    if (size == 0) {
+        return;
+    }
+
+    switch (kind) {
+        case _AST_RECORD_UINT:
+            if ((size == 1) || (size == 2) || (size == 4)) {
+                uint32_t value = 0;
+
+                for (size_t i = size; i > 0; i--) {
+                    value = (value << 8) | data[i - 1];
+                }
+                ast_output_key (out, "decoded");
+                ast_output_uint (out, value);
+            }
+            break;
+        case _AST_RECORD_ORDER:
+            if (size % 2 == 0) {
+                ast_output_key (out, "decoded");
+                ast_output_begin_array (out);
+                for (size_t i = 0; i < size; i += 2) {
+                    ast_output_uint (out, (uint16_t) (data[i] | (data[i + 1] << 8)));
+                }
+                ast_output_end_array (out);
+            }
+            break;
+        case _AST_RECORD_TEXT: {
+            size_t len = strnlen ((const char *) data, size);
+            size_t i = 0;
+
+            // ASCII language codes; anything else is only shown raw.
+            while ((i < len) && (data[i] >= 0x20) && (data[i] < 0x7f)) {
+                i++;
+            }
+            if (i == len) {
+                ast_output_key (out, "decoded");
+                ast_output_string (out, (const char *) data, len);
+            }
+            break;
+        }
+        case _AST_RECORD_LOAD_OPTION:
+            _ast_record_load_option (out, data, size);
+            break;
+        case _AST_RECORD_SIGNATURE_LIST:
+            // Check every list before decoding any, so that a malformed one writes no half-decoded array.
+            if (ast_siglist_validate (data, size, NULL) == AST_RETURN_SUCCESS) {
+                _ast_record_signature_lists (out, data, size);
+            }
+            break;
+        case _AST_RECORD_RAW: // fall through
+        default:
+            break;
+    }
+}
+
+
+
+
+
+static void _ast_record_load_option (struct ast_output *out, const uint8_t *data, size_t size)
+{
+    struct ast_load_option_view view;
+    char text[AST_RECORD_TEXT_MAX];
+    size_t len = 0;
+
+    if (ast_load_option_parse (data, size, &view) != AST_RETURN_SUCCESS) {
+        return;
+    }
+
+    ast_output_key (out, "decoded");
+    ast_output_begin_map (out);
+    ast_output_key (out, "attributes");
+    ast_output_uint (out, view.attributes);
+    len = ast_utf16_decode (data + view.descriptionOffset, view.descriptionLength, text, sizeof (text));
+    if (len < sizeof (text)) {
+        ast_output_key (out, "description");
+        ast_output_string (out, text, len);
+    }
+    len = ast_devpath_to_text (data + view.filePathListOffset, view.filePathListLength, text, sizeof (text));
+    if (len < sizeof (text)) {
+        ast_output_key (out, "filePath");
+        ast_output_string (out, text, len);
+    }
+    ast_output_key (out, "optionalDataSize");
+    ast_output_uint (out, view.optionalDataLength);
+    ast_output_end_map (out);
+}
+
+
+
+
+
+static void _ast_record_signature_lists (struct ast_output *out, const uint8_t *data, size_t size)
+{
+    struct ast_siglist_iter iter;
+    struct ast_siglist list;
+
+    ast_output_key (out, "decoded");
+    ast_output_begin_array (out);
+    ast_siglist_iter_init (&iter, data, size);
+    while (ast_siglist_next (&iter, &list) > 0) {
+        ast_output_begin_map (out);
+        ast_output_key (out, "type");
+        if (ast_guid_equal (&(list.type), &_ast_record_sha256)) {
+            ast_output_cstring (out, "sha256");
+        } else if (ast_guid_equal (&(list.type), &_ast_record_x509)) {
+            ast_output_cstring (out, "x509");
+        } else if (ast_guid_equal (&(list.type), &_ast_record_sha1)) {
+            ast_output_cstring (out, "sha1");
+        } else {
+            ast_output_guid (out, &(list.type));
+        }
+        ast_output_key (out, "signatures");
+        ast_output_uint (out, list.nEntries);
+        ast_output_key (out, "signatureSize");
+        ast_output_uint (out, list.entrySize);
+        ast_output_end_map (out);
+    }
+    ast_output_end_array (out);
+}
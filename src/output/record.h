@@ -0,0 +1,76 @@
+/**
+ * @file record.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares the records the test program reports, written with output.h.
+ *
+ * Every record has a "record" key naming its kind:
+ *
+ *     {"record":"firmware","type":"UEFI","bitness":64,"runtimeServices":true,"secureBoot":true,"setupMode":false}
+ *     {"record":"variable","guid":"8be4df61-...","name":"BootOrder","attributes":7,"size":4,
+ *      "data":"01000000","decoded":[1,0]}
+ *     {"record":"error","guid":"8be4df61-...","name":"BootNext","status":3,"error":"not found"}
+ *
+ * "data" holds the raw value (hex in JSON, a byte string in CBOR). "decoded" is only there for variables
+ * this library knows: a number for BootCurrent, BootNext, Timeout and the Secure Boot mode variables, an
+ * array of slots for BootOrder and the other *Order variables, text for the language variables, a map of
+ * attributes, description, filePath (as DevicePathToText renders it) and optional data size for load
+ * options, and one map per list (type, signature count and size) for signature databases. A signature
+ * database is summed up rather than listed signature by signature, so its record stays small next to its
+ * raw value.
+ */
+
+#ifndef _AST_RECORD_H
+#define _AST_RECORD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "output.h"
+#include "../firmware/firmware.h"
+
+/**
+ * Write the firmware type, and for UEFI its bitness, runtime services and Secure Boot state (null when
+ * unknown).
+ *
+ * @param out  [in] Writer.
+ * @param info [in] Firmware information.
+ */
+void ast_output_firmware (struct ast_output *out, const struct ast_firmware_info *info);
+
+/**
+ * Write one variable, raw and decoded.
+ *
+ * @param out  [in] Writer.
+ * @param guid [in] GUID namespace.
+ * @param name [in] Variable name.
+ * @param attr [in] Attributes.
+ * @param data [in] Value.
+ * @param size [in] Size of the value.
+ */
+void ast_output_variable (struct ast_output *out, const ast_guid *guid, const char *name, uint32_t attr, const void *data, size_t size);
+
+/**
+ * Write a failure to read a variable.
+ *
+ * @param out    [in] Writer.
+ * @param guid   [in] GUID namespace, or NULL if the failure concerns no particular variable.
+ * @param name   [in] Variable name, or what failed if guid is NULL (e.g. "enumerate").
+ * @param status [in] AST_RETURN code.
+ */
+void ast_output_error (struct ast_output *out, const ast_guid *guid, const char *name, int status);
+
+/**
+ * Write every variable of the current backend, and an error record for each one that cannot be read.
+ *
+ * One buffer, grown to the largest variable, is reused for all of them.
+ *
+ * @param out    [in]  Writer.
+ * @param nVars  [out] Number of variable records written. May be NULL.
+ * @return AST_RETURN_SUCCESS, or another AST_RETURN code if the store cannot be enumerated.
+ */
+int ast_output_store (struct ast_output *out, size_t *nVars);
+
+#endif /* end of include guard: _AST_RECORD_H */
@@ -0,0 +1,232 @@
+/**
+ * @file pe.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements pe.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "pe.h"
+#include "../firmware/firmware.h"
+
+/** Offset of e_lfanew (the PE header offset) in the MS-DOS header. */
+#define AST_PE_LFANEW_OFFSET 0x3c
+
+/** Size of the COFF file header, after the "PE\0\0" signature. */
+#define AST_PE_COFF_HEADER_SIZE 20
+
+/** Size of a section table entry. */
+#define AST_PE_SECTION_SIZE 40
+
+/** Index of the Certificate Table among the data directories. */
+#define AST_PE_DIRECTORY_SECURITY 4
+
+/**
+ * Raw data of one section.
+ */
+struct _ast_pe_section {
+    uint32_t offset; /**< PointerToRawData */
+    uint32_t size;   /**< SizeOfRawData */
+};
+
+static uint16_t _ast_pe_u16 (const uint8_t *p);
+static uint32_t _ast_pe_u32 (const uint8_t *p);
+
+
+
+
+
+int ast_pe_hash (const void *image, size_t size, uint8_t *digest)
+{
+    const uint8_t *p = image;
+    struct _ast_pe_section sections[AST_PE_MAX_SECTIONS];
+    struct ast_sha256 ctx;
+    size_t pe = 0, opt = 0, optSize = 0, dirs = 0, checksum = 0, certDir = 0, headers = 0, table = 0, hashed = 0;
+    uint32_t nRva = 0, certOffset = 0, certSize = 0;
+    uint16_t nSections = 0, magic = 0;
+    size_t n = 0;
+
+    if ((size < AST_PE_LFANEW_OFFSET + 4) || (p[0] != 'M') || (p[1] != 'Z')) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    pe = _ast_pe_u32 (p + AST_PE_LFANEW_OFFSET);
+    if ((pe > size) || (size - pe < 4 + AST_PE_COFF_HEADER_SIZE) || (memcmp (p + pe, "PE\0\0", 4) != 0)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    nSections = _ast_pe_u16 (p + pe + 6);
+    optSize   = _ast_pe_u16 (p + pe + 20);
+    opt       = pe + 4 + AST_PE_COFF_HEADER_SIZE;
+    if ((nSections > AST_PE_MAX_SECTIONS) || (optSize < 2) || (size - opt < optSize)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    // PE32 and PE32+ differ in the size of ImageBase and the stack and heap sizes, which moves the
+    //   data directories; CheckSum and SizeOfHeaders are at the same place in both.
+    magic = _ast_pe_u16 (p + opt);
+    if ((magic == 0x10b) && (optSize >= 96)) {
+        nRva = _ast_pe_u32 (p + opt + 92);
+        dirs = opt + 96;
+    } else if ((magic == 0x20b) && (optSize >= 112)) {
+        nRva = _ast_pe_u32 (p + opt + 108);
+        dirs = opt + 112;
+    } else {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    if (nRva > (opt + optSize - dirs) / 8) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    checksum = opt + 64;
+    headers  = _ast_pe_u32 (p + opt + 60);
+    table    = opt + optSize;
+    if ((headers > size) || (headers < table + (size_t) nSections * AST_PE_SECTION_SIZE)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    if (nRva > AST_PE_DIRECTORY_SECURITY) {
+        certDir    = dirs + 8 * AST_PE_DIRECTORY_SECURITY;
+        certOffset = _ast_pe_u32 (p + certDir);
+        certSize   = _ast_pe_u32 (p + certDir + 4);
+        if ((certSize != 0) && ((certOffset > size) || (size - certOffset < certSize))) {
+            return AST_RETURN_INVALID_PARAMETER;
+        }
+    }
+
+    // Sections in file order; empty ones (e.g. .bss) have nothing to hash.
+    for (uint16_t i = 0; i < nSections; i++) {
+        const uint8_t *s = p + table + (size_t) i * AST_PE_SECTION_SIZE;
+        struct _ast_pe_section section = {_ast_pe_u32 (s + 20), _ast_pe_u32 (s + 16)};
+        size_t j = n;
+
+        if (section.size == 0) {
+            continue;
+        }
+        if ((section.offset > size) || (size - section.offset < section.size)) {
+            return AST_RETURN_INVALID_PARAMETER;
+        }
+        for (; (j > 0) && (sections[j - 1].offset > section.offset); j--) {
+            sections[j] = sections[j - 1];
+        }
+        sections[j] = section;
+        n++;
+    }
+
+    ast_sha256_init (&ctx);
+    ast_sha256_update (&ctx, p, checksum);
+    if (certDir != 0) {
+        ast_sha256_update (&ctx, p + checksum + 4, certDir - (checksum + 4));
+        ast_sha256_update (&ctx, p + certDir + 8, headers - (certDir + 8));
+    } else {
+        ast_sha256_update (&ctx, p + checksum + 4, headers - (checksum + 4));
+    }
+    hashed = headers;
+    for (size_t i = 0; i < n; i++) {
+        ast_sha256_update (&ctx, p + sections[i].offset, sections[i].size);
+        hashed += sections[i].size;
+    }
+    // What follows the sections (e.g. debug data), up to the signatures.
+    if (size > hashed + certSize) {
+        ast_sha256_update (&ctx, p + hashed, size - hashed - certSize);
+    }
+    ast_sha256_final (&ctx, digest);
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+int ast_pe_hash_file (const char *path, uint8_t *digest)
+{
+    const void *base = NULL;
+    size_t size = 0;
+    int ret = AST_RETURN_SUCCESS;
+
+    if ((path == NULL) || (digest == NULL)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+#ifdef _WIN32
+    {
+        HANDLE file = CreateFileA (path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        HANDLE mapping = NULL;
+        LARGE_INTEGER fileSize;
+
+        if (file == INVALID_HANDLE_VALUE) {
+            return (GetLastError () == ERROR_FILE_NOT_FOUND) ? AST_RETURN_NOT_FOUND : AST_RETURN_ACCESS_DENIED;
+        }
+        if (!GetFileSizeEx (file, &fileSize) || (fileSize.QuadPart == 0)) {
+            CloseHandle (file);
+            return AST_RETURN_INVALID_PARAMETER;
+        }
+        size    = (size_t) fileSize.QuadPart;
+        mapping = CreateFileMappingA (file, NULL, PAGE_READONLY, 0, 0, NULL);
+        base    = (mapping != NULL) ? MapViewOfFile (mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+        if (base == NULL) {
+            fprintf (stderr, " ** Cannot map %s (error %lu).\n", path, GetLastError ());
+            ret = AST_RETURN_OPERATION_FAILED;
+        } else {
+            ret = ast_pe_hash (base, size, digest);
+            UnmapViewOfFile (base);
+        }
+        if (mapping != NULL) {
+            CloseHandle (mapping);
+        }
+        CloseHandle (file);
+    }
+#else
+    {
+        struct stat st;
+        int fd = open (path, O_RDONLY | O_CLOEXEC);
+
+        if (fd < 0) {
+            return (errno == ENOENT) ? AST_RETURN_NOT_FOUND : AST_RETURN_ACCESS_DENIED;
+        }
+        if ((fstat (fd, &st) != 0) || (st.st_size == 0)) {
+            close (fd);
+            return AST_RETURN_INVALID_PARAMETER;
+        }
+        size = (size_t) st.st_size;
+        base = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close (fd);
+        if (base == MAP_FAILED) {
+            fprintf (stderr, " ** Cannot map %s: %s.\n", path, strerror (errno));
+            return AST_RETURN_OPERATION_FAILED;
+        }
+        // The image is read once, front to back (sections are usually in file order already).
+        madvise ((void *) base, size, MADV_SEQUENTIAL);
+        ret = ast_pe_hash (base, size, digest);
+        munmap ((void *) base, size);
+    }
+#endif
+    return ret;
+}
+
+
+
+
+
+static uint16_t _ast_pe_u16 (const uint8_t *p)
+{
+    return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+
+
+
+
+static uint32_t _ast_pe_u32 (const uint8_t *p)
+{
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
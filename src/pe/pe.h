@@ -0,0 +1,52 @@
+/**
+ * @file pe.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares the Authenticode digest of PE/COFF images, the hash firmware looks up in db
+ * and dbx (EFI_CERT_SHA256_GUID entries) before it runs an EFI application.
+ *
+ * The digest covers, as the Authenticode specification and EDK II define it:
+ *
+ * - the headers up to SizeOfHeaders, except the optional header CheckSum and the Certificate Table
+ *   data directory entry;
+ * - the raw data of every section, in file order (by PointerToRawData);
+ * - whatever follows the sections, up to the Certificate Table (the signatures themselves are not hashed).
+ *
+ * The image is hashed in place, region by region; a file is mapped rather than read.
+ */
+
+#ifndef _AST_PE_H
+#define _AST_PE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../crypto/sha256.h"
+
+/** Most sections hashed; the Windows loader refuses images with more. */
+#define AST_PE_MAX_SECTIONS 96
+
+/**
+ * Compute the Authenticode SHA-256 digest of an image in memory.
+ *
+ * @param image  [in]  Image bytes.
+ * @param size   [in]  Size of the image.
+ * @param digest [out] AST_SHA256_SIZE bytes.
+ * @return AST_RETURN_SUCCESS, or AST_RETURN_INVALID_PARAMETER if the image is not a well formed PE32 or
+ *         PE32+ image (e.g. a section or the Certificate Table lies beyond its end).
+ */
+int ast_pe_hash (const void *image, size_t size, uint8_t *digest);
+
+/**
+ * Compute the Authenticode SHA-256 digest of an image file.
+ *
+ * @param path   [in]  File name.
+ * @param digest [out] AST_SHA256_SIZE bytes.
+ * @return AST_RETURN_SUCCESS, AST_RETURN_NOT_FOUND if there is no such file, AST_RETURN_ACCESS_DENIED if
+ *         it cannot be opened, or the same as ast_pe_hash.
+ */
+int ast_pe_hash_file (const char *path, uint8_t *digest);
+
+#endif /* end of include guard: _AST_PE_H */
@@ -14,10 +14,43 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <windows.h>
+#include <string.h>
 #include "privilege.h"
+#include "privilege_os.h"
+#include "../thread/thread.h"
+#include "../stats/stats.h"
 
-static int _ast_privilege_do (char *privName, DWORD attr);
+#define AST_PRIVILEGE_CACHE_SIZE 16
+#define AST_PRIVILEGE_NAME_MAX   64
+
+/**
+ * What we know about one privilege: its LUID, and its attributes in the token if we set them.
+ */
+struct _ast_privilege_entry {
+    char     name[AST_PRIVILEGE_NAME_MAX];
+    ast_luid luid;
+    int      known; // attr is valid
+    uint32_t attr;
+};
+
+/**
+ * Process-wide privilege manager state. Guarded by lock.
+ */
+static struct {
+    ast_mutex lock;
+    const struct ast_privilege_os *os;
+    void   *token;
+    int    hasToken;
+    struct _ast_privilege_entry cache[AST_PRIVILEGE_CACHE_SIZE];
+    size_t nCache;
+} _ast_privilege = { .lock = AST_MUTEX_INIT };
+
+static int  _ast_privilege_do (const char *privName, uint32_t attr);
+static const struct ast_privilege_os *_ast_privilege_os_locked (void);
+static struct _ast_privilege_entry *_ast_privilege_entry_locked (const char *privName, struct _ast_privilege_entry *tmp);
+static int  _ast_privilege_token_locked (void);
+static void _ast_privilege_release_locked (void);
+static size_t _ast_luid_hash (ast_luid luid);
 
 
 
@@ -25,11 +58,7 @@ static int _ast_privilege_do (char *privName, DWORD attr);
 
 int ast_privilege_obtain (char *privName)
 {
-    if (_ast_privilege_do (privName, SE_PRIVILEGE_ENABLED) == EXIT_SUCCESS) {
-        return EXIT_SUCCESS;
-    } else {
-        return EXIT_FAILURE;
-    }
+    return _ast_privilege_do (privName, SE_PRIVILEGE_ENABLED);
 }
 
 
@@ -38,120 +67,293 @@ int ast_privilege_obtain (char *privName)
 
 int ast_privilege_remove (char *privName)
 {
-    if (_ast_privilege_do (privName, AST_PRIVILEGE_DISABLED) == EXIT_SUCCESS) { // AST_PRIVILEGE_DISABLED = 0
+    return _ast_privilege_do (privName, AST_PRIVILEGE_DISABLED); // AST_PRIVILEGE_DISABLED = 0
+}
+
+
+
+
+
+void ast_privilege_release (void)
+{
+    ast_mutex_lock (&_ast_privilege.lock);
+    _ast_privilege_release_locked ();
+    ast_mutex_unlock (&_ast_privilege.lock);
+}
+
+
+
+
+
+void ast_privilege_set_os (const struct ast_privilege_os *os)
+{
+    ast_mutex_lock (&_ast_privilege.lock);
+    // Handles and LUIDs belong to the old table.
+    if (_ast_privilege.os != NULL) {
+        _ast_privilege_release_locked ();
+    }
+    _ast_privilege.os = os;
+    ast_mutex_unlock (&_ast_privilege.lock);
+}
+
+
+
+
+
+static int _ast_privilege_do (const char *privName, uint32_t attr)
+{
+    struct _ast_privilege_entry *entry = NULL;
+    struct _ast_privilege_entry tmp;
+    const struct ast_privilege_os *os = NULL;
+    int ret = EXIT_FAILURE;
+
+    ast_mutex_lock (&_ast_privilege.lock);
+    os = _ast_privilege_os_locked ();
+
+    entry = _ast_privilege_entry_locked (privName, &tmp);
+    if (entry == NULL) {
+        ast_mutex_unlock (&_ast_privilege.lock);
+        return EXIT_FAILURE;
+    }
+
+    if ((entry->known) && (entry->attr == attr)) {
+        // Already in the requested state: no kernel call at all.
+        ast_mutex_unlock (&_ast_privilege.lock);
+        AST_STATS_ADD (AST_STATS_COUNTER_PRIV_CACHE_HITS, 1);
         return EXIT_SUCCESS;
-    } else {
+    }
+
+    if (_ast_privilege_token_locked () != EXIT_SUCCESS) {
+        ast_mutex_unlock (&_ast_privilege.lock);
         return EXIT_FAILURE;
     }
+
+    AST_STATS_BEGIN (t);
+    ret = os->adjust (os->ctx, _ast_privilege.token, entry->luid, attr);
+    AST_STATS_END (AST_STATS_OP_PRIV_ADJUST, NULL, privName, ret, t);
+    if (ret == EXIT_SUCCESS) {
+        entry->known = 1;
+        entry->attr  = attr;
+    } else {
+        fprintf (stderr, "Cannot set privilege %s.\n", privName);
+        entry->known = 0;
+    }
+
+    ast_mutex_unlock (&_ast_privilege.lock);
+    return ret;
 }
 
 
 
 
 
-static int _ast_privilege_do (char *privName, DWORD attr)
+static const struct ast_privilege_os *_ast_privilege_os_locked (void)
 {
-    HANDLE hToken;
-    TOKEN_PRIVILEGES tpNew;
-    // XXX: We don't need a previous state here. Invoke ast_privilege_remove to remove a privilege.
-    // TOKEN_PRIVILEGES *p_tpPrev = ;
-
-    if (OpenProcessToken (GetCurrentProcess (), TOKEN_ADJUST_PRIVILEGES, &hToken)) {
-        if (LookupPrivilegeValue (NULL, privName, &(tpNew.Privileges[0].Luid))) {
-            tpNew.PrivilegeCount = 1;
-            // tpNew.Privileges[0].Luid is filled just now
-            tpNew.Privileges[0].Attributes = attr;
-
-            if (AdjustTokenPrivileges (hToken, FALSE, &tpNew, 0, NULL, NULL)) {
-                if (GetLastError () == ERROR_SUCCESS) {
-                    // AdjustTokenPrivileges succeeded
-                    return EXIT_SUCCESS;
-                } else {
-                    // AdjustTokenPrivileges succeeded with error code ERROR_NOT_ALL_ASSIGNED (XXX: maybe)
-                    fprintf (stderr, "AdjustTokenPrivileges cannot assign privilege %s (error %lu)\n", privName, GetLastError ());
-                    return EXIT_FAILURE; // FIXME: Particular exit code
-                }
-            } else {
-                // AdjustTokenPrivileges failed
-                fprintf (stderr, "AdjustTokenPrivileges failed with error %lu\n", GetLastError ());
-                return EXIT_FAILURE;
-            }
-        } else {
-            // LookupPrivilegeValue failed
-            fprintf (stderr, "LookupPrivilegeValue failed with error %lu.\n", GetLastError ());
-            return EXIT_FAILURE;
+    if (_ast_privilege.os == NULL) {
+#ifdef _WIN32
+        _ast_privilege.os = ast_privilege_os_win32 ();
+#else
+        _ast_privilege.os = ast_privilege_os_stub ();
+#endif
+    }
+    return _ast_privilege.os;
+}
+
+
+
+
+
+static struct _ast_privilege_entry *_ast_privilege_entry_locked (const char *privName, struct _ast_privilege_entry *tmp)
+{
+    const struct ast_privilege_os *os = _ast_privilege.os;
+    struct _ast_privilege_entry *entry = NULL;
+    int ret = EXIT_SUCCESS;
+
+    if ((privName == NULL) || (strlen (privName) >= AST_PRIVILEGE_NAME_MAX)) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < _ast_privilege.nCache; i++) {
+        if (strcmp (_ast_privilege.cache[i].name, privName) == 0) {
+            return &(_ast_privilege.cache[i]);
         }
-    } else {
-        // OpenProcessToken failed
-        fprintf (stderr, "OpenProcessToken failed with error %lu.\n", GetLastError ());
-        return EXIT_FAILURE;
     }
 
-    return EXIT_FAILURE;
+    // Resolve the name once; keep it if there is room, otherwise use it just this time.
+    entry = (_ast_privilege.nCache < AST_PRIVILEGE_CACHE_SIZE) ? &(_ast_privilege.cache[_ast_privilege.nCache]) : tmp;
+    AST_STATS_BEGIN (t);
+    ret = os->lookup_value (os->ctx, privName, &(entry->luid));
+    AST_STATS_END (AST_STATS_OP_PRIV_LOOKUP, NULL, privName, ret, t);
+    if (ret != EXIT_SUCCESS) {
+        return NULL;
+    }
+    strcpy (entry->name, privName);
+    entry->known = 0;
+    if (entry != tmp) {
+        _ast_privilege.nCache++;
+    }
+    return entry;
 }
 
 
 
 
 
-int ast_privilege_check_status (char *privName, enum AST_PRIVILEGE_STATUS isStatus)
+static int _ast_privilege_token_locked (void)
+{
+    const struct ast_privilege_os *os = _ast_privilege.os;
+    int ret = EXIT_SUCCESS;
+
+    if (!_ast_privilege.hasToken) {
+        AST_STATS_BEGIN (t);
+        ret = os->open_token (os->ctx, &(_ast_privilege.token));
+        AST_STATS_END (AST_STATS_OP_PRIV_OPEN_TOKEN, NULL, NULL, ret, t);
+        if (ret != EXIT_SUCCESS) {
+            return EXIT_FAILURE;
+        }
+        _ast_privilege.hasToken = 1;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+
+
+
+int ast_privilege_query_many (struct ast_privilege_query *queries, size_t n)
 {
-    const size_t BufferSize = 4096; // Should be enough
-    char *strPrivName = malloc (BufferSize);
-    DWORD lenPrivName = BufferSize;
-    TOKEN_PRIVILEGES *tmpToken = malloc (sizeof (TOKEN_PRIVILEGES));
-    HANDLE hToken;
-    DWORD retLen = 0;
-    BOOL bRet = FALSE;
-
-    if (OpenProcessToken (GetCurrentProcess (), TOKEN_QUERY, &hToken)) {
-        bRet = GetTokenInformation (hToken, TokenPrivileges, (TOKEN_PRIVILEGES *)tmpToken, sizeof (TOKEN_PRIVILEGES), &retLen);
-        if ((bRet) && (retLen <= sizeof (TOKEN_PRIVILEGES))) {
-            for (DWORD i = 0; i < tmpToken->PrivilegeCount; i++) {
-                // Reset buffer length lenPrivName because LookupPrivilegeName will change its value.
-                lenPrivName = BufferSize;
-
-                bRet = LookupPrivilegeName (NULL, &((tmpToken->Privileges[i]).Luid), strPrivName, &lenPrivName);
-                if ((bRet) && (lenPrivName <= BufferSize)) {
-                    if (strcmp (strPrivName, privName) == 0) {
-                        // Privilege name matched; check status via 'Attributes'
-                        if (isStatus == (tmpToken->Privileges[i]).Attributes) {
-                            CloseHandle (hToken);
-                            free (strPrivName);
-                            free (tmpToken);
-                            return EXIT_SUCCESS;
-                        } else {
-                            CloseHandle (hToken);
-                            free (strPrivName);
-                            free (tmpToken);
-                            return EXIT_FAILURE;
-                        }
-                    } else {} // Continue the loop
-                } else {
-                    // LookupPrivilegeName error
-                    fprintf (stderr, "LookupPrivilegeName failed with error %lu.\n", GetLastError ());
-                    CloseHandle (hToken);
-                    free (strPrivName);
-                    free (tmpToken);
-                    return EXIT_FAILURE;
-                }
+    const struct ast_privilege_os *os = NULL;
+    ast_luid_attr *privs = NULL;
+    size_t   nPrivs = 0;
+    size_t   nSlots = 1;
+    uint16_t stackSlots[128];
+    uint16_t *slots = stackSlots;
+    int      ret = EXIT_SUCCESS;
+
+    ast_mutex_lock (&_ast_privilege.lock);
+    os = _ast_privilege_os_locked ();
+
+    // Resolve every name before reading the token; the answers below then hit the LUID cache.
+    for (size_t q = 0; q < n; q++) {
+        struct _ast_privilege_entry tmp;
+        _ast_privilege_entry_locked (queries[q].privName, &tmp);
+    }
+
+    if (_ast_privilege_token_locked () != EXIT_SUCCESS) {
+        ast_mutex_unlock (&_ast_privilege.lock);
+        return EXIT_FAILURE;
+    }
+    AST_STATS_BEGIN (t);
+    ret = os->query (os->ctx, _ast_privilege.token, &privs, &nPrivs);
+    AST_STATS_END (AST_STATS_OP_PRIV_QUERY, NULL, NULL, ret, t);
+    if (ret != EXIT_SUCCESS) {
+        ast_mutex_unlock (&_ast_privilege.lock);
+        return EXIT_FAILURE;
+    }
+
+    // Index the token by LUID: open addressing, at most half full. Slot values are entry index + 1.
+    while (nSlots < 2 * nPrivs) {
+        nSlots <<= 1;
+    }
+    if ((nSlots > sizeof (stackSlots) / sizeof (stackSlots[0])) && ((nPrivs > UINT16_MAX - 1) || ((slots = malloc (nSlots * sizeof (uint16_t))) == NULL))) {
+        free (privs);
+        ast_mutex_unlock (&_ast_privilege.lock);
+        return EXIT_FAILURE;
+    }
+    memset (slots, 0, nSlots * sizeof (uint16_t));
+    for (size_t i = 0; i < nPrivs; i++) {
+        size_t h = _ast_luid_hash (privs[i].luid) & (nSlots - 1);
+        while (slots[h] != 0) {
+            h = (h + 1) & (nSlots - 1);
+        }
+        slots[h] = (uint16_t) (i + 1);
+    }
+
+    for (size_t q = 0; q < n; q++) {
+        struct _ast_privilege_entry tmp;
+        struct _ast_privilege_entry *entry = _ast_privilege_entry_locked (queries[q].privName, &tmp);
+        const ast_luid_attr *found = NULL;
+
+        queries[q].status = AST_PRIVILEGE_REMOVED;
+        queries[q].attr   = 0;
+        if (entry == NULL) {
+            // Unknown privilege name
+            queries[q].found = 0;
+            ret = EXIT_FAILURE;
+            continue;
+        }
+
+        for (size_t h = _ast_luid_hash (entry->luid) & (nSlots - 1); slots[h] != 0; h = (h + 1) & (nSlots - 1)) {
+            const ast_luid_attr *p = &(privs[slots[h] - 1]);
+            if ((p->luid.low == entry->luid.low) && (p->luid.high == entry->luid.high)) {
+                found = p;
+                break;
             }
+        }
+
+        queries[q].found = (found != NULL);
+        if (found == NULL) {
+            // A privilege missing from the token can never be enabled.
+            entry->known = 0;
+            continue;
+        }
+
+        queries[q].attr = found->attr;
+        if (found->attr & SE_PRIVILEGE_REMOVED) {
+            queries[q].status = AST_PRIVILEGE_REMOVED;
+            entry->known = 0;
+        } else if (found->attr & SE_PRIVILEGE_ENABLED) {
+            queries[q].status = AST_PRIVILEGE_ENABLED;
+            entry->known = 1;
+            entry->attr  = SE_PRIVILEGE_ENABLED;
         } else {
-            // GetTokenInformation error
-            fprintf (stderr, "GetTokenInformation failed with error %lu.\n", GetLastError ());
-            CloseHandle (hToken);
-            free (strPrivName);
-            free (tmpToken);
-            return EXIT_FAILURE;
+            queries[q].status = AST_PRIVILEGE_DISABLED;
+            entry->known = 1;
+            entry->attr  = AST_PRIVILEGE_DISABLED;
         }
-    } else {
-        // OpenProcessToken error
-        fprintf(stderr, "OpenProcessToken failed with error %lu\n", GetLastError ());
-        CloseHandle (hToken);
-        free (strPrivName);
-        free (tmpToken);
+    }
+
+    if (slots != stackSlots) {
+        free (slots);
+    }
+    free (privs);
+    ast_mutex_unlock (&_ast_privilege.lock);
+    return ret;
+}
+
+
+
+
+
+int ast_privilege_check_status (char *privName, enum AST_PRIVILEGE_STATUS isStatus)
+{
+    struct ast_privilege_query query = { privName, AST_PRIVILEGE_REMOVED, 0, 0 };
+
+    if (ast_privilege_query_many (&query, 1) != EXIT_SUCCESS) {
         return EXIT_FAILURE;
     }
+    return (query.status == isStatus) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+
 
-    return EXIT_FAILURE;
+
+
+static size_t _ast_luid_hash (ast_luid luid)
+{
+    return (size_t) ((luid.low * 2654435761u) ^ ((uint32_t) luid.high * 2246822519u));
+}
+
+
+
+
+
+static void _ast_privilege_release_locked (void)
+{
+    if (_ast_privilege.hasToken) {
+        _ast_privilege.os->close_token (_ast_privilege.os->ctx, _ast_privilege.token);
+        _ast_privilege.token    = NULL;
+        _ast_privilege.hasToken = 0;
+    }
+    _ast_privilege.nCache = 0;
 }
@@ -10,12 +10,33 @@
  * On Windows, some operations must be proceeded with high privileges, like [GetFirmwareEnvironmentVariable](https://msdn.microsoft.com/en-us/library/windows/desktop/ms724325(v=vs.85).aspx),
  * which needs [SE_SYSTEM_ENVIRONMENT](https://msdn.microsoft.com/en-us/library/windows/desktop/bb530716(v=vs.85).aspx#SE_SYSTEM_ENVIRONMENT_NAME) to function. In this file we abstract and
  * declare methods to do with system special privileges.
+ *
+ * Privilege changes go through a process-wide manager that keeps the token handle open, caches LUIDs,
+ * and remembers what it has set, so asking for an already enabled privilege costs no system call.
+ * The manager is thread-safe. Operating system calls go through privilege_os.h.
+ *
+ * Other systems have no token privileges (efivarfs checks file permissions instead), so there the stub
+ * table is used: these functions always succeed and every privilege reads as enabled.
  */
 
 #ifndef _AST_PRIVILEGE_H
 #define _AST_PRIVILEGE_H
 
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef _WIN32
 #include <windows.h>
+#include "privilege_os.h"
+#else
+// Privilege names and attributes from winnt.h, so that callers build unchanged on other systems.
+#define SE_SYSTEM_ENVIRONMENT_NAME "SeSystemEnvironmentPrivilege"
+#define SE_BACKUP_NAME             "SeBackupPrivilege"
+#define SE_RESTORE_NAME            "SeRestorePrivilege"
+#define SE_PRIVILEGE_ENABLED       0x00000002L
+#define SE_PRIVILEGE_REMOVED       0x00000004L
+#include "privilege_os.h"
+#endif
 
 /**
  * Enumeration that indicates the privilege status.
@@ -40,8 +61,11 @@ enum AST_PRIVILEGE_STATUS {
  *
  * @param privName [in] Name of the privilege. On Windows this is specified as constants in Winbase.h (which is included in Windows.h).
  *                      Just pass the constant to this function.
+ * The token handle and the privilege's LUID are cached, and nothing is called if the manager has already
+ * enabled the privilege.
+ *
  * @return EXIT_SUCCESS if operation succeeded, or particular return code may return.
- * @see ast_privilege_remove
+ * @see ast_privilege_remove, ast_privilege_release
  */
 int ast_privilege_obtain (char *privName);
 
@@ -57,6 +81,52 @@ int ast_privilege_obtain (char *privName);
  */
 int ast_privilege_remove (char *privName);
 
+/**
+ * Close the cached token handle and forget cached LUIDs and privilege states.
+ *
+ * Privileges stay as they are in the token. Call this before exiting, or after something outside this
+ * library has changed the token, so that the next call asks the operating system again.
+ *
+ * @see ast_privilege_obtain
+ */
+void ast_privilege_release (void);
+
+/**
+ * Select the operating system call table used by the privilege manager.
+ *
+ * The manager is released first. Passing NULL restores the platform default: ast_privilege_os_win32 on
+ * Windows, ast_privilege_os_stub elsewhere.
+ *
+ * @param os [in] Table to use, or NULL.
+ */
+void ast_privilege_set_os (const struct ast_privilege_os *os);
+
+/**
+ * One privilege status query.
+ *
+ * @see ast_privilege_query_many
+ */
+struct ast_privilege_query {
+    const char *privName;              /**< [in]  Name of the privilege. */
+    enum AST_PRIVILEGE_STATUS status;  /**< [out] Status. A privilege missing from the token reads as removed. */
+    int        found;                  /**< [out] Nonzero if the privilege is present in the token. */
+    uint32_t   attr;                   /**< [out] Raw SE_PRIVILEGE_* attributes, 0 if not found. */
+};
+
+/**
+ * Check the status of several privileges of the current process at once.
+ *
+ * The token's privileges are fetched once, into a buffer of the size the system asks for, and indexed
+ * by LUID. Names are resolved to LUIDs through the manager's cache, so N queries take O(N) lookups
+ * instead of a name lookup per token entry per query.
+ *
+ * @param queries [in,out] Array of n queries.
+ * @param n       [in]     Number of queries.
+ * @return EXIT_SUCCESS if every query was answered, EXIT_FAILURE if the token cannot be read or a name is unknown
+ *         (other queries are still answered in that case).
+ */
+int ast_privilege_query_many (struct ast_privilege_query *queries, size_t n);
+
 /**
  * Check the status of the current process.
  *
@@ -65,7 +135,7 @@ int ast_privilege_remove (char *privName);
  * @param isStatus [in] Status of the privilege to check.
  * @return EXIT_SUCCESS if the specified privilege is at such status.
  *         EXIT_FAILURE if the specified privilege is not at such status.
- * @see ast_privilege_is_enabled, ast_privilege_is_disabled, ast_privilege_is_removed
+ * @see ast_privilege_query_many, ast_privilege_is_enabled, ast_privilege_is_disabled, ast_privilege_is_removed
  */
 int ast_privilege_check_status (char *privName, enum AST_PRIVILEGE_STATUS isStatus);
 
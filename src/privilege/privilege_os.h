@@ -0,0 +1,110 @@
+/**
+ * @file privilege_os.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares the operating system calls the privilege manager is built on.
+ *
+ * privilege.c never calls OpenProcessToken, LookupPrivilegeValue or AdjustTokenPrivileges directly;
+ * it goes through a struct ast_privilege_os. On Windows the default table calls the real API. The stub
+ * table grants everything and counts calls, which lets the manager be exercised and measured on Linux.
+ */
+
+#ifndef _AST_PRIVILEGE_OS_H
+#define _AST_PRIVILEGE_OS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Locally unique identifier of a privilege. Same layout as the Windows LUID.
+ */
+typedef struct ast_luid {
+    uint32_t low;  /**< LowPart */
+    int32_t  high; /**< HighPart */
+} ast_luid;
+
+/**
+ * A privilege and its attributes in a token. Same layout as the Windows LUID_AND_ATTRIBUTES.
+ */
+typedef struct ast_luid_attr {
+    ast_luid luid; /**< Privilege */
+    uint32_t attr; /**< SE_PRIVILEGE_* bits */
+} ast_luid_attr;
+
+/**
+ * Table of operating system calls used by the privilege manager.
+ *
+ * All operations return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+struct ast_privilege_os {
+    const char *name; /**< Human readable name. */
+    void       *ctx;  /**< Private data, passed to every operation. */
+
+    /** Open the current process' token for adjusting and querying (OpenProcessToken). */
+    int  (*open_token)   (void *ctx, void **token);
+
+    /** Resolve a privilege name to its LUID (LookupPrivilegeValue). */
+    int  (*lookup_value) (void *ctx, const char *privName, ast_luid *luid);
+
+    /** Set the attributes of one privilege in the token (AdjustTokenPrivileges). */
+    int  (*adjust)       (void *ctx, void *token, ast_luid luid, uint32_t attr);
+
+    /**
+     * Fetch all privileges of the token (GetTokenInformation with TokenPrivileges).
+     * *privs is allocated with malloc and must be freed by the caller.
+     */
+    int  (*query)        (void *ctx, void *token, ast_luid_attr **privs, size_t *n);
+
+    /** Close a token opened by open_token (CloseHandle). */
+    void (*close_token)  (void *ctx, void *token);
+};
+
+/**
+ * Number of calls made through the stub table, by operation.
+ *
+ * @see ast_privilege_os_stub_counters
+ */
+struct ast_privilege_os_counters {
+    unsigned long openToken;   /**< open_token calls */
+    unsigned long lookupValue; /**< lookup_value calls */
+    unsigned long adjust;      /**< adjust calls */
+    unsigned long query;       /**< query calls */
+    unsigned long closeToken;  /**< close_token calls */
+};
+
+#ifdef _WIN32
+/**
+ * Get the table calling the Win32 API.
+ *
+ * @return The table. It is static and must not be freed.
+ */
+const struct ast_privilege_os *ast_privilege_os_win32 (void);
+#endif
+
+/**
+ * Get the stub table, which grants every privilege without asking any operating system.
+ *
+ * The stub token holds every privilege that has been looked up, enabled unless adjusted otherwise.
+ *
+ * This is the default table on systems other than Windows.
+ *
+ * @return The table. It is static and must not be freed.
+ */
+const struct ast_privilege_os *ast_privilege_os_stub (void);
+
+/**
+ * Read the stub table's call counters.
+ *
+ * @param counters [out] Counters since the last reset.
+ */
+void ast_privilege_os_stub_counters (struct ast_privilege_os_counters *counters);
+
+/**
+ * Reset the stub table's call counters to zero, and its token to the initial state.
+ */
+void ast_privilege_os_stub_reset (void);
+
+#endif /* end of include guard: _AST_PRIVILEGE_OS_H */
@@ -0,0 +1,167 @@
+/**
+ * @file privilege_stub.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements the stub operating system table declared in privilege_os.h.
+ *
+ * Every call succeeds and is counted. LUIDs are derived from the privilege name, so the same name always
+ * maps to the same LUID. The token remembers the attributes of every LUID that was looked up or adjusted.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "privilege_os.h"
+#include "../util/hash.h"
+
+#define AST_STUB_TOKEN_SIZE 64
+#define AST_STUB_ENABLED    0x00000002 // SE_PRIVILEGE_ENABLED
+
+struct _ast_stub_state {
+    struct ast_privilege_os_counters counters;
+    ast_luid_attr token[AST_STUB_TOKEN_SIZE];
+    size_t nToken;
+};
+
+static int  _ast_stub_open_token (void *ctx, void **token);
+static int  _ast_stub_lookup_value (void *ctx, const char *privName, ast_luid *luid);
+static int  _ast_stub_adjust (void *ctx, void *token, ast_luid luid, uint32_t attr);
+static int  _ast_stub_query (void *ctx, void *token, ast_luid_attr **privs, size_t *n);
+static void _ast_stub_close_token (void *ctx, void *token);
+
+static ast_luid_attr *_ast_stub_find (struct _ast_stub_state *state, ast_luid luid);
+
+static struct _ast_stub_state _ast_stub_state;
+static int _ast_stub_token; // Its address is the token handle
+
+static const struct ast_privilege_os _ast_stub_os = {
+    "stub",
+    &_ast_stub_state,
+    _ast_stub_open_token,
+    _ast_stub_lookup_value,
+    _ast_stub_adjust,
+    _ast_stub_query,
+    _ast_stub_close_token
+};
+
+
+
+
+
+const struct ast_privilege_os *ast_privilege_os_stub (void)
+{
+    return &_ast_stub_os;
+}
+
+
+
+
+
+void ast_privilege_os_stub_counters (struct ast_privilege_os_counters *counters)
+{
+    *counters = _ast_stub_state.counters;
+}
+
+
+
+
+
+void ast_privilege_os_stub_reset (void)
+{
+    memset (&_ast_stub_state, 0, sizeof (_ast_stub_state));
+}
+
+
+
+
+
+static int _ast_stub_open_token (void *ctx, void **token)
+{
+    ((struct _ast_stub_state *) ctx)->counters.openToken++;
+    *token = &_ast_stub_token;
+    return EXIT_SUCCESS;
+}
+
+
+
+
+
+static int _ast_stub_lookup_value (void *ctx, const char *privName, ast_luid *luid)
+{
+    ((struct _ast_stub_state *) ctx)->counters.lookupValue++;
+    // FNV-1a over the name; any stable mapping will do.
+    luid->low  = ast_fnv1a32_str (AST_FNV1A32_INIT, privName);
+    luid->high = 0;
+
+    // Every privilege exists in the stub token, enabled until adjusted.
+    _ast_stub_find (ctx, *luid);
+    return EXIT_SUCCESS;
+}
+
+
+
+
+
+static int _ast_stub_adjust (void *ctx, void *token, ast_luid luid, uint32_t attr)
+{
+    ast_luid_attr *entry = _ast_stub_find (ctx, luid);
+
+    (void) token;
+    ((struct _ast_stub_state *) ctx)->counters.adjust++;
+    if (entry != NULL) {
+        entry->attr = attr;
+    }
+    return EXIT_SUCCESS;
+}
+
+
+
+
+
+static int _ast_stub_query (void *ctx, void *token, ast_luid_attr **privs, size_t *n)
+{
+    struct _ast_stub_state *state = ctx;
+
+    (void) token;
+    state->counters.query++;
+    *privs = malloc ((state->nToken + 1) * sizeof (ast_luid_attr));
+    if (*privs == NULL) {
+        return EXIT_FAILURE;
+    }
+    memcpy (*privs, state->token, state->nToken * sizeof (ast_luid_attr));
+    *n = state->nToken;
+    return EXIT_SUCCESS;
+}
+
+
+
+
+
+static void _ast_stub_close_token (void *ctx, void *token)
+{
+    (void) token;
+    ((struct _ast_stub_state *) ctx)->counters.closeToken++;
+}
+
+
+
+
+
+static ast_luid_attr *_ast_stub_find (struct _ast_stub_state *state, ast_luid luid)
+{
+    for (size_t i = 0; i < state->nToken; i++) {
+        if ((state->token[i].luid.low == luid.low) && (state->token[i].luid.high == luid.high)) {
+            return &(state->token[i]);
+        }
+    }
+
+    if (state->nToken == AST_STUB_TOKEN_SIZE) {
+        return NULL;
+    }
+    state->token[state->nToken].luid = luid;
+    state->token[state->nToken].attr = AST_STUB_ENABLED;
+    return &(state->token[state->nToken++]);
+}
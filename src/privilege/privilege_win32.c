@@ -0,0 +1,164 @@
+/**
+ * @file privilege_win32.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements the Win32 operating system table declared in privilege_os.h.
+ */
+
+#ifdef _WIN32
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <windows.h>
+#include "privilege_os.h"
+
+static int  _ast_win32_open_token (void *ctx, void **token);
+static int  _ast_win32_lookup_value (void *ctx, const char *privName, ast_luid *luid);
+static int  _ast_win32_adjust (void *ctx, void *token, ast_luid luid, uint32_t attr);
+static int  _ast_win32_query (void *ctx, void *token, ast_luid_attr **privs, size_t *n);
+static void _ast_win32_close_token (void *ctx, void *token);
+
+static const struct ast_privilege_os _ast_win32_os = {
+    "win32",
+    NULL,
+    _ast_win32_open_token,
+    _ast_win32_lookup_value,
+    _ast_win32_adjust,
+    _ast_win32_query,
+    _ast_win32_close_token
+};
+
+
+
+
+
+const struct ast_privilege_os *ast_privilege_os_win32 (void)
+{
+    return &_ast_win32_os;
+}
+
+
+
+
+
+static int _ast_win32_open_token (void *ctx, void **token)
+{
+    HANDLE hToken;
+
+    (void) ctx;
+    if (OpenProcessToken (GetCurrentProcess (), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &hToken)) {
+        *token = hToken;
+        return EXIT_SUCCESS;
+    } else {
+        // OpenProcessToken failed
+        fprintf (stderr, "OpenProcessToken failed with error %lu.\n", GetLastError ());
+        return EXIT_FAILURE;
+    }
+}
+
+
+
+
+
+static int _ast_win32_lookup_value (void *ctx, const char *privName, ast_luid *luid)
+{
+    LUID value;
+
+    (void) ctx;
+    if (LookupPrivilegeValue (NULL, privName, &value)) {
+        luid->low  = value.LowPart;
+        luid->high = value.HighPart;
+        return EXIT_SUCCESS;
+    } else {
+        // LookupPrivilegeValue failed
+        fprintf (stderr, "LookupPrivilegeValue failed with error %lu.\n", GetLastError ());
+        return EXIT_FAILURE;
+    }
+}
+
+
+
+
+
+static int _ast_win32_adjust (void *ctx, void *token, ast_luid luid, uint32_t attr)
+{
+    TOKEN_PRIVILEGES tpNew;
+
+    (void) ctx;
+    tpNew.PrivilegeCount = 1;
+    tpNew.Privileges[0].Luid.LowPart  = luid.low;
+    tpNew.Privileges[0].Luid.HighPart = luid.high;
+    tpNew.Privileges[0].Attributes    = attr;
+
+    if (AdjustTokenPrivileges ((HANDLE) token, FALSE, &tpNew, 0, NULL, NULL)) {
+        if (GetLastError () == ERROR_SUCCESS) {
+            // AdjustTokenPrivileges succeeded
+            return EXIT_SUCCESS;
+        } else {
+            // AdjustTokenPrivileges succeeded with error code ERROR_NOT_ALL_ASSIGNED
+            fprintf (stderr, "AdjustTokenPrivileges cannot assign privilege (error %lu)\n", GetLastError ());
+            return EXIT_FAILURE;
+        }
+    } else {
+        // AdjustTokenPrivileges failed
+        fprintf (stderr, "AdjustTokenPrivileges failed with error %lu\n", GetLastError ());
+        return EXIT_FAILURE;
+    }
+}
+
+
+
+
+
+static int _ast_win32_query (void *ctx, void *token, ast_luid_attr **privs, size_t *n)
+{
+    TOKEN_PRIVILEGES *tp = NULL;
+    DWORD retLen = 0;
+
+    (void) ctx;
+    // Ask for the size first: a token holds a variable number of privileges.
+    if (!GetTokenInformation ((HANDLE) token, TokenPrivileges, NULL, 0, &retLen) && (GetLastError () != ERROR_INSUFFICIENT_BUFFER)) {
+        fprintf (stderr, "GetTokenInformation failed with error %lu.\n", GetLastError ());
+        return EXIT_FAILURE;
+    }
+
+    tp = malloc (retLen);
+    if (tp == NULL) {
+        return EXIT_FAILURE;
+    }
+    if (!GetTokenInformation ((HANDLE) token, TokenPrivileges, tp, retLen, &retLen)) {
+        fprintf (stderr, "GetTokenInformation failed with error %lu.\n", GetLastError ());
+        free (tp);
+        return EXIT_FAILURE;
+    }
+
+    *privs = malloc ((tp->PrivilegeCount + 1) * sizeof (ast_luid_attr));
+    if (*privs == NULL) {
+        free (tp);
+        return EXIT_FAILURE;
+    }
+    for (DWORD i = 0; i < tp->PrivilegeCount; i++) {
+        (*privs)[i].luid.low  = tp->Privileges[i].Luid.LowPart;
+        (*privs)[i].luid.high = tp->Privileges[i].Luid.HighPart;
+        (*privs)[i].attr      = tp->Privileges[i].Attributes;
+    }
+    *n = tp->PrivilegeCount;
+
+    free (tp);
+    return EXIT_SUCCESS;
+}
+
+
+
+
+
+static void _ast_win32_close_token (void *ctx, void *token)
+{
+    (void) ctx;
+    CloseHandle ((HANDLE) token);
+}
+
+#endif /* _WIN32 */
@@ -12,7 +12,12 @@
  * - `BootNext`
  * - `Boot####` (where `####` varies)
  *
- * To avoid annoying Secure Boot, we need to detect `SecureBoot` too.
+ * To avoid annoying Secure Boot, we need to detect `SecureBoot` too. When it is on, `db` and `dbx` are
+ * loaded to tell whether our image would be allowed to run: set `AST_BOOT_IMAGE` to the image file, and
+ * its Authenticode digest is looked up before anything is written (a refused image costs a reboot).
+ *
+ * `AST_BOOT_DISK` names the disk holding the EFI system partition. Its GPT gives the hard drive node of
+ * `Boot####`, and the image is looked up on the ESP's FAT file system, read directly without mounting.
  *
  * `Boot####` contains a set of data structure. For details, see:
  *   www.uefi.org/sites/default/files/resources/UEFI Spec 2_6.pdf
@@ -22,10 +27,12 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <stdbool.h>
-#include <windows.h>
+#include <string.h>
 #include "../ast.h"
 
-#define EFI_GLOBAL_GUID "{8be4df61-93ca-11d2-aa0d-00e098032b8c}"
+static const ast_guid efiGlobalGuid   = AST_GUID_EFI_GLOBAL;
+static const ast_guid efiSecurityGuid = AST_GUID_IMAGE_SECURITY_DATABASE;
+static const char     efiImagePath[]  = "\\EFI\\AST\\astg2x64.efi";
 
 /**
  * 16-Bit fixed-length character type.
@@ -39,48 +46,31 @@
 typedef uint16_t char16_t;
 
 /**
- * EFI device path protocol descriptor.
- *
- * The device path describes the location of the device the handle is for. See
- * UEFI specification 2.6: 9.2 EFI Device Path Protocol.
- */
-typedef struct _EFI_DEVICE_PATH_PROTOCOL {
-    uint8_t Type;
-    uint8_t SubType;
-    uint8_t Length[2];
-} EFI_DEVICE_PATH_PROTOCOL;
-
-/**
- * Load options.
- *
- * Each load option variable contains a EFI_LOAD_OPTION descriptor that is a
- * byte packed buffer of variable length fields. See UEFI specification 2.6:
- * 3.1.3 Load Options.
+ * Function performing a series of operation to prepare a boot option in EFI and set it to boot next time.
  */
-typedef struct _EFI_LOAD_OPTION {
-    uint32_t Attributes;
-    uint16_t FilePathListLength;
-    char16_t *Description;
-    EFI_DEVICE_PATH_PROTOCOL *FilePathList;
-    uint8_t  *OptionalData;
-} EFI_LOAD_OPTION;
+int efivar_set (void);
 
 /**
- * Function performing a series of operation to prepare a boot option in EFI and set it to boot next time.
+ * Function filling in the fields of our EFI_LOAD_OPTION (see loadopt.h for the encoding).
  */
-int efivar_set (void);
+int efi_load_option_fill (struct ast_load_option *option);
 
 /**
- * Function filling in an EFI_LOAD_OPTION.
+ * Function checking that our image is on the ESP, reading its FAT file system directly.
  */
-int efi_load_option_fill (EFI_LOAD_OPTION *option);
+int efi_image_check (const char *disk, uint32_t blockSize, const struct ast_gpt_partition *esp);
 
 int efivar_set (void)
 {
     uint8_t  efiSecureBoot = 0;
     uint16_t efiBootNext   = 0;
-    EFI_LOAD_OPTION efiBootOption = {0};
-    DWORD    nBytesStored  = 0;
+    struct ast_load_option efiBootOption = {0};
+    void     *efiBootOptionData = NULL;
+    size_t   efiBootOptionSize  = 0;
+    size_t   nBytesStored  = 0;
+    struct ast_efivar_txn *txn = NULL;
+    struct ast_sigdb db, dbx;
+    int      ret           = 0;
 
     if (ast_privilege_obtain (SE_SYSTEM_ENVIRONMENT_NAME) != EXIT_SUCCESS)
     {
@@ -89,103 +79,149 @@ int efivar_set (void)
     }
 
     // Check SecureBoot first.
-    // We don't want to support this shit.
-    nBytesStored = GetFirmwareEnvironmentVariable ("SecureBoot", EFI_GLOBAL_GUID, &efiSecureBoot, sizeof (efiSecureBoot));
-    if (nBytesStored != 0)
+    // If it is on, our image has to be allowed by db and not forbidden by dbx.
+    ast_sigdb_init (&db);
+    ast_sigdb_init (&dbx);
+    ret = ast_read_efivar_guid (&efiSecureBoot, sizeof (efiSecureBoot), &efiGlobalGuid, "SecureBoot", &nBytesStored, NULL);
+    if (ret == AST_RETURN_SUCCESS)
     {
         printf ("Secure Boot is currently %s.\n", efiSecureBoot == 0 ? "off" : "on");
         if (efiSecureBoot != 0)
         {
-            puts ("We do not support Secure Boot now.");
-        }
-    }
-    else
-    {
-        fprintf (stderr, "Failed to read SecureBoot with error %lu.\n", GetLastError ());
-    }
-
-    // Prepare Boot####.
-    // To avoid conflict, we need to determine the "####" first (by checking whether our selected number is occupied),
-    //   and then fill in the complicated buffer.
-    char *efiBootOptionName = malloc (9); // strlen ("Boot####") + 1(NUL);
-    char *efiTempBuffer     = malloc (4096);
-    for (uint16_t i = 0x0004; i < 0x00FF; i++)
-    {
-        if (snprintf (efiBootOptionName, 9, "Boot%04X", i) == 4)
-        {
-            nBytesStored = GetFirmwareEnvironmentVariable (efiBootOptionName, EFI_GLOBAL_GUID, &efiTempBuffer, 4096);
-            if (nBytesStored != 0)
+            ret = ast_sigdb_add_var (&db, &efiSecurityGuid, "db");
+            if (ret != AST_RETURN_SUCCESS)
             {
-                // Boot option exists, switch to the next number...
-                continue;
+                fprintf (stderr, "Failed to load db with error %d.\n", ret);
             }
-            else
+            ret = ast_sigdb_add_var (&dbx, &efiSecurityGuid, "dbx");
+            if ((ret != AST_RETURN_SUCCESS) && (ret != AST_RETURN_NOT_FOUND))
             {
-                // Boot option does not exist, so it is ours...
-                if (efi_load_option_fill (&efiBootOption))
+                fprintf (stderr, "Failed to load dbx with error %d.\n", ret);
+            }
+            printf ("db lists %zu hashes and certificates, dbx %zu.\n", db.count, dbx.count);
+            if (getenv ("AST_BOOT_IMAGE") != NULL)
+            {
+                uint8_t digest[AST_SHA256_SIZE];
+
+                ret = ast_pe_hash_file (getenv ("AST_BOOT_IMAGE"), digest);
+                if (ret != AST_RETURN_SUCCESS)
                 {
-                    break;
+                    fprintf (stderr, "Failed to hash %s with error %d. Abort.\n", getenv ("AST_BOOT_IMAGE"), ret);
+                    exit (1);
                 }
-                else
+                switch (ast_sigdb_check_sha256 (&db, &dbx, digest))
                 {
-                    fprintf(stderr, "Failed to fill in %s... Abort.\n", efiBootOptionName);
-                    exit (1);
+                    case AST_SIGDB_FORBIDDEN:
+                        fprintf (stderr, "%s is forbidden by dbx. Abort.\n", getenv ("AST_BOOT_IMAGE"));
+                        exit (1);
+                    case AST_SIGDB_ALLOWED:
+                        printf ("%s is allowed by db.\n", getenv ("AST_BOOT_IMAGE"));
+                        break;
+                    default:
+                        // Not listed by hash: firmware will check its signature against db instead.
+                        printf ("%s is not listed by hash; it must be signed by a key in db.\n", getenv ("AST_BOOT_IMAGE"));
+                        break;
                 }
             }
         }
-        else
-        {
-            fprintf (stderr, "We met an error when doing snprintf... Abort.");
-            abort ();
-        }
     }
-    // efiBootOptionName will be used later.
-    free (efiTempBuffer);
-    efiTempBuffer = NULL;
+    else
+    {
+        fprintf (stderr, "Failed to read SecureBoot with error %d.\n", ret);
+    }
+
+    // Prepare Boot####.
+    // To avoid conflict, we need to determine the "####" first (by reserving a number not occupied),
+    //   and then fill in the complicated buffer.
+    // One enumeration pass tells which numbers are taken, instead of probing each candidate in turn.
+    char efiBootOptionName[9]; // strlen ("Boot####") + 1(NUL);
+    uint16_t efiBootOptionNumber = 0;
+    struct ast_slot_map *slots = ast_slot_map_new ();
+
+    if (slots == NULL)
+    {
+        fprintf (stderr, "Out of memory. Abort.\n");
+        exit (1);
+    }
+    ret = ast_slot_map_scan (slots);
+    if (ret != AST_RETURN_SUCCESS)
+    {
+        fprintf (stderr, "Failed to enumerate efivars with error %d. Abort.\n", ret);
+        exit (1);
+    }
+    if (ast_slot_map_reserve (slots, AST_LOAD_OPTION_BOOT, 0x0004, &efiBootOptionNumber) != AST_RETURN_SUCCESS)
+    {
+        fprintf (stderr, "No free Boot#### left. Abort.\n");
+        exit (1);
+    }
+    ast_slot_name (AST_LOAD_OPTION_BOOT, efiBootOptionNumber, efiBootOptionName, sizeof (efiBootOptionName));
 
-    // Save Boot#### to NVRAM.
-    if (!SetFirmwareEnvironmentVariable (
-        efiBootOptionName, EFI_GLOBAL_GUID, &efiBootOption,
-        sizeof (uint32_t) + sizeof (uint16_t)
-        + wcslen ((wchar_t *)efiBootOption.Description) + efiBootOption.FilePathListLength // XXX: uint16_t -> wchar_t (although it works)
-        + strlen ((char *)(efiBootOption.OptionalData == NULL ? "" : efiBootOption.OptionalData))))
+    // Boot option does not exist, so it is ours...
+    if (!efi_load_option_fill (&efiBootOption))
     {
-        fprintf (stderr, "We met an error while setting %s... (error %lu) Abort.\n", efiBootOptionName, GetLastError ());
+        fprintf(stderr, "Failed to fill in %s... Abort.\n", efiBootOptionName);
+        exit (1);
     }
+    // efiBootOptionName will be used later.
 
     // Check if BootNext is available to set (not exists).
     // If BootNext exists, there must be something interesting.
-    nBytesStored = GetFirmwareEnvironmentVariable ("BootNext", EFI_GLOBAL_GUID, &efiBootNext, sizeof (efiBootNext));
-    if (nBytesStored == 0)
+    ret = ast_read_efivar_guid (&efiBootNext, sizeof (efiBootNext), &efiGlobalGuid, "BootNext", &nBytesStored, NULL);
+    if (ret == AST_RETURN_SUCCESS)
     {
-        if (GetLastError () == ERROR_ENVVAR_NOT_FOUND)
-        {
-            // BootNext does not exist, so it is our turn.
-            // Set BootNext to current Boot####.
-            if (!SetFirmwareEnvironmentVariable ("BootNext", EFI_GLOBAL_GUID, efiBootOptionName, strlen (efiBootOptionName)))
-            {
-                fprintf (stderr, "We met an error while setting BootNext... (error %lu) Abort.", GetLastError ());
-                abort ();
-            }
-        }
-        else
-        {
-            // Other kinds of error occurred...
-            fprintf (stderr, "Failed to read BootNext with error %lu.\n", GetLastError ());
-        }
+        fprintf (stderr, "BootNext exists! Abort.\n");
+        exit (1);
+    }
+    else if (ret != AST_RETURN_NOT_FOUND)
+    {
+        // Other kinds of error occurred...
+        fprintf (stderr, "Failed to read BootNext with error %d. Abort.\n", ret);
+        exit (1);
+    }
+
+    // Save Boot#### and BootNext to NVRAM together.
+    // The option is packed into one buffer of exactly the encoded size. BootNext holds the option number
+    //   (a UINT16), and is written after Boot#### so that it never points at nothing; if it cannot be
+    //   written, Boot#### is removed again.
+    ret = ast_load_option_encode_alloc (&efiBootOption, &efiBootOptionData, &efiBootOptionSize);
+    if (ret != AST_RETURN_SUCCESS)
+    {
+        fprintf (stderr, "Failed to encode %s... (error %d) Abort.\n", efiBootOptionName, ret);
+        exit (1);
+    }
+    efiBootNext = efiBootOptionNumber;
+
+    ret = ast_efivar_txn_begin (&txn);
+    if (ret == AST_RETURN_SUCCESS)
+    {
+        ret = ast_efivar_txn_put (txn, efiBootOptionData, efiBootOptionSize, &efiGlobalGuid, efiBootOptionName, AST_EFIVAR_DEFAULT_ATTRIBUTES);
+    }
+    if (ret == AST_RETURN_SUCCESS)
+    {
+        ret = ast_efivar_txn_put (txn, &efiBootNext, sizeof (efiBootNext), &efiGlobalGuid, "BootNext", AST_EFIVAR_DEFAULT_ATTRIBUTES);
+    }
+    free (efiBootOptionData);
+    if (ret == AST_RETURN_SUCCESS)
+    {
+        ret = ast_efivar_txn_commit (txn, NULL);
     }
     else
     {
-        fprintf (stderr, "BootNext exists! Abort.\n");
+        ast_efivar_txn_abort (txn);
+    }
+    if (ret != AST_RETURN_SUCCESS)
+    {
+        fprintf (stderr, "We met an error while setting %s and BootNext... (error %d) Abort.\n", efiBootOptionName, ret);
         exit (1);
     }
 
-    free (efiBootOptionName);
-    efiBootOptionName = NULL;
+    ast_slot_map_free (slots);
+    ast_sigdb_free (&db);
+    ast_sigdb_free (&dbx);
     return true;
 }
 
-int efi_load_option_fill (EFI_LOAD_OPTION *option)
+int efi_load_option_fill (struct ast_load_option *option)
 {
     /* Attributes         = 0x00000001 (LOAD_OPTION_ACTIVE) {4}
      * FilePathListLength = 0x5e (94) {2}
@@ -194,10 +230,10 @@ int efi_load_option_fill (EFI_LOAD_OPTION *option)
      *   Type       = 0x04 (Media Device Path) {1}
      *   SubType    = 0x01 (Hard Drive) {1}
      *   Length[0]  = 0x2a (42) Length[1] = 0x00 {2}
-     *   PartitionNumber    = TODO {4}  << WinAPI (<PARTITION_INFORMATION_EX>.PartitionNumber)
-     *   PartitionStart     = TODO {8}  << GPT Partition Header (StartingLBA) || (WinAPI returns bytes)
-     *   PartitionSize      = TODO {8}  << GPT Partition Header (EndingLBA - StartingLBA + 1) || (WinAPI returns bytes)
-     *   PartitionSignature = TODO {16} << GPT Partition Header (UniquePartitionGUID) || WinAPI (<PARTITION_INFORMATION_EX>.Gpt.PartitionId)
+     *   PartitionNumber    = ESP entry index + 1 {4}         << GPT of AST_BOOT_DISK (ast_gpt_hd)
+     *   PartitionStart     = StartingLBA {8}                 << GPT Partition Entry
+     *   PartitionSize      = EndingLBA - StartingLBA + 1 {8} << GPT Partition Entry
+     *   PartitionSignature = UniquePartitionGUID {16}        << GPT Partition Entry
      *   PartitionFormat    = 0x02 (GUID Partition Table) (XXX) {1}
      *   SignatureType      = 0x02 (GUID signature) (XXX) {1}
      * FilePathList[1] => {48}
@@ -213,5 +249,83 @@ int efi_load_option_fill (EFI_LOAD_OPTION *option)
      *
      * Total length = 146 (0x92)
      */
-    return false;
+    option->attributes  = AST_LOAD_OPTION_ACTIVE;
+    option->description = "Boot Linux OS from AST";
+
+    static uint8_t filePathList[128];
+    struct ast_devpath_builder builder;
+    struct ast_devpath_hd hd = {0};
+    size_t filePathListLength = 0;
+    static const ast_guid espType = AST_GUID_PARTITION_ESP;
+
+    // The HD node names the ESP of the disk we boot from: AST_BOOT_DISK, a block device (\\.\PhysicalDriveN
+    //   on Windows) or a disk image. Its GPT is read directly, without a round trip per field.
+    hd.partitionFormat = AST_DEVPATH_HD_FORMAT_GPT;
+    hd.signatureType   = AST_DEVPATH_HD_SIGNATURE_GUID;
+    if (getenv ("AST_BOOT_DISK") != NULL)
+    {
+        struct ast_gpt gpt;
+        int ret = ast_gpt_read (getenv ("AST_BOOT_DISK"), &gpt);
+
+        if (ret == AST_RETURN_SUCCESS)
+        {
+            const struct ast_gpt_partition *esp = ast_gpt_find (&gpt, &espType);
+
+            if (esp != NULL)
+            {
+                ast_gpt_hd (esp, &hd);
+                // BootNext at a file that is not there costs a reboot: look for it on the ESP first.
+                if (!efi_image_check (getenv ("AST_BOOT_DISK"), gpt.blockSize, esp))
+                {
+                    hd.partitionNumber = 0;
+                }
+            }
+            else
+            {
+                fprintf (stderr, "%s has no EFI system partition.\n", getenv ("AST_BOOT_DISK"));
+            }
+            ast_gpt_free (&gpt);
+        }
+        else
+        {
+            fprintf (stderr, "Failed to read the GPT of %s with error %d.\n", getenv ("AST_BOOT_DISK"), ret);
+        }
+    }
+
+    ast_devpath_builder_init (&builder, filePathList, sizeof (filePathList));
+    ast_devpath_add_hd (&builder, &hd);
+    ast_devpath_add_file (&builder, efiImagePath);
+    ast_devpath_add_end (&builder, AST_DEVPATH_END_ENTIRE);
+    if (ast_devpath_builder_finish (&builder, &filePathListLength) != AST_RETURN_SUCCESS)
+    {
+        return false;
+    }
+
+    option->filePathList       = filePathList;
+    option->filePathListLength = (uint16_t) filePathListLength;
+    option->optionalData       = NULL;
+    option->optionalDataLength = 0;
+    return hd.partitionNumber != 0;
+}
+
+int efi_image_check (const char *disk, uint32_t blockSize, const struct ast_gpt_partition *esp)
+{
+    struct ast_fat *fat = NULL;
+    struct ast_fat_entry entry;
+    int ret = ast_fat_open (disk, esp->firstLba * blockSize, (esp->lastLba - esp->firstLba + 1) * blockSize, &fat);
+
+    if (ret != AST_RETURN_SUCCESS)
+    {
+        fprintf (stderr, "Failed to open the ESP of %s with error %d.\n", disk, ret);
+        return false;
+    }
+    ret = ast_fat_lookup (fat, efiImagePath, &entry);
+    ast_fat_close (fat);
+    if ((ret != AST_RETURN_SUCCESS) || (entry.attributes & AST_FAT_ATTR_DIRECTORY) || (entry.size == 0))
+    {
+        fprintf (stderr, "%s is not on the ESP of %s (error %d).\n", efiImagePath, disk, ret);
+        return false;
+    }
+    printf ("%s is on the ESP of %s, %llu bytes.\n", efiImagePath, disk, (unsigned long long) entry.size);
+    return true;
 }
@@ -0,0 +1,395 @@
+/**
+ * @file sigdb.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements sigdb.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "sigdb.h"
+#include "../util/hash.h"
+
+/** Smallest table; it doubles whenever it would become more than half full. */
+#define AST_SIGDB_MIN_SLOTS 64
+
+/**
+ * Kinds of indexed entries.
+ */
+enum _AST_SIGDB_KIND {
+    _AST_SIGDB_EMPTY = 0,
+    _AST_SIGDB_SHA256,
+    _AST_SIGDB_X509
+};
+
+/**
+ * One slot of the table. The key is the signature itself, pointed to in the indexed bytes.
+ */
+struct _ast_sigdb_slot {
+    uint64_t      hash;
+    const uint8_t *data;
+    uint32_t      size;
+    uint32_t      kind; /**< _AST_SIGDB_*; _AST_SIGDB_EMPTY marks a free slot. */
+};
+
+static const ast_guid _ast_sigdb_global   = AST_GUID_EFI_GLOBAL;
+static const ast_guid _ast_sigdb_security = AST_GUID_IMAGE_SECURITY_DATABASE;
+static const ast_guid _ast_sigdb_shim     = AST_GUID_SHIM_LOCK;
+static const ast_guid _ast_sigdb_sha256   = AST_GUID_CERT_SHA256;
+static const ast_guid _ast_sigdb_x509     = AST_GUID_CERT_X509;
+
+static const char *const _ast_sigdb_global_names[] = {
+    "PK", "KEK", "PKDefault", "KEKDefault", "dbDefault", "dbxDefault", "dbtDefault", "dbrDefault"
+};
+static const char *const _ast_sigdb_security_names[] = {
+    "db", "dbx", "dbt", "dbr"
+};
+
+static int _ast_sigdb_kind (const struct ast_siglist *list);
+static uint64_t _ast_sigdb_hash (enum _AST_SIGDB_KIND kind, const uint8_t *data, size_t size);
+static const struct _ast_sigdb_slot *_ast_sigdb_find (const struct ast_sigdb *db, enum _AST_SIGDB_KIND kind, const uint8_t *data, size_t size, uint64_t hash);
+static int  _ast_sigdb_reserve (struct ast_sigdb *db, size_t n);
+static void _ast_sigdb_insert (struct ast_sigdb *db, enum _AST_SIGDB_KIND kind, const uint8_t *data, size_t size);
+
+
+
+
+
+int ast_siglist_validate (const void *data, size_t size, size_t *nEntries)
+{
+    struct ast_siglist_iter iter;
+    struct ast_siglist list;
+    size_t n = 0;
+    int r = 0;
+
+    ast_siglist_iter_init (&iter, data, size);
+    while ((r = ast_siglist_next (&iter, &list)) > 0) {
+        n += list.nEntries;
+    }
+    if (r < 0) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    if (nEntries != NULL) {
+        *nEntries = n;
+    }
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+void ast_siglist_iter_init (struct ast_siglist_iter *iter, const void *data, size_t size)
+{
+    iter->p    = data;
+    iter->left = size;
+}
+
+
+
+
+
+int ast_siglist_next (struct ast_siglist_iter *iter, struct ast_siglist *list)
+{
+    uint32_t listSize = 0, headerSize = 0, entrySize = 0;
+
+    if (iter->left == 0) {
+        return 0;
+    }
+    if (iter->left < AST_SIGNATURE_LIST_HEADER_SIZE) {
+        return -1;
+    }
+    memcpy (&(list->type), iter->p, sizeof (ast_guid));
+    memcpy (&listSize, iter->p + 16, 4);
+    memcpy (&headerSize, iter->p + 20, 4);
+    memcpy (&entrySize, iter->p + 24, 4);
+    if ((listSize > iter->left) || (listSize < AST_SIGNATURE_LIST_HEADER_SIZE) ||
+        (headerSize > listSize - AST_SIGNATURE_LIST_HEADER_SIZE) || (entrySize < sizeof (ast_guid)) ||
+        ((listSize - AST_SIGNATURE_LIST_HEADER_SIZE - headerSize) % entrySize != 0)) {
+        return -1;
+    }
+
+    list->header     = iter->p + AST_SIGNATURE_LIST_HEADER_SIZE;
+    list->headerSize = headerSize;
+    list->entries    = list->header + headerSize;
+    list->entrySize  = entrySize;
+    list->nEntries   = (listSize - AST_SIGNATURE_LIST_HEADER_SIZE - headerSize) / entrySize;
+    iter->p    += listSize;
+    iter->left -= listSize;
+    return 1;
+}
+
+
+
+
+
+void ast_siglist_entry (const struct ast_siglist *list, size_t index, struct ast_sig *sig)
+{
+    const uint8_t *p = list->entries + index * list->entrySize;
+
+    sig->type = list->type;
+    memcpy (&(sig->owner), p, sizeof (ast_guid));
+    sig->data = p + sizeof (ast_guid);
+    sig->size = list->entrySize - sizeof (ast_guid);
+}
+
+
+
+
+
+int ast_siglist_is_database (const ast_guid *guid, const char *name)
+{
+    if (ast_guid_equal (guid, &_ast_sigdb_global)) {
+        for (size_t i = 0; i < sizeof (_ast_sigdb_global_names) / sizeof (_ast_sigdb_global_names[0]); i++) {
+            if (strcmp (name, _ast_sigdb_global_names[i]) == 0) {
+                return 1;
+            }
+        }
+    } else if (ast_guid_equal (guid, &_ast_sigdb_security)) {
+        for (size_t i = 0; i < sizeof (_ast_sigdb_security_names) / sizeof (_ast_sigdb_security_names[0]); i++) {
+            if (strcmp (name, _ast_sigdb_security_names[i]) == 0) {
+                return 1;
+            }
+        }
+    } else if (ast_guid_equal (guid, &_ast_sigdb_shim)) {
+        return strncmp (name, "MokList", 7) == 0;
+    }
+    return 0;
+}
+
+
+
+
+
+void ast_sigdb_init (struct ast_sigdb *db)
+{
+    memset (db, 0, sizeof (*db));
+    ast_arena_init (&(db->arena), 0);
+}
+
+
+
+
+
+int ast_sigdb_add (struct ast_sigdb *db, const void *data, size_t size)
+{
+    struct ast_siglist_iter iter;
+    struct ast_siglist list;
+    size_t n = 0;
+
+    // Count first, so that a malformed database indexes nothing and the table grows once.
+    ast_siglist_iter_init (&iter, data, size);
+    for (int r = ast_siglist_next (&iter, &list); r != 0; r = ast_siglist_next (&iter, &list)) {
+        if (r < 0) {
+            return AST_RETURN_INVALID_PARAMETER;
+        }
+        if (_ast_sigdb_kind (&list) != _AST_SIGDB_EMPTY) {
+            n += list.nEntries;
+        }
+    }
+    if (_ast_sigdb_reserve (db, n) != AST_RETURN_SUCCESS) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+
+    ast_siglist_iter_init (&iter, data, size);
+    while (ast_siglist_next (&iter, &list) > 0) {
+        enum _AST_SIGDB_KIND kind = _ast_sigdb_kind (&list);
+
+        if (kind == _AST_SIGDB_EMPTY) {
+            db->nSkipped += list.nEntries;
+            continue;
+        }
+        for (size_t i = 0; i < list.nEntries; i++) {
+            struct ast_sig sig;
+
+            ast_siglist_entry (&list, i, &sig);
+            _ast_sigdb_insert (db, kind, sig.data, sig.size);
+        }
+    }
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+int ast_sigdb_add_var (struct ast_sigdb *db, const ast_guid *guid, const char *name)
+{
+    void *data = NULL;
+    size_t size = 0;
+    int ret = ast_read_efivar_alloc (&(db->arena), guid, name, &data, &size, NULL);
+
+    if (ret != AST_RETURN_SUCCESS) {
+        return ret;
+    }
+    return ast_sigdb_add (db, data, size);
+}
+
+
+
+
+
+int ast_sigdb_has_sha256 (const struct ast_sigdb *db, const uint8_t *digest)
+{
+    return _ast_sigdb_find (db, _AST_SIGDB_SHA256, digest, AST_SHA256_SIZE, _ast_sigdb_hash (_AST_SIGDB_SHA256, digest, AST_SHA256_SIZE)) != NULL;
+}
+
+
+
+
+
+int ast_sigdb_has_x509 (const struct ast_sigdb *db, const void *cert, size_t size)
+{
+    return _ast_sigdb_find (db, _AST_SIGDB_X509, cert, size, _ast_sigdb_hash (_AST_SIGDB_X509, cert, size)) != NULL;
+}
+
+
+
+
+
+int ast_sigdb_check_sha256 (const struct ast_sigdb *db, const struct ast_sigdb *dbx, const uint8_t *digest)
+{
+    if ((dbx != NULL) && ast_sigdb_has_sha256 (dbx, digest)) {
+        return AST_SIGDB_FORBIDDEN;
+    }
+    if ((db != NULL) && ast_sigdb_has_sha256 (db, digest)) {
+        return AST_SIGDB_ALLOWED;
+    }
+    return AST_SIGDB_UNKNOWN;
+}
+
+
+
+
+
+void ast_sigdb_free (struct ast_sigdb *db)
+{
+    free (db->slots);
+    ast_arena_free (&(db->arena));
+    ast_sigdb_init (db);
+}
+
+
+
+
+
+/**
+ * Which entries of a list are indexed, or _AST_SIGDB_EMPTY for none. A SHA-256 list whose entries are
+ * not exactly a digest is not indexed either.
+ */
+static int _ast_sigdb_kind (const struct ast_siglist *list)
+{
+    if (ast_guid_equal (&(list->type), &_ast_sigdb_sha256)) {
+        return (list->entrySize == sizeof (ast_guid) + AST_SHA256_SIZE) ? _AST_SIGDB_SHA256 : _AST_SIGDB_EMPTY;
+    }
+    if (ast_guid_equal (&(list->type), &_ast_sigdb_x509)) {
+        return _AST_SIGDB_X509;
+    }
+    return _AST_SIGDB_EMPTY;
+}
+
+
+
+
+
+static uint64_t _ast_sigdb_hash (enum _AST_SIGDB_KIND kind, const uint8_t *data, size_t size)
+{
+    uint64_t h = 0;
+
+    // A digest is already uniformly distributed: its first bytes are the hash.
+    if (kind == _AST_SIGDB_SHA256) {
+        memcpy (&h, data, sizeof (h));
+        return h;
+    }
+    // FNV-1a over the certificate.
+    return ast_fnv1a64 (AST_FNV1A64_INIT, data, size);
+}
+
+
+
+
+
+static const struct _ast_sigdb_slot *_ast_sigdb_find (const struct ast_sigdb *db, enum _AST_SIGDB_KIND kind, const uint8_t *data, size_t size, uint64_t hash)
+{
+    if (db->cap == 0) {
+        return NULL;
+    }
+    // Linear probing; the table is at most half full, so an empty slot ends every miss soon.
+    for (size_t i = hash & (db->cap - 1); ; i = (i + 1) & (db->cap - 1)) {
+        const struct _ast_sigdb_slot *slot = &(db->slots[i]);
+
+        if (slot->kind == _AST_SIGDB_EMPTY) {
+            return NULL;
+        }
+        if ((slot->hash == hash) && (slot->kind == (uint32_t) kind) && (slot->size == size) && (memcmp (slot->data, data, size) == 0)) {
+            return slot;
+        }
+    }
+}
+
+
+
+
+
+/**
+ * Make room for n more entries, keeping the table at most half full.
+ */
+static int _ast_sigdb_reserve (struct ast_sigdb *db, size_t n)
+{
+    struct _ast_sigdb_slot *slots = NULL;
+    size_t cap = (db->cap != 0) ? db->cap : AST_SIGDB_MIN_SLOTS;
+
+    while ((db->count + n) * 2 > cap) {
+        cap *= 2;
+    }
+    if (cap == db->cap) {
+        return AST_RETURN_SUCCESS;
+    }
+
+    slots = calloc (cap, sizeof (*slots));
+    if (slots == NULL) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+    for (size_t i = 0; i < db->cap; i++) {
+        if (db->slots[i].kind != _AST_SIGDB_EMPTY) {
+            size_t j = db->slots[i].hash & (cap - 1);
+
+            while (slots[j].kind != _AST_SIGDB_EMPTY) {
+                j = (j + 1) & (cap - 1);
+            }
+            slots[j] = db->slots[i];
+        }
+    }
+    free (db->slots);
+    db->slots = slots;
+    db->cap   = cap;
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+/**
+ * Add an entry to a table with room for it; an entry already there is not added again.
+ */
+static void _ast_sigdb_insert (struct ast_sigdb *db, enum _AST_SIGDB_KIND kind, const uint8_t *data, size_t size)
+{
+    uint64_t hash = _ast_sigdb_hash (kind, data, size);
+    size_t i = hash & (db->cap - 1);
+
+    if (_ast_sigdb_find (db, kind, data, size, hash) != NULL) {
+        return;
+    }
+    while (db->slots[i].kind != _AST_SIGDB_EMPTY) {
+        i = (i + 1) & (db->cap - 1);
+    }
+    db->slots[i].hash = hash;
+    db->slots[i].data = data;
+    db->slots[i].size = (uint32_t) size;
+    db->slots[i].kind = kind;
+    db->count++;
+}
@@ -0,0 +1,198 @@
+/**
+ * @file sigdb.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares views over signature databases (PK, KEK, db, dbx, ...) and a lookup index
+ * over them.
+ *
+ * A signature database is a sequence of EFI_SIGNATURE_LISTs: a type GUID, the list size, a type-specific
+ * header size, the size of each entry, the header, then EFI_SIGNATURE_DATA entries of that size (an owner
+ * GUID, then the signature: a SHA-256 digest, a DER certificate, ...). Lists and entries are views into the
+ * variable bytes; nothing is copied.
+ *
+ * An ast_sigdb indexes the SHA-256 and X.509 entries of one or more databases in an open-addressing hash
+ * table, so that asking whether a digest or certificate is in dbx is one probe (rarely a few) instead of a
+ * scan of every list. The table keeps pointers into the bytes it indexed; variables read with
+ * ast_sigdb_add_var are kept by the index itself.
+ */
+
+#ifndef _AST_SIGDB_H
+#define _AST_SIGDB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../guid/guid.h"
+#include "../arena/arena.h"
+#include "../crypto/sha256.h"
+#include "../firmware/firmware.h"
+
+/** Size of the fixed part of an EFI_SIGNATURE_LIST: SignatureType, then three UINT32 sizes. */
+#define AST_SIGNATURE_LIST_HEADER_SIZE 28
+
+/**
+ * One EFI_SIGNATURE_LIST.
+ */
+struct ast_siglist {
+    ast_guid      type;       /**< SignatureType, e.g. AST_GUID_CERT_SHA256. */
+    const uint8_t *header;    /**< Type-specific header. */
+    size_t        headerSize; /**< Size of the header. */
+    const uint8_t *entries;   /**< First EFI_SIGNATURE_DATA. */
+    size_t        entrySize;  /**< Size of each EFI_SIGNATURE_DATA, owner GUID included. */
+    size_t        nEntries;   /**< Number of entries. */
+};
+
+/**
+ * One EFI_SIGNATURE_DATA.
+ */
+struct ast_sig {
+    ast_guid      type;  /**< SignatureType of its list. */
+    ast_guid      owner; /**< SignatureOwner. */
+    const uint8_t *data; /**< Signature: a digest, a certificate, ... */
+    size_t        size;  /**< Size of the signature. */
+};
+
+/**
+ * List iterator over a signature database. Initialize with ast_siglist_iter_init; it can live on the stack.
+ */
+struct ast_siglist_iter {
+    const uint8_t *p;    /**< Next list */
+    size_t        left;  /**< Bytes left */
+};
+
+/**
+ * Lookup index. Zero-initialize it (or use ast_sigdb_init) before adding databases.
+ */
+struct ast_sigdb {
+    struct _ast_sigdb_slot *slots;     /**< Open-addressing table; capacity is a power of two. */
+    size_t                 cap;        /**< Number of slots. */
+    size_t                 count;      /**< Entries indexed (duplicates once). */
+    size_t                 nSkipped;   /**< Entries of other types (SHA-1, X.509 TBS hashes, ...), not indexed. */
+    struct ast_arena       arena;      /**< Variables read by ast_sigdb_add_var. */
+};
+
+/**
+ * Check a signature database and count its entries.
+ *
+ * @param data     [in]  Database bytes.
+ * @param size     [in]  Size of data. An empty database is valid.
+ * @param nEntries [out] Number of entries over all lists. May be NULL.
+ * @return AST_RETURN_SUCCESS, or AST_RETURN_INVALID_PARAMETER if a list is malformed.
+ */
+int ast_siglist_validate (const void *data, size_t size, size_t *nEntries);
+
+/**
+ * Start iterating the lists of a signature database.
+ *
+ * @param iter [out] Iterator.
+ * @param data [in]  Database bytes.
+ * @param size [in]  Size of data.
+ */
+void ast_siglist_iter_init (struct ast_siglist_iter *iter, const void *data, size_t size);
+
+/**
+ * Get the next list.
+ *
+ * @param iter [in]  Iterator.
+ * @param list [out] Next list.
+ * @return 1 if a list was stored, 0 at the end, or -1 if the next list is malformed.
+ */
+int ast_siglist_next (struct ast_siglist_iter *iter, struct ast_siglist *list);
+
+/**
+ * Get one entry of a list.
+ *
+ * @param list  [in]  List.
+ * @param index [in]  Entry index, below list->nEntries.
+ * @param sig   [out] Entry.
+ */
+void ast_siglist_entry (const struct ast_siglist *list, size_t index, struct ast_sig *sig);
+
+/**
+ * Whether a variable is a signature database: PK, KEK and the *Default variables in the global namespace,
+ * db, dbx, dbt and dbr in the image security database namespace, and shim's MokList* variables.
+ *
+ * @param guid [in] GUID namespace.
+ * @param name [in] Variable name.
+ * @return Nonzero if it is.
+ */
+int ast_siglist_is_database (const ast_guid *guid, const char *name);
+
+/**
+ * Prepare an empty index.
+ *
+ * @param db [out] Index.
+ */
+void ast_sigdb_init (struct ast_sigdb *db);
+
+/**
+ * Index the SHA-256 and X.509 entries of a signature database. The bytes are not copied and must stay
+ * valid as long as the index is used.
+ *
+ * @param db   [in] Index.
+ * @param data [in] Database bytes.
+ * @param size [in] Size of data.
+ * @return AST_RETURN_SUCCESS, AST_RETURN_INVALID_PARAMETER if the database is malformed (nothing is
+ *         indexed then), or AST_RETURN_OPERATION_FAILED if out of memory.
+ */
+int ast_sigdb_add (struct ast_sigdb *db, const void *data, size_t size);
+
+/**
+ * Read a variable through the current backend and index it; the index keeps the bytes.
+ *
+ * @param db   [in] Index.
+ * @param guid [in] GUID namespace.
+ * @param name [in] Variable name, e.g. "dbx".
+ * @return AST_RETURN_SUCCESS, or another AST_RETURN code (AST_RETURN_NOT_FOUND if there is no such variable).
+ */
+int ast_sigdb_add_var (struct ast_sigdb *db, const ast_guid *guid, const char *name);
+
+/**
+ * Whether a SHA-256 digest is listed (EFI_CERT_SHA256_GUID entries).
+ *
+ * @param db     [in] Index.
+ * @param digest [in] AST_SHA256_SIZE bytes.
+ * @return Nonzero if it is.
+ */
+int ast_sigdb_has_sha256 (const struct ast_sigdb *db, const uint8_t *digest);
+
+/**
+ * Whether a DER certificate is listed (EFI_CERT_X509_GUID entries), byte for byte.
+ *
+ * @param db   [in] Index.
+ * @param cert [in] Certificate.
+ * @param size [in] Size of the certificate.
+ * @return Nonzero if it is.
+ */
+int ast_sigdb_has_x509 (const struct ast_sigdb *db, const void *cert, size_t size);
+
+/**
+ * Verdicts of ast_sigdb_check_sha256.
+ */
+enum AST_SIGDB_VERDICT {
+    AST_SIGDB_UNKNOWN = 0, /**< Neither database lists the digest: only a signature check can tell. */
+    AST_SIGDB_ALLOWED,     /**< db lists the digest, and dbx does not. */
+    AST_SIGDB_FORBIDDEN    /**< dbx lists the digest. */
+};
+
+/**
+ * Tell whether firmware enforcing Secure Boot would run an image, by its digest alone: a digest in dbx
+ * is refused whatever signs the image, one in db is run.
+ *
+ * @param db     [in] Index of db. May be NULL.
+ * @param dbx    [in] Index of dbx. May be NULL.
+ * @param digest [in] Authenticode SHA-256 digest of the image (AST_SHA256_SIZE bytes).
+ * @return An AST_SIGDB_VERDICT.
+ */
+int ast_sigdb_check_sha256 (const struct ast_sigdb *db, const struct ast_sigdb *dbx, const uint8_t *digest);
+
+/**
+ * Free the table and the variables read by ast_sigdb_add_var. The index is empty afterwards.
+ *
+ * @param db [in] Index.
+ */
+void ast_sigdb_free (struct ast_sigdb *db);
+
+#endif /* end of include guard: _AST_SIGDB_H */
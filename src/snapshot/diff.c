@@ -0,0 +1,403 @@
+/**
+ * @file diff.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements diff.h.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "diff.h"
+#include "../firmware/firmware.h"
+#include "../loadopt/loadopt.h"
+#include "../loadopt/slot.h"
+#include "../sigdb/sigdb.h"
+#include "../util/hash.h"
+
+/**
+ * A signature and its sort key.
+ */
+struct _ast_diff_sig {
+    uint64_t                hash;
+    struct ast_snapshot_sig sig;
+};
+
+static const ast_guid _ast_diff_global = AST_GUID_EFI_GLOBAL;
+
+static int  _ast_diff_key_cmp (const struct ast_snapshot_var *a, const struct ast_snapshot_var *b);
+static int  _ast_diff_same_value (const struct ast_snapshot_var *a, const struct ast_snapshot_var *b, unsigned int flags);
+static int  _ast_diff_append (struct ast_snapshot_diff *diff, size_t *cap, const struct ast_snapshot_change *change);
+static enum AST_SNAPSHOT_KIND _ast_diff_kind (const struct ast_snapshot_var *var);
+static void _ast_diff_load_option (struct ast_snapshot_change *change);
+static int  _ast_diff_signatures (struct ast_snapshot_diff *diff, struct ast_snapshot_change *change);
+static int  _ast_diff_sigs_parse (const void *data, size_t size, struct _ast_diff_sig **sigs, size_t *nSigs);
+static int  _ast_diff_sig_cmp (const void *a, const void *b);
+static int  _ast_diff_region_equal (const struct ast_snapshot_var *a, size_t aOffset, size_t aLength,
+                                    const struct ast_snapshot_var *b, size_t bOffset, size_t bLength);
+
+
+
+
+
+int ast_snapshot_diff (const struct ast_snapshot *a, const struct ast_snapshot *b, unsigned int flags, struct ast_snapshot_diff *diff)
+{
+    size_t nA = ast_snapshot_count (a);
+    size_t nB = ast_snapshot_count (b);
+    size_t i = 0, j = 0, cap = 0;
+    struct ast_snapshot_var va, vb;
+
+    diff->nChanges = 0;
+    diff->changes  = NULL;
+    ast_arena_init (&(diff->arena), 0);
+
+    if (i < nA) {
+        ast_snapshot_get (a, i, &va);
+    }
+    if (j < nB) {
+        ast_snapshot_get (b, j, &vb);
+    }
+    while ((i < nA) || (j < nB)) {
+        struct ast_snapshot_change change;
+        int c = (i == nA) ? 1 : (j == nB) ? -1 : _ast_diff_key_cmp (&va, &vb);
+        int same = (c == 0) && _ast_diff_same_value (&va, &vb, flags);
+
+        memset (&change, 0, sizeof (change));
+        if (c < 0) {
+            change.type   = AST_SNAPSHOT_REMOVED;
+            change.before = va;
+        } else if (c > 0) {
+            change.type  = AST_SNAPSHOT_ADDED;
+            change.after = vb;
+        } else if (!same || (va.attr != vb.attr)) {
+            change.type   = AST_SNAPSHOT_MODIFIED;
+            change.before = va;
+            change.after  = vb;
+            change.fields = (va.attr != vb.attr) ? AST_SNAPSHOT_FIELD_ATTRIBUTES : 0;
+            if (same) {
+                // Only the attributes changed
+            } else if (_ast_diff_kind (&vb) == AST_SNAPSHOT_KIND_LOAD_OPTION) {
+                _ast_diff_load_option (&change);
+            } else if (_ast_diff_kind (&vb) == AST_SNAPSHOT_KIND_SIGNATURE_LIST) {
+                if (_ast_diff_signatures (diff, &change) != AST_RETURN_SUCCESS) {
+                    ast_snapshot_diff_free (diff);
+                    return AST_RETURN_OPERATION_FAILED;
+                }
+            } else {
+                change.fields |= AST_SNAPSHOT_FIELD_DATA;
+            }
+        }
+
+        if (((c != 0) || (change.type == AST_SNAPSHOT_MODIFIED)) && (_ast_diff_append (diff, &cap, &change) != AST_RETURN_SUCCESS)) {
+            ast_snapshot_diff_free (diff);
+            return AST_RETURN_OPERATION_FAILED;
+        }
+        if ((c <= 0) && (++i < nA)) {
+            ast_snapshot_get (a, i, &va);
+        }
+        if ((c >= 0) && (++j < nB)) {
+            ast_snapshot_get (b, j, &vb);
+        }
+    }
+
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+void ast_snapshot_diff_free (struct ast_snapshot_diff *diff)
+{
+    free (diff->changes);
+    diff->changes  = NULL;
+    diff->nChanges = 0;
+    ast_arena_free (&(diff->arena));
+}
+
+
+
+
+
+void ast_snapshot_diff_print (const struct ast_snapshot_diff *diff, FILE *out)
+{
+    static const struct {
+        unsigned int field;
+        const char   *name;
+    } fieldNames[] = {
+        { AST_SNAPSHOT_FIELD_ATTRIBUTES,      "attributes" },
+        { AST_SNAPSHOT_FIELD_DATA,            "data" },
+        { AST_SNAPSHOT_FIELD_LOAD_ATTRIBUTES, "load attributes" },
+        { AST_SNAPSHOT_FIELD_DESCRIPTION,     "description" },
+        { AST_SNAPSHOT_FIELD_FILE_PATH,       "file path" },
+        { AST_SNAPSHOT_FIELD_OPTIONAL_DATA,   "optional data" }
+    };
+
+    for (size_t i = 0; i < diff->nChanges; i++) {
+        const struct ast_snapshot_change *c = &(diff->changes[i]);
+        const struct ast_snapshot_var *var = (c->type == AST_SNAPSHOT_REMOVED) ? &(c->before) : &(c->after);
+        char guid[AST_GUID_STRLEN + 1];
+        const char *sep = " ";
+
+        ast_guid_format (&(var->guid), guid);
+        switch (c->type) {
+            case AST_SNAPSHOT_ADDED:
+                fprintf (out, "+ %s:%s (attributes %#x, %zu bytes)\n", guid, var->name, (unsigned int) var->attr, var->size);
+                break;
+            case AST_SNAPSHOT_REMOVED:
+                fprintf (out, "- %s:%s (attributes %#x, %zu bytes)\n", guid, var->name, (unsigned int) var->attr, var->size);
+                break;
+            case AST_SNAPSHOT_MODIFIED: // fall through
+            default:
+                fprintf (out, "~ %s:%s", guid, var->name);
+                for (size_t k = 0; k < sizeof (fieldNames) / sizeof (fieldNames[0]); k++) {
+                    if (c->fields & fieldNames[k].field) {
+                        fprintf (out, "%s%s", sep, fieldNames[k].name);
+                        sep = ", ";
+                    }
+                }
+                if (c->fields & AST_SNAPSHOT_FIELD_SIGNATURES) {
+                    fprintf (out, "%ssignatures +%zu -%zu", sep, c->nSigsAdded, c->nSigsRemoved);
+                }
+                fputc ('\n', out);
+                break;
+        }
+    }
+}
+
+
+
+
+
+static int _ast_diff_key_cmp (const struct ast_snapshot_var *a, const struct ast_snapshot_var *b)
+{
+    int c = memcmp (a->guid.b, b->guid.b, sizeof (a->guid.b));
+
+    return (c != 0) ? c : strcmp (a->name, b->name);
+}
+
+
+
+
+
+static int _ast_diff_same_value (const struct ast_snapshot_var *a, const struct ast_snapshot_var *b, unsigned int flags)
+{
+    // Differing hashes settle most changes without touching the values.
+    if ((a->size != b->size) || (a->hash != b->hash)) {
+        return 0;
+    }
+    if ((flags & AST_SNAPSHOT_DIFF_TRUST_HASH) || (a->data == b->data) || (a->size == 0)) {
+        return 1;
+    }
+    return memcmp (a->data, b->data, a->size) == 0;
+}
+
+
+
+
+
+static int _ast_diff_append (struct ast_snapshot_diff *diff, size_t *cap, const struct ast_snapshot_change *change)
+{
+    if (diff->nChanges == *cap) {
+        size_t newCap = *cap ? 2 * *cap : 16;
+        struct ast_snapshot_change *p = realloc (diff->changes, newCap * sizeof (struct ast_snapshot_change));
+        if (p == NULL) {
+            return AST_RETURN_OPERATION_FAILED;
+        }
+        diff->changes = p;
+        *cap = newCap;
+    }
+    diff->changes[diff->nChanges++] = *change;
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static enum AST_SNAPSHOT_KIND _ast_diff_kind (const struct ast_snapshot_var *var)
+{
+    enum AST_LOAD_OPTION_CLASS cls;
+    uint16_t slot = 0;
+
+    if (ast_siglist_is_database (&(var->guid), var->name)) {
+        return AST_SNAPSHOT_KIND_SIGNATURE_LIST;
+    }
+    if (ast_guid_equal (&(var->guid), &_ast_diff_global) && (ast_slot_parse_name (var->name, &cls, &slot) == AST_RETURN_SUCCESS)) {
+        return AST_SNAPSHOT_KIND_LOAD_OPTION;
+    }
+    return AST_SNAPSHOT_KIND_RAW;
+}
+
+
+
+
+
+static void _ast_diff_load_option (struct ast_snapshot_change *change)
+{
+    struct ast_load_option_view va, vb;
+
+    if ((ast_load_option_parse (change->before.data, change->before.size, &va) != AST_RETURN_SUCCESS) ||
+        (ast_load_option_parse (change->after.data, change->after.size, &vb) != AST_RETURN_SUCCESS)) {
+        change->fields |= AST_SNAPSHOT_FIELD_DATA; // Not a well formed load option on one side
+        return;
+    }
+
+    change->kind = AST_SNAPSHOT_KIND_LOAD_OPTION;
+    if (va.attributes != vb.attributes) {
+        change->fields |= AST_SNAPSHOT_FIELD_LOAD_ATTRIBUTES;
+    }
+    if (!_ast_diff_region_equal (&(change->before), va.descriptionOffset, va.descriptionLength, &(change->after), vb.descriptionOffset, vb.descriptionLength)) {
+        change->fields |= AST_SNAPSHOT_FIELD_DESCRIPTION;
+    }
+    if (!_ast_diff_region_equal (&(change->before), va.filePathListOffset, va.filePathListLength, &(change->after), vb.filePathListOffset, vb.filePathListLength)) {
+        change->fields |= AST_SNAPSHOT_FIELD_FILE_PATH;
+    }
+    if (!_ast_diff_region_equal (&(change->before), va.optionalDataOffset, va.optionalDataLength, &(change->after), vb.optionalDataOffset, vb.optionalDataLength)) {
+        change->fields |= AST_SNAPSHOT_FIELD_OPTIONAL_DATA;
+    }
+}
+
+
+
+
+
+static int _ast_diff_signatures (struct ast_snapshot_diff *diff, struct ast_snapshot_change *change)
+{
+    struct _ast_diff_sig *sa = NULL, *sb = NULL;
+    struct ast_snapshot_sig *added = NULL, *removed = NULL;
+    size_t na = 0, nb = 0, i = 0, j = 0;
+    int ret = AST_RETURN_SUCCESS;
+
+    ret = _ast_diff_sigs_parse (change->before.data, change->before.size, &sa, &na);
+    if (ret == AST_RETURN_SUCCESS) {
+        ret = _ast_diff_sigs_parse (change->after.data, change->after.size, &sb, &nb);
+    }
+    if (ret == AST_RETURN_INVALID_PARAMETER) {
+        change->fields |= AST_SNAPSHOT_FIELD_DATA; // Not well formed signature lists on one side
+        ret = AST_RETURN_SUCCESS;
+        goto out;
+    }
+    if (ret != AST_RETURN_SUCCESS) {
+        goto out;
+    }
+
+    // Both sides sorted the same way, then walked like the directories.
+    qsort (sa, na, sizeof (struct _ast_diff_sig), _ast_diff_sig_cmp);
+    qsort (sb, nb, sizeof (struct _ast_diff_sig), _ast_diff_sig_cmp);
+    added   = ast_arena_alloc (&(diff->arena), (nb + 1) * sizeof (struct ast_snapshot_sig));
+    removed = ast_arena_alloc (&(diff->arena), (na + 1) * sizeof (struct ast_snapshot_sig));
+    if ((added == NULL) || (removed == NULL)) {
+        ret = AST_RETURN_OPERATION_FAILED;
+        goto out;
+    }
+    while ((i < na) || (j < nb)) {
+        int c = (i == na) ? 1 : (j == nb) ? -1 : _ast_diff_sig_cmp (&(sa[i]), &(sb[j]));
+
+        if (c < 0) {
+            removed[change->nSigsRemoved++] = sa[i++].sig;
+        } else if (c > 0) {
+            added[change->nSigsAdded++] = sb[j++].sig;
+        } else {
+            i++;
+            j++;
+        }
+    }
+
+    change->kind        = AST_SNAPSHOT_KIND_SIGNATURE_LIST;
+    change->sigsAdded   = added;
+    change->sigsRemoved = removed;
+    if ((change->nSigsAdded != 0) || (change->nSigsRemoved != 0)) {
+        change->fields |= AST_SNAPSHOT_FIELD_SIGNATURES;
+    } else {
+        // Same signatures, but ordered, grouped or padded differently.
+        change->fields |= AST_SNAPSHOT_FIELD_DATA;
+    }
+
+out:
+    free (sa);
+    free (sb);
+    return ret;
+}
+
+
+
+
+
+static int _ast_diff_sigs_parse (const void *data, size_t size, struct _ast_diff_sig **sigs, size_t *nSigs)
+{
+    struct ast_siglist_iter iter;
+    struct ast_siglist list;
+    size_t n = 0, k = 0;
+
+    *sigs  = NULL;
+    *nSigs = 0;
+
+    if (ast_siglist_validate (data, size, &n) != AST_RETURN_SUCCESS) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    *sigs = malloc ((n + 1) * sizeof (struct _ast_diff_sig));
+    if (*sigs == NULL) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+    ast_siglist_iter_init (&iter, data, size);
+    while (ast_siglist_next (&iter, &list) > 0) {
+        for (size_t e = 0; e < list.nEntries; e++) {
+            struct _ast_diff_sig *sig = &((*sigs)[k++]);
+            const uint8_t *p = list.entries + e * list.entrySize;
+            struct ast_sig entry;
+
+            ast_siglist_entry (&list, e, &entry);
+            sig->sig.type  = entry.type;
+            sig->sig.owner = entry.owner;
+            sig->sig.data  = entry.data;
+            sig->sig.size  = entry.size;
+            // FNV-1a over the type and the whole signature, owner included.
+            sig->hash = ast_fnv1a64 (ast_fnv1a64 (AST_FNV1A64_INIT, list.type.b, sizeof (list.type.b)), p, list.entrySize);
+        }
+    }
+
+    *nSigs = n;
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static int _ast_diff_sig_cmp (const void *a, const void *b)
+{
+    const struct _ast_diff_sig *x = a;
+    const struct _ast_diff_sig *y = b;
+    int c = 0;
+
+    if (x->hash != y->hash) {
+        return (x->hash < y->hash) ? -1 : 1;
+    }
+    if (x->sig.size != y->sig.size) {
+        return (x->sig.size < y->sig.size) ? -1 : 1;
+    }
+    c = memcmp (x->sig.type.b, y->sig.type.b, sizeof (x->sig.type.b));
+    if (c == 0) {
+        c = memcmp (x->sig.owner.b, y->sig.owner.b, sizeof (x->sig.owner.b));
+    }
+    if ((c == 0) && (x->sig.size != 0)) {
+        c = memcmp (x->sig.data, y->sig.data, x->sig.size);
+    }
+    return c;
+}
+
+
+
+
+
+static int _ast_diff_region_equal (const struct ast_snapshot_var *a, size_t aOffset, size_t aLength,
+                                   const struct ast_snapshot_var *b, size_t bOffset, size_t bLength)
+{
+    if (aLength != bLength) {
+        return 0;
+    }
+    return (aLength == 0) || (memcmp ((const uint8_t *) a->data + aOffset, (const uint8_t *) b->data + bOffset, aLength) == 0);
+}
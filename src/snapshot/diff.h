@@ -0,0 +1,124 @@
+/**
+ * @file diff.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares the comparison of two snapshots.
+ *
+ * Both directories are sorted the same way, so they are walked side by side once. A value is only read
+ * when the stored hashes and sizes of both sides agree (to confirm they are really equal) or when the
+ * variable is decoded to tell which fields changed: load options (Boot####, Driver####, SysPrep####) and
+ * signature lists (PK, KEK, db, dbx, dbt, dbr, their defaults, and shim's MokList variables).
+ */
+
+#ifndef _AST_SNAPSHOT_DIFF_H
+#define _AST_SNAPSHOT_DIFF_H
+
+#include <stdio.h>
+#include "snapshot.h"
+#include "../arena/arena.h"
+
+/** Flag for ast_snapshot_diff: values with equal hashes and sizes are equal, without comparing their bytes. */
+#define AST_SNAPSHOT_DIFF_TRUST_HASH 0x00000001
+
+/**
+ * @defgroup SnapshotDiffFields Changed fields of a modified variable
+ * @{
+ */
+#define AST_SNAPSHOT_FIELD_ATTRIBUTES      0x00000001 /**< Variable attributes. */
+#define AST_SNAPSHOT_FIELD_DATA            0x00000002 /**< Value of a variable that is not decoded. */
+#define AST_SNAPSHOT_FIELD_LOAD_ATTRIBUTES 0x00000004 /**< Load option attributes. */
+#define AST_SNAPSHOT_FIELD_DESCRIPTION     0x00000008 /**< Load option description. */
+#define AST_SNAPSHOT_FIELD_FILE_PATH       0x00000010 /**< Load option device path list. */
+#define AST_SNAPSHOT_FIELD_OPTIONAL_DATA   0x00000020 /**< Load option optional data. */
+#define AST_SNAPSHOT_FIELD_SIGNATURES      0x00000040 /**< Signatures added to or removed from a signature list. */
+/** @} */
+
+/**
+ * Kinds of change.
+ */
+enum AST_SNAPSHOT_CHANGE {
+    AST_SNAPSHOT_ADDED = 0, /**< Only in the second snapshot. */
+    AST_SNAPSHOT_REMOVED,   /**< Only in the first snapshot. */
+    AST_SNAPSHOT_MODIFIED   /**< In both, with a different value or attributes. */
+};
+
+/**
+ * How a modified variable was compared.
+ */
+enum AST_SNAPSHOT_KIND {
+    AST_SNAPSHOT_KIND_RAW = 0,        /**< As bytes. */
+    AST_SNAPSHOT_KIND_LOAD_OPTION,    /**< Field by field as an EFI_LOAD_OPTION. */
+    AST_SNAPSHOT_KIND_SIGNATURE_LIST  /**< Signature by signature as EFI_SIGNATURE_LISTs. */
+};
+
+/**
+ * One signature of a signature list. Pointers are into a snapshot.
+ */
+struct ast_snapshot_sig {
+    ast_guid   type;  /**< Signature type of the list, e.g. AST_GUID_CERT_SHA256. */
+    ast_guid   owner; /**< SignatureOwner. */
+    const void *data; /**< SignatureData. */
+    size_t     size;  /**< Size of SignatureData in bytes. */
+};
+
+/**
+ * One changed variable.
+ */
+struct ast_snapshot_change {
+    enum AST_SNAPSHOT_CHANGE type;              /**< Kind of change. */
+    enum AST_SNAPSHOT_KIND   kind;              /**< How the values were compared (modified variables only). */
+    struct ast_snapshot_var  before;            /**< Variable in the first snapshot, zeroed if added. */
+    struct ast_snapshot_var  after;             /**< Variable in the second snapshot, zeroed if removed. */
+    unsigned int             fields;            /**< AST_SNAPSHOT_FIELD_* bits (modified variables only). */
+    const struct ast_snapshot_sig *sigsAdded;   /**< Signatures only in after (signature lists only). */
+    size_t                   nSigsAdded;        /**< Number of sigsAdded. */
+    const struct ast_snapshot_sig *sigsRemoved; /**< Signatures only in before (signature lists only). */
+    size_t                   nSigsRemoved;      /**< Number of sigsRemoved. */
+};
+
+/**
+ * Differences between two snapshots. Zero-initialize it before ast_snapshot_diff.
+ */
+struct ast_snapshot_diff {
+    size_t                     nChanges; /**< Number of changes. */
+    struct ast_snapshot_change *changes; /**< Changes, in directory order. */
+    struct ast_arena           arena;    /**< Holds the signature arrays. */
+};
+
+/**
+ * Compare two snapshots.
+ *
+ * Both snapshots must stay open while diff is used; the changes point into them.
+ *
+ * @param a     [in]  First (older) snapshot.
+ * @param b     [in]  Second (newer) snapshot.
+ * @param flags [in]  AST_SNAPSHOT_DIFF_* flags.
+ * @param diff  [out] Differences, to free with ast_snapshot_diff_free.
+ * @return AST_RETURN_SUCCESS, or AST_RETURN_OPERATION_FAILED on allocation failure.
+ */
+int ast_snapshot_diff (const struct ast_snapshot *a, const struct ast_snapshot *b, unsigned int flags, struct ast_snapshot_diff *diff);
+
+/**
+ * Free the memory held by a diff.
+ *
+ * @param diff [in] Diff filled by ast_snapshot_diff.
+ */
+void ast_snapshot_diff_free (struct ast_snapshot_diff *diff);
+
+/**
+ * Print a diff, one line per change:
+ *
+ *     + GUID:Name (attributes, size)
+ *     - GUID:Name
+ *     ~ GUID:Name description, file path
+ *     ~ GUID:Name signatures +2 -0
+ *
+ * @param diff [in] Diff.
+ * @param out  [in] Stream to write to.
+ */
+void ast_snapshot_diff_print (const struct ast_snapshot_diff *diff, FILE *out);
+
+#endif /* end of include guard: _AST_SNAPSHOT_DIFF_H */
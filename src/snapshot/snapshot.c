@@ -0,0 +1,771 @@
+/**
+ * @file snapshot.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements snapshot.h.
+ *
+ * The file layout is read through the structures below, straight from the mapping, so the format is only
+ * usable on little endian machines (which is every machine with UEFI variables to read). Opening checks
+ * every directory entry once; after that, lookups and the backend trust the offsets.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "snapshot.h"
+#include "../firmware/firmware.h"
+#include "../firmware/backend.h"
+#include "../arena/arena.h"
+#include "../crypto/crc32.h"
+#include "../util/hash.h"
+
+#if defined (__BYTE_ORDER__) && (__BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__)
+#error "The snapshot format is read in place and needs a little endian machine."
+#endif
+
+#define AST_SNAPSHOT_MAGIC "ASTSNAP"
+
+struct _ast_snapshot_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t fileSize;
+    uint64_t captureTime;
+    uint32_t nEntries;
+    uint32_t nSlots;
+    uint64_t dirOffset;
+    uint64_t indexOffset;
+    uint64_t dataOffset;
+    uint32_t crc;
+    uint32_t entrySize;
+};
+
+struct _ast_snapshot_entry {
+    ast_guid guid;
+    uint32_t attr;
+    uint32_t keyHash;
+    uint32_t nameSize;
+    uint32_t dataSize;
+    uint64_t nameOffset;
+    uint64_t dataOffset;
+    uint64_t dataHash;
+};
+
+_Static_assert (sizeof (struct _ast_snapshot_header) == 72, "snapshot header layout");
+_Static_assert (sizeof (struct _ast_snapshot_entry) == 56, "snapshot entry layout");
+
+struct ast_snapshot {
+    const uint8_t *base;
+    size_t        size;
+    size_t        nEntries;
+    size_t        entrySize;
+    const uint8_t *dir;
+    const uint32_t *slots;
+    size_t        nSlots;
+    uint64_t      captureTime;
+    int           mapped;
+#ifdef _WIN32
+    HANDLE        file;
+    HANDLE        mapping;
+#endif
+};
+
+/**
+ * A variable being captured.
+ */
+struct _ast_snapshot_rec {
+    ast_guid   guid;
+    const char *name;
+    size_t     nameSiz;
+    uint32_t   attr;
+    const void *data;
+    size_t     size;
+};
+
+static uint64_t _ast_snapshot_key_hash (const ast_guid *guid, const char *name, size_t nameSiz);
+static int      _ast_snapshot_rec_cmp (const void *a, const void *b);
+static int      _ast_snapshot_write_file (const char *path, const void *data, size_t size);
+static int      _ast_snapshot_check (struct ast_snapshot *s, unsigned int flags);
+static const struct _ast_snapshot_entry *_ast_snapshot_entry (const struct ast_snapshot *s, size_t i);
+static void     _ast_snapshot_view (const struct ast_snapshot *s, const struct _ast_snapshot_entry *e, struct ast_snapshot_var *var);
+
+static int  _ast_snapshot_backend_read (void *ctx, const ast_guid *guid, const char *name, void *buf, size_t bufSiz, size_t *nBytes, uint32_t *attr);
+static int  _ast_snapshot_backend_write (void *ctx, const ast_guid *guid, const char *name, const void *buf, size_t bufSiz, uint32_t attr);
+static int  _ast_snapshot_backend_iter_open (void *ctx, unsigned int flags, void **it);
+static int  _ast_snapshot_backend_iter_next (void *ctx, void *it, struct ast_efivar_info *infos, size_t cap, size_t *n);
+static void _ast_snapshot_backend_iter_close (void *ctx, void *it);
+static void _ast_snapshot_backend_destroy (struct ast_efivar_backend *backend);
+
+#define _AST_ALIGN8(x) (((x) + 7) & ~(uint64_t) 7)
+
+
+
+
+
+int ast_snapshot_capture (const char *path, size_t *nVars)
+{
+    struct ast_arena arena;
+    struct ast_efivar_iter *iter = NULL;
+    struct ast_efivar_info infos[32];
+    struct _ast_snapshot_rec *recs = NULL;
+    struct _ast_snapshot_header *hdr = NULL;
+    struct timespec now;
+    size_t nRecs = 0, capRecs = 0, n = 0, nSlots = 1;
+    uint64_t off = 0, dataOff = 0;
+    uint32_t *slots = NULL;
+    uint8_t *file = NULL;
+    int ret = AST_RETURN_SUCCESS;
+
+    if (nVars != NULL) {
+        *nVars = 0;
+    }
+    if (path == NULL) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    ast_arena_init (&arena, 0);
+    ret = ast_efivar_iter_open (&iter, AST_EFIVAR_ITER_ATTRIBUTES);
+    if (ret != AST_RETURN_SUCCESS) {
+        return ret;
+    }
+    do {
+        ret = ast_efivar_iter_next (iter, infos, sizeof (infos) / sizeof (infos[0]), &n);
+        for (size_t i = 0; (ret == AST_RETURN_SUCCESS) && (i < n); i++) {
+            struct _ast_snapshot_rec *r = NULL;
+            size_t nameSiz = strlen (infos[i].name);
+            char   *name = ast_arena_alloc (&arena, nameSiz + 1);
+            void   *data = NULL;
+
+            if (nRecs == capRecs) {
+                struct _ast_snapshot_rec *p = realloc (recs, (capRecs ? 2 * capRecs : 64) * sizeof (struct _ast_snapshot_rec));
+                if (p == NULL) {
+                    ret = AST_RETURN_OPERATION_FAILED;
+                    break;
+                }
+                recs = p;
+                capRecs = capRecs ? 2 * capRecs : 64;
+            }
+            if (name == NULL) {
+                ret = AST_RETURN_OPERATION_FAILED;
+                break;
+            }
+            memcpy (name, infos[i].name, nameSiz + 1);
+
+            r = &(recs[nRecs]);
+            r->guid    = infos[i].guid;
+            r->name    = name;
+            r->nameSiz = nameSiz;
+            r->attr    = infos[i].attr;
+            if (infos[i].data != NULL) {
+                // The backend holds the value already; copy it before the iterator goes away.
+                data = ast_arena_alloc (&arena, infos[i].size);
+                if ((data == NULL) && (infos[i].size != 0)) {
+                    ret = AST_RETURN_OPERATION_FAILED;
+                    break;
+                }
+                memcpy (data, infos[i].data, infos[i].size);
+                r->size = infos[i].size;
+            } else {
+                ret = ast_read_efivar_alloc (&arena, &(infos[i].guid), name, &data, &(r->size), &(r->attr));
+                if (ret == AST_RETURN_NOT_FOUND) {
+                    // Deleted since it was listed.
+                    ret = AST_RETURN_SUCCESS;
+                    continue;
+                }
+                if (ret != AST_RETURN_SUCCESS) {
+                    fprintf (stderr, " ** Cannot read efivar %s for the snapshot (error %d).\n", name, ret);
+                    break;
+                }
+            }
+            r->data = data;
+            nRecs++;
+        }
+    } while ((ret == AST_RETURN_SUCCESS) && (n != 0));
+    ast_efivar_iter_close (iter);
+    if (ret != AST_RETURN_SUCCESS) {
+        goto out;
+    }
+
+    // Sort, and keep the first of any duplicate a backend might list twice.
+    if (nRecs != 0) {
+        size_t kept = 1;
+
+        qsort (recs, nRecs, sizeof (struct _ast_snapshot_rec), _ast_snapshot_rec_cmp);
+        for (size_t i = 1; i < nRecs; i++) {
+            if (_ast_snapshot_rec_cmp (&(recs[kept - 1]), &(recs[i])) != 0) {
+                recs[kept++] = recs[i];
+            }
+        }
+        nRecs = kept;
+    }
+    if (nRecs > UINT32_MAX / 4) {
+        ret = AST_RETURN_OPERATION_FAILED;
+        goto out;
+    }
+
+    // Lay the file out.
+    while (nSlots < 2 * nRecs) {
+        nSlots <<= 1;
+    }
+    off = sizeof (struct _ast_snapshot_header) + nRecs * sizeof (struct _ast_snapshot_entry);
+    off = _AST_ALIGN8 (off + nSlots * sizeof (uint32_t));
+    dataOff = off;
+    for (size_t i = 0; i < nRecs; i++) {
+        off = _AST_ALIGN8 (off + recs[i].nameSiz + 1);
+        off = _AST_ALIGN8 (off + recs[i].size);
+    }
+
+    file = calloc (1, off);
+    if (file == NULL) {
+        ret = AST_RETURN_OPERATION_FAILED;
+        goto out;
+    }
+    clock_gettime (CLOCK_REALTIME, &now);
+
+    hdr = (struct _ast_snapshot_header *) file;
+    memcpy (hdr->magic, AST_SNAPSHOT_MAGIC, sizeof (AST_SNAPSHOT_MAGIC));
+    hdr->version     = AST_SNAPSHOT_VERSION;
+    hdr->headerSize  = sizeof (struct _ast_snapshot_header);
+    hdr->fileSize    = off;
+    hdr->captureTime = (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+    hdr->nEntries    = (uint32_t) nRecs;
+    hdr->nSlots      = (uint32_t) nSlots;
+    hdr->dirOffset   = sizeof (struct _ast_snapshot_header);
+    hdr->indexOffset = hdr->dirOffset + nRecs * sizeof (struct _ast_snapshot_entry);
+    hdr->dataOffset  = dataOff;
+    hdr->entrySize   = sizeof (struct _ast_snapshot_entry);
+
+    slots = (uint32_t *) (file + hdr->indexOffset);
+    off = dataOff;
+    for (size_t i = 0; i < nRecs; i++) {
+        struct _ast_snapshot_entry *e = (struct _ast_snapshot_entry *) (file + hdr->dirOffset) + i;
+        uint64_t h = _ast_snapshot_key_hash (&(recs[i].guid), recs[i].name, recs[i].nameSiz);
+        size_t   s = (size_t) h & (nSlots - 1);
+
+        e->guid       = recs[i].guid;
+        e->attr       = recs[i].attr;
+        e->keyHash    = (uint32_t) h;
+        e->nameSize   = (uint32_t) recs[i].nameSiz;
+        e->dataSize   = (uint32_t) recs[i].size;
+        e->nameOffset = off;
+        memcpy (file + off, recs[i].name, recs[i].nameSiz + 1);
+        off = _AST_ALIGN8 (off + recs[i].nameSiz + 1);
+        e->dataOffset = off;
+        if (recs[i].size != 0) {
+            memcpy (file + off, recs[i].data, recs[i].size);
+        }
+        e->dataHash   = ast_fnv1a64 (AST_FNV1A64_INIT, recs[i].data, recs[i].size);
+        off = _AST_ALIGN8 (off + recs[i].size);
+
+        while (slots[s] != 0) {
+            s = (s + 1) & (nSlots - 1);
+        }
+        slots[s] = (uint32_t) (i + 1);
+    }
+    hdr->crc = ast_crc32 (0, file, hdr->fileSize);
+
+    ret = _ast_snapshot_write_file (path, file, hdr->fileSize);
+    if ((ret == AST_RETURN_SUCCESS) && (nVars != NULL)) {
+        *nVars = nRecs;
+    }
+
+out:
+    free (file);
+    free (recs);
+    ast_arena_free (&arena);
+    return ret;
+}
+
+
+
+
+
+int ast_snapshot_open (const char *path, unsigned int flags, struct ast_snapshot **snap)
+{
+    struct ast_snapshot *s = NULL;
+    int ret = AST_RETURN_SUCCESS;
+
+    if ((path == NULL) || (snap == NULL)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    s = calloc (1, sizeof (struct ast_snapshot));
+    if (s == NULL) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+
+#ifdef _WIN32
+    {
+        LARGE_INTEGER size;
+
+        s->file = CreateFileA (path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (s->file == INVALID_HANDLE_VALUE) {
+            free (s);
+            return (GetLastError () == ERROR_FILE_NOT_FOUND) ? AST_RETURN_NOT_FOUND : AST_RETURN_ACCESS_DENIED;
+        }
+        if (!GetFileSizeEx (s->file, &size) || (size.QuadPart < (LONGLONG) sizeof (struct _ast_snapshot_header))) {
+            CloseHandle (s->file);
+            free (s);
+            return AST_RETURN_INVALID_PARAMETER;
+        }
+        s->size    = (size_t) size.QuadPart;
+        s->mapping = CreateFileMappingA (s->file, NULL, PAGE_READONLY, 0, 0, NULL);
+        s->base    = (s->mapping != NULL) ? MapViewOfFile (s->mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+        if (s->base == NULL) {
+            fprintf (stderr, " ** Cannot map snapshot %s (error %lu).\n", path, GetLastError ());
+            if (s->mapping != NULL) {
+                CloseHandle (s->mapping);
+            }
+            CloseHandle (s->file);
+            free (s);
+            return AST_RETURN_OPERATION_FAILED;
+        }
+    }
+#else
+    {
+        struct stat st;
+        void *p = NULL;
+        int fd = open (path, O_RDONLY | O_CLOEXEC);
+
+        if (fd < 0) {
+            free (s);
+            return (errno == ENOENT) ? AST_RETURN_NOT_FOUND : AST_RETURN_ACCESS_DENIED;
+        }
+        if ((fstat (fd, &st) != 0) || (st.st_size < (off_t) sizeof (struct _ast_snapshot_header))) {
+            close (fd);
+            free (s);
+            return AST_RETURN_INVALID_PARAMETER;
+        }
+        s->size = (size_t) st.st_size;
+        p = mmap (NULL, s->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close (fd);
+        if (p == MAP_FAILED) {
+            fprintf (stderr, " ** Cannot map snapshot %s: %s.\n", path, strerror (errno));
+            free (s);
+            return AST_RETURN_OPERATION_FAILED;
+        }
+        s->base = p;
+    }
+#endif
+    s->mapped = 1;
+
+    ret = _ast_snapshot_check (s, flags);
+    if (ret != AST_RETURN_SUCCESS) {
+        ast_snapshot_close (s);
+        return ret;
+    }
+    *snap = s;
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+int ast_snapshot_open_memory (const void *data, size_t size, unsigned int flags, struct ast_snapshot **snap)
+{
+    struct ast_snapshot *s = NULL;
+    int ret = AST_RETURN_SUCCESS;
+
+    if ((data == NULL) || (snap == NULL) || (((uintptr_t) data & 7) != 0)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    s = calloc (1, sizeof (struct ast_snapshot));
+    if (s == NULL) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+    s->base = data;
+    s->size = size;
+
+    ret = _ast_snapshot_check (s, flags);
+    if (ret != AST_RETURN_SUCCESS) {
+        free (s);
+        return ret;
+    }
+    *snap = s;
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+void ast_snapshot_close (struct ast_snapshot *snap)
+{
+    if (snap == NULL) {
+        return;
+    }
+    if (snap->mapped) {
+#ifdef _WIN32
+        UnmapViewOfFile (snap->base);
+        CloseHandle (snap->mapping);
+        CloseHandle (snap->file);
+#else
+        munmap ((void *) snap->base, snap->size);
+#endif
+    }
+    free (snap);
+}
+
+
+
+
+
+size_t ast_snapshot_count (const struct ast_snapshot *snap)
+{
+    return snap->nEntries;
+}
+
+
+
+
+
+uint64_t ast_snapshot_time (const struct ast_snapshot *snap)
+{
+    return snap->captureTime;
+}
+
+
+
+
+
+int ast_snapshot_get (const struct ast_snapshot *snap, size_t i, struct ast_snapshot_var *var)
+{
+    if ((snap == NULL) || (var == NULL) || (i >= snap->nEntries)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    _ast_snapshot_view (snap, _ast_snapshot_entry (snap, i), var);
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+int ast_snapshot_find (const struct ast_snapshot *snap, const ast_guid *guid, const char *name, struct ast_snapshot_var *var)
+{
+    size_t   nameSiz = 0;
+    uint64_t h = 0;
+    size_t   s = 0;
+
+    if ((snap == NULL) || (guid == NULL) || (name == NULL)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    nameSiz = strlen (name);
+    h = _ast_snapshot_key_hash (guid, name, nameSiz);
+    s = (size_t) h & (snap->nSlots - 1);
+    // Bounded, in case a damaged index has no empty slot.
+    for (size_t probes = 0; (probes < snap->nSlots) && (snap->slots[s] != 0); probes++) {
+        const struct _ast_snapshot_entry *e = _ast_snapshot_entry (snap, snap->slots[s] - 1);
+
+        if ((e->keyHash == (uint32_t) h) && (e->nameSize == nameSiz) && (memcmp (e->guid.b, guid->b, sizeof (guid->b)) == 0) &&
+            (memcmp (snap->base + e->nameOffset, name, nameSiz) == 0)) {
+            if (var != NULL) {
+                _ast_snapshot_view (snap, e, var);
+            }
+            return AST_RETURN_SUCCESS;
+        }
+        s = (s + 1) & (snap->nSlots - 1);
+    }
+    return AST_RETURN_NOT_FOUND;
+}
+
+
+
+
+
+struct ast_efivar_backend *ast_efivar_backend_snapshot_new (const char *path)
+{
+    struct ast_efivar_backend *backend = calloc (1, sizeof (struct ast_efivar_backend));
+    struct ast_snapshot *snap = NULL;
+    int ret = AST_RETURN_SUCCESS;
+
+    if (backend == NULL) {
+        return NULL;
+    }
+    ret = ast_snapshot_open (path, 0, &snap);
+    if (ret != AST_RETURN_SUCCESS) {
+        fprintf (stderr, " ** Cannot open snapshot %s (error %d).\n", (path != NULL) ? path : "(null)", ret);
+        free (backend);
+        return NULL;
+    }
+
+    backend->name       = "snapshot";
+    backend->ctx        = snap;
+    backend->read       = _ast_snapshot_backend_read;
+    backend->read_batch = NULL;
+    backend->write      = _ast_snapshot_backend_write;
+    backend->iter_open  = _ast_snapshot_backend_iter_open;
+    backend->iter_next  = _ast_snapshot_backend_iter_next;
+    backend->iter_close = _ast_snapshot_backend_iter_close;
+    backend->destroy    = _ast_snapshot_backend_destroy;
+    return backend;
+}
+
+
+
+
+
+static int _ast_snapshot_check (struct ast_snapshot *s, unsigned int flags)
+{
+    const struct _ast_snapshot_header *hdr = (const struct _ast_snapshot_header *) s->base;
+    const char *prev = NULL;
+
+    if ((s->size < sizeof (struct _ast_snapshot_header)) || (memcmp (hdr->magic, AST_SNAPSHOT_MAGIC, sizeof (AST_SNAPSHOT_MAGIC)) != 0) ||
+        (hdr->version != AST_SNAPSHOT_VERSION) || (hdr->fileSize != s->size) ||
+        (hdr->headerSize < sizeof (struct _ast_snapshot_header)) || (hdr->entrySize < sizeof (struct _ast_snapshot_entry)) ||
+        ((hdr->entrySize & 7) != 0) || ((hdr->dirOffset & 7) != 0) || ((hdr->indexOffset & 3) != 0)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    if ((hdr->nSlots == 0) || ((hdr->nSlots & (hdr->nSlots - 1)) != 0) || (hdr->nSlots <= hdr->nEntries) ||
+        (hdr->dirOffset < hdr->headerSize) || (hdr->dirOffset > s->size) ||
+        ((s->size - hdr->dirOffset) / hdr->entrySize < hdr->nEntries) ||
+        (hdr->indexOffset > s->size) || ((s->size - hdr->indexOffset) / sizeof (uint32_t) < hdr->nSlots)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    if (flags & AST_SNAPSHOT_VERIFY) {
+        uint32_t zero = 0;
+        uint32_t crc = ast_crc32 (0, s->base, offsetof (struct _ast_snapshot_header, crc));
+
+        crc = ast_crc32 (crc, &zero, sizeof (zero));
+        crc = ast_crc32 (crc, s->base + offsetof (struct _ast_snapshot_header, crc) + sizeof (zero),
+                         s->size - offsetof (struct _ast_snapshot_header, crc) - sizeof (zero));
+        if (crc != hdr->crc) {
+            return AST_RETURN_INVALID_PARAMETER;
+        }
+    }
+
+    s->nEntries    = hdr->nEntries;
+    s->entrySize   = hdr->entrySize;
+    s->dir         = s->base + hdr->dirOffset;
+    s->slots       = (const uint32_t *) (s->base + hdr->indexOffset);
+    s->nSlots      = hdr->nSlots;
+    s->captureTime = hdr->captureTime;
+
+    for (size_t i = 0; i < s->nSlots; i++) {
+        if (s->slots[i] > s->nEntries) {
+            return AST_RETURN_INVALID_PARAMETER;
+        }
+    }
+    for (size_t i = 0; i < s->nEntries; i++) {
+        const struct _ast_snapshot_entry *e = _ast_snapshot_entry (s, i);
+        const char *name = (const char *) s->base + e->nameOffset;
+
+        if ((e->nameOffset > s->size) || (s->size - e->nameOffset <= e->nameSize) || (e->nameSize >= AST_EFIVAR_NAME_MAX) ||
+            (memchr (name, '\0', e->nameSize + 1) != name + e->nameSize) ||
+            (e->dataOffset > s->size) || (s->size - e->dataOffset < e->dataSize)) {
+            return AST_RETURN_INVALID_PARAMETER;
+        }
+        // Strictly sorted, so keys are unique and diffs can merge-walk.
+        if (i != 0) {
+            const struct _ast_snapshot_entry *p = _ast_snapshot_entry (s, i - 1);
+            int c = memcmp (p->guid.b, e->guid.b, sizeof (e->guid.b));
+            if ((c > 0) || ((c == 0) && (strcmp (prev, name) >= 0))) {
+                return AST_RETURN_INVALID_PARAMETER;
+            }
+        }
+        prev = name;
+    }
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static const struct _ast_snapshot_entry *_ast_snapshot_entry (const struct ast_snapshot *s, size_t i)
+{
+    return (const struct _ast_snapshot_entry *) (s->dir + i * s->entrySize);
+}
+
+
+
+
+
+static void _ast_snapshot_view (const struct ast_snapshot *s, const struct _ast_snapshot_entry *e, struct ast_snapshot_var *var)
+{
+    var->guid = e->guid;
+    var->name = (const char *) s->base + e->nameOffset;
+    var->attr = e->attr;
+    var->data = s->base + e->dataOffset;
+    var->size = e->dataSize;
+    var->hash = e->dataHash;
+}
+
+
+
+
+
+static uint64_t _ast_snapshot_key_hash (const ast_guid *guid, const char *name, size_t nameSiz)
+{
+    return ast_fnv1a64 (ast_fnv1a64 (AST_FNV1A64_INIT, guid->b, sizeof (guid->b)), name, nameSiz);
+}
+
+
+
+
+
+static int _ast_snapshot_rec_cmp (const void *a, const void *b)
+{
+    const struct _ast_snapshot_rec *x = a;
+    const struct _ast_snapshot_rec *y = b;
+    int c = memcmp (x->guid.b, y->guid.b, sizeof (x->guid.b));
+
+    return (c != 0) ? c : strcmp (x->name, y->name);
+}
+
+
+
+
+
+static int _ast_snapshot_write_file (const char *path, const void *data, size_t size)
+{
+    size_t tmpSiz = strlen (path) + sizeof (".tmp");
+    char   *tmp = malloc (tmpSiz);
+    FILE   *fp = NULL;
+    int    ok = 0;
+
+    if (tmp == NULL) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+    snprintf (tmp, tmpSiz, "%s.tmp", path);
+
+    fp = fopen (tmp, "wb");
+    if (fp == NULL) {
+        fprintf (stderr, " ** Cannot create snapshot %s.\n", tmp);
+        free (tmp);
+        return AST_RETURN_ACCESS_DENIED;
+    }
+    ok = (fwrite (data, 1, size, fp) == size) && (fflush (fp) == 0);
+#ifndef _WIN32
+    ok = ok && (fsync (fileno (fp)) == 0);
+#endif
+    ok = (fclose (fp) == 0) && ok;
+#ifdef _WIN32
+    ok = ok && MoveFileExA (tmp, path, MOVEFILE_REPLACE_EXISTING);
+#else
+    ok = ok && (rename (tmp, path) == 0);
+#endif
+    if (!ok) {
+        fprintf (stderr, " ** Cannot write snapshot %s.\n", path);
+        remove (tmp);
+    }
+    free (tmp);
+    return ok ? AST_RETURN_SUCCESS : AST_RETURN_OPERATION_FAILED;
+}
+
+
+
+
+
+static int _ast_snapshot_backend_read (void *ctx, const ast_guid *guid, const char *name, void *buf, size_t bufSiz, size_t *nBytes, uint32_t *attr)
+{
+    struct ast_snapshot_var var;
+    int ret = ast_snapshot_find (ctx, guid, name, &var);
+
+    if (ret != AST_RETURN_SUCCESS) {
+        return ret;
+    }
+    if (nBytes != NULL) {
+        *nBytes = var.size;
+    }
+    if (attr != NULL) {
+        *attr = var.attr;
+    }
+    if (var.size > bufSiz) {
+        return AST_RETURN_BUFFER_TOO_SMALL;
+    }
+    if (var.size != 0) {
+        memcpy (buf, var.data, var.size);
+    }
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static int _ast_snapshot_backend_write (void *ctx, const ast_guid *guid, const char *name, const void *buf, size_t bufSiz, uint32_t attr)
+{
+    (void) ctx;
+    (void) guid;
+    (void) name;
+    (void) buf;
+    (void) bufSiz;
+    (void) attr;
+    return AST_RETURN_NOT_SUPPORTED; // Snapshots are read-only
+}
+
+
+
+
+
+static int _ast_snapshot_backend_iter_open (void *ctx, unsigned int flags, void **it)
+{
+    size_t *next = malloc (sizeof (size_t));
+
+    (void) ctx;
+    (void) flags; // Attributes are in the directory and always filled in
+    if (next == NULL) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+    *next = 0;
+    *it = next;
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static int _ast_snapshot_backend_iter_next (void *ctx, void *it, struct ast_efivar_info *infos, size_t cap, size_t *n)
+{
+    const struct ast_snapshot *snap = ctx;
+    size_t *next = it;
+
+    for (*n = 0; (*n < cap) && (*next < snap->nEntries); (*n)++, (*next)++) {
+        const struct _ast_snapshot_entry *e = _ast_snapshot_entry (snap, *next);
+        struct ast_efivar_info *info = &infos[*n];
+
+        info->guid = e->guid;
+        memcpy (info->name, snap->base + e->nameOffset, e->nameSize + 1); // Checked to fit when opened
+        info->attr = e->attr;
+        info->size = e->dataSize;
+        info->data = snap->base + e->dataOffset;
+    }
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static void _ast_snapshot_backend_iter_close (void *ctx, void *it)
+{
+    (void) ctx;
+    free (it);
+}
+
+
+
+
+
+static void _ast_snapshot_backend_destroy (struct ast_efivar_backend *backend)
+{
+    ast_snapshot_close (backend->ctx);
+    free (backend);
+}
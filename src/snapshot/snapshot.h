@@ -0,0 +1,145 @@
+/**
+ * @file snapshot.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares snapshots: the whole variable store saved to a file that is queried in place.
+ *
+ * A snapshot is opened by mapping it into memory. Variables are found through a hash index in O(1), and
+ * names and values are returned as pointers into the mapping, so nothing is parsed or copied. A backend
+ * serving reads from a snapshot lets the rest of the library run without touching firmware.
+ *
+ * All integers are little endian, and every section starts on an 8-byte boundary:
+ *
+ *     header    | magic "ASTSNAP\0" | version (u32) | header size (u32) | file size (u64) | capture time (u64, ns since the epoch)
+ *               | entries (u32) | index slots (u32) | directory offset (u64) | index offset (u64) | data offset (u64)
+ *               | CRC-32 of the whole file with this field zero (u32) | entry size (u32)
+ *     directory | one entry per variable, sorted by GUID bytes then name bytes:
+ *               | GUID (16 bytes) | attributes (u32) | key hash (u32) | name size (u32) | data size (u32)
+ *               | name offset (u64) | data offset (u64) | data hash (u64)
+ *     index     | slots (u32, a power of two, at most half used): entry number + 1, or 0 if empty
+ *     data      | each name, UTF-8 and NUL-terminated, and each value
+ *
+ * The key hash is FNV-1a 64 over the GUID bytes then the name bytes; a variable's index slot is found by
+ * linear probing from the key hash modulo the slot count, and the directory keeps its low 32 bits to skip
+ * mismatches. The data hash is FNV-1a 64 of the value, as ast_fnv1a64 (see hash.h) computes it. Offsets
+ * are from the start of the file.
+ */
+
+#ifndef _AST_SNAPSHOT_H
+#define _AST_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../guid/guid.h"
+
+struct ast_efivar_backend;
+struct ast_snapshot;
+
+/** Current snapshot format version. */
+#define AST_SNAPSHOT_VERSION 1
+
+/** Flag for ast_snapshot_open: check the CRC-32 of the whole file (one pass over it) before using it. */
+#define AST_SNAPSHOT_VERIFY 0x00000001
+
+/**
+ * One variable of a snapshot. Pointers are into the snapshot and valid until it is closed.
+ */
+struct ast_snapshot_var {
+    ast_guid   guid;  /**< GUID namespace. */
+    const char *name; /**< Name, UTF-8. */
+    uint32_t   attr;  /**< Attributes. */
+    const void *data; /**< Value. */
+    size_t     size;  /**< Size of the value in bytes. */
+    uint64_t   hash;  /**< FNV-1a 64 of the value. */
+};
+
+/**
+ * Save every variable of the current backend into a snapshot file.
+ *
+ * The store is enumerated once with attributes; values the backend already holds in memory are not read
+ * again. The file is written next to path and renamed over it, so a reader never sees a partial snapshot.
+ *
+ * @param path  [in]  File to create or replace.
+ * @param nVars [out] Number of variables saved. May be NULL.
+ * @return AST_RETURN_SUCCESS, or another AST_RETURN code.
+ */
+int ast_snapshot_capture (const char *path, size_t *nVars);
+
+/**
+ * Map a snapshot file.
+ *
+ * The header and the directory are checked, so lookups never read outside the file.
+ *
+ * @param path  [in]  Snapshot file.
+ * @param flags [in]  AST_SNAPSHOT_* flags.
+ * @param snap  [out] Snapshot, to close with ast_snapshot_close.
+ * @return AST_RETURN_SUCCESS, AST_RETURN_INVALID_PARAMETER if the file is not a valid snapshot, or another AST_RETURN code.
+ */
+int ast_snapshot_open (const char *path, unsigned int flags, struct ast_snapshot **snap);
+
+/**
+ * Use a snapshot already in memory. The memory is not copied and must outlive the snapshot.
+ *
+ * @param data  [in]  Snapshot bytes, 8-byte aligned.
+ * @param size  [in]  Size of data.
+ * @param flags [in]  AST_SNAPSHOT_* flags.
+ * @param snap  [out] Snapshot, to close with ast_snapshot_close.
+ * @return The same as ast_snapshot_open.
+ */
+int ast_snapshot_open_memory (const void *data, size_t size, unsigned int flags, struct ast_snapshot **snap);
+
+/**
+ * Unmap a snapshot.
+ *
+ * @param snap [in] Snapshot. May be NULL.
+ */
+void ast_snapshot_close (struct ast_snapshot *snap);
+
+/**
+ * Number of variables in a snapshot.
+ */
+size_t ast_snapshot_count (const struct ast_snapshot *snap);
+
+/**
+ * Time the snapshot was captured.
+ *
+ * @return Nanoseconds since the epoch.
+ */
+uint64_t ast_snapshot_time (const struct ast_snapshot *snap);
+
+/**
+ * Get the i-th variable in directory order (by GUID bytes, then name bytes).
+ *
+ * @param snap [in]  Snapshot.
+ * @param i    [in]  Index, below ast_snapshot_count.
+ * @param var  [out] Variable.
+ * @return AST_RETURN_SUCCESS, or AST_RETURN_INVALID_PARAMETER if i is out of range.
+ */
+int ast_snapshot_get (const struct ast_snapshot *snap, size_t i, struct ast_snapshot_var *var);
+
+/**
+ * Look a variable up.
+ *
+ * @param snap [in]  Snapshot.
+ * @param guid [in]  GUID namespace.
+ * @param name [in]  Variable name.
+ * @param var  [out] Variable. May be NULL to test for presence.
+ * @return AST_RETURN_SUCCESS, or AST_RETURN_NOT_FOUND.
+ */
+int ast_snapshot_find (const struct ast_snapshot *snap, const ast_guid *guid, const char *name, struct ast_snapshot_var *var);
+
+/**
+ * Create a read-only backend serving a snapshot file.
+ *
+ * Select it with ast_efivar_backend_set. Enumeration returns values in place, so reading a whole snapshot
+ * copies nothing. Writes return AST_RETURN_NOT_SUPPORTED.
+ *
+ * @param path [in] Snapshot file, opened with ast_snapshot_open and closed with the backend.
+ * @return The backend, or NULL if the file cannot be opened.
+ */
+struct ast_efivar_backend *ast_efivar_backend_snapshot_new (const char *path);
+
+#endif /* end of include guard: _AST_SNAPSHOT_H */
@@ -0,0 +1,537 @@
+/**
+ * @file stats.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements stats.h.
+ *
+ * Every thread owns a table of entries, found through a thread-local pointer and registered once on a
+ * push-only list. Only the owner writes its entries, so updates are plain relaxed stores; a new entry is
+ * published with a release store of its slot, which is what lets ast_stats_snapshot walk the tables of
+ * running threads. Tables are never freed, so the samples of threads that have exited stay in snapshots.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "stats.h"
+#include "../firmware/firmware.h"
+#include "../util/hash.h"
+
+#define AST_STATS_SLOTS     512 // Per thread; a power of two
+#define AST_STATS_KEYED_MAX 384 // Entries with a variable per thread, leaving room for one entry per operation
+
+static const char *_ast_stats_op_names[AST_STATS_OP_COUNT] = {
+    "read", "write", "read_batch", "iter_open", "iter_next", "priv_open_token", "priv_lookup", "priv_adjust", "priv_query"
+};
+
+static const char *_ast_stats_counter_names[AST_STATS_COUNTER_COUNT] = {
+    "read_bytes", "write_bytes", "writes_skipped", "batch_items", "vars_enumerated", "priv_cache_hits"
+};
+
+static void _ast_stats_json_string (FILE *out, const char *s);
+
+#ifndef AST_NO_STATS
+/**
+ * One thread's entries and counters.
+ */
+struct _ast_stats_thread {
+    struct _ast_stats_thread *next;
+    struct ast_stats_entry   *slots[AST_STATS_SLOTS];
+    size_t                   nKeyed;
+    uint64_t                 counters[AST_STATS_COUNTER_COUNT];
+};
+
+static struct _ast_stats_thread *_ast_stats_threads = NULL;
+static _Thread_local struct _ast_stats_thread *_ast_stats_self = NULL;
+
+static struct _ast_stats_thread *_ast_stats_thread (void);
+static struct ast_stats_entry *_ast_stats_lookup (struct _ast_stats_thread *self, enum AST_STATS_OP op, const ast_guid *guid, const char *name);
+static int  _ast_stats_key_cmp (const void *a, const void *b);
+static int  _ast_stats_time_cmp (const void *a, const void *b);
+
+#define _AST_STATS_BUMP(field, n) __atomic_store_n (&(field), (field) + (n), __ATOMIC_RELAXED)
+#endif
+
+
+
+
+
+uint64_t ast_stats_now (void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+
+    if (freq.QuadPart == 0) {
+        QueryPerformanceFrequency (&freq);
+    }
+    QueryPerformanceCounter (&count);
+    return (uint64_t) (count.QuadPart / freq.QuadPart) * 1000000000ULL +
+           (uint64_t) (count.QuadPart % freq.QuadPart) * 1000000000ULL / (uint64_t) freq.QuadPart;
+#else
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+
+
+
+
+unsigned int ast_stats_bucket (uint64_t ns)
+{
+    unsigned int e = 0;
+
+    if (ns < 16) {
+        return (unsigned int) ns;
+    }
+    e = 63 - (unsigned int) __builtin_clzll (ns);
+    if (e >= 40) {
+        return AST_STATS_BUCKETS - 1;
+    }
+    // The two bits below the leading one pick the quarter of [2^e, 2^(e+1)).
+    return 16 + (e - 4) * 4 + (unsigned int) ((ns >> (e - 2)) & 3);
+}
+
+
+
+
+
+uint64_t ast_stats_bucket_max (unsigned int bucket)
+{
+    unsigned int e = 0, quarter = 0;
+
+    if (bucket < 16) {
+        return bucket;
+    }
+    if (bucket >= AST_STATS_BUCKETS - 1) {
+        return UINT64_MAX;
+    }
+    e       = (bucket - 16) / 4 + 4;
+    quarter = (bucket - 16) % 4;
+    return ((uint64_t) (5 + quarter) << (e - 2)) - 1;
+}
+
+
+
+
+
+uint64_t ast_stats_percentile (const struct ast_stats_entry *entry, double q)
+{
+    uint64_t total = 0, seen = 0, rank = 0;
+
+    for (unsigned int i = 0; i < AST_STATS_BUCKETS; i++) {
+        total += entry->hist[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    rank = (uint64_t) (q * total + 0.5);
+    if (rank < 1) {
+        rank = 1;
+    } else if (rank > total) {
+        rank = total;
+    }
+    for (unsigned int i = 0; i < AST_STATS_BUCKETS; i++) {
+        seen += entry->hist[i];
+        if (seen >= rank) {
+            uint64_t max = ast_stats_bucket_max (i);
+            return (max < entry->maxNs) ? max : entry->maxNs;
+        }
+    }
+    return entry->maxNs;
+}
+
+
+
+
+
+const char *ast_stats_op_name (enum AST_STATS_OP op)
+{
+    return ((unsigned int) op < AST_STATS_OP_COUNT) ? _ast_stats_op_names[op] : "unknown";
+}
+
+
+
+
+
+const char *ast_stats_counter_name (enum AST_STATS_COUNTER counter)
+{
+    return ((unsigned int) counter < AST_STATS_COUNTER_COUNT) ? _ast_stats_counter_names[counter] : "unknown";
+}
+
+
+
+
+
+#ifndef AST_NO_STATS
+void ast_stats_record (enum AST_STATS_OP op, const ast_guid *guid, const char *name, int status, uint64_t ns)
+{
+    struct _ast_stats_thread *self = _ast_stats_thread ();
+    struct ast_stats_entry *e = NULL;
+    unsigned int b = ast_stats_bucket (ns);
+
+    if ((self == NULL) || ((unsigned int) op >= AST_STATS_OP_COUNT)) {
+        return;
+    }
+    e = _ast_stats_lookup (self, op, guid, name);
+    if (e == NULL) {
+        return;
+    }
+
+    _AST_STATS_BUMP (e->count, 1);
+    if (status != 0) {
+        _AST_STATS_BUMP (e->errors, 1);
+    }
+    _AST_STATS_BUMP (e->totalNs, ns);
+    if (ns > e->maxNs) {
+        __atomic_store_n (&(e->maxNs), ns, __ATOMIC_RELAXED);
+    }
+    _AST_STATS_BUMP (e->hist[b], 1);
+}
+
+
+
+
+
+void ast_stats_add (enum AST_STATS_COUNTER counter, uint64_t n)
+{
+    struct _ast_stats_thread *self = _ast_stats_thread ();
+
+    if ((self != NULL) && ((unsigned int) counter < AST_STATS_COUNTER_COUNT)) {
+        _AST_STATS_BUMP (self->counters[counter], n);
+    }
+}
+
+
+
+
+
+int ast_stats_snapshot (struct ast_stats_snapshot *snap)
+{
+    struct _ast_stats_thread *t = NULL;
+    struct ast_stats_entry *all = NULL;
+    size_t n = 0, cap = 0, out = 0;
+
+    if (snap == NULL) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    memset (snap, 0, sizeof (struct ast_stats_snapshot));
+
+    // Copy every published entry of every thread, then merge entries with the same key.
+    for (t = __atomic_load_n (&_ast_stats_threads, __ATOMIC_ACQUIRE); t != NULL; t = t->next) {
+        for (int c = 0; c < AST_STATS_COUNTER_COUNT; c++) {
+            snap->counters[c] += __atomic_load_n (&(t->counters[c]), __ATOMIC_RELAXED);
+        }
+        for (size_t s = 0; s < AST_STATS_SLOTS; s++) {
+            struct ast_stats_entry *e = __atomic_load_n (&(t->slots[s]), __ATOMIC_ACQUIRE);
+            struct ast_stats_entry *copy = NULL;
+
+            if (e == NULL) {
+                continue;
+            }
+            if (n == cap) {
+                struct ast_stats_entry *p = realloc (all, (cap ? 2 * cap : 64) * sizeof (struct ast_stats_entry));
+                if (p == NULL) {
+                    free (all);
+                    return AST_RETURN_OPERATION_FAILED;
+                }
+                all = p;
+                cap = cap ? 2 * cap : 64;
+            }
+            copy = &(all[n++]);
+            copy->op      = e->op;
+            copy->guid    = e->guid;
+            memcpy (copy->name, e->name, AST_STATS_NAME_MAX);
+            copy->count   = __atomic_load_n (&(e->count), __ATOMIC_RELAXED);
+            copy->errors  = __atomic_load_n (&(e->errors), __ATOMIC_RELAXED);
+            copy->totalNs = __atomic_load_n (&(e->totalNs), __ATOMIC_RELAXED);
+            copy->maxNs   = __atomic_load_n (&(e->maxNs), __ATOMIC_RELAXED);
+            for (unsigned int b = 0; b < AST_STATS_BUCKETS; b++) {
+                copy->hist[b] = __atomic_load_n (&(e->hist[b]), __ATOMIC_RELAXED);
+            }
+        }
+    }
+
+    if (n != 0) {
+        qsort (all, n, sizeof (struct ast_stats_entry), _ast_stats_key_cmp);
+        for (size_t i = 1; i < n; i++) {
+            struct ast_stats_entry *dst = &(all[out]);
+            const struct ast_stats_entry *src = &(all[i]);
+
+            if (_ast_stats_key_cmp (dst, src) != 0) {
+                all[++out] = *src;
+                continue;
+            }
+            dst->count   += src->count;
+            dst->errors  += src->errors;
+            dst->totalNs += src->totalNs;
+            if (src->maxNs > dst->maxNs) {
+                dst->maxNs = src->maxNs;
+            }
+            for (unsigned int b = 0; b < AST_STATS_BUCKETS; b++) {
+                dst->hist[b] += src->hist[b];
+            }
+        }
+        n = out + 1;
+        qsort (all, n, sizeof (struct ast_stats_entry), _ast_stats_time_cmp);
+    }
+
+    snap->nEntries = n;
+    snap->entries  = all;
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static struct _ast_stats_thread *_ast_stats_thread (void)
+{
+    struct _ast_stats_thread *self = _ast_stats_self;
+
+    if (self != NULL) {
+        return self;
+    }
+
+    self = calloc (1, sizeof (struct _ast_stats_thread));
+    if (self == NULL) {
+        return NULL;
+    }
+    self->next = __atomic_load_n (&_ast_stats_threads, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n (&_ast_stats_threads, &(self->next), self, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+        // self->next was reloaded by the failed exchange.
+    }
+    _ast_stats_self = self;
+    return self;
+}
+
+
+
+
+
+static struct ast_stats_entry *_ast_stats_lookup (struct _ast_stats_thread *self, enum AST_STATS_OP op, const ast_guid *guid, const char *name)
+{
+    static const ast_guid none;
+    struct ast_stats_entry *e = NULL;
+    char     key[AST_STATS_NAME_MAX];
+    uint64_t h = 0, lo = 0, hi = 0;
+    size_t   len = 0;
+    size_t   slot = 0;
+    int      keyed = 0;
+
+    if (guid == NULL) {
+        guid = &none;
+    }
+    if (name == NULL) {
+        name = "";
+    }
+    keyed = (name[0] != '\0') || (memcmp (guid, &none, sizeof (ast_guid)) != 0);
+
+    for (;;) {
+        for (len = 0; (len < AST_STATS_NAME_MAX - 1) && (name[len] != '\0'); len++) {
+            key[len] = name[len];
+        }
+        if (name[len] != '\0') {
+            // Cut at a character boundary, so the key stays valid UTF-8.
+            while ((len > 0) && (((uint8_t) name[len] & 0xC0) == 0x80)) {
+                len--;
+            }
+        }
+        key[len] = '\0';
+
+        // FNV-1a over the name, seeded with the operation and the GUID taken 8 bytes at a time.
+        memcpy (&lo, guid->b, 8);
+        memcpy (&hi, guid->b + 8, 8);
+        h = (AST_FNV1A64_INIT ^ (uint64_t) op ^ lo) * AST_FNV1A64_PRIME;
+        h = (h ^ hi ^ (h >> 29)) * AST_FNV1A64_PRIME;
+        h = ast_fnv1a64 (h, key, len);
+
+        for (slot = (size_t) (h ^ (h >> 32)) & (AST_STATS_SLOTS - 1); self->slots[slot] != NULL; slot = (slot + 1) & (AST_STATS_SLOTS - 1)) {
+            e = self->slots[slot];
+            if ((e->op == op) && (memcmp (&(e->guid), guid, sizeof (ast_guid)) == 0) && (strcmp (e->name, key) == 0)) {
+                return e;
+            }
+        }
+        if (!keyed || (self->nKeyed < AST_STATS_KEYED_MAX)) {
+            break;
+        }
+        // Table full: fold a new variable into the operation's own entry.
+        guid  = &none;
+        name  = "";
+        keyed = 0;
+    }
+
+    // First call of its kind on this thread.
+    e = calloc (1, sizeof (struct ast_stats_entry));
+    if (e == NULL) {
+        return NULL;
+    }
+    e->op   = op;
+    e->guid = *guid;
+    memcpy (e->name, key, len + 1);
+    __atomic_store_n (&(self->slots[slot]), e, __ATOMIC_RELEASE);
+    if (keyed) {
+        self->nKeyed++;
+    }
+    return e;
+}
+
+
+
+
+
+static int _ast_stats_key_cmp (const void *a, const void *b)
+{
+    const struct ast_stats_entry *x = a;
+    const struct ast_stats_entry *y = b;
+    int r = 0;
+
+    if (x->op != y->op) {
+        return (x->op < y->op) ? -1 : 1;
+    }
+    r = memcmp (&(x->guid), &(y->guid), sizeof (ast_guid));
+    if (r != 0) {
+        return r;
+    }
+    return strcmp (x->name, y->name);
+}
+
+
+
+
+
+static int _ast_stats_time_cmp (const void *a, const void *b)
+{
+    const struct ast_stats_entry *x = a;
+    const struct ast_stats_entry *y = b;
+
+    if (x->totalNs != y->totalNs) {
+        return (x->totalNs > y->totalNs) ? -1 : 1;
+    }
+    return _ast_stats_key_cmp (a, b);
+}
+#else
+void ast_stats_record (enum AST_STATS_OP op, const ast_guid *guid, const char *name, int status, uint64_t ns)
+{
+    (void) op;
+    (void) guid;
+    (void) name;
+    (void) status;
+    (void) ns;
+}
+
+
+
+
+
+void ast_stats_add (enum AST_STATS_COUNTER counter, uint64_t n)
+{
+    (void) counter;
+    (void) n;
+}
+
+
+
+
+
+int ast_stats_snapshot (struct ast_stats_snapshot *snap)
+{
+    if (snap != NULL) {
+        memset (snap, 0, sizeof (struct ast_stats_snapshot));
+    }
+    return AST_RETURN_NOT_SUPPORTED;
+}
+#endif
+
+
+
+
+
+void ast_stats_snapshot_free (struct ast_stats_snapshot *snap)
+{
+    if (snap == NULL) {
+        return;
+    }
+    free (snap->entries);
+    snap->entries  = NULL;
+    snap->nEntries = 0;
+}
+
+
+
+
+
+int ast_stats_dump_json (const struct ast_stats_snapshot *snap, FILE *out)
+{
+    static const ast_guid none;
+    char guid[AST_GUID_STRLEN + 1];
+
+    if ((snap == NULL) || (out == NULL)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    fputs ("{\"counters\":{", out);
+    for (int c = 0; c < AST_STATS_COUNTER_COUNT; c++) {
+        fprintf (out, "%s\"%s\":%llu", (c == 0) ? "" : ",", _ast_stats_counter_names[c], (unsigned long long) snap->counters[c]);
+    }
+    fputs ("},\"ops\":[", out);
+
+    for (size_t i = 0; i < snap->nEntries; i++) {
+        const struct ast_stats_entry *e = &(snap->entries[i]);
+        int first = 1;
+
+        fprintf (out, "%s\n{\"op\":\"%s\",", (i == 0) ? "" : ",", ast_stats_op_name (e->op));
+        if (memcmp (&(e->guid), &none, sizeof (ast_guid)) != 0) {
+            ast_guid_format (&(e->guid), guid);
+            fprintf (out, "\"guid\":\"%s\",", guid);
+        }
+        fputs ("\"name\":", out);
+        _ast_stats_json_string (out, e->name);
+        fprintf (out, ",\"count\":%llu,\"errors\":%llu,\"total_ns\":%llu,\"p50_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu,\"buckets\":[",
+                 (unsigned long long) e->count, (unsigned long long) e->errors, (unsigned long long) e->totalNs,
+                 (unsigned long long) ast_stats_percentile (e, 0.5), (unsigned long long) ast_stats_percentile (e, 0.99),
+                 (unsigned long long) e->maxNs);
+        for (unsigned int b = 0; b < AST_STATS_BUCKETS; b++) {
+            if (e->hist[b] != 0) {
+                fprintf (out, "%s[%llu,%lu]", first ? "" : ",", (unsigned long long) ast_stats_bucket_max (b), (unsigned long) e->hist[b]);
+                first = 0;
+            }
+        }
+        fputs ("]}", out);
+    }
+
+    fputs ("]}\n", out);
+    return ferror (out) ? AST_RETURN_OPERATION_FAILED : AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static void _ast_stats_json_string (FILE *out, const char *s)
+{
+    fputc ('"', out);
+    for (; *s != '\0'; s++) {
+        unsigned char c = (unsigned char) *s;
+        if ((c == '"') || (c == '\\')) {
+            fputc ('\\', out);
+            fputc (c, out);
+        } else if (c < 0x20) {
+            fprintf (out, "\\u%04x", c);
+        } else {
+            fputc (c, out);
+        }
+    }
+    fputc ('"', out);
+}
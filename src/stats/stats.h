@@ -0,0 +1,201 @@
+/**
+ * @file stats.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares the library's built-in latency histograms and counters.
+ *
+ * Firmware calls (variable reads, writes, batches, enumeration) and privilege manager calls are timed as
+ * they happen, and each sample lands in a histogram keyed by operation and variable (GUID and name; the
+ * privilege name for privilege calls). Each thread records into its own table without locks or atomic
+ * read-modify-write; ast_stats_snapshot merges the tables of every thread that has recorded anything.
+ *
+ * Histograms are log-linear: exact below 16 ns, then four buckets per power of two, so a percentile is
+ * within 25% of the true value.
+ *
+ * Build with `AST_NO_STATS` defined to compile the instrumentation out entirely. The functions below then
+ * still exist, but ast_stats_snapshot returns AST_RETURN_NOT_SUPPORTED.
+ */
+
+#ifndef _AST_STATS_H
+#define _AST_STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "../guid/guid.h"
+
+/** Longest variable or privilege name kept, in bytes including the terminating NUL. Longer names are cut. */
+#define AST_STATS_NAME_MAX 64
+
+/** Number of histogram buckets: 16 exact ones, then 4 per power of two up to 2^40 ns (about 18 minutes). */
+#define AST_STATS_BUCKETS (16 + 36 * 4)
+
+/**
+ * Timed operations.
+ */
+enum AST_STATS_OP {
+    AST_STATS_OP_READ = 0,        /**< Backend read of one variable. */
+    AST_STATS_OP_WRITE,           /**< Backend write or deletion of one variable. */
+    AST_STATS_OP_READ_BATCH,      /**< Backend batch read (no variable). */
+    AST_STATS_OP_ITER_OPEN,       /**< Start of an enumeration (no variable). */
+    AST_STATS_OP_ITER_NEXT,       /**< One enumeration step (no variable). */
+    AST_STATS_OP_PRIV_OPEN_TOKEN, /**< Opening the process token (no variable). */
+    AST_STATS_OP_PRIV_LOOKUP,     /**< Privilege name to LUID lookup; the name is the privilege. */
+    AST_STATS_OP_PRIV_ADJUST,     /**< Privilege adjustment; the name is the privilege. */
+    AST_STATS_OP_PRIV_QUERY,      /**< Reading every privilege of the token (no variable). */
+    AST_STATS_OP_COUNT
+};
+
+/**
+ * Plain counters.
+ */
+enum AST_STATS_COUNTER {
+    AST_STATS_COUNTER_READ_BYTES = 0,   /**< Bytes returned by successful reads. */
+    AST_STATS_COUNTER_WRITE_BYTES,      /**< Bytes passed to successful writes. */
+    AST_STATS_COUNTER_WRITES_SKIPPED,   /**< Writes skipped because the value was already there. */
+    AST_STATS_COUNTER_BATCH_ITEMS,      /**< Variables requested through batch reads. */
+    AST_STATS_COUNTER_VARS_ENUMERATED,  /**< Variables returned by enumeration. */
+    AST_STATS_COUNTER_PRIV_CACHE_HITS,  /**< Privilege requests answered without a system call. */
+    AST_STATS_COUNTER_COUNT
+};
+
+/**
+ * Samples of one operation on one variable.
+ */
+struct ast_stats_entry {
+    enum AST_STATS_OP op;                       /**< Operation. */
+    ast_guid guid;                              /**< Variable GUID, all zero if the operation has no variable. */
+    char     name[AST_STATS_NAME_MAX];          /**< Variable or privilege name, "" if none. */
+    uint64_t count;                             /**< Number of calls. */
+    uint64_t errors;                            /**< Calls that did not return success. */
+    uint64_t totalNs;                           /**< Time spent in all calls. */
+    uint64_t maxNs;                             /**< Longest call. */
+    uint32_t hist[AST_STATS_BUCKETS];           /**< Calls per latency bucket, see ast_stats_bucket. */
+};
+
+/**
+ * Merged statistics of all threads.
+ */
+struct ast_stats_snapshot {
+    uint64_t counters[AST_STATS_COUNTER_COUNT]; /**< Counters, indexed by enum AST_STATS_COUNTER. */
+    size_t   nEntries;                          /**< Number of entries. */
+    struct ast_stats_entry *entries;            /**< Entries, the most total time first. */
+};
+
+/**
+ * Merge the statistics recorded so far by every thread.
+ *
+ * Threads keep recording meanwhile; a call in progress may show in the count but not yet in the histogram.
+ * A thread keeps at most a few hundred distinct variables per operation apart; beyond that, its samples
+ * are kept under the operation with an empty name.
+ *
+ * @param snap [out] Snapshot, to free with ast_stats_snapshot_free.
+ * @return AST_RETURN_SUCCESS, AST_RETURN_OPERATION_FAILED on allocation failure, or AST_RETURN_NOT_SUPPORTED
+ *         if built with AST_NO_STATS.
+ */
+int ast_stats_snapshot (struct ast_stats_snapshot *snap);
+
+/**
+ * Free the memory held by a snapshot.
+ *
+ * @param snap [in] Snapshot filled by ast_stats_snapshot.
+ */
+void ast_stats_snapshot_free (struct ast_stats_snapshot *snap);
+
+/**
+ * Estimate a latency percentile of an entry.
+ *
+ * @param entry [in] Entry.
+ * @param q     [in] Quantile between 0 and 1, e.g. 0.99.
+ * @return Upper bound of the bucket holding the quantile (at most maxNs), or 0 if the entry is empty.
+ */
+uint64_t ast_stats_percentile (const struct ast_stats_entry *entry, double q);
+
+/**
+ * Histogram bucket of a duration.
+ *
+ * @param ns [in] Duration in nanoseconds.
+ * @return Bucket index, below AST_STATS_BUCKETS.
+ */
+unsigned int ast_stats_bucket (uint64_t ns);
+
+/**
+ * Largest duration falling into a histogram bucket.
+ *
+ * @param bucket [in] Bucket index.
+ * @return Duration in nanoseconds.
+ */
+uint64_t ast_stats_bucket_max (unsigned int bucket);
+
+/**
+ * Name of an operation, as used in the JSON output (e.g. "read").
+ */
+const char *ast_stats_op_name (enum AST_STATS_OP op);
+
+/**
+ * Name of a counter, as used in the JSON output (e.g. "read_bytes").
+ */
+const char *ast_stats_counter_name (enum AST_STATS_COUNTER counter);
+
+/**
+ * Write a snapshot as one JSON object:
+ *
+ *     {"counters":{"read_bytes":...,...},
+ *      "ops":[{"op":"read","guid":"...","name":"BootOrder","count":...,"errors":...,"total_ns":...,
+ *              "p50_ns":...,"p99_ns":...,"max_ns":...,"buckets":[[max_ns,count],...]},...]}
+ *
+ * Only non-empty buckets are listed. "guid" is omitted for operations without a variable.
+ *
+ * @param snap [in] Snapshot.
+ * @param out  [in] Stream to write to.
+ * @return AST_RETURN_SUCCESS, or AST_RETURN_OPERATION_FAILED if writing failed.
+ */
+int ast_stats_dump_json (const struct ast_stats_snapshot *snap, FILE *out);
+
+/**
+ * Monotonic clock used for the samples.
+ *
+ * @return Nanoseconds since an arbitrary point.
+ */
+uint64_t ast_stats_now (void);
+
+/**
+ * Record one call. Use the AST_STATS_* macros below rather than calling this directly.
+ *
+ * @param op     [in] Operation.
+ * @param guid   [in] Variable GUID, or NULL.
+ * @param name   [in] Variable or privilege name, or NULL.
+ * @param status [in] What the call returned; anything but 0 counts as an error.
+ * @param ns     [in] Duration.
+ */
+void ast_stats_record (enum AST_STATS_OP op, const ast_guid *guid, const char *name, int status, uint64_t ns);
+
+/**
+ * Add to a counter. Use AST_STATS_ADD rather than calling this directly.
+ *
+ * @param counter [in] Counter.
+ * @param n       [in] Amount.
+ */
+void ast_stats_add (enum AST_STATS_COUNTER counter, uint64_t n);
+
+/**
+ * @name Instrumentation macros
+ *
+ * AST_STATS_BEGIN (t) starts a clock named t; AST_STATS_END records the call timed by it. All three
+ * expand to nothing with AST_NO_STATS.
+ * @{
+ */
+#ifndef AST_NO_STATS
+#define AST_STATS_BEGIN(t)                       uint64_t t = ast_stats_now ()
+#define AST_STATS_END(op, guid, name, status, t) ast_stats_record ((op), (guid), (name), (status), ast_stats_now () - (t))
+#define AST_STATS_ADD(counter, n)                ast_stats_add ((counter), (n))
+#else
+#define AST_STATS_BEGIN(t)                       ((void) 0)
+#define AST_STATS_END(op, guid, name, status, t) ((void) 0)
+#define AST_STATS_ADD(counter, n)                ((void) 0)
+#endif
+/** @} */
+
+#endif /* end of include guard: _AST_STATS_H */
@@ -0,0 +1,221 @@
+/**
+ * @file pool.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements pool.h.
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#include "pool.h"
+#include "thread.h"
+#include "../firmware/firmware.h"
+
+/**
+ * Items left to one worker, [begin, end). Aligned so that two workers' locks never share a cache line.
+ */
+struct _ast_pool_range {
+    _Alignas (64) ast_mutex lock;
+    size_t begin;
+    size_t end;
+};
+
+struct _ast_pool {
+    struct _ast_pool_range *ranges;
+    unsigned int           nWorkers;
+    ast_pool_task          task;
+    void                   *arg;
+};
+
+struct _ast_pool_worker {
+    struct _ast_pool *pool;
+    unsigned int     index;
+};
+
+static int  _ast_pool_take (struct _ast_pool *pool, unsigned int self, size_t *item);
+static int  _ast_pool_steal (struct _ast_pool *pool, unsigned int self);
+static void _ast_pool_work (struct _ast_pool *pool, unsigned int self);
+#ifdef _WIN32
+static DWORD WINAPI _ast_pool_thread (LPVOID param);
+#else
+static void *_ast_pool_thread (void *param);
+#endif
+
+
+
+
+
+unsigned int ast_pool_cpu_count (void)
+{
+#ifdef _WIN32
+    SYSTEM_INFO info;
+
+    GetSystemInfo (&info);
+    return (info.dwNumberOfProcessors > 0) ? (unsigned int) info.dwNumberOfProcessors : 1;
+#else
+    long n = sysconf (_SC_NPROCESSORS_ONLN);
+
+    return (n > 0) ? (unsigned int) n : 1;
+#endif
+}
+
+
+
+
+
+int ast_pool_run (size_t nItems, unsigned int nWorkers, ast_pool_task task, void *arg)
+{
+    struct _ast_pool pool;
+    struct _ast_pool_range ranges[AST_POOL_MAX_WORKERS];
+    struct _ast_pool_worker workers[AST_POOL_MAX_WORKERS];
+#ifdef _WIN32
+    HANDLE threads[AST_POOL_MAX_WORKERS];
+#else
+    pthread_t threads[AST_POOL_MAX_WORKERS];
+#endif
+    int started[AST_POOL_MAX_WORKERS] = {0};
+
+    if (nItems == 0) {
+        return AST_RETURN_SUCCESS;
+    }
+    if (nWorkers == 0) {
+        nWorkers = ast_pool_cpu_count ();
+    }
+    if (nWorkers > AST_POOL_MAX_WORKERS) {
+        nWorkers = AST_POOL_MAX_WORKERS;
+    }
+    if (nWorkers > nItems) {
+        nWorkers = (unsigned int) nItems;
+    }
+
+    pool.ranges   = ranges;
+    pool.nWorkers = nWorkers;
+    pool.task     = task;
+    pool.arg      = arg;
+    for (unsigned int w = 0; w < nWorkers; w++) {
+        ast_mutex_init (&(pool.ranges[w].lock));
+        pool.ranges[w].begin = nItems * w / nWorkers;
+        pool.ranges[w].end   = nItems * (w + 1) / nWorkers;
+        workers[w].pool  = &pool;
+        workers[w].index = w;
+    }
+
+    // A worker that fails to start leaves its range to be stolen.
+    for (unsigned int w = 1; w < nWorkers; w++) {
+#ifdef _WIN32
+        threads[w] = CreateThread (NULL, 0, _ast_pool_thread, &(workers[w]), 0, NULL);
+        started[w] = (threads[w] != NULL);
+#else
+        started[w] = (pthread_create (&(threads[w]), NULL, _ast_pool_thread, &(workers[w])) == 0);
+#endif
+    }
+    _ast_pool_work (&pool, 0);
+    for (unsigned int w = 1; w < nWorkers; w++) {
+        if (started[w]) {
+#ifdef _WIN32
+            WaitForSingleObject (threads[w], INFINITE);
+            CloseHandle (threads[w]);
+#else
+            pthread_join (threads[w], NULL);
+#endif
+        }
+    }
+    for (unsigned int w = 0; w < nWorkers; w++) {
+        ast_mutex_destroy (&(pool.ranges[w].lock));
+    }
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static int _ast_pool_take (struct _ast_pool *pool, unsigned int self, size_t *item)
+{
+    struct _ast_pool_range *r = &(pool->ranges[self]);
+    int ok = 0;
+
+    ast_mutex_lock (&(r->lock));
+    if (r->begin < r->end) {
+        *item = r->begin++;
+        ok = 1;
+    }
+    ast_mutex_unlock (&(r->lock));
+    return ok;
+}
+
+
+
+
+
+static int _ast_pool_steal (struct _ast_pool *pool, unsigned int self)
+{
+    for (unsigned int k = 1; k < pool->nWorkers; k++) {
+        struct _ast_pool_range *victim = &(pool->ranges[(self + k) % pool->nWorkers]);
+        size_t begin = 0, end = 0;
+
+        ast_mutex_lock (&(victim->lock));
+        if (victim->begin < victim->end) {
+            // The upper half, rounded up so that a single item left can be stolen too.
+            begin = victim->begin + (victim->end - victim->begin) / 2;
+            end   = victim->end;
+            victim->end = begin;
+        }
+        ast_mutex_unlock (&(victim->lock));
+
+        if (begin < end) {
+            struct _ast_pool_range *own = &(pool->ranges[self]);
+
+            ast_mutex_lock (&(own->lock));
+            own->begin = begin;
+            own->end   = end;
+            ast_mutex_unlock (&(own->lock));
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+
+
+
+static void _ast_pool_work (struct _ast_pool *pool, unsigned int self)
+{
+    size_t item = 0;
+
+    do {
+        while (_ast_pool_take (pool, self, &item)) {
+            pool->task (pool->arg, item, self);
+        }
+    } while (_ast_pool_steal (pool, self));
+}
+
+
+
+
+
+#ifdef _WIN32
+static DWORD WINAPI _ast_pool_thread (LPVOID param)
+{
+    struct _ast_pool_worker *worker = param;
+
+    _ast_pool_work (worker->pool, worker->index);
+    return 0;
+}
+#else
+static void *_ast_pool_thread (void *param)
+{
+    struct _ast_pool_worker *worker = param;
+
+    _ast_pool_work (worker->pool, worker->index);
+    return NULL;
+}
+#endif
@@ -0,0 +1,55 @@
+/**
+ * @file pool.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares a work-stealing pool running a task over a range of items.
+ *
+ * The items are split evenly between the workers up front. A worker takes its own items one at a time;
+ * once it runs out, it steals the upper half of what another worker has left, so uneven items (a large
+ * dump next to a small one) still keep every worker busy. Each worker's range has its own lock, which is
+ * only contended while a steal is going on.
+ */
+
+#ifndef _AST_POOL_H
+#define _AST_POOL_H
+
+#include <stddef.h>
+
+/** Most workers a pool runs. */
+#define AST_POOL_MAX_WORKERS 256
+
+/**
+ * Task run for each item.
+ *
+ * @param arg    [in] Argument given to ast_pool_run.
+ * @param item   [in] Item index, below the item count.
+ * @param worker [in] Index of the worker running it, below the worker count. A worker runs one item at a
+ *                    time, so per-worker state needs no locking.
+ */
+typedef void (*ast_pool_task) (void *arg, size_t item, unsigned int worker);
+
+/**
+ * Number of processors available to this process.
+ *
+ * @return Processor count, at least 1.
+ */
+unsigned int ast_pool_cpu_count (void);
+
+/**
+ * Run a task over items 0 to nItems - 1 and wait for all of them.
+ *
+ * The calling thread is worker 0; nWorkers - 1 threads are started for the others.
+ *
+ * @param nItems   [in] Number of items.
+ * @param nWorkers [in] Number of workers, or 0 for ast_pool_cpu_count. At most AST_POOL_MAX_WORKERS,
+ *                      and no more than there are items.
+ * @param task     [in] Task.
+ * @param arg      [in] Argument passed to the task.
+ * @return AST_RETURN_SUCCESS. If threads cannot be started, the remaining workers run the items.
+ */
+int ast_pool_run (size_t nItems, unsigned int nWorkers, ast_pool_task task, void *arg);
+
+#endif /* end of include guard: _AST_POOL_H */
@@ -0,0 +1,100 @@
+/**
+ * @file thread.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements thread.h.
+ */
+
+#include "thread.h"
+
+#ifdef _WIN32
+struct _ast_once_arg {
+    void (*fn) (void);
+};
+
+static BOOL CALLBACK _ast_once_call (PINIT_ONCE once, PVOID param, PVOID *context);
+#endif
+
+
+
+
+
+void ast_mutex_init (ast_mutex *m)
+{
+#ifdef _WIN32
+    InitializeSRWLock (m);
+#else
+    pthread_mutex_init (m, NULL);
+#endif
+}
+
+
+
+
+
+void ast_mutex_destroy (ast_mutex *m)
+{
+#ifdef _WIN32
+    (void) m; // SRW locks hold no resources
+#else
+    pthread_mutex_destroy (m);
+#endif
+}
+
+
+
+
+
+void ast_mutex_lock (ast_mutex *m)
+{
+#ifdef _WIN32
+    AcquireSRWLockExclusive (m);
+#else
+    pthread_mutex_lock (m);
+#endif
+}
+
+
+
+
+
+void ast_mutex_unlock (ast_mutex *m)
+{
+#ifdef _WIN32
+    ReleaseSRWLockExclusive (m);
+#else
+    pthread_mutex_unlock (m);
+#endif
+}
+
+
+
+
+
+void ast_once_run (ast_once *once, void (*fn) (void))
+{
+#ifdef _WIN32
+    struct _ast_once_arg arg = { fn };
+
+    InitOnceExecuteOnce (once, _ast_once_call, &arg, NULL);
+#else
+    pthread_once (once, fn);
+#endif
+}
+
+
+
+
+
+#ifdef _WIN32
+static BOOL CALLBACK _ast_once_call (PINIT_ONCE once, PVOID param, PVOID *context)
+{
+    (void) once;
+    (void) context;
+    ((struct _ast_once_arg *) param)->fn ();
+    return TRUE;
+}
+#endif
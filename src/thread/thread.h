@@ -0,0 +1,66 @@
+/**
+ * @file thread.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares thin wrappers over the platform's locking primitives: slim reader/writer
+ * locks on Windows, POSIX threads elsewhere.
+ */
+
+#ifndef _AST_THREAD_H
+#define _AST_THREAD_H
+
+#ifdef _WIN32
+#include <windows.h>
+typedef SRWLOCK ast_mutex;
+#define AST_MUTEX_INIT SRWLOCK_INIT
+typedef INIT_ONCE ast_once;
+#define AST_ONCE_INIT INIT_ONCE_STATIC_INIT
+#else
+#include <pthread.h>
+typedef pthread_mutex_t ast_mutex;
+#define AST_MUTEX_INIT PTHREAD_MUTEX_INITIALIZER
+typedef pthread_once_t ast_once;
+#define AST_ONCE_INIT PTHREAD_ONCE_INIT
+#endif
+
+/**
+ * Initialize a mutex that cannot be statically initialized with AST_MUTEX_INIT (e.g. one in heap memory).
+ *
+ * @param m [in] Mutex to initialize.
+ */
+void ast_mutex_init (ast_mutex *m);
+
+/**
+ * Destroy a mutex initialized with ast_mutex_init. It must not be locked.
+ *
+ * @param m [in] Mutex to destroy.
+ */
+void ast_mutex_destroy (ast_mutex *m);
+
+/**
+ * Lock a mutex. Mutexes are statically initialized with AST_MUTEX_INIT and are not recursive.
+ *
+ * @param m [in] Mutex to lock.
+ */
+void ast_mutex_lock (ast_mutex *m);
+
+/**
+ * Unlock a mutex locked by ast_mutex_lock.
+ *
+ * @param m [in] Mutex to unlock.
+ */
+void ast_mutex_unlock (ast_mutex *m);
+
+/**
+ * Run a function exactly once per ast_once, statically initialized with AST_ONCE_INIT. Threads arriving
+ * while it runs wait for it to return, and then see everything it wrote.
+ *
+ * @param once [in] Guard.
+ * @param fn   [in] Function to run.
+ */
+void ast_once_run (ast_once *once, void (*fn) (void));
+
+#endif /* end of include guard: _AST_THREAD_H */
@@ -0,0 +1,1200 @@
+/**
+ * @file trace.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements trace.h.
+ *
+ * Records are encoded into a stack buffer and written with one buffered fwrite under the trace lock, so the
+ * cost of tracing a call is two clock reads and a few dozen bytes of copying. A batch or an enumeration step
+ * and the item records following it are written under the same lock, so they stay together.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+#include "trace.h"
+#include "../firmware/firmware.h"
+#include "../firmware/backend.h"
+#include "../privilege/privilege_os.h"
+#include "../thread/thread.h"
+#include "../arena/arena.h"
+
+#define AST_TRACE_MAGIC       "ASTTRACE"
+#define AST_TRACE_HEADER_SIZE 20
+#define AST_TRACE_RECORD_MAX  (1 + 3 * 10 + AST_EFIVAR_NAME_MAX + 6 * 10)
+#define AST_TRACE_REPLAY_ITERS 16
+#define AST_TRACE_RECORD_MIN  9           // Op byte and eight one-byte varints
+#define AST_TRACE_ITER_MAX    (1 << 20)   // Largest iterator chunk replayed
+
+struct ast_trace {
+    ast_mutex lock;
+    FILE      *fp;
+    uint64_t  t0;        // Clock at creation; record starts are relative to it
+    uint64_t  lastStart;
+    ast_guid  *guids;    // GUIDs defined so far, in order
+    size_t    nGuids;
+    size_t    capGuids;
+    size_t    lastGuid;  // Most calls in a row use the same GUID
+    uint64_t  nextIter;
+    int       failed;
+};
+
+struct _ast_trace_backend_ctx {
+    struct ast_efivar_backend *inner;
+    struct ast_trace *trace;
+};
+
+struct _ast_trace_iter {
+    void     *inner;
+    uint64_t id;
+};
+
+struct _ast_trace_os {
+    struct ast_privilege_os os; // First, so the table's address is the wrapper's
+    const struct ast_privilege_os *inner;
+    struct ast_trace *trace;
+};
+
+struct _ast_trace_reader {
+    uint8_t  *data;
+    size_t   size;
+    size_t   pos;
+    ast_guid *guids;
+    size_t   nGuids;
+    size_t   capGuids;
+    uint64_t start;
+};
+
+struct _ast_trace_rec {
+    int      op;
+    int      wantAttr;
+    int      hasGuid;
+    ast_guid guid;
+    char     name[AST_EFIVAR_NAME_MAX];
+    int      status;
+    uint64_t start;  // Nanoseconds after the trace was opened
+    uint64_t dur;
+    uint64_t a;
+    uint64_t b;
+    uint64_t c;
+};
+
+struct _ast_trace_seen {
+    ast_guid guid;
+    char     *name;
+    size_t   order;
+    int      prime;  // First seen as present in the store
+    size_t   size;
+    uint32_t attr;
+};
+
+static const char *_ast_trace_op_names[AST_TRACE_OP_COUNT] = {
+    "guid", "read", "write", "read_batch", "batch_item", "iter_open", "iter_next", "iter_item", "iter_close",
+    "priv_open", "priv_lookup", "priv_adjust", "priv_query", "priv_close"
+};
+
+static int  _ast_trace_read (void *ctx, const ast_guid *guid, const char *name, void *buf, size_t bufSiz, size_t *nBytes, uint32_t *attr);
+static int  _ast_trace_read_batch (void *ctx, const ast_var_request *reqs, size_t n, ast_var_result *results);
+static int  _ast_trace_write (void *ctx, const ast_guid *guid, const char *name, const void *buf, size_t bufSiz, uint32_t attr);
+static int  _ast_trace_iter_open (void *ctx, unsigned int flags, void **it);
+static int  _ast_trace_iter_next (void *ctx, void *it, struct ast_efivar_info *infos, size_t cap, size_t *n);
+static void _ast_trace_iter_close (void *ctx, void *it);
+static void _ast_trace_destroy (struct ast_efivar_backend *backend);
+
+static int  _ast_trace_os_open_token (void *ctx, void **token);
+static int  _ast_trace_os_lookup_value (void *ctx, const char *privName, ast_luid *luid);
+static int  _ast_trace_os_adjust (void *ctx, void *token, ast_luid luid, uint32_t attr);
+static int  _ast_trace_os_query (void *ctx, void *token, ast_luid_attr **privs, size_t *n);
+static void _ast_trace_os_close_token (void *ctx, void *token);
+
+static void   _ast_trace_emit (struct ast_trace *t, int op, const ast_guid *guid, const char *name, int status,
+                               uint64_t start, uint64_t end, uint64_t a, uint64_t b, uint64_t c);
+static void   _ast_trace_put (struct ast_trace *t, int op, const ast_guid *guid, const char *name, int status,
+                              uint64_t start, uint64_t end, uint64_t a, uint64_t b, uint64_t c);
+static size_t _ast_trace_guid_ref (struct ast_trace *t, const ast_guid *guid);
+static size_t _ast_trace_put_varint (uint8_t *p, uint64_t v);
+static int    _ast_trace_get_varint (struct _ast_trace_reader *r, uint64_t *v);
+static int    _ast_trace_reader_open (struct _ast_trace_reader *r, const char *path);
+static void   _ast_trace_reader_rewind (struct _ast_trace_reader *r);
+static void   _ast_trace_reader_close (struct _ast_trace_reader *r);
+static int    _ast_trace_reader_next (struct _ast_trace_reader *r, struct _ast_trace_rec *rec);
+static int    _ast_trace_prime (struct _ast_trace_reader *r, struct ast_trace_replay_stats *st);
+static int    _ast_trace_seen_cmp (const void *a, const void *b);
+static void  *_ast_trace_grow (void *p, size_t *cap, size_t need);
+static uint64_t _ast_trace_now (void);
+static void   _ast_trace_sleep (uint64_t ns);
+
+
+
+
+
+struct ast_trace *ast_trace_open (const char *path)
+{
+    struct ast_trace *t = calloc (1, sizeof (struct ast_trace));
+    uint8_t  header[AST_TRACE_HEADER_SIZE];
+    uint32_t version = AST_TRACE_VERSION;
+    uint64_t wall = (uint64_t) time (NULL) * 1000000000ULL;
+
+    if (t == NULL) {
+        return NULL;
+    }
+    t->fp = fopen (path, "wb");
+    if (t->fp == NULL) {
+        fprintf (stderr, " ** Cannot create trace %s.\n", path);
+        free (t);
+        return NULL;
+    }
+    // Records are small; let stdio gather them.
+    setvbuf (t->fp, NULL, _IOFBF, 1 << 16);
+
+    memcpy (header, AST_TRACE_MAGIC, 8);
+    for (int i = 0; i < 4; i++) {
+        header[8 + i] = (uint8_t) (version >> (8 * i));
+    }
+    for (int i = 0; i < 8; i++) {
+        header[12 + i] = (uint8_t) (wall >> (8 * i));
+    }
+    if (fwrite (header, 1, sizeof (header), t->fp) != sizeof (header)) {
+        t->failed = 1;
+    }
+
+    ast_mutex_init (&(t->lock));
+    t->t0 = _ast_trace_now ();
+    return t;
+}
+
+
+
+
+
+int ast_trace_close (struct ast_trace *trace)
+{
+    int failed = 0;
+
+    if (trace == NULL) {
+        return AST_RETURN_SUCCESS;
+    }
+    failed = trace->failed | (fclose (trace->fp) != 0);
+    ast_mutex_destroy (&(trace->lock));
+    free (trace->guids);
+    free (trace);
+    return failed ? AST_RETURN_OPERATION_FAILED : AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+struct ast_efivar_backend *ast_efivar_backend_trace_new (struct ast_efivar_backend *inner, struct ast_trace *trace)
+{
+    struct ast_efivar_backend *backend = NULL;
+    struct _ast_trace_backend_ctx *ctx = NULL;
+
+    if ((inner == NULL) || (trace == NULL)) {
+        return NULL;
+    }
+    backend = calloc (1, sizeof (struct ast_efivar_backend));
+    ctx     = calloc (1, sizeof (struct _ast_trace_backend_ctx));
+    if ((backend == NULL) || (ctx == NULL)) {
+        free (backend);
+        free (ctx);
+        return NULL;
+    }
+    ctx->inner = inner;
+    ctx->trace = trace;
+
+    // Optional operations stay absent, so firmware.c takes the same path as with inner alone.
+    backend->name       = "trace";
+    backend->ctx        = ctx;
+    backend->read       = _ast_trace_read;
+    backend->read_batch = (inner->read_batch != NULL) ? _ast_trace_read_batch : NULL;
+    backend->write      = _ast_trace_write;
+    backend->iter_open  = (inner->iter_open != NULL) ? _ast_trace_iter_open : NULL;
+    backend->iter_next  = _ast_trace_iter_next;
+    backend->iter_close = _ast_trace_iter_close;
+    backend->destroy    = _ast_trace_destroy;
+    return backend;
+}
+
+
+
+
+
+const struct ast_privilege_os *ast_privilege_os_trace_new (const struct ast_privilege_os *inner, struct ast_trace *trace)
+{
+    struct _ast_trace_os *w = NULL;
+
+    if ((inner == NULL) || (trace == NULL)) {
+        return NULL;
+    }
+    w = calloc (1, sizeof (struct _ast_trace_os));
+    if (w == NULL) {
+        return NULL;
+    }
+    w->inner = inner;
+    w->trace = trace;
+
+    w->os.name         = "trace";
+    w->os.ctx          = w;
+    w->os.open_token   = _ast_trace_os_open_token;
+    w->os.lookup_value = _ast_trace_os_lookup_value;
+    w->os.adjust       = _ast_trace_os_adjust;
+    w->os.query        = _ast_trace_os_query;
+    w->os.close_token  = _ast_trace_os_close_token;
+    return &(w->os);
+}
+
+
+
+
+
+void ast_privilege_os_trace_free (const struct ast_privilege_os *os)
+{
+    free ((void *) os);
+}
+
+
+
+
+
+int ast_trace_replay (const char *path, unsigned int flags, struct ast_trace_replay_stats *stats)
+{
+    struct _ast_trace_reader r;
+    struct _ast_trace_rec rec;
+    struct ast_trace_replay_stats st;
+    struct {
+        uint64_t id;
+        struct ast_efivar_iter *it;
+    } iters[AST_TRACE_REPLAY_ITERS];
+    struct ast_efivar_info *infos = NULL;
+    size_t   infosCap = 0;
+    uint8_t  *buf = NULL;
+    size_t   bufCap = 0;
+    uint64_t t0 = _ast_trace_now ();
+    uint64_t base = 0;   // Clock when replaying started, for AST_TRACE_REPLAY_TIMED
+    uint64_t first = 0;  // Recorded start of the first replayed call
+    int      haveFirst = 0;
+    int      k = 0;
+    int      ret = AST_RETURN_SUCCESS;
+
+    memset (&st, 0, sizeof (st));
+    memset (iters, 0, sizeof (iters));
+    ret = _ast_trace_reader_open (&r, path);
+    if (ret != AST_RETURN_SUCCESS) {
+        return ret;
+    }
+
+    if (flags & AST_TRACE_REPLAY_PRIME) {
+        ret = _ast_trace_prime (&r, &st);
+        if (ret != AST_RETURN_SUCCESS) {
+            goto out;
+        }
+        _ast_trace_reader_rewind (&r);
+    }
+
+    base = _ast_trace_now ();
+    while ((k = _ast_trace_reader_next (&r, &rec)) == 1) {
+        uint64_t s = 0;
+        int      same = 1;
+        int      status = AST_RETURN_SUCCESS;
+
+        if ((rec.op == AST_TRACE_OP_BATCH_ITEM) || (rec.op == AST_TRACE_OP_ITER_ITEM)) {
+            continue; // Consumed with the record they belong to
+        }
+        if ((rec.op >= AST_TRACE_OP_PRIV_OPEN_TOKEN) || ((rec.op == AST_TRACE_OP_WRITE) && !(flags & AST_TRACE_REPLAY_WRITES))) {
+            st.skipped++;
+            continue;
+        }
+
+        if (flags & AST_TRACE_REPLAY_TIMED) {
+            int64_t offset = 0;
+            int64_t elapsed = 0;
+
+            if (!haveFirst) {
+                first     = rec.start;
+                haveFirst = 1;
+            }
+            // Concurrent calls are recorded in completion order, so a start may precede the first one.
+            offset  = (int64_t) (rec.start - first);
+            elapsed = (int64_t) (_ast_trace_now () - base);
+            if (offset > elapsed) {
+                _ast_trace_sleep ((uint64_t) (offset - elapsed));
+            }
+        }
+
+        // Sizes and counts come from the file: a corrupt trace must not size allocations.
+        if ((((rec.op == AST_TRACE_OP_READ) || (rec.op == AST_TRACE_OP_WRITE)) && (rec.a > AST_EFIVAR_MAX_SIZE)) ||
+            ((rec.op == AST_TRACE_OP_READ_BATCH) && (rec.a > (r.size - r.pos) / AST_TRACE_RECORD_MIN)) ||
+            ((rec.op == AST_TRACE_OP_ITER_NEXT) && (rec.a > AST_TRACE_ITER_MAX))) {
+            ret = AST_RETURN_INVALID_PARAMETER;
+            goto out;
+        }
+
+        switch (rec.op) {
+            case AST_TRACE_OP_READ: {
+                size_t   nBytes = 0;
+                uint32_t attr = 0;
+
+                if ((buf = _ast_trace_grow (buf, &bufCap, rec.a)) == NULL) {
+                    ret = AST_RETURN_OPERATION_FAILED;
+                    goto out;
+                }
+                s = _ast_trace_now ();
+                status = ast_read_efivar_guid (buf, rec.a, &rec.guid, rec.name, &nBytes, rec.wantAttr ? &attr : NULL);
+                same = (status == rec.status) && ((status != AST_RETURN_SUCCESS) || (nBytes == rec.b));
+                break;
+            }
+
+            case AST_TRACE_OP_WRITE:
+                if ((buf = _ast_trace_grow (buf, &bufCap, rec.a)) == NULL) {
+                    ret = AST_RETURN_OPERATION_FAILED;
+                    goto out;
+                }
+                memset (buf, 0, rec.a);
+                s = _ast_trace_now ();
+                status = ast_write_efivar_guid (buf, rec.a, &rec.guid, rec.name, (uint32_t) rec.c);
+                same = (status == rec.status);
+                break;
+
+            case AST_TRACE_OP_READ_BATCH: {
+                size_t n = rec.a;
+                size_t total = 0;
+                ast_var_request *reqs = calloc (n + 1, sizeof (ast_var_request));
+                ast_var_result  *results = calloc (n + 1, sizeof (ast_var_result));
+                struct _ast_trace_rec *items = calloc (n + 1, sizeof (struct _ast_trace_rec));
+
+                if ((reqs == NULL) || (results == NULL) || (items == NULL)) {
+                    free (reqs);
+                    free (results);
+                    free (items);
+                    ret = AST_RETURN_OPERATION_FAILED;
+                    goto out;
+                }
+                for (size_t i = 0; i < n; i++) {
+                    if ((_ast_trace_reader_next (&r, &items[i]) != 1) || (items[i].op != AST_TRACE_OP_BATCH_ITEM) ||
+                        (items[i].a > AST_EFIVAR_MAX_SIZE) || (total > SIZE_MAX - items[i].a)) {
+                        free (reqs);
+                        free (results);
+                        free (items);
+                        ret = AST_RETURN_INVALID_PARAMETER;
+                        goto out;
+                    }
+                    total += items[i].a;
+                }
+                buf = _ast_trace_grow (buf, &bufCap, total);
+                if (buf == NULL) {
+                    free (reqs);
+                    free (results);
+                    free (items);
+                    ret = AST_RETURN_OPERATION_FAILED;
+                    goto out;
+                }
+                total = 0;
+                for (size_t i = 0; i < n; i++) {
+                    reqs[i].guid     = &(items[i].guid);
+                    reqs[i].name     = items[i].name;
+                    reqs[i].buf      = buf + total;
+                    reqs[i].bufSiz   = items[i].a;
+                    reqs[i].withAttr = items[i].wantAttr;
+                    total += items[i].a;
+                }
+
+                s = _ast_trace_now ();
+                status = ast_read_efivars_batch (reqs, n, results);
+                same = 1;
+                for (size_t i = 0; i < n; i++) {
+                    if ((results[i].status != items[i].status) ||
+                        ((results[i].status == AST_RETURN_SUCCESS) && (results[i].nBytes != items[i].b))) {
+                        same = 0;
+                    }
+                }
+                free (reqs);
+                free (results);
+                free (items);
+                break;
+            }
+
+            case AST_TRACE_OP_ITER_OPEN: {
+                size_t slot = AST_TRACE_REPLAY_ITERS;
+
+                for (size_t i = 0; i < AST_TRACE_REPLAY_ITERS; i++) {
+                    if (iters[i].it == NULL) {
+                        slot = i;
+                        break;
+                    }
+                }
+                if (slot == AST_TRACE_REPLAY_ITERS) {
+                    st.skipped++;
+                    continue;
+                }
+                s = _ast_trace_now ();
+                status = ast_efivar_iter_open (&(iters[slot].it), (unsigned int) rec.a);
+                iters[slot].id = rec.b;
+                if (status != AST_RETURN_SUCCESS) {
+                    iters[slot].it = NULL;
+                }
+                same = (status == rec.status);
+                break;
+            }
+
+            case AST_TRACE_OP_ITER_NEXT:
+            case AST_TRACE_OP_ITER_CLOSE: {
+                struct ast_efivar_iter *it = NULL;
+                size_t i = 0;
+                size_t n = 0;
+
+                for (i = 0; i < AST_TRACE_REPLAY_ITERS; i++) {
+                    if ((iters[i].it != NULL) && (iters[i].id == rec.c)) {
+                        it = iters[i].it;
+                        break;
+                    }
+                }
+                if (it == NULL) {
+                    st.skipped++;
+                    continue;
+                }
+
+                if (rec.op == AST_TRACE_OP_ITER_CLOSE) {
+                    s = _ast_trace_now ();
+                    ast_efivar_iter_close (it);
+                    iters[i].it = NULL;
+                    break;
+                }
+
+                if (rec.a > infosCap) {
+                    free (infos);
+                    infos = malloc (rec.a * sizeof (struct ast_efivar_info));
+                    infosCap = (infos == NULL) ? 0 : rec.a;
+                    if (infos == NULL) {
+                        ret = AST_RETURN_OPERATION_FAILED;
+                        goto out;
+                    }
+                }
+                s = _ast_trace_now ();
+                status = ast_efivar_iter_next (it, infos, rec.a, &n);
+                same = (status == rec.status) && (n == rec.b);
+                break;
+            }
+
+            default:
+                st.skipped++;
+                continue;
+        }
+
+        st.replayedNs += _ast_trace_now () - s;
+        st.recordedNs += rec.dur;
+        st.ops++;
+        if (!same) {
+            st.mismatches++;
+        }
+    }
+    if (k < 0) {
+        fprintf (stderr, " ** Trace %s is truncated or malformed.\n", path);
+        ret = AST_RETURN_INVALID_PARAMETER;
+    }
+
+out:
+    for (size_t i = 0; i < AST_TRACE_REPLAY_ITERS; i++) {
+        if (iters[i].it != NULL) {
+            ast_efivar_iter_close (iters[i].it);
+        }
+    }
+    st.wallNs = _ast_trace_now () - t0;
+    if (stats != NULL) {
+        *stats = st;
+    }
+    free (infos);
+    free (buf);
+    _ast_trace_reader_close (&r);
+    return ret;
+}
+
+
+
+
+
+int ast_trace_dump (const char *path, FILE *out)
+{
+    struct _ast_trace_reader r;
+    struct _ast_trace_rec rec;
+    char guid[AST_GUID_STRLEN + 1];
+    int  k = 0;
+    int  ret = _ast_trace_reader_open (&r, path);
+
+    if (ret != AST_RETURN_SUCCESS) {
+        return ret;
+    }
+
+    while ((k = _ast_trace_reader_next (&r, &rec)) == 1) {
+        if (rec.hasGuid) {
+            ast_guid_format (&(rec.guid), guid);
+        } else {
+            strcpy (guid, "-");
+        }
+        fprintf (out, "%14.3f us %-11s %s %s%s status=%d dur=%llu ns a=%llu b=%llu c=%#llx\n",
+                 rec.start / 1000.0, _ast_trace_op_names[rec.op], guid, (rec.name[0] == '\0') ? "-" : rec.name,
+                 rec.wantAttr ? " +attr" : "", rec.status, (unsigned long long) rec.dur,
+                 (unsigned long long) rec.a, (unsigned long long) rec.b, (unsigned long long) rec.c);
+    }
+
+    _ast_trace_reader_close (&r);
+    return (k < 0) ? AST_RETURN_INVALID_PARAMETER : AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static int _ast_trace_read (void *ctx, const ast_guid *guid, const char *name, void *buf, size_t bufSiz, size_t *nBytes, uint32_t *attr)
+{
+    struct _ast_trace_backend_ctx *c = ctx;
+    size_t   n = 0;
+    uint64_t start = _ast_trace_now ();
+    int      ret = c->inner->read (c->inner->ctx, guid, name, buf, bufSiz, &n, attr);
+    uint64_t end = _ast_trace_now ();
+
+    _ast_trace_emit (c->trace, AST_TRACE_OP_READ | ((attr != NULL) ? AST_TRACE_OP_WANT_ATTR : 0), guid, name, ret,
+                     start, end, bufSiz, n, ((attr != NULL) && (ret == AST_RETURN_SUCCESS)) ? *attr : 0);
+    if (nBytes != NULL) {
+        *nBytes = n;
+    }
+    return ret;
+}
+
+
+
+
+
+static int _ast_trace_read_batch (void *ctx, const ast_var_request *reqs, size_t n, ast_var_result *results)
+{
+    struct _ast_trace_backend_ctx *c = ctx;
+    uint64_t start = _ast_trace_now ();
+    int      ret = c->inner->read_batch (c->inner->ctx, reqs, n, results);
+    uint64_t end = _ast_trace_now ();
+
+    ast_mutex_lock (&(c->trace->lock));
+    _ast_trace_put (c->trace, AST_TRACE_OP_READ_BATCH, NULL, NULL, ret, start, end, n, 0, 0);
+    for (size_t i = 0; i < n; i++) {
+        _ast_trace_put (c->trace, AST_TRACE_OP_BATCH_ITEM | (reqs[i].withAttr ? AST_TRACE_OP_WANT_ATTR : 0), reqs[i].guid, reqs[i].name,
+                        results[i].status, start, start, reqs[i].bufSiz, results[i].nBytes, results[i].attr);
+    }
+    ast_mutex_unlock (&(c->trace->lock));
+    return ret;
+}
+
+
+
+
+
+static int _ast_trace_write (void *ctx, const ast_guid *guid, const char *name, const void *buf, size_t bufSiz, uint32_t attr)
+{
+    struct _ast_trace_backend_ctx *c = ctx;
+    uint64_t start = _ast_trace_now ();
+    int      ret = c->inner->write (c->inner->ctx, guid, name, buf, bufSiz, attr);
+    uint64_t end = _ast_trace_now ();
+
+    _ast_trace_emit (c->trace, AST_TRACE_OP_WRITE, guid, name, ret, start, end, bufSiz, 0, attr);
+    return ret;
+}
+
+
+
+
+
+static int _ast_trace_iter_open (void *ctx, unsigned int flags, void **it)
+{
+    struct _ast_trace_backend_ctx *c = ctx;
+    struct _ast_trace_iter *i = calloc (1, sizeof (struct _ast_trace_iter));
+    uint64_t start = 0;
+    int      ret = AST_RETURN_SUCCESS;
+
+    if (i == NULL) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+
+    ast_mutex_lock (&(c->trace->lock));
+    i->id = ++(c->trace->nextIter);
+    ast_mutex_unlock (&(c->trace->lock));
+
+    start = _ast_trace_now ();
+    ret = c->inner->iter_open (c->inner->ctx, flags, &(i->inner));
+    _ast_trace_emit (c->trace, AST_TRACE_OP_ITER_OPEN, NULL, NULL, ret, start, _ast_trace_now (), flags, i->id, 0);
+
+    if (ret != AST_RETURN_SUCCESS) {
+        free (i);
+        return ret;
+    }
+    *it = i;
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static int _ast_trace_iter_next (void *ctx, void *it, struct ast_efivar_info *infos, size_t cap, size_t *n)
+{
+    struct _ast_trace_backend_ctx *c = ctx;
+    struct _ast_trace_iter *i = it;
+    uint64_t start = _ast_trace_now ();
+    int      ret = c->inner->iter_next (c->inner->ctx, i->inner, infos, cap, n);
+    uint64_t end = _ast_trace_now ();
+    size_t   got = (ret == AST_RETURN_SUCCESS) ? *n : 0;
+
+    ast_mutex_lock (&(c->trace->lock));
+    _ast_trace_put (c->trace, AST_TRACE_OP_ITER_NEXT, NULL, NULL, ret, start, end, cap, got, i->id);
+    for (size_t k = 0; k < got; k++) {
+        _ast_trace_put (c->trace, AST_TRACE_OP_ITER_ITEM, &(infos[k].guid), infos[k].name, AST_RETURN_SUCCESS,
+                        start, start, infos[k].size, 0, infos[k].attr);
+    }
+    ast_mutex_unlock (&(c->trace->lock));
+    return ret;
+}
+
+
+
+
+
+static void _ast_trace_iter_close (void *ctx, void *it)
+{
+    struct _ast_trace_backend_ctx *c = ctx;
+    struct _ast_trace_iter *i = it;
+    uint64_t start = _ast_trace_now ();
+
+    c->inner->iter_close (c->inner->ctx, i->inner);
+    _ast_trace_emit (c->trace, AST_TRACE_OP_ITER_CLOSE, NULL, NULL, AST_RETURN_SUCCESS, start, _ast_trace_now (), 0, 0, i->id);
+    free (i);
+}
+
+
+
+
+
+static void _ast_trace_destroy (struct ast_efivar_backend *backend)
+{
+    free (backend->ctx);
+    free (backend);
+}
+
+
+
+
+
+static int _ast_trace_os_open_token (void *ctx, void **token)
+{
+    struct _ast_trace_os *w = ctx;
+    uint64_t start = _ast_trace_now ();
+    int      ret = w->inner->open_token (w->inner->ctx, token);
+
+    _ast_trace_emit (w->trace, AST_TRACE_OP_PRIV_OPEN_TOKEN, NULL, NULL, ret, start, _ast_trace_now (), 0, 0, 0);
+    return ret;
+}
+
+
+
+
+
+static int _ast_trace_os_lookup_value (void *ctx, const char *privName, ast_luid *luid)
+{
+    struct _ast_trace_os *w = ctx;
+    uint64_t start = _ast_trace_now ();
+    int      ret = w->inner->lookup_value (w->inner->ctx, privName, luid);
+
+    _ast_trace_emit (w->trace, AST_TRACE_OP_PRIV_LOOKUP, NULL, privName, ret, start, _ast_trace_now (),
+                     (ret == EXIT_SUCCESS) ? luid->low : 0, (ret == EXIT_SUCCESS) ? (uint32_t) luid->high : 0, 0);
+    return ret;
+}
+
+
+
+
+
+static int _ast_trace_os_adjust (void *ctx, void *token, ast_luid luid, uint32_t attr)
+{
+    struct _ast_trace_os *w = ctx;
+    uint64_t start = _ast_trace_now ();
+    int      ret = w->inner->adjust (w->inner->ctx, token, luid, attr);
+
+    _ast_trace_emit (w->trace, AST_TRACE_OP_PRIV_ADJUST, NULL, NULL, ret, start, _ast_trace_now (), luid.low, (uint32_t) luid.high, attr);
+    return ret;
+}
+
+
+
+
+
+static int _ast_trace_os_query (void *ctx, void *token, ast_luid_attr **privs, size_t *n)
+{
+    struct _ast_trace_os *w = ctx;
+    uint64_t start = _ast_trace_now ();
+    int      ret = w->inner->query (w->inner->ctx, token, privs, n);
+
+    _ast_trace_emit (w->trace, AST_TRACE_OP_PRIV_QUERY, NULL, NULL, ret, start, _ast_trace_now (), 0, (ret == EXIT_SUCCESS) ? *n : 0, 0);
+    return ret;
+}
+
+
+
+
+
+static void _ast_trace_os_close_token (void *ctx, void *token)
+{
+    struct _ast_trace_os *w = ctx;
+    uint64_t start = _ast_trace_now ();
+
+    w->inner->close_token (w->inner->ctx, token);
+    _ast_trace_emit (w->trace, AST_TRACE_OP_PRIV_CLOSE_TOKEN, NULL, NULL, EXIT_SUCCESS, start, _ast_trace_now (), 0, 0, 0);
+}
+
+
+
+
+
+static void _ast_trace_emit (struct ast_trace *t, int op, const ast_guid *guid, const char *name, int status,
+                             uint64_t start, uint64_t end, uint64_t a, uint64_t b, uint64_t c)
+{
+    ast_mutex_lock (&(t->lock));
+    _ast_trace_put (t, op, guid, name, status, start, end, a, b, c);
+    ast_mutex_unlock (&(t->lock));
+}
+
+
+
+
+
+static void _ast_trace_put (struct ast_trace *t, int op, const ast_guid *guid, const char *name, int status,
+                            uint64_t start, uint64_t end, uint64_t a, uint64_t b, uint64_t c)
+{
+    // Called with t->lock held.
+    uint8_t rec[AST_TRACE_RECORD_MAX];
+    size_t  len = 0;
+    size_t  nameLen = (name == NULL) ? 0 : strlen (name);
+    size_t  ref = 0;
+    int64_t rel = (int64_t) (start - t->t0);
+    int64_t delta = rel - (int64_t) t->lastStart;
+
+    if (guid != NULL) {
+        ref = _ast_trace_guid_ref (t, guid);
+    }
+    if (nameLen >= AST_EFIVAR_NAME_MAX) {
+        nameLen = AST_EFIVAR_NAME_MAX - 1;
+    }
+
+    rec[len++] = (uint8_t) op;
+    len += _ast_trace_put_varint (rec + len, ref);
+    len += _ast_trace_put_varint (rec + len, nameLen);
+    if (nameLen != 0) {
+        memcpy (rec + len, name, nameLen);
+        len += nameLen;
+    }
+    len += _ast_trace_put_varint (rec + len, ((uint64_t) (int64_t) status << 1) ^ (uint64_t) ((int64_t) status >> 63));
+    len += _ast_trace_put_varint (rec + len, ((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63));
+    len += _ast_trace_put_varint (rec + len, end - start);
+    len += _ast_trace_put_varint (rec + len, a);
+    len += _ast_trace_put_varint (rec + len, b);
+    len += _ast_trace_put_varint (rec + len, c);
+    t->lastStart = (uint64_t) rel;
+
+    if (fwrite (rec, 1, len, t->fp) != len) {
+        t->failed = 1;
+    }
+}
+
+
+
+
+
+static size_t _ast_trace_guid_ref (struct ast_trace *t, const ast_guid *guid)
+{
+    // Called with t->lock held. Returns the 1-based reference, defining the GUID first if it is new.
+    uint8_t rec[1 + sizeof (guid->b)];
+
+    if ((t->nGuids != 0) && ast_guid_equal (&(t->guids[t->lastGuid]), guid)) {
+        return t->lastGuid + 1;
+    }
+    for (size_t i = 0; i < t->nGuids; i++) {
+        if (ast_guid_equal (&(t->guids[i]), guid)) {
+            t->lastGuid = i;
+            return i + 1;
+        }
+    }
+
+    if (t->nGuids == t->capGuids) {
+        size_t   cap = (t->capGuids == 0) ? 8 : 2 * t->capGuids;
+        ast_guid *guids = realloc (t->guids, cap * sizeof (ast_guid));
+
+        if (guids == NULL) {
+            t->failed = 1;
+            return 0;
+        }
+        t->guids    = guids;
+        t->capGuids = cap;
+    }
+    t->guids[t->nGuids] = *guid;
+    t->lastGuid = t->nGuids++;
+
+    rec[0] = AST_TRACE_OP_GUID;
+    memcpy (rec + 1, guid->b, sizeof (guid->b));
+    if (fwrite (rec, 1, sizeof (rec), t->fp) != sizeof (rec)) {
+        t->failed = 1;
+    }
+    return t->nGuids;
+}
+
+
+
+
+
+static size_t _ast_trace_put_varint (uint8_t *p, uint64_t v)
+{
+    size_t n = 0;
+
+    while (v >= 0x80) {
+        p[n++] = (uint8_t) (v | 0x80);
+        v >>= 7;
+    }
+    p[n++] = (uint8_t) v;
+    return n;
+}
+
+
+
+
+
+static int _ast_trace_get_varint (struct _ast_trace_reader *r, uint64_t *v)
+{
+    *v = 0;
+    for (unsigned int shift = 0; shift < 64; shift += 7) {
+        uint8_t byte = 0;
+
+        if (r->pos >= r->size) {
+            return -1;
+        }
+        byte = r->data[r->pos++];
+        *v |= (uint64_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return 0;
+        }
+    }
+    return -1;
+}
+
+
+
+
+
+static int _ast_trace_reader_open (struct _ast_trace_reader *r, const char *path)
+{
+    FILE *fp = fopen (path, "rb");
+    long size = 0;
+
+    memset (r, 0, sizeof (struct _ast_trace_reader));
+    if (fp == NULL) {
+        fprintf (stderr, " ** Cannot open trace %s.\n", path);
+        return AST_RETURN_NOT_FOUND;
+    }
+    if ((fseek (fp, 0, SEEK_END) != 0) || ((size = ftell (fp)) < AST_TRACE_HEADER_SIZE) || (fseek (fp, 0, SEEK_SET) != 0)) {
+        fclose (fp);
+        fprintf (stderr, " ** %s is not a trace.\n", path);
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    r->size = (size_t) size;
+    r->data = malloc (r->size);
+    if ((r->data == NULL) || (fread (r->data, 1, r->size, fp) != r->size)) {
+        fclose (fp);
+        free (r->data);
+        r->data = NULL;
+        return AST_RETURN_OPERATION_FAILED;
+    }
+    fclose (fp);
+
+    if ((memcmp (r->data, AST_TRACE_MAGIC, 8) != 0) ||
+        ((r->data[8] | (r->data[9] << 8) | (r->data[10] << 16) | ((uint32_t) r->data[11] << 24)) != AST_TRACE_VERSION)) {
+        fprintf (stderr, " ** %s is not a version %d trace.\n", path, AST_TRACE_VERSION);
+        _ast_trace_reader_close (r);
+        return AST_RETURN_NOT_SUPPORTED;
+    }
+    r->pos = AST_TRACE_HEADER_SIZE;
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static void _ast_trace_reader_rewind (struct _ast_trace_reader *r)
+{
+    r->pos    = AST_TRACE_HEADER_SIZE;
+    r->nGuids = 0;
+    r->start  = 0;
+}
+
+
+
+
+
+static void _ast_trace_reader_close (struct _ast_trace_reader *r)
+{
+    free (r->data);
+    free (r->guids);
+    memset (r, 0, sizeof (struct _ast_trace_reader));
+}
+
+
+
+
+
+static int _ast_trace_reader_next (struct _ast_trace_reader *r, struct _ast_trace_rec *rec)
+{
+    uint64_t ref = 0;
+    uint64_t nameLen = 0;
+    uint64_t v = 0;
+    uint8_t  op = 0;
+
+    // GUID definitions are folded into the reader's table.
+    for (;;) {
+        if (r->pos == r->size) {
+            return 0;
+        }
+        op = r->data[r->pos++];
+        if (op != AST_TRACE_OP_GUID) {
+            break;
+        }
+        if (r->size - r->pos < sizeof (ast_guid)) {
+            return -1;
+        }
+        if (r->nGuids == r->capGuids) {
+            size_t   cap = (r->capGuids == 0) ? 8 : 2 * r->capGuids;
+            ast_guid *guids = realloc (r->guids, cap * sizeof (ast_guid));
+
+            if (guids == NULL) {
+                return -1;
+            }
+            r->guids    = guids;
+            r->capGuids = cap;
+        }
+        memcpy (r->guids[r->nGuids++].b, r->data + r->pos, sizeof (ast_guid));
+        r->pos += sizeof (ast_guid);
+    }
+
+    rec->op       = op & ~AST_TRACE_OP_WANT_ATTR;
+    rec->wantAttr = (op & AST_TRACE_OP_WANT_ATTR) != 0;
+    if (rec->op >= AST_TRACE_OP_COUNT) {
+        return -1;
+    }
+
+    if ((_ast_trace_get_varint (r, &ref) != 0) || (ref > r->nGuids)) {
+        return -1;
+    }
+    rec->hasGuid = (ref != 0);
+    if (rec->hasGuid) {
+        rec->guid = r->guids[ref - 1];
+    }
+
+    if ((_ast_trace_get_varint (r, &nameLen) != 0) || (nameLen >= AST_EFIVAR_NAME_MAX) || (nameLen > r->size - r->pos)) {
+        return -1;
+    }
+    memcpy (rec->name, r->data + r->pos, nameLen);
+    rec->name[nameLen] = '\0';
+    r->pos += nameLen;
+
+    if (_ast_trace_get_varint (r, &v) != 0) {
+        return -1;
+    }
+    rec->status = (int) (int64_t) ((v >> 1) ^ (~(v & 1) + 1));
+    if (_ast_trace_get_varint (r, &v) != 0) {
+        return -1;
+    }
+    r->start  += (uint64_t) (int64_t) ((v >> 1) ^ (~(v & 1) + 1));
+    rec->start = r->start;
+
+    if ((_ast_trace_get_varint (r, &(rec->dur)) != 0) || (_ast_trace_get_varint (r, &(rec->a)) != 0) ||
+        (_ast_trace_get_varint (r, &(rec->b)) != 0) || (_ast_trace_get_varint (r, &(rec->c)) != 0)) {
+        return -1;
+    }
+    return 1;
+}
+
+
+
+
+
+static int _ast_trace_prime (struct _ast_trace_reader *r, struct ast_trace_replay_stats *st)
+{
+    // The store as the trace found it: a variable whose first appearance shows it present existed before.
+    struct ast_arena arena;
+    struct _ast_trace_rec rec;
+    struct _ast_trace_seen *seen = NULL;
+    size_t  nSeen = 0;
+    size_t  capSeen = 0;
+    uint8_t *zero = NULL;
+    size_t  zeroCap = 0;
+    int     k = 0;
+    int     ret = AST_RETURN_SUCCESS;
+
+    ast_arena_init (&arena, 0);
+    while ((k = _ast_trace_reader_next (r, &rec)) == 1) {
+        struct _ast_trace_seen *s = NULL;
+        size_t nameLen = strlen (rec.name);
+
+        if (!rec.hasGuid || ((rec.op != AST_TRACE_OP_READ) && (rec.op != AST_TRACE_OP_BATCH_ITEM) &&
+                             (rec.op != AST_TRACE_OP_ITER_ITEM) && (rec.op != AST_TRACE_OP_WRITE))) {
+            continue;
+        }
+        if (nSeen == capSeen) {
+            size_t cap = (capSeen == 0) ? 64 : 2 * capSeen;
+            struct _ast_trace_seen *p = realloc (seen, cap * sizeof (struct _ast_trace_seen));
+
+            if (p == NULL) {
+                ret = AST_RETURN_OPERATION_FAILED;
+                goto out;
+            }
+            seen    = p;
+            capSeen = cap;
+        }
+
+        s = &seen[nSeen];
+        s->guid  = rec.guid;
+        s->order = nSeen;
+        s->name  = ast_arena_alloc (&arena, nameLen + 1);
+        if (s->name == NULL) {
+            ret = AST_RETURN_OPERATION_FAILED;
+            goto out;
+        }
+        memcpy (s->name, rec.name, nameLen + 1);
+        s->prime = 0;
+        s->attr  = AST_EFIVAR_DEFAULT_ATTRIBUTES;
+        if (rec.op == AST_TRACE_OP_ITER_ITEM) {
+            s->prime = 1;
+            s->size  = rec.a;
+            s->attr  = (rec.c != 0) ? (uint32_t) rec.c : s->attr;
+        } else if ((rec.op != AST_TRACE_OP_WRITE) &&
+                   ((rec.status == AST_RETURN_SUCCESS) || (rec.status == AST_RETURN_BUFFER_TOO_SMALL))) {
+            s->prime = 1;
+            s->size  = rec.b;
+            s->attr  = (rec.wantAttr && (rec.status == AST_RETURN_SUCCESS)) ? (uint32_t) rec.c : s->attr;
+        }
+        if (s->size == 0) {
+            s->prime = 0; // Size unknown: nothing sensible to create
+        }
+        nSeen++;
+    }
+    if (k < 0) {
+        ret = AST_RETURN_INVALID_PARAMETER;
+        goto out;
+    }
+
+    qsort (seen, nSeen, sizeof (struct _ast_trace_seen), _ast_trace_seen_cmp);
+    for (size_t i = 0; i < nSeen; i++) {
+        if ((i > 0) && ast_guid_equal (&(seen[i].guid), &(seen[i - 1].guid)) && (strcmp (seen[i].name, seen[i - 1].name) == 0)) {
+            continue; // Only the first appearance counts
+        }
+        if (!seen[i].prime) {
+            continue;
+        }
+        if ((zero = _ast_trace_grow (zero, &zeroCap, seen[i].size)) == NULL) {
+            ret = AST_RETURN_OPERATION_FAILED;
+            goto out;
+        }
+        memset (zero, 0, seen[i].size);
+        if (ast_write_efivar_guid (zero, seen[i].size, &(seen[i].guid), seen[i].name, seen[i].attr) == AST_RETURN_SUCCESS) {
+            st->primed++;
+        }
+    }
+
+out:
+    free (zero);
+    free (seen);
+    ast_arena_free (&arena);
+    return ret;
+}
+
+
+
+
+
+static int _ast_trace_seen_cmp (const void *a, const void *b)
+{
+    const struct _ast_trace_seen *x = a;
+    const struct _ast_trace_seen *y = b;
+    int c = memcmp (x->guid.b, y->guid.b, sizeof (x->guid.b));
+
+    if (c == 0) {
+        c = strcmp (x->name, y->name);
+    }
+    if (c == 0) {
+        c = (x->order > y->order) - (x->order < y->order);
+    }
+    return c;
+}
+
+
+
+
+
+static void *_ast_trace_grow (void *p, size_t *cap, size_t need)
+{
+    // Keeps the old buffer on failure only to free it: callers give up then.
+    void *q = NULL;
+
+    if ((need <= *cap) && (p != NULL)) {
+        return p;
+    }
+    q = realloc (p, (need == 0) ? 1 : need);
+    if (q == NULL) {
+        free (p);
+        *cap = 0;
+        return NULL;
+    }
+    *cap = need;
+    return q;
+}
+
+
+
+
+
+static uint64_t _ast_trace_now (void)
+{
+#ifdef _WIN32
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+
+    if (freq.QuadPart == 0) {
+        QueryPerformanceFrequency (&freq);
+    }
+    QueryPerformanceCounter (&count);
+    return (uint64_t) (count.QuadPart / freq.QuadPart) * 1000000000ULL +
+           (uint64_t) (count.QuadPart % freq.QuadPart) * 1000000000ULL / (uint64_t) freq.QuadPart;
+#else
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+#endif
+}
+
+
+
+
+
+static void _ast_trace_sleep (uint64_t ns)
+{
+#ifdef _WIN32
+    Sleep ((DWORD) (ns / 1000000));
+#else
+    struct timespec req = { (time_t) (ns / 1000000000ULL), (long) (ns % 1000000000ULL) };
+
+    while ((nanosleep (&req, &req) != 0) && (errno == EINTR)) {
+    }
+#endif
+}
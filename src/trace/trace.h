@@ -0,0 +1,154 @@
+/**
+ * @file trace.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares recording and replaying of variable store and privilege calls.
+ *
+ * A recording backend wraps another backend and logs every call it forwards; a recording privilege table
+ * does the same for the privilege manager's operating system calls. The trace file starts with a header
+ * (`ASTTRACE`, a 32-bit version, the 64-bit wall clock time of the start in nanoseconds since the epoch),
+ * followed by records:
+ *
+ *     op (byte) | guid (varint) | name length (varint) | name | status (varint)
+ *               | start (zigzag varint, nanoseconds after the previous record's start)
+ *               | duration (varint, nanoseconds) | a | b | c (varints)
+ *
+ * Varints are unsigned LEB128. A GUID is written once, in an AST_TRACE_OP_GUID record made of the op byte
+ * and its 16 bytes; later records refer to the n-th such GUID as n (0 means none). The meaning of a, b and
+ * c depends on the op, see enum AST_TRACE_OP. Values written or read are not recorded.
+ */
+
+#ifndef _AST_TRACE_H
+#define _AST_TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "../guid/guid.h"
+
+struct ast_efivar_backend;
+struct ast_privilege_os;
+struct ast_trace;
+
+/** Current trace format version. */
+#define AST_TRACE_VERSION 1
+
+/**
+ * Record types of a trace.
+ */
+enum AST_TRACE_OP {
+    AST_TRACE_OP_GUID = 0,        /**< Defines the next GUID; not an operation. */
+    AST_TRACE_OP_READ,            /**< a = buffer size, b = bytes returned or needed, c = attributes. */
+    AST_TRACE_OP_WRITE,           /**< a = size (0 deletes), c = attributes. */
+    AST_TRACE_OP_READ_BATCH,      /**< a = number of AST_TRACE_OP_BATCH_ITEM records that follow. */
+    AST_TRACE_OP_BATCH_ITEM,      /**< One read of a batch, fields as AST_TRACE_OP_READ; no duration of its own. */
+    AST_TRACE_OP_ITER_OPEN,       /**< a = flags, b = iterator id. */
+    AST_TRACE_OP_ITER_NEXT,       /**< a = capacity, b = records returned, c = iterator id. */
+    AST_TRACE_OP_ITER_ITEM,       /**< One record returned by the preceding AST_TRACE_OP_ITER_NEXT: a = size, c = attributes. */
+    AST_TRACE_OP_ITER_CLOSE,      /**< c = iterator id. */
+    AST_TRACE_OP_PRIV_OPEN_TOKEN, /**< Privilege table open_token. */
+    AST_TRACE_OP_PRIV_LOOKUP,     /**< Privilege table lookup_value: name = privilege, a = LUID low, b = LUID high. */
+    AST_TRACE_OP_PRIV_ADJUST,     /**< Privilege table adjust: a = LUID low, b = LUID high, c = attributes. */
+    AST_TRACE_OP_PRIV_QUERY,      /**< Privilege table query: b = number of privileges. */
+    AST_TRACE_OP_PRIV_CLOSE_TOKEN,/**< Privilege table close_token. */
+    AST_TRACE_OP_COUNT
+};
+
+/** Set in the op byte of AST_TRACE_OP_READ and AST_TRACE_OP_BATCH_ITEM when attributes were asked for. */
+#define AST_TRACE_OP_WANT_ATTR 0x80
+
+/** Replay with the recorded spacing between calls instead of as fast as possible. */
+#define AST_TRACE_REPLAY_TIMED  0x00000001
+/** Replay writes and deletions too (with zero-filled values). Without it, they are skipped. */
+#define AST_TRACE_REPLAY_WRITES 0x00000002
+/**
+ * Before replaying, create every variable the trace found in the store (read or enumerated before being
+ * written), zero-filled with its recorded size and attributes. Meant for an empty emulated store.
+ */
+#define AST_TRACE_REPLAY_PRIME  0x00000004
+
+/**
+ * Outcome of a replay.
+ */
+struct ast_trace_replay_stats {
+    unsigned long ops;        /**< Operations replayed */
+    unsigned long skipped;    /**< Operations not replayed: privilege calls, and writes without AST_TRACE_REPLAY_WRITES */
+    unsigned long mismatches; /**< Replayed operations whose status or count differs from the recording */
+    unsigned long primed;     /**< Variables created by AST_TRACE_REPLAY_PRIME */
+    uint64_t      recordedNs; /**< Recorded time spent in the replayed operations */
+    uint64_t      replayedNs; /**< Time spent in the same operations during the replay */
+    uint64_t      wallNs;     /**< Duration of the whole replay */
+};
+
+/**
+ * Create a trace file.
+ *
+ * @param path [in] File to create or truncate.
+ * @return The trace, or NULL if the file cannot be created.
+ */
+struct ast_trace *ast_trace_open (const char *path);
+
+/**
+ * Flush and close a trace. Wrappers recording into it must be freed first.
+ *
+ * @param trace [in] Trace. May be NULL.
+ * @return AST_RETURN_SUCCESS, or AST_RETURN_OPERATION_FAILED if some record could not be written.
+ */
+int ast_trace_close (struct ast_trace *trace);
+
+/**
+ * Create a backend forwarding every call to another one and recording it.
+ *
+ * Select it with ast_efivar_backend_set. Freeing it leaves inner and trace alone.
+ *
+ * @param inner [in] Backend doing the work.
+ * @param trace [in] Trace to record into. Calls from several threads are recorded in completion order.
+ * @return The backend, or NULL on allocation failure.
+ */
+struct ast_efivar_backend *ast_efivar_backend_trace_new (struct ast_efivar_backend *inner, struct ast_trace *trace);
+
+/**
+ * Create a privilege table forwarding every call to another one and recording it.
+ *
+ * Select it with ast_privilege_set_os, and free it with ast_privilege_os_trace_free after selecting another.
+ *
+ * @param inner [in] Table doing the work, e.g. ast_privilege_os_stub ().
+ * @param trace [in] Trace to record into.
+ * @return The table, or NULL on allocation failure.
+ */
+const struct ast_privilege_os *ast_privilege_os_trace_new (const struct ast_privilege_os *inner, struct ast_trace *trace);
+
+/**
+ * Free a table created by ast_privilege_os_trace_new.
+ *
+ * @param os [in] Table. May be NULL.
+ */
+void ast_privilege_os_trace_free (const struct ast_privilege_os *os);
+
+/**
+ * Replay the variable store calls of a trace through the library, against the current backend.
+ *
+ * Reads use the recorded buffer sizes and enumerations the recorded capacities, so the backend sees the
+ * same calls. Select an emulated store (see backend.h) before replaying writes.
+ *
+ * @param path  [in]  Trace file.
+ * @param flags [in]  AST_TRACE_REPLAY_* flags.
+ * @param stats [out] Outcome. May be NULL.
+ * @return AST_RETURN_SUCCESS if the trace was replayed to its end (mismatches included),
+ *         AST_RETURN_INVALID_PARAMETER if a record is malformed or sizes beyond the store's limits, or another
+ *         AST_RETURN code.
+ */
+int ast_trace_replay (const char *path, unsigned int flags, struct ast_trace_replay_stats *stats);
+
+/**
+ * Print a trace as text, one record per line.
+ *
+ * @param path [in] Trace file.
+ * @param out  [in] Stream to print to.
+ * @return AST_RETURN_SUCCESS, or another AST_RETURN code if the file cannot be read or is malformed.
+ */
+int ast_trace_dump (const char *path, FILE *out);
+
+#endif /* end of include guard: _AST_TRACE_H */
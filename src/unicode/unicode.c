@@ -0,0 +1,178 @@
+/**
+ * @file unicode.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements unicode.h.
+ */
+
+#include "unicode.h"
+
+static int    _ast_utf8_next (const uint8_t **p, uint32_t *cp);
+static size_t _ast_utf8_put (char *dst, size_t dstSiz, size_t len, uint32_t cp);
+
+
+
+
+
+size_t ast_utf16_units (const char *utf8)
+{
+    const uint8_t *p = (const uint8_t *) utf8;
+    size_t   units = 0;
+    uint32_t cp = 0;
+
+    if (utf8 == NULL) {
+        return 0;
+    }
+    while (*p != '\0') {
+        if (_ast_utf8_next (&p, &cp) != 0) {
+            return SIZE_MAX;
+        }
+        units += (cp >= 0x10000) ? 2 : 1;
+    }
+    return units;
+}
+
+
+
+
+
+size_t ast_utf16_encode (uint8_t *dst, const char *utf8)
+{
+    // The string has been validated by ast_utf16_units.
+    const uint8_t *p = (const uint8_t *) utf8;
+    uint8_t  *d = dst;
+    uint32_t cp = 0;
+
+    if (utf8 == NULL) {
+        return 0;
+    }
+    while (*p != '\0') {
+        _ast_utf8_next (&p, &cp);
+        if (cp >= 0x10000) {
+            uint32_t hi = 0xD800 + ((cp - 0x10000) >> 10);
+            uint32_t lo = 0xDC00 + ((cp - 0x10000) & 0x3FF);
+            *d++ = (uint8_t) hi;
+            *d++ = (uint8_t) (hi >> 8);
+            cp = lo;
+        }
+        *d++ = (uint8_t) cp;
+        *d++ = (uint8_t) (cp >> 8);
+    }
+    return (size_t) (d - dst);
+}
+
+
+
+
+size_t ast_utf16_decode (const uint8_t *src, size_t srcSiz, char *dst, size_t dstSiz)
+{
+    size_t len = 0;
+
+    for (size_t i = 0; i + 1 < srcSiz; i += 2) {
+        uint32_t cp = (uint32_t) src[i] | ((uint32_t) src[i + 1] << 8);
+
+        if (cp == 0) {
+            break;
+        }
+        if ((cp >= 0xD800) && (cp < 0xDC00) && (i + 3 < srcSiz)) {
+            uint32_t lo = (uint32_t) src[i + 2] | ((uint32_t) src[i + 3] << 8);
+            if ((lo >= 0xDC00) && (lo < 0xE000)) {
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                i += 2;
+            }
+        }
+        if ((cp >= 0xD800) && (cp < 0xE000)) {
+            cp = 0xFFFD;
+        }
+        len = _ast_utf8_put (dst, dstSiz, len, cp);
+    }
+
+    if (dstSiz != 0) {
+        dst[(len < dstSiz) ? len : dstSiz - 1] = '\0';
+    }
+    return len;
+}
+
+
+
+
+
+static int _ast_utf8_next (const uint8_t **p, uint32_t *cp)
+{
+    const uint8_t *s = *p;
+    uint32_t c = s[0];
+    size_t   n = 0;
+
+    if (c < 0x80) {
+        *cp = c;
+        *p  = s + 1;
+        return 0;
+    } else if ((c & 0xE0) == 0xC0) {
+        c &= 0x1F;
+        n = 1;
+    } else if ((c & 0xF0) == 0xE0) {
+        c &= 0x0F;
+        n = 2;
+    } else if ((c & 0xF8) == 0xF0) {
+        c &= 0x07;
+        n = 3;
+    } else {
+        return -1;
+    }
+
+    for (size_t i = 1; i <= n; i++) {
+        if ((s[i] & 0xC0) != 0x80) {
+            return -1;
+        }
+        c = (c << 6) | (s[i] & 0x3F);
+    }
+
+    // Reject overlong forms, surrogates and anything beyond U+10FFFF.
+    if (((n == 1) && (c < 0x80)) || ((n == 2) && (c < 0x800)) || ((n == 3) && (c < 0x10000))
+        || ((c >= 0xD800) && (c < 0xE000)) || (c > 0x10FFFF)) {
+        return -1;
+    }
+
+    *cp = c;
+    *p  = s + n + 1;
+    return 0;
+}
+
+
+
+
+static size_t _ast_utf8_put (char *dst, size_t dstSiz, size_t len, uint32_t cp)
+{
+    // Bytes that do not fit (with room for the terminator) are counted but not stored.
+    uint8_t buf[4];
+    size_t  n = 0;
+
+    if (cp < 0x80) {
+        buf[n++] = (uint8_t) cp;
+    } else if (cp < 0x800) {
+        buf[n++] = (uint8_t) (0xC0 | (cp >> 6));
+        buf[n++] = (uint8_t) (0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        buf[n++] = (uint8_t) (0xE0 | (cp >> 12));
+        buf[n++] = (uint8_t) (0x80 | ((cp >> 6) & 0x3F));
+        buf[n++] = (uint8_t) (0x80 | (cp & 0x3F));
+    } else {
+        buf[n++] = (uint8_t) (0xF0 | (cp >> 18));
+        buf[n++] = (uint8_t) (0x80 | ((cp >> 12) & 0x3F));
+        buf[n++] = (uint8_t) (0x80 | ((cp >> 6) & 0x3F));
+        buf[n++] = (uint8_t) (0x80 | (cp & 0x3F));
+    }
+
+    // Never split a character: either all of it fits or none of it is stored.
+    if (len + n < dstSiz) {
+        for (size_t i = 0; i < n; i++) {
+            dst[len + i] = (char) buf[i];
+        }
+    } else if (len < dstSiz) {
+        dst[len] = '\0';
+    }
+    return len + n;
+}
@@ -0,0 +1,50 @@
+/**
+ * @file unicode.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares conversions between UTF-8 and the UTF-16 (CHAR16) strings found in UEFI data.
+ *
+ * UEFI strings sit unaligned inside packed structures, so UTF-16 is always handled as little endian bytes.
+ */
+
+#ifndef _AST_UNICODE_H
+#define _AST_UNICODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Count the UTF-16 code units needed for a UTF-8 string.
+ *
+ * @param utf8 [in] NUL terminated UTF-8 string. NULL counts as empty.
+ * @return Number of code units, without a terminator, or SIZE_MAX if the string is not valid UTF-8.
+ */
+size_t ast_utf16_units (const char *utf8);
+
+/**
+ * Convert a UTF-8 string, already validated by ast_utf16_units, to UTF-16 LE. No terminator is written.
+ *
+ * @param dst  [out] Destination; 2 * ast_utf16_units (utf8) bytes.
+ * @param utf8 [in]  NUL terminated UTF-8 string. NULL counts as empty.
+ * @return Number of bytes written.
+ */
+size_t ast_utf16_encode (uint8_t *dst, const char *utf8);
+
+/**
+ * Convert UTF-16 LE bytes to a NUL terminated UTF-8 string.
+ *
+ * Conversion stops at a NUL code unit or after srcSiz bytes. Unpaired surrogates become U+FFFD.
+ *
+ * @param src    [in]  UTF-16 LE bytes; need not be aligned.
+ * @param srcSiz [in]  Size of src in bytes.
+ * @param dst    [out] Destination. May be NULL if dstSiz is 0.
+ * @param dstSiz [in]  Size of dst in bytes.
+ * @return Length of the full UTF-8 string, without the terminator. The output is truncated (and still
+ *         terminated) if this is not less than dstSiz.
+ */
+size_t ast_utf16_decode (const uint8_t *src, size_t srcSiz, char *dst, size_t dstSiz);
+
+#endif /* end of include guard: _AST_UNICODE_H */
@@ -0,0 +1,82 @@
+/**
+ * @file hash.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file defines FNV-1a, the hash behind the library's in-memory tables and the key and data
+ * hashes of snapshot files (see snapshot.h). Changing the 64-bit variant changes the snapshot format.
+ *
+ * A hash is started from AST_FNV1A*_INIT and can be continued over several pieces:
+ *
+ *     uint64_t h = ast_fnv1a64 (AST_FNV1A64_INIT, guid->b, sizeof (guid->b));
+ *
+ *     h = ast_fnv1a64_str (h, name);
+ */
+
+#ifndef _AST_HASH_H
+#define _AST_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define AST_FNV1A32_INIT  2166136261u
+#define AST_FNV1A32_PRIME 16777619u
+#define AST_FNV1A64_INIT  14695981039346656037ULL
+#define AST_FNV1A64_PRIME 1099511628211ULL
+
+/**
+ * Compute or continue a 64-bit FNV-1a hash.
+ *
+ * @param h    [in] AST_FNV1A64_INIT to start, or the hash of the bytes before data to continue.
+ * @param data [in] Bytes.
+ * @param size [in] Size of data.
+ * @return The hash of everything so far.
+ */
+static inline uint64_t ast_fnv1a64 (uint64_t h, const void *data, size_t size)
+{
+    const uint8_t *p = data;
+
+    for (size_t i = 0; i < size; i++) {
+        h = (h ^ p[i]) * AST_FNV1A64_PRIME;
+    }
+    return h;
+}
+
+/**
+ * Continue a 64-bit FNV-1a hash over a string, without its NUL.
+ */
+static inline uint64_t ast_fnv1a64_str (uint64_t h, const char *s)
+{
+    for (const uint8_t *p = (const uint8_t *) s; *p != '\0'; p++) {
+        h = (h ^ *p) * AST_FNV1A64_PRIME;
+    }
+    return h;
+}
+
+/**
+ * Compute or continue a 32-bit FNV-1a hash, as ast_fnv1a64.
+ */
+static inline uint32_t ast_fnv1a32 (uint32_t h, const void *data, size_t size)
+{
+    const uint8_t *p = data;
+
+    for (size_t i = 0; i < size; i++) {
+        h = (h ^ p[i]) * AST_FNV1A32_PRIME;
+    }
+    return h;
+}
+
+/**
+ * Continue a 32-bit FNV-1a hash over a string, without its NUL.
+ */
+static inline uint32_t ast_fnv1a32_str (uint32_t h, const char *s)
+{
+    for (const uint8_t *p = (const uint8_t *) s; *p != '\0'; p++) {
+        h = (h ^ *p) * AST_FNV1A32_PRIME;
+    }
+    return h;
+}
+
+#endif /* end of include guard: _AST_HASH_H */
@@ -0,0 +1,697 @@
+/**
+ * @file watch.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements watch.h.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#endif
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include "watch.h"
+#include "../firmware/backend.h"
+#include "../util/hash.h"
+
+/** Initial number of hash buckets; doubled whenever there are more variables than buckets. */
+#define AST_WATCH_BUCKETS 64
+
+/** Initial size of the read buffer; grown to the largest variable seen. */
+#define AST_WATCH_SCRATCH_SIZE 4096
+
+/** Records read from the store per ast_efivar_iter_next call while polling. */
+#define AST_WATCH_ITER_CHUNK 64
+
+/**
+ * One cached variable.
+ */
+struct _ast_watch_entry {
+    struct _ast_watch_entry *next;       /**< Next entry in the same bucket. */
+    uint64_t                hash;        /**< Key hash. */
+    ast_guid                guid;
+    uint32_t                attr;
+    size_t                  size;
+    size_t                  cap;         /**< Allocated size of data. */
+    void                    *data;
+    unsigned int            generation;  /**< Last poll that saw the variable. */
+    char                    name[];
+};
+
+struct ast_efivar_watch {
+    struct _ast_watch_entry **buckets;
+    size_t                  nBuckets;
+    size_t                  count;
+    unsigned int            generation;
+    void                    *scratch;    /**< Buffer values are read into before being compared. */
+    size_t                  scratchSiz;
+    int                     fd;          /**< inotify descriptor, or -1 when polling. */
+};
+
+/**
+ * Where events of one ast_efivar_watch_wait call go.
+ */
+struct _ast_watch_sink {
+    ast_efivar_watch_cb cb;
+    void                *arg;
+    size_t              n;
+};
+
+static uint64_t _ast_watch_hash (const ast_guid *guid, const char *name);
+static struct _ast_watch_entry **_ast_watch_find (const struct ast_efivar_watch *watch, const ast_guid *guid, const char *name, uint64_t hash);
+static struct _ast_watch_entry *_ast_watch_insert (struct ast_efivar_watch *watch, const ast_guid *guid, const char *name, uint64_t hash);
+static int  _ast_watch_store (struct _ast_watch_entry *e, const void *data, size_t size, uint32_t attr);
+static void _ast_watch_emit (struct _ast_watch_sink *sink, enum AST_EFIVAR_CHANGE type, const struct _ast_watch_entry *e);
+static int  _ast_watch_fetch (struct ast_efivar_watch *watch, const ast_guid *guid, const char *name, size_t *size, uint32_t *attr);
+static int  _ast_watch_update (struct ast_efivar_watch *watch, const ast_guid *guid, const char *name, const void *data, size_t size, uint32_t attr, struct _ast_watch_sink *sink);
+static int  _ast_watch_refresh (struct ast_efivar_watch *watch, const ast_guid *guid, const char *name, struct _ast_watch_sink *sink);
+static int  _ast_watch_poll (struct ast_efivar_watch *watch, struct _ast_watch_sink *sink);
+static long long _ast_watch_now_ms (void);
+static void _ast_watch_sleep_ms (int ms);
+#ifdef __linux__
+static int  _ast_watch_inotify_open (const char *dir);
+static int  _ast_watch_inotify_read (struct ast_efivar_watch *watch, int timeoutMs, struct _ast_watch_sink *sink);
+#endif
+
+
+
+
+
+int ast_efivar_watch_open (struct ast_efivar_watch **watch, unsigned int flags)
+{
+    struct ast_efivar_watch *w = NULL;
+    int ret = AST_RETURN_SUCCESS;
+
+    if (watch == NULL) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    w = calloc (1, sizeof (*w));
+    if (w == NULL) {
+        return AST_RETURN_OPERATION_FAILED;
+    }
+    w->fd         = -1;
+    w->nBuckets   = AST_WATCH_BUCKETS;
+    w->buckets    = calloc (w->nBuckets, sizeof (*(w->buckets)));
+    w->scratchSiz = AST_WATCH_SCRATCH_SIZE;
+    w->scratch    = malloc (w->scratchSiz);
+    if ((w->buckets == NULL) || (w->scratch == NULL)) {
+        ast_efivar_watch_close (w);
+        return AST_RETURN_OPERATION_FAILED;
+    }
+
+#ifdef __linux__
+    // Watch before reading, so that nothing written in between is missed: it is just read twice.
+    if (!(flags & AST_EFIVAR_WATCH_POLL)) {
+        const char *dir = ast_efivar_backend_efivarfs_dir (ast_efivar_backend_get ());
+
+        if (dir != NULL) {
+            w->fd = _ast_watch_inotify_open (dir);
+        }
+    }
+#else
+    (void) flags;
+#endif
+
+    // The first poll fills the cache; nobody listens yet.
+    ret = _ast_watch_poll (w, NULL);
+    if (ret != AST_RETURN_SUCCESS) {
+        ast_efivar_watch_close (w);
+        return ret;
+    }
+
+    *watch = w;
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+void ast_efivar_watch_close (struct ast_efivar_watch *watch)
+{
+    if (watch == NULL) {
+        return;
+    }
+
+#ifndef _WIN32
+    if (watch->fd >= 0) {
+        close (watch->fd);
+    }
+#endif
+    if (watch->buckets != NULL) {
+        for (size_t i = 0; i < watch->nBuckets; i++) {
+            struct _ast_watch_entry *e = watch->buckets[i];
+
+            while (e != NULL) {
+                struct _ast_watch_entry *next = e->next;
+
+                free (e->data);
+                free (e);
+                e = next;
+            }
+        }
+        free (watch->buckets);
+    }
+    free (watch->scratch);
+    free (watch);
+}
+
+
+
+
+
+int ast_efivar_watch_wait (struct ast_efivar_watch *watch, int timeoutMs, ast_efivar_watch_cb cb, void *arg, size_t *nEvents)
+{
+    struct _ast_watch_sink sink = { cb, arg, 0 };
+    long long deadline = 0;
+    int ret = AST_RETURN_SUCCESS;
+
+    if (watch == NULL) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+    if (timeoutMs > 0) {
+        deadline = _ast_watch_now_ms () + timeoutMs;
+    }
+
+    // Rewriting a variable with the value it had is an inotify event but no change: keep waiting.
+    for (;;) {
+        int remaining = timeoutMs;
+
+        if (timeoutMs > 0) {
+            long long left = deadline - _ast_watch_now_ms ();
+
+            remaining = (left > 0) ? (int) left : 0;
+        }
+
+#ifdef __linux__
+        if (watch->fd >= 0) {
+            ret = _ast_watch_inotify_read (watch, remaining, &sink);
+        } else
+#endif
+        {
+            ret = _ast_watch_poll (watch, &sink);
+            if ((ret == AST_RETURN_SUCCESS) && (sink.n == 0) && (remaining != 0)) {
+                int nap = AST_EFIVAR_WATCH_POLL_INTERVAL_MS;
+
+                if ((remaining > 0) && (remaining < nap)) {
+                    nap = remaining;
+                }
+                _ast_watch_sleep_ms (nap);
+            }
+        }
+
+        if ((ret != AST_RETURN_SUCCESS) || (sink.n > 0) || (remaining == 0)) {
+            break;
+        }
+    }
+
+    if (nEvents != NULL) {
+        *nEvents = sink.n;
+    }
+    return ret;
+}
+
+
+
+
+
+int ast_efivar_watch_get (const struct ast_efivar_watch *watch, const ast_guid *guid, const char *name, const void **data, size_t *size, uint32_t *attr)
+{
+    struct _ast_watch_entry **link = NULL;
+
+    if ((watch == NULL) || (guid == NULL) || (name == NULL) || (data == NULL)) {
+        return AST_RETURN_INVALID_PARAMETER;
+    }
+
+    link = _ast_watch_find (watch, guid, name, _ast_watch_hash (guid, name));
+    if (*link == NULL) {
+        return AST_RETURN_NOT_FOUND;
+    }
+
+    *data = (*link)->data;
+    if (size != NULL) {
+        *size = (*link)->size;
+    }
+    if (attr != NULL) {
+        *attr = (*link)->attr;
+    }
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+size_t ast_efivar_watch_count (const struct ast_efivar_watch *watch)
+{
+    return (watch != NULL) ? watch->count : 0;
+}
+
+
+
+
+
+int ast_efivar_watch_fd (const struct ast_efivar_watch *watch)
+{
+    return (watch != NULL) ? watch->fd : -1;
+}
+
+
+
+
+
+static uint64_t _ast_watch_hash (const ast_guid *guid, const char *name)
+{
+    // FNV-1a over the GUID bytes, then the name.
+    return ast_fnv1a64_str (ast_fnv1a64 (AST_FNV1A64_INIT, guid->b, sizeof (guid->b)), name);
+}
+
+
+
+
+
+/**
+ * Find a variable's link in its bucket chain: the pointer to its entry, or the NULL at the end of the
+ * chain if it is not cached (where a new entry would go).
+ */
+static struct _ast_watch_entry **_ast_watch_find (const struct ast_efivar_watch *watch, const ast_guid *guid, const char *name, uint64_t hash)
+{
+    struct _ast_watch_entry **link = &(watch->buckets[hash & (watch->nBuckets - 1)]);
+
+    while (*link != NULL) {
+        struct _ast_watch_entry *e = *link;
+
+        if ((e->hash == hash) && ast_guid_equal (&(e->guid), guid) && (strcmp (e->name, name) == 0)) {
+            break;
+        }
+        link = &(e->next);
+    }
+    return link;
+}
+
+
+
+
+
+static struct _ast_watch_entry *_ast_watch_insert (struct ast_efivar_watch *watch, const ast_guid *guid, const char *name, uint64_t hash)
+{
+    size_t nameSiz = strlen (name) + 1;
+    struct _ast_watch_entry *e = NULL;
+
+    if (watch->count >= watch->nBuckets) {
+        size_t nBuckets = watch->nBuckets * 2;
+        struct _ast_watch_entry **buckets = calloc (nBuckets, sizeof (*buckets));
+
+        // A failed resize only makes the chains longer.
+        if (buckets != NULL) {
+            for (size_t i = 0; i < watch->nBuckets; i++) {
+                struct _ast_watch_entry *cur = watch->buckets[i];
+
+                while (cur != NULL) {
+                    struct _ast_watch_entry *next = cur->next;
+
+                    cur->next = buckets[cur->hash & (nBuckets - 1)];
+                    buckets[cur->hash & (nBuckets - 1)] = cur;
+                    cur = next;
+                }
+            }
+            free (watch->buckets);
+            watch->buckets  = buckets;
+            watch->nBuckets = nBuckets;
+        }
+    }
+
+    e = calloc (1, sizeof (*e) + nameSiz);
+    if (e == NULL) {
+        return NULL;
+    }
+    e->hash = hash;
+    e->guid = *guid;
+    memcpy (e->name, name, nameSiz);
+    e->next = watch->buckets[hash & (watch->nBuckets - 1)];
+    watch->buckets[hash & (watch->nBuckets - 1)] = e;
+    watch->count++;
+    return e;
+}
+
+
+
+
+
+static int _ast_watch_store (struct _ast_watch_entry *e, const void *data, size_t size, uint32_t attr)
+{
+    if (size > e->cap) {
+        void *grown = realloc (e->data, size);
+
+        if (grown == NULL) {
+            return AST_RETURN_OPERATION_FAILED;
+        }
+        e->data = grown;
+        e->cap  = size;
+    }
+    if (size > 0) {
+        memcpy (e->data, data, size);
+    }
+    e->size = size;
+    e->attr = attr;
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static void _ast_watch_emit (struct _ast_watch_sink *sink, enum AST_EFIVAR_CHANGE type, const struct _ast_watch_entry *e)
+{
+    struct ast_efivar_event event;
+
+    if (sink == NULL) {
+        return;
+    }
+
+    event.type = type;
+    event.guid = e->guid;
+    event.name = e->name;
+    if (type == AST_EFIVAR_CHANGE_REMOVED) {
+        event.attr = 0;
+        event.data = NULL;
+        event.size = 0;
+    } else {
+        event.attr = e->attr;
+        event.data = e->data;
+        event.size = e->size;
+    }
+
+    sink->n++;
+    if (sink->cb != NULL) {
+        sink->cb (sink->arg, &event);
+    }
+}
+
+
+
+
+
+/**
+ * Read a variable into the scratch buffer, growing it as needed.
+ */
+static int _ast_watch_fetch (struct ast_efivar_watch *watch, const ast_guid *guid, const char *name, size_t *size, uint32_t *attr)
+{
+    int ret = ast_read_efivar_guid (watch->scratch, watch->scratchSiz, guid, name, size, attr);
+
+    if ((ret == AST_RETURN_BUFFER_TOO_SMALL) && (*size > watch->scratchSiz)) {
+        void *grown = realloc (watch->scratch, *size);
+
+        if (grown == NULL) {
+            return AST_RETURN_OPERATION_FAILED;
+        }
+        watch->scratch    = grown;
+        watch->scratchSiz = *size;
+        ret = ast_read_efivar_guid (watch->scratch, watch->scratchSiz, guid, name, size, attr);
+    }
+    return ret;
+}
+
+
+
+
+
+/**
+ * Bring one cached variable up to date with a value known to be current, and report what changed.
+ */
+static int _ast_watch_update (struct ast_efivar_watch *watch, const ast_guid *guid, const char *name, const void *data, size_t size, uint32_t attr, struct _ast_watch_sink *sink)
+{
+    uint64_t hash = _ast_watch_hash (guid, name);
+    struct _ast_watch_entry *e = *_ast_watch_find (watch, guid, name, hash);
+    enum AST_EFIVAR_CHANGE type = AST_EFIVAR_CHANGE_MODIFIED;
+    int ret = AST_RETURN_SUCCESS;
+
+    if (e == NULL) {
+        e = _ast_watch_insert (watch, guid, name, hash);
+        if (e == NULL) {
+            return AST_RETURN_OPERATION_FAILED;
+        }
+        type = AST_EFIVAR_CHANGE_ADDED;
+    } else if ((e->attr == attr) && (e->size == size) && ((size == 0) || (memcmp (e->data, data, size) == 0))) {
+        e->generation = watch->generation;
+        return AST_RETURN_SUCCESS;
+    }
+
+    ret = _ast_watch_store (e, data, size, attr);
+    if (ret == AST_RETURN_SUCCESS) {
+        e->generation = watch->generation;
+        _ast_watch_emit (sink, type, e);
+    }
+    return ret;
+}
+
+
+
+
+
+/**
+ * Re-read one variable from the store and update the cache.
+ */
+static int _ast_watch_refresh (struct ast_efivar_watch *watch, const ast_guid *guid, const char *name, struct _ast_watch_sink *sink)
+{
+    size_t size = 0;
+    uint32_t attr = 0;
+    int ret = _ast_watch_fetch (watch, guid, name, &size, &attr);
+
+    if (ret == AST_RETURN_NOT_FOUND) {
+        struct _ast_watch_entry **link = _ast_watch_find (watch, guid, name, _ast_watch_hash (guid, name));
+        struct _ast_watch_entry *e = *link;
+
+        if (e != NULL) {
+            _ast_watch_emit (sink, AST_EFIVAR_CHANGE_REMOVED, e);
+            *link = e->next;
+            watch->count--;
+            free (e->data);
+            free (e);
+        }
+        return AST_RETURN_SUCCESS;
+    }
+    if (ret != AST_RETURN_SUCCESS) {
+        return ret;
+    }
+    return _ast_watch_update (watch, guid, name, watch->scratch, size, attr, sink);
+}
+
+
+
+
+
+/**
+ * Enumerate the store, re-read what looks changed, and drop what is gone.
+ */
+static int _ast_watch_poll (struct ast_efivar_watch *watch, struct _ast_watch_sink *sink)
+{
+    struct ast_efivar_iter *iter = NULL;
+    struct ast_efivar_info infos[AST_WATCH_ITER_CHUNK];
+    size_t n = 0;
+    int ret = ast_efivar_iter_open (&iter, AST_EFIVAR_ITER_ATTRIBUTES);
+
+    if (ret != AST_RETURN_SUCCESS) {
+        return ret;
+    }
+
+    watch->generation++;
+    while (((ret = ast_efivar_iter_next (iter, infos, AST_WATCH_ITER_CHUNK, &n)) == AST_RETURN_SUCCESS) && (n > 0)) {
+        for (size_t i = 0; (i < n) && (ret == AST_RETURN_SUCCESS); i++) {
+            const struct ast_efivar_info *info = &(infos[i]);
+            struct _ast_watch_entry *e = *_ast_watch_find (watch, &(info->guid), info->name, _ast_watch_hash (&(info->guid), info->name));
+
+            if (info->data != NULL) {
+                ret = _ast_watch_update (watch, &(info->guid), info->name, info->data, info->size, info->attr, sink);
+            } else if ((e != NULL) && (e->attr == info->attr) && (e->size == info->size)) {
+                e->generation = watch->generation;
+            } else {
+                // Also drops a variable deleted since it was listed.
+                ret = _ast_watch_refresh (watch, &(info->guid), info->name, sink);
+            }
+        }
+        if (ret != AST_RETURN_SUCCESS) {
+            break;
+        }
+    }
+    ast_efivar_iter_close (iter);
+
+    // Only a complete enumeration tells what is gone.
+    if (ret != AST_RETURN_SUCCESS) {
+        return ret;
+    }
+    for (size_t i = 0; i < watch->nBuckets; i++) {
+        struct _ast_watch_entry **link = &(watch->buckets[i]);
+
+        while (*link != NULL) {
+            struct _ast_watch_entry *e = *link;
+
+            if (e->generation != watch->generation) {
+                _ast_watch_emit (sink, AST_EFIVAR_CHANGE_REMOVED, e);
+                *link = e->next;
+                watch->count--;
+                free (e->data);
+                free (e);
+            } else {
+                link = &(e->next);
+            }
+        }
+    }
+    return AST_RETURN_SUCCESS;
+}
+
+
+
+
+
+static long long _ast_watch_now_ms (void)
+{
+#ifdef _WIN32
+    return (long long) GetTickCount64 ();
+#else
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (long long) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+#endif
+}
+
+
+
+
+
+static void _ast_watch_sleep_ms (int ms)
+{
+#ifdef _WIN32
+    Sleep ((DWORD) ms);
+#else
+    struct timespec ts;
+
+    ts.tv_sec  = ms / 1000;
+    ts.tv_nsec = (long) (ms % 1000) * 1000000;
+    while ((nanosleep (&ts, &ts) != 0) && (errno == EINTR)) {
+        // Sleep for what is left.
+    }
+#endif
+}
+
+
+
+
+
+#ifdef __linux__
+static int _ast_watch_inotify_open (const char *dir)
+{
+    int fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+
+    if (fd < 0) {
+        return -1;
+    }
+    if (inotify_add_watch (fd, dir, IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB) < 0) {
+        fprintf (stderr, " ** Cannot watch %s; polling instead.\n", dir);
+        close (fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+
+
+
+/**
+ * Wait for inotify events and refresh the variables they name. A file name that is not a variable
+ * ("Name-GUID") is ignored; a queue overflow or a lost watch falls back to a full poll.
+ *
+ * Each refresh is a firmware read, and one write usually raises several events (IN_CREATE,
+ * IN_CLOSE_WRITE, IN_ATTRIB when the file is made mutable first), so a name is refreshed once per
+ * read(2) batch. The mask leaves IN_MODIFY out: IN_CLOSE_WRITE follows every write anyway.
+ */
+static int _ast_watch_inotify_read (struct ast_efivar_watch *watch, int timeoutMs, struct _ast_watch_sink *sink)
+{
+    char buf[4096] __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+    struct pollfd pfd = { watch->fd, POLLIN, 0 };
+    int resync = 0;
+    int ret = AST_RETURN_SUCCESS;
+    int r = poll (&pfd, 1, timeoutMs);
+
+    if (r < 0) {
+        return (errno == EINTR) ? AST_RETURN_SUCCESS : AST_RETURN_OPERATION_FAILED;
+    }
+    if (r == 0) {
+        return AST_RETURN_SUCCESS;
+    }
+
+    for (;;) {
+        const char *seen[sizeof (buf) / (sizeof (struct inotify_event) + 1)];
+        size_t nSeen = 0;
+        ssize_t len = read (watch->fd, buf, sizeof (buf));
+
+        if (len <= 0) {
+            if ((len < 0) && (errno != EAGAIN) && (errno != EINTR)) {
+                ret = AST_RETURN_OPERATION_FAILED;
+            }
+            break;
+        }
+
+        for (char *p = buf; p < buf + len; ) {
+            const struct inotify_event *ev = (const struct inotify_event *) p;
+
+            p += sizeof (*ev) + ev->len;
+            if (ev->mask & (IN_Q_OVERFLOW | IN_IGNORED)) {
+                resync = 1;
+                if (ev->mask & IN_IGNORED) {
+                    // The directory went away (unmounted): nothing more will come from inotify.
+                    close (watch->fd);
+                    watch->fd = -1;
+                }
+            } else if (!resync && (ev->len > 0)) {
+                size_t nameLen = strlen (ev->name);
+                size_t i = 0;
+                ast_guid guid;
+
+                for (i = 0; (i < nSeen) && (strcmp (seen[i], ev->name) != 0); i++) {
+                    // Find an earlier event of this batch for the same file.
+                }
+                if (i < nSeen) {
+                    continue;
+                }
+                seen[nSeen++] = ev->name;
+                if ((nameLen > AST_GUID_STRLEN + 1) && (nameLen - AST_GUID_STRLEN - 1 < AST_EFIVAR_NAME_MAX) &&
+                    (ev->name[nameLen - AST_GUID_STRLEN - 1] == '-') &&
+                    (ast_guid_parse_n (ev->name + nameLen - AST_GUID_STRLEN, &guid) == AST_RETURN_SUCCESS)) {
+                    char name[AST_EFIVAR_NAME_MAX];
+
+                    memcpy (name, ev->name, nameLen - AST_GUID_STRLEN - 1);
+                    name[nameLen - AST_GUID_STRLEN - 1] = '\0';
+                    ret = _ast_watch_refresh (watch, &guid, name, sink);
+                    if (ret != AST_RETURN_SUCCESS) {
+                        return ret;
+                    }
+                }
+            }
+        }
+        if (watch->fd < 0) {
+            break;
+        }
+    }
+
+    if (resync && (ret == AST_RETURN_SUCCESS)) {
+        ret = _ast_watch_poll (watch, sink);
+    }
+    return ret;
+}
+#endif
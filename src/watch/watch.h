@@ -0,0 +1,126 @@
+/**
+ * @file watch.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares variable store watchers: an in-process copy of every variable, kept fresh by
+ * re-reading only the variables that changed.
+ *
+ * On Linux with the efivarfs backend, changes are learned from inotify: waiting for them costs nothing,
+ * and each event names the one variable to re-read. efivarfs only reports changes made through efivarfs
+ * itself (by any process), not by firmware behind the kernel's back. Everywhere else, and when inotify is
+ * not available, a watcher polls: it enumerates the store with attributes and re-reads the variables whose
+ * size or attributes differ from its copy, as well as new ones. A backend that returns values while
+ * enumerating (the emulator, snapshots) is compared by value too; otherwise a change that keeps both the
+ * size and the attributes is only seen through inotify.
+ *
+ * Values are read through the current backend (see firmware.h). A watcher is not thread-safe: it is meant
+ * to be owned by one agent thread.
+ */
+
+#ifndef _AST_WATCH_H
+#define _AST_WATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../firmware/firmware.h"
+
+struct ast_efivar_watch;
+
+/** Flag for ast_efivar_watch_open: poll even if inotify is available. */
+#define AST_EFIVAR_WATCH_POLL 0x00000001
+
+/** How often a polling watcher enumerates the store while ast_efivar_watch_wait waits. */
+#define AST_EFIVAR_WATCH_POLL_INTERVAL_MS 1000
+
+/**
+ * Kinds of change.
+ */
+enum AST_EFIVAR_CHANGE {
+    AST_EFIVAR_CHANGE_ADDED = 0, /**< A new variable. */
+    AST_EFIVAR_CHANGE_REMOVED,   /**< A variable was deleted. */
+    AST_EFIVAR_CHANGE_MODIFIED   /**< A variable has a new value or new attributes. */
+};
+
+/**
+ * One change, after the cached copy was refreshed.
+ */
+struct ast_efivar_event {
+    enum AST_EFIVAR_CHANGE type; /**< Kind of change. */
+    ast_guid   guid;             /**< GUID namespace. */
+    const char *name;            /**< Variable name. */
+    uint32_t   attr;             /**< New attributes; 0 if removed. */
+    const void *data;            /**< New value, cached; NULL if removed. */
+    size_t     size;             /**< Size of the new value; 0 if removed. */
+};
+
+/**
+ * Called for each change. The event and what it points to are only valid during the call.
+ *
+ * @param arg   [in] Argument given to ast_efivar_watch_wait.
+ * @param event [in] Change.
+ */
+typedef void (*ast_efivar_watch_cb) (void *arg, const struct ast_efivar_event *event);
+
+/**
+ * Read every variable of the current backend and start watching for changes.
+ *
+ * @param watch [out] Watcher, to close with ast_efivar_watch_close.
+ * @param flags [in]  AST_EFIVAR_WATCH_* flags.
+ * @return AST_RETURN_SUCCESS, AST_RETURN_NOT_SUPPORTED if the backend can neither notify nor enumerate,
+ *         or another AST_RETURN code.
+ */
+int ast_efivar_watch_open (struct ast_efivar_watch **watch, unsigned int flags);
+
+/**
+ * Stop watching and free the cache.
+ *
+ * @param watch [in] Watcher. May be NULL.
+ */
+void ast_efivar_watch_close (struct ast_efivar_watch *watch);
+
+/**
+ * Wait for changes, refresh the cache and report them.
+ *
+ * Returns as soon as some changes were handled, or after timeoutMs without any. With a timeout of 0 the
+ * watcher only checks: it reads pending inotify events, or polls the store once.
+ *
+ * @param watch     [in]  Watcher.
+ * @param timeoutMs [in]  Longest wait in milliseconds, 0 not to wait, or -1 to wait for a change.
+ * @param cb        [in]  Called for each change. May be NULL.
+ * @param arg       [in]  Passed to cb.
+ * @param nEvents   [out] Number of changes. May be NULL.
+ * @return AST_RETURN_SUCCESS, or another AST_RETURN code.
+ */
+int ast_efivar_watch_wait (struct ast_efivar_watch *watch, int timeoutMs, ast_efivar_watch_cb cb, void *arg, size_t *nEvents);
+
+/**
+ * Get a variable from the cache, without reading the store.
+ *
+ * @param watch [in]  Watcher.
+ * @param guid  [in]  GUID namespace.
+ * @param name  [in]  Variable name.
+ * @param data  [out] Cached value, valid until the next ast_efivar_watch_wait.
+ * @param size  [out] Size of the value. May be NULL.
+ * @param attr  [out] Attributes. May be NULL.
+ * @return AST_RETURN_SUCCESS, or AST_RETURN_NOT_FOUND.
+ */
+int ast_efivar_watch_get (const struct ast_efivar_watch *watch, const ast_guid *guid, const char *name, const void **data, size_t *size, uint32_t *attr);
+
+/**
+ * Number of variables in the cache.
+ */
+size_t ast_efivar_watch_count (const struct ast_efivar_watch *watch);
+
+/**
+ * File descriptor becoming readable when changes are pending, to wait in the caller's own event loop
+ * (then call ast_efivar_watch_wait with a timeout of 0).
+ *
+ * @param watch [in] Watcher.
+ * @return The inotify descriptor, or -1 if the watcher polls.
+ */
+int ast_efivar_watch_fd (const struct ast_efivar_watch *watch);
+
+#endif /* end of include guard: _AST_WATCH_H */
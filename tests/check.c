@@ -0,0 +1,39 @@
+/**
+ * @file check.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file implements the checks declared in check.h.
+ */
+
+#include <stdio.h>
+#include "check.h"
+
+static const char *_check_suite = "";
+static unsigned long _check_count = 0;
+static unsigned long _check_failed = 0;
+
+void check_init (const char *suite)
+{
+    _check_suite  = suite;
+    _check_count  = 0;
+    _check_failed = 0;
+}
+
+int check_report (int ok, const char *expr, const char *file, int line)
+{
+    _check_count++;
+    if (!ok) {
+        _check_failed++;
+        fprintf (stderr, "%s: %s:%d: check failed: %s\n", _check_suite, file, line, expr);
+    }
+    return ok;
+}
+
+int check_finish (void)
+{
+    printf ("%s: %lu checks, %lu failed\n", _check_suite, _check_count, _check_failed);
+    return (_check_failed == 0) ? 0 : 1;
+}
@@ -0,0 +1,51 @@
+/**
+ * @file check.h
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This header file declares the checks shared by the tests.
+ *
+ * A test is a program checking one module, on the build host and without firmware: variables go to an
+ * emulated store in memory (see backend.h), disks are images the test writes itself. A failed check
+ * prints its file, line and expression and the test goes on; the program then exits nonzero.
+ */
+
+#ifndef _AST_TEST_CHECK_H
+#define _AST_TEST_CHECK_H
+
+/**
+ * Check a condition.
+ *
+ * @param cond Expression that must be true.
+ * @return 1 if it holds, 0 if it does not.
+ */
+#define CHECK(cond) check_report ((cond) != 0, #cond, __FILE__, __LINE__)
+
+/**
+ * Start a test. Call once, before any check.
+ *
+ * @param suite [in] Test name, e.g. "efivar".
+ */
+void check_init (const char *suite);
+
+/**
+ * Record the outcome of one check (see CHECK).
+ *
+ * @param ok   [in] Nonzero if the check passed.
+ * @param expr [in] Checked expression.
+ * @param file [in] Source file of the check.
+ * @param line [in] Line of the check.
+ * @return ok.
+ */
+int check_report (int ok, const char *expr, const char *file, int line);
+
+/**
+ * End a test and print its summary.
+ *
+ * @return 0 if every check passed, 1 otherwise: the exit status of the test.
+ */
+int check_finish (void);
+
+#endif /* end of include guard: _AST_TEST_CHECK_H */
@@ -0,0 +1,222 @@
+/**
+ * @file test_devpath.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file checks the device path builder against the bytes of a typical boot option path, decodes and
+ * renders them back, and feeds the iterator truncated and malformed paths.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/devpath/devpath.h"
+#include "../src/firmware/firmware.h"
+#include "check.h"
+
+/** PciRoot(0x0)/Pci(0x1F,0x2)/Sata(0x0,0xFFFF,0x0)/HD(1,GPT,...,0x800,0x100000)/\EFI\BOOT\BOOTX64.EFI */
+static const uint8_t _test_path[] = {
+    0x02, 0x01, 0x0c, 0x00, 0xd0, 0x41, 0x03, 0x0a, 0x00, 0x00, 0x00, 0x00,
+    0x01, 0x01, 0x06, 0x00, 0x02, 0x1f,
+    0x03, 0x12, 0x0a, 0x00, 0x00, 0x00, 0xff, 0xff, 0x00, 0x00,
+    0x04, 0x01, 0x2a, 0x00, 0x01, 0x00, 0x00, 0x00,
+    0x00, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x28, 0x73, 0x2a, 0xc1, 0x1f, 0xf8, 0xd2, 0x11, 0xba, 0x4b, 0x00, 0xa0, 0xc9, 0x3e, 0xc9, 0x3b,
+    0x02, 0x02,
+    0x04, 0x04, 0x30, 0x00,
+    '\\', 0, 'E', 0, 'F', 0, 'I', 0, '\\', 0, 'B', 0, 'O', 0, 'O', 0, 'T', 0, '\\', 0, 'B', 0,
+    'O', 0, 'O', 0, 'T', 0, 'X', 0, '6', 0, '4', 0, '.', 0, 'E', 0, 'F', 0, 'I', 0, 0, 0,
+    0x7f, 0xff, 0x04, 0x00
+};
+
+static const char *_test_text =
+    "PciRoot(0x0)/Pci(0x1F,0x2)/Sata(0x0,0xFFFF,0x0)/HD(1,GPT,c12a7328-f81f-11d2-ba4b-00a0c93ec93b,0x800,0x100000)/"
+    "\\EFI\\BOOT\\BOOTX64.EFI";
+
+static size_t _test_build (void *buf, size_t bufSiz, int *ret)
+{
+    static const uint8_t signature[16] = {0x28, 0x73, 0x2a, 0xc1, 0x1f, 0xf8, 0xd2, 0x11,
+                                          0xba, 0x4b, 0x00, 0xa0, 0xc9, 0x3e, 0xc9, 0x3b};
+    struct ast_devpath_builder b;
+    struct ast_devpath_acpi acpi = { 0x0a0341d0, 0 };
+    struct ast_devpath_pci  pci  = { 0x02, 0x1f };
+    struct ast_devpath_sata sata = { 0, 0xffff, 0 };
+    struct ast_devpath_hd   hd;
+    size_t n = 0;
+
+    memset (&hd, 0, sizeof (hd));
+    hd.partitionNumber = 1;
+    hd.partitionStart  = 0x800;
+    hd.partitionSize   = 0x100000;
+    memcpy (hd.signature, signature, 16);
+    hd.partitionFormat = AST_DEVPATH_HD_FORMAT_GPT;
+    hd.signatureType   = AST_DEVPATH_HD_SIGNATURE_GUID;
+
+    ast_devpath_builder_init (&b, buf, bufSiz);
+    ast_devpath_add_acpi (&b, &acpi);
+    ast_devpath_add_pci (&b, &pci);
+    ast_devpath_add_sata (&b, &sata);
+    ast_devpath_add_hd (&b, &hd);
+    ast_devpath_add_file (&b, "\\EFI\\BOOT\\BOOTX64.EFI");
+    ast_devpath_add_end (&b, AST_DEVPATH_END_ENTIRE);
+    *ret = ast_devpath_builder_finish (&b, &n);
+    return n;
+}
+
+static void _test_builder (void)
+{
+    uint8_t buf[256];
+    int     ret = 0;
+
+    CHECK (_test_build (buf, sizeof (buf), &ret) == sizeof (_test_path));
+    CHECK (ret == AST_RETURN_SUCCESS);
+    CHECK (memcmp (buf, _test_path, sizeof (_test_path)) == 0);
+
+    // Too small a buffer, or none, still gives the size.
+    CHECK (_test_build (buf, 20, &ret) == sizeof (_test_path));
+    CHECK (ret == AST_RETURN_BUFFER_TOO_SMALL);
+    CHECK (_test_build (NULL, 0, &ret) == sizeof (_test_path));
+    CHECK (ret == AST_RETURN_BUFFER_TOO_SMALL);
+}
+
+static void _test_decode (void)
+{
+    struct ast_devpath_iter iter;
+    struct ast_devpath_node node;
+    struct ast_devpath_acpi acpi;
+    struct ast_devpath_pci  pci;
+    struct ast_devpath_sata sata;
+    struct ast_devpath_hd   hd;
+    struct ast_devpath_file file;
+    int n = 0;
+
+    CHECK (ast_devpath_size (_test_path, sizeof (_test_path)) == sizeof (_test_path));
+
+    ast_devpath_iter_init (&iter, _test_path, sizeof (_test_path));
+    while (ast_devpath_next (&iter, &node) == 1) {
+        switch (n++) {
+            case 0:
+                CHECK (ast_devpath_decode_acpi (&node, &acpi) == AST_RETURN_SUCCESS);
+                CHECK ((acpi.hid == 0x0a0341d0) && (acpi.uid == 0));
+                CHECK (ast_devpath_decode_pci (&node, &pci) == AST_RETURN_INVALID_PARAMETER);
+                break;
+            case 1:
+                CHECK (ast_devpath_decode_pci (&node, &pci) == AST_RETURN_SUCCESS);
+                CHECK ((pci.device == 0x1f) && (pci.function == 0x02));
+                break;
+            case 2:
+                CHECK (ast_devpath_decode_sata (&node, &sata) == AST_RETURN_SUCCESS);
+                CHECK ((sata.hbaPort == 0) && (sata.pmPort == 0xffff) && (sata.lun == 0));
+                break;
+            case 3:
+                CHECK (ast_devpath_decode_hd (&node, &hd) == AST_RETURN_SUCCESS);
+                CHECK ((hd.partitionNumber == 1) && (hd.partitionStart == 0x800) && (hd.partitionSize == 0x100000));
+                CHECK ((hd.partitionFormat == AST_DEVPATH_HD_FORMAT_GPT) && (hd.signatureType == AST_DEVPATH_HD_SIGNATURE_GUID));
+                CHECK (memcmp (hd.signature, _test_path + 52, 16) == 0);
+                break;
+            case 4:
+                CHECK (ast_devpath_decode_file (&node, &file) == AST_RETURN_SUCCESS);
+                CHECK ((file.pathSiz == 44) && (file.path == _test_path + 74));
+                break;
+            case 5:
+                CHECK ((node.type == AST_DEVPATH_TYPE_END) && (node.subType == AST_DEVPATH_END_ENTIRE));
+                break;
+        }
+    }
+    CHECK (n == 6);
+    CHECK (ast_devpath_next (&iter, &node) == 0);
+}
+
+static void _test_text_render (void)
+{
+    char   text[256];
+    char   small[16];
+    size_t len = strlen (_test_text);
+
+    CHECK (ast_devpath_to_text (_test_path, sizeof (_test_path), text, sizeof (text)) == len);
+    CHECK (strcmp (text, _test_text) == 0);
+
+    // Truncated text is still terminated, and the full length is reported.
+    memset (small, 'x', sizeof (small));
+    CHECK (ast_devpath_to_text (_test_path, sizeof (_test_path), small, sizeof (small)) == len);
+    CHECK ((small[sizeof (small) - 1] == '\0') && (strncmp (small, _test_text, sizeof (small) - 1) == 0));
+}
+
+/** Every proper prefix of the path, each in a buffer of its exact size so that overreads are caught. */
+static void _test_truncated (void)
+{
+    for (size_t len = 0; len < sizeof (_test_path); len++) {
+        uint8_t *p = malloc ((len == 0) ? 1 : len);
+        struct ast_devpath_iter iter;
+        struct ast_devpath_node node;
+        char   text[256];
+        int    k = 0;
+        int    ok = 1;
+
+        if (p == NULL) {
+            CHECK (p != NULL);
+            return;
+        }
+        memcpy (p, _test_path, len);
+        ok &= (ast_devpath_size (p, len) == 0);
+        ast_devpath_iter_init (&iter, p, len);
+        while ((k = ast_devpath_next (&iter, &node)) == 1) {
+            ok &= (node.data + node.dataSiz <= p + len) && (node.type != AST_DEVPATH_TYPE_END);
+        }
+        ok &= (k == 0) || (k == -1);
+        ast_devpath_to_text (p, len, text, sizeof (text));
+        ok &= (strncmp (text, _test_text, strlen (text)) == 0) || (strstr (text, "<malformed>") != NULL);
+        if (!CHECK (ok)) {
+            fprintf (stderr, "devpath: prefix of %zu bytes\n", len);
+        }
+        free (p);
+    }
+}
+
+static void _test_malformed (void)
+{
+    uint8_t path[sizeof (_test_path)];
+    struct ast_devpath_iter iter;
+    struct ast_devpath_node node;
+    struct ast_devpath_pci  pci;
+    char   text[256];
+
+    // A node shorter than its header ends the iteration in an error.
+    memcpy (path, _test_path, sizeof (path));
+    path[14] = 2;
+    ast_devpath_iter_init (&iter, path, sizeof (path));
+    CHECK (ast_devpath_next (&iter, &node) == 1);
+    CHECK (ast_devpath_next (&iter, &node) == -1);
+    CHECK (ast_devpath_next (&iter, &node) == 0);
+    CHECK (ast_devpath_size (path, sizeof (path)) == 0);
+    ast_devpath_to_text (path, sizeof (path), text, sizeof (text));
+    CHECK (strcmp (text, "PciRoot(0x0)/<malformed>") == 0);
+
+    // So does a node longer than what is left, overlapping the end of the span.
+    memcpy (path, _test_path, sizeof (path));
+    path[sizeof (path) - 2] = 8;
+    CHECK (ast_devpath_size (path, sizeof (path)) == 0);
+
+    // A PCI node too short for its two bytes of data is refused by its decoder.
+    memcpy (path, _test_path + 12, 6);
+    path[2] = 5;
+    ast_devpath_iter_init (&iter, path, 5);
+    CHECK (ast_devpath_next (&iter, &node) == 1);
+    CHECK (ast_devpath_decode_pci (&node, &pci) == AST_RETURN_INVALID_PARAMETER);
+}
+
+int main (void)
+{
+    check_init ("devpath");
+
+    _test_builder ();
+    _test_decode ();
+    _test_text_render ();
+    _test_truncated ();
+    _test_malformed ();
+
+    return check_finish ();
+}
@@ -0,0 +1,134 @@
+/**
+ * @file test_efivar.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file checks reading, writing, updating, deleting and enumerating variables through the library,
+ * against an emulated store in memory.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "../src/firmware/firmware.h"
+#include "../src/firmware/backend.h"
+#include "check.h"
+
+#define ATTR (AST_EFIVAR_NON_VOLATILE | AST_EFIVAR_BOOTSERVICE_ACCESS | AST_EFIVAR_RUNTIME_ACCESS)
+
+static const ast_guid _test_guid = AST_GUID_EFI_GLOBAL;
+
+static void _test_round_trip (void)
+{
+    uint8_t  buf[64];
+    size_t   n = 0;
+    uint32_t attr = 0;
+
+    CHECK (ast_read_efivar_guid (buf, sizeof (buf), &_test_guid, "Test", &n, &attr) == AST_RETURN_NOT_FOUND);
+    CHECK (ast_write_efivar_guid ("hello", 5, &_test_guid, "Test", ATTR) == AST_RETURN_SUCCESS);
+    CHECK (ast_read_efivar_guid (buf, sizeof (buf), &_test_guid, "Test", &n, &attr) == AST_RETURN_SUCCESS);
+    CHECK ((n == 5) && (memcmp (buf, "hello", 5) == 0) && (attr == ATTR));
+
+    // A short buffer reports the size needed.
+    CHECK (ast_read_efivar_guid (buf, 2, &_test_guid, "Test", &n, NULL) == AST_RETURN_BUFFER_TOO_SMALL);
+    CHECK (n == 5);
+
+    CHECK (ast_write_efivar_guid ("bye", 3, &_test_guid, "Test", ATTR) == AST_RETURN_SUCCESS);
+    CHECK (ast_read_efivar_guid (buf, sizeof (buf), &_test_guid, "Test", &n, NULL) == AST_RETURN_SUCCESS);
+    CHECK ((n == 3) && (memcmp (buf, "bye", 3) == 0));
+
+    // Appending adds to the value.
+    CHECK (ast_write_efivar_guid ("!", 1, &_test_guid, "Test", ATTR | AST_EFIVAR_APPEND_WRITE) == AST_RETURN_SUCCESS);
+    CHECK (ast_read_efivar_guid (buf, sizeof (buf), &_test_guid, "Test", &n, NULL) == AST_RETURN_SUCCESS);
+    CHECK ((n == 4) && (memcmp (buf, "bye!", 4) == 0));
+
+    // Appending nothing changes nothing, and does not delete.
+    CHECK (ast_write_efivar_guid (NULL, 0, &_test_guid, "Test", ATTR | AST_EFIVAR_APPEND_WRITE) == AST_RETURN_SUCCESS);
+    CHECK (ast_read_efivar_guid (buf, sizeof (buf), &_test_guid, "Test", &n, NULL) == AST_RETURN_SUCCESS);
+    CHECK ((n == 4) && (memcmp (buf, "bye!", 4) == 0));
+
+    CHECK (ast_write_efivar_guid (NULL, 0, &_test_guid, "Test", 0) == AST_RETURN_SUCCESS);
+    CHECK (ast_read_efivar_guid (buf, sizeof (buf), &_test_guid, "Test", &n, NULL) == AST_RETURN_NOT_FOUND);
+}
+
+static void _test_update (struct ast_efivar_backend *backend)
+{
+    struct ast_efivar_emu_stats before, after;
+    int changed = -1;
+
+    CHECK (ast_update_efivar_guid ("same", 4, &_test_guid, "Update", ATTR, &changed) == AST_RETURN_SUCCESS);
+    CHECK (changed == 1);
+
+    // Writing the value it already has does not reach the store.
+    ast_efivar_backend_emu_stats (backend, &before);
+    CHECK (ast_update_efivar_guid ("same", 4, &_test_guid, "Update", ATTR, &changed) == AST_RETURN_SUCCESS);
+    CHECK (changed == 0);
+    ast_efivar_backend_emu_stats (backend, &after);
+    CHECK (after.writes == before.writes);
+
+    CHECK (ast_update_efivar_guid ("diff", 4, &_test_guid, "Update", ATTR, &changed) == AST_RETURN_SUCCESS);
+    CHECK (changed == 1);
+    CHECK (ast_update_efivar_guid (NULL, 0, &_test_guid, "Update", 0, &changed) == AST_RETURN_SUCCESS);
+    CHECK (changed == 1);
+    CHECK (ast_update_efivar_guid (NULL, 0, &_test_guid, "Update", 0, &changed) == AST_RETURN_SUCCESS);
+    CHECK (changed == 0);
+}
+
+static void _test_enumerate (void)
+{
+    struct ast_efivar_iter *it = NULL;
+    struct ast_efivar_info infos[3];
+    char   name[16];
+    size_t n = 0;
+    int    seen[10] = {0};
+    int    total = 0;
+
+    for (int i = 0; i < 10; i++) {
+        snprintf (name, sizeof (name), "Var%d", i);
+        CHECK (ast_write_efivar_guid (name, strlen (name), &_test_guid, name, ATTR) == AST_RETURN_SUCCESS);
+    }
+
+    // Chunks smaller than the store, so the iterator has to resume.
+    if (!CHECK (ast_efivar_iter_open (&it, AST_EFIVAR_ITER_ATTRIBUTES) == AST_RETURN_SUCCESS)) {
+        return;
+    }
+    do {
+        CHECK (ast_efivar_iter_next (it, infos, 3, &n) == AST_RETURN_SUCCESS);
+        for (size_t k = 0; k < n; k++) {
+            int i = -1;
+
+            if ((sscanf (infos[k].name, "Var%d", &i) == 1) && (i >= 0) && (i < 10)) {
+                seen[i]++;
+                CHECK (infos[k].size == strlen (infos[k].name));
+                CHECK (infos[k].attr == ATTR);
+            }
+            total++;
+        }
+    } while (n != 0);
+    ast_efivar_iter_close (it);
+
+    CHECK (total == 10);
+    for (int i = 0; i < 10; i++) {
+        CHECK (seen[i] == 1);
+    }
+}
+
+int main (void)
+{
+    struct ast_efivar_backend *backend = ast_efivar_backend_emu_new (NULL, NULL);
+
+    check_init ("efivar");
+    if (!CHECK (backend != NULL)) {
+        return check_finish ();
+    }
+    ast_efivar_backend_set (backend);
+
+    _test_round_trip ();
+    _test_update (backend);
+    _test_enumerate ();
+
+    ast_efivar_backend_set (NULL);
+    ast_efivar_backend_free (backend);
+    return check_finish ();
+}
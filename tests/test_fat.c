@@ -0,0 +1,236 @@
+/**
+ * @file test_fat.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file checks the FAT reader on a small FAT16 image it writes: path lookups by long and 8.3 names,
+ * reading files, and a damaged cluster chain.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/fat/fat.h"
+#include "../src/firmware/firmware.h"
+#include "check.h"
+
+#define SECTOR       512
+#define NSECTORS     4400
+#define FAT_SECTORS  18
+#define ROOT_ENTRIES 512
+#define DATA_SECTOR  (1 + 2 * FAT_SECTORS + ROOT_ENTRIES * 32 / SECTOR)
+#define IMAGE_SIZE   1300 // Three clusters, the last one partly used
+
+static const char *_test_path = "test_fat.img";
+
+static void _test_put16 (uint8_t *p, unsigned int v)
+{
+    p[0] = (uint8_t) v;
+    p[1] = (uint8_t) (v >> 8);
+}
+
+static void _test_put32 (uint8_t *p, uint32_t v)
+{
+    _test_put16 (p, v & 0xffff);
+    _test_put16 (p + 2, v >> 16);
+}
+
+static uint8_t *_test_dirent (uint8_t *e, const char *shortName, uint8_t attributes, uint16_t cluster, uint32_t size)
+{
+    memcpy (e, shortName, 11);
+    e[11] = attributes;
+    _test_put16 (e + 26, cluster);
+    _test_put32 (e + 28, size);
+    return e + 32;
+}
+
+/** Two long name entries (up to 26 characters) and the short entry. */
+static uint8_t *_test_long (uint8_t *e, const char *name, const char *shortName, uint16_t cluster, uint32_t size)
+{
+    static const int offsets[13] = { 1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30 };
+    size_t len = strlen (name);
+    uint8_t sum = 0;
+
+    for (int i = 0; i < 11; i++) {
+        sum = (uint8_t) (((sum & 1) << 7) + (sum >> 1) + (uint8_t) shortName[i]);
+    }
+    for (int ord = 2; ord >= 1; ord--) {
+        e[0]  = (uint8_t) (ord | ((ord == 2) ? 0x40 : 0));
+        e[11] = 0x0f;
+        e[13] = sum;
+        for (int k = 0; k < 13; k++) {
+            size_t c = (size_t) (ord - 1) * 13 + (size_t) k;
+
+            _test_put16 (e + offsets[k], (c < len) ? (uint8_t) name[c] : (c == len) ? 0 : 0xffff);
+        }
+        e += 32;
+    }
+    return _test_dirent (e, shortName, AST_FAT_ATTR_ARCHIVE, cluster, size);
+}
+
+static uint8_t _test_byte (size_t i)
+{
+    return (uint8_t) (i * 2654435761u >> 24);
+}
+
+/**
+ * Root: EFI (cluster 2), LOOP.BIN (cluster 4, chained to itself) and the empty README.TXT.
+ * \EFI: AST (cluster 3). \EFI\AST: "Boot Entry.efi" (cluster 5) and ASTG2X64.EFI (clusters 6 to 8).
+ */
+static uint8_t *_test_volume (void)
+{
+    uint8_t *v = calloc (NSECTORS, SECTOR);
+    uint8_t *fat = NULL, *e = NULL;
+
+    if (v == NULL) {
+        return NULL;
+    }
+    v[0] = 0xeb;
+    v[1] = 0x3c;
+    v[2] = 0x90;
+    _test_put16 (v + 11, SECTOR);
+    v[13] = 1;
+    _test_put16 (v + 14, 1);
+    v[16] = 2;
+    _test_put16 (v + 17, ROOT_ENTRIES);
+    _test_put16 (v + 19, NSECTORS);
+    v[21] = 0xf8;
+    _test_put16 (v + 22, FAT_SECTORS);
+    v[510] = 0x55;
+    v[511] = 0xaa;
+
+    fat = v + SECTOR;
+    _test_put16 (fat, 0xfff8);
+    _test_put16 (fat + 2, 0xffff);
+    _test_put16 (fat + 2 * 2, 0xffff);
+    _test_put16 (fat + 2 * 3, 0xffff);
+    _test_put16 (fat + 2 * 4, 4);
+    _test_put16 (fat + 2 * 5, 0xffff);
+    _test_put16 (fat + 2 * 6, 7);
+    _test_put16 (fat + 2 * 7, 8);
+    _test_put16 (fat + 2 * 8, 0xffff);
+    memcpy (v + SECTOR * (1 + FAT_SECTORS), fat, FAT_SECTORS * SECTOR);
+
+    e = v + SECTOR * (1 + 2 * FAT_SECTORS);
+    e = _test_dirent (e, "EFI        ", AST_FAT_ATTR_DIRECTORY, 2, 0);
+    e = _test_dirent (e, "LOOP    BIN", AST_FAT_ATTR_ARCHIVE, 4, 2000);
+    _test_dirent (e, "README  TXT", AST_FAT_ATTR_ARCHIVE, 0, 0);
+
+    e = v + SECTOR * DATA_SECTOR;
+    e = _test_dirent (e, ".          ", AST_FAT_ATTR_DIRECTORY, 2, 0);
+    e = _test_dirent (e, "..         ", AST_FAT_ATTR_DIRECTORY, 0, 0);
+    _test_dirent (e, "AST        ", AST_FAT_ATTR_DIRECTORY, 3, 0);
+
+    e = v + SECTOR * (DATA_SECTOR + 1);
+    e = _test_dirent (e, ".          ", AST_FAT_ATTR_DIRECTORY, 3, 0);
+    e = _test_dirent (e, "..         ", AST_FAT_ATTR_DIRECTORY, 2, 0);
+    e = _test_long (e, "Boot Entry.efi", "BOOTEN~1EFI", 5, 10);
+    _test_dirent (e, "ASTG2X64EFI", AST_FAT_ATTR_ARCHIVE, 6, IMAGE_SIZE);
+
+    memcpy (v + SECTOR * (DATA_SECTOR + 3), "0123456789", 10);
+    for (size_t i = 0; i < IMAGE_SIZE; i++) {
+        v[SECTOR * (DATA_SECTOR + 4) + i] = _test_byte (i);
+    }
+    return v;
+}
+
+struct _test_sink_state {
+    size_t size;
+    int    same;
+};
+
+static int _test_sink (void *arg, const void *data, size_t size)
+{
+    struct _test_sink_state *s = arg;
+    const uint8_t *p = data;
+
+    for (size_t i = 0; i < size; i++) {
+        s->same &= (p[i] == _test_byte (s->size + i));
+    }
+    s->size += size;
+    return AST_RETURN_SUCCESS;
+}
+
+static void _test_lookup (struct ast_fat *fat)
+{
+    struct ast_fat_entry entry;
+
+    CHECK (ast_fat_type (fat) == 16);
+
+    CHECK (ast_fat_lookup (fat, "\\efi\\ast\\Astg2x64.Efi", &entry) == AST_RETURN_SUCCESS);
+    CHECK ((strcmp (entry.name, "ASTG2X64.EFI") == 0) && (entry.cluster == 6) && (entry.size == IMAGE_SIZE));
+
+    CHECK (ast_fat_lookup (fat, "/EFI/AST/boot entry.EFI", &entry) == AST_RETURN_SUCCESS);
+    CHECK ((strcmp (entry.name, "Boot Entry.efi") == 0) && (entry.cluster == 5) && (entry.size == 10));
+    CHECK (ast_fat_lookup (fat, "\\EFI\\AST\\BOOTEN~1.EFI", &entry) == AST_RETURN_SUCCESS);
+    CHECK (strcmp (entry.name, "Boot Entry.efi") == 0);
+
+    CHECK (ast_fat_lookup (fat, "\\EFI\\AST", &entry) == AST_RETURN_SUCCESS);
+    CHECK ((entry.attributes & AST_FAT_ATTR_DIRECTORY) && (entry.cluster == 3));
+    CHECK (ast_fat_lookup (fat, "\\", &entry) == AST_RETURN_SUCCESS);
+    CHECK ((entry.attributes & AST_FAT_ATTR_DIRECTORY) && (entry.name[0] == '\0'));
+
+    CHECK (ast_fat_lookup (fat, "\\EFI\\AST\\missing.efi", &entry) == AST_RETURN_NOT_FOUND);
+    CHECK (ast_fat_lookup (fat, "\\README.TXT\\x", &entry) == AST_RETURN_NOT_FOUND);
+}
+
+static void _test_read (struct ast_fat *fat)
+{
+    struct ast_fat_entry entry;
+    struct _test_sink_state s = { 0, 1 };
+
+    if (CHECK (ast_fat_lookup (fat, "\\EFI\\AST\\astg2x64.efi", &entry) == AST_RETURN_SUCCESS)) {
+        CHECK (ast_fat_read (fat, &entry, _test_sink, &s) == AST_RETURN_SUCCESS);
+        CHECK ((s.size == IMAGE_SIZE) && s.same);
+    }
+
+    s.size = 0;
+    if (CHECK (ast_fat_lookup (fat, "\\README.TXT", &entry) == AST_RETURN_SUCCESS)) {
+        CHECK (ast_fat_read (fat, &entry, _test_sink, &s) == AST_RETURN_SUCCESS);
+        CHECK (s.size == 0);
+    }
+
+    // A chain that loops back before the end of the file, and a directory, cannot be read.
+    if (CHECK (ast_fat_lookup (fat, "\\LOOP.BIN", &entry) == AST_RETURN_SUCCESS)) {
+        CHECK (ast_fat_read (fat, &entry, _test_sink, &s) == AST_RETURN_INVALID_PARAMETER);
+    }
+    if (CHECK (ast_fat_lookup (fat, "\\EFI", &entry) == AST_RETURN_SUCCESS)) {
+        CHECK (ast_fat_read (fat, &entry, _test_sink, &s) == AST_RETURN_INVALID_PARAMETER);
+    }
+}
+
+int main (void)
+{
+    uint8_t *data = _test_volume ();
+    struct ast_fat *fat = NULL;
+    FILE *fp = NULL;
+    int  written = 0;
+
+    check_init ("fat");
+    fp = fopen (_test_path, "wb");
+    if (fp != NULL) {
+        written = (data != NULL) && (fwrite (data, SECTOR, NSECTORS, fp) == NSECTORS);
+        written &= (fclose (fp) == 0);
+    }
+    if (CHECK (written) && CHECK (ast_fat_open (_test_path, 0, 0, &fat) == AST_RETURN_SUCCESS)) {
+        _test_lookup (fat);
+        _test_read (fat);
+        ast_fat_close (fat);
+    }
+
+    // Without a boot sector signature, there is no file system.
+    if ((data != NULL) && ((fp = fopen (_test_path, "wb")) != NULL)) {
+        data[510] = 0;
+        written = (fwrite (data, SECTOR, NSECTORS, fp) == NSECTORS);
+        written &= (fclose (fp) == 0);
+        if (CHECK (written)) {
+            CHECK (ast_fat_open (_test_path, 0, 0, &fat) == AST_RETURN_INVALID_PARAMETER);
+        }
+    }
+
+    remove (_test_path);
+    free (data);
+    return check_finish ();
+}
@@ -0,0 +1,158 @@
+/**
+ * @file test_gpt.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file checks the GPT reader on disk images it writes: a sound table, one with a damaged primary
+ * header, where the backup is used, and one with both headers damaged.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/crypto/crc32.h"
+#include "../src/gpt/gpt.h"
+#include "../src/firmware/firmware.h"
+#include "check.h"
+
+#define NBLOCKS    256
+#define BLOCK_SIZE 512
+#define NENTRIES   128
+#define ENTRY_SIZE 128
+#define ARRAY_SIZE (NENTRIES * ENTRY_SIZE)
+
+static const char *_test_path = "test_gpt.img";
+static const ast_guid _test_esp = AST_GUID_PARTITION_ESP;
+
+static void _test_put (uint8_t *p, uint64_t v, int n)
+{
+    for (int k = 0; k < n; k++) {
+        p[k] = (uint8_t) (v >> (8 * k));
+    }
+}
+
+static void _test_header (uint8_t *h, uint64_t myLba, uint64_t altLba, uint64_t arrayLba, uint32_t arrayCrc)
+{
+    memset (h, 0, BLOCK_SIZE);
+    memcpy (h, "EFI PART", 8);
+    _test_put (h + 8, 0x00010000, 4);
+    _test_put (h + 12, 92, 4);
+    _test_put (h + 24, myLba, 8);
+    _test_put (h + 32, altLba, 8);
+    _test_put (h + 40, 34, 8);
+    _test_put (h + 48, NBLOCKS - 34, 8);
+    memset (h + 56, 0x5a, 16);
+    _test_put (h + 72, arrayLba, 8);
+    _test_put (h + 80, NENTRIES, 4);
+    _test_put (h + 84, ENTRY_SIZE, 4);
+    _test_put (h + 88, arrayCrc, 4);
+    _test_put (h + 16, ast_crc32 (0, h, 92), 4);
+}
+
+/** A disk with a data partition (number 1) and an ESP named "ESP" (number 3) in 34..99 and 100..199. */
+static uint8_t *_test_disk (void)
+{
+    static const uint8_t dataType[16] = {0xaf, 0x3d, 0xc6, 0x0f, 0x83, 0x84, 0x72, 0x47,
+                                         0x8e, 0x79, 0x3d, 0x69, 0xd8, 0x47, 0x7d, 0xe4};
+    uint8_t *p = calloc (NBLOCKS, BLOCK_SIZE);
+    uint8_t *array = NULL;
+    uint32_t arrayCrc = 0;
+
+    if (p == NULL) {
+        return NULL;
+    }
+    array = p + 2 * BLOCK_SIZE;
+    p[446 + 4] = 0xee; // Protective MBR
+    _test_put (p + 446 + 8, 1, 4);
+    _test_put (p + 446 + 12, NBLOCKS - 1, 4);
+    p[510] = 0x55;
+    p[511] = 0xaa;
+
+    memcpy (array, dataType, 16);
+    memset (array + 16, 0x11, 16);
+    _test_put (array + 32, 34, 8);
+    _test_put (array + 40, 99, 8);
+    memcpy (array + 2 * ENTRY_SIZE, _test_esp.b, 16);
+    memset (array + 2 * ENTRY_SIZE + 16, 0x33, 16);
+    _test_put (array + 2 * ENTRY_SIZE + 32, 100, 8);
+    _test_put (array + 2 * ENTRY_SIZE + 40, 199, 8);
+    _test_put (array + 2 * ENTRY_SIZE + 48, 1, 8);
+    memcpy (array + 2 * ENTRY_SIZE + 56, "E\0S\0P\0", 6);
+
+    arrayCrc = ast_crc32 (0, array, ARRAY_SIZE);
+    memcpy (p + (NBLOCKS - 33) * BLOCK_SIZE, array, ARRAY_SIZE);
+    _test_header (p + BLOCK_SIZE, 1, NBLOCKS - 1, 2, arrayCrc);
+    _test_header (p + (NBLOCKS - 1) * BLOCK_SIZE, NBLOCKS - 1, 1, NBLOCKS - 33, arrayCrc);
+    return p;
+}
+
+static int _test_write (const uint8_t *data)
+{
+    FILE *fp = fopen (_test_path, "wb");
+    int  ok = (fp != NULL) && (fwrite (data, BLOCK_SIZE, NBLOCKS, fp) == NBLOCKS);
+
+    if (fp != NULL) {
+        ok &= (fclose (fp) == 0);
+    }
+    return CHECK (ok);
+}
+
+static void _test_read (unsigned int valid)
+{
+    struct ast_gpt gpt;
+    const struct ast_gpt_partition *esp = NULL;
+    struct ast_devpath_hd hd;
+
+    if (!CHECK (ast_gpt_read (_test_path, &gpt) == AST_RETURN_SUCCESS)) {
+        return;
+    }
+    CHECK (gpt.valid == valid);
+    CHECK ((gpt.blockSize == BLOCK_SIZE) && (gpt.nBlocks == NBLOCKS));
+    CHECK ((gpt.firstUsableLba == 34) && (gpt.lastUsableLba == NBLOCKS - 34));
+    CHECK (gpt.nPartitions == 2);
+
+    esp = ast_gpt_find (&gpt, &_test_esp);
+    if (CHECK (esp != NULL)) {
+        CHECK ((esp->number == 3) && (esp->firstLba == 100) && (esp->lastLba == 199) && (esp->attributes == 1));
+        CHECK (strcmp (esp->name, "ESP") == 0);
+
+        ast_gpt_hd (esp, &hd);
+        CHECK ((hd.partitionNumber == 3) && (hd.partitionStart == 100) && (hd.partitionSize == 100));
+        CHECK ((hd.signature[0] == 0x33) && (hd.signature[15] == 0x33));
+        CHECK ((hd.partitionFormat == AST_DEVPATH_HD_FORMAT_GPT) && (hd.signatureType == AST_DEVPATH_HD_SIGNATURE_GUID));
+    }
+    ast_gpt_free (&gpt);
+}
+
+int main (void)
+{
+    uint8_t *data = _test_disk ();
+    struct ast_gpt gpt;
+
+    check_init ("gpt");
+    if (!CHECK (data != NULL)) {
+        return check_finish ();
+    }
+
+    if (_test_write (data)) {
+        _test_read (AST_GPT_PRIMARY | AST_GPT_BACKUP);
+    }
+
+    // A bad header CRC sends the reader to the backup.
+    data[BLOCK_SIZE + 16] ^= 1;
+    if (_test_write (data)) {
+        _test_read (AST_GPT_BACKUP);
+    }
+
+    data[(NBLOCKS - 1) * BLOCK_SIZE + 16] ^= 1;
+    if (_test_write (data)) {
+        CHECK (ast_gpt_read (_test_path, &gpt) == AST_RETURN_INVALID_PARAMETER);
+    }
+
+    remove (_test_path);
+    CHECK (ast_gpt_read (_test_path, &gpt) == AST_RETURN_NOT_FOUND);
+    free (data);
+    return check_finish ();
+}
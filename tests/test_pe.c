@@ -0,0 +1,329 @@
+/**
+ * @file test_pe.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file checks SHA-256 against the FIPS 180-4 examples on every engine, and the Authenticode digest
+ * of PE32 and PE32+ images it builds against the regions the specification says are hashed; truncated
+ * images and headers that overlap or point past the end are refused without reading out of bounds.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/pe/pe.h"
+#include "../src/firmware/firmware.h"
+#include "check.h"
+
+#define IMAGE_SIZE   0x700
+#define LFANEW       0x80
+#define HEADERS_SIZE 0x200
+#define CERT_OFFSET  0x680
+#define CERT_SIZE    0x80
+
+static const char *_test_path = "test_pe.img";
+
+/**
+ * A known answer.
+ */
+struct _test_vector {
+    const char *message;
+    size_t     repeat;
+    uint8_t    digest[AST_SHA256_SIZE];
+};
+
+static const struct _test_vector _test_vectors[] = {
+    { "", 1, {
+        0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14, 0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+        0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c, 0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55 } },
+    { "abc", 1, {
+        0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+        0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad } },
+    { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1, {
+        0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8, 0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+        0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67, 0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1 } },
+    { "a", 1000000, {
+        0xcd, 0xc7, 0x6e, 0x5c, 0x99, 0x14, 0xfb, 0x92, 0x81, 0xa1, 0xc7, 0xe2, 0x84, 0xd7, 0x3e, 0x67,
+        0xf1, 0x80, 0x9a, 0x48, 0xa4, 0x97, 0x20, 0x0e, 0x04, 0x6d, 0x39, 0xcc, 0xc7, 0x11, 0x2c, 0xd0 } }
+};
+
+static void _test_put (uint8_t *p, uint64_t v, int n)
+{
+    for (int k = 0; k < n; k++) {
+        p[k] = (uint8_t) (v >> (8 * k));
+    }
+}
+
+static void _test_sha256_vectors (const char *engine)
+{
+    for (size_t i = 0; i < sizeof (_test_vectors) / sizeof (_test_vectors[0]); i++) {
+        const struct _test_vector *v = &_test_vectors[i];
+        size_t len = strlen (v->message);
+        uint8_t digest[AST_SHA256_SIZE];
+        struct ast_sha256 ctx;
+
+        ast_sha256_init (&ctx);
+        for (size_t k = 0; k < v->repeat; k++) {
+            ast_sha256_update (&ctx, v->message, len);
+        }
+        ast_sha256_final (&ctx, digest);
+        if (!CHECK (memcmp (digest, v->digest, AST_SHA256_SIZE) == 0)) {
+            fprintf (stderr, "pe: %s, vector %zu\n", engine, i);
+        }
+        if (v->repeat == 1) {
+            ast_sha256 (v->message, len, digest);
+            CHECK (memcmp (digest, v->digest, AST_SHA256_SIZE) == 0);
+        }
+    }
+}
+
+/** Every length around the block and padding boundaries, in one piece and in uneven pieces. */
+static void _test_sha256_split (uint8_t (*digests)[AST_SHA256_SIZE])
+{
+    uint8_t msg[200];
+    int     ok = 1;
+
+    for (size_t i = 0; i < sizeof (msg); i++) {
+        msg[i] = (uint8_t) (i * 7 + 1);
+    }
+    for (size_t len = 0; len <= sizeof (msg); len++) {
+        uint8_t piecewise[AST_SHA256_SIZE];
+        struct ast_sha256 ctx;
+
+        ast_sha256 (msg, len, digests[len]);
+        ast_sha256_init (&ctx);
+        for (size_t at = 0, step = 1; at < len; at += step, step = step % 13 + 1) {
+            ast_sha256_update (&ctx, msg + at, (len - at < step) ? len - at : step);
+        }
+        ast_sha256_final (&ctx, piecewise);
+        ok &= (memcmp (piecewise, digests[len], AST_SHA256_SIZE) == 0);
+    }
+    CHECK (ok);
+}
+
+static void _test_sha256 (void)
+{
+    static uint8_t portable[201][AST_SHA256_SIZE];
+    static uint8_t hardware[201][AST_SHA256_SIZE];
+
+    CHECK (ast_sha256_select (0) == AST_RETURN_SUCCESS);
+    CHECK (strcmp (ast_sha256_engine (), "portable") == 0);
+    _test_sha256_vectors ("portable");
+    _test_sha256_split (portable);
+
+    // SHA-NI, where the processor has it, must agree with portable C on every length.
+    if (ast_sha256_select (1) == AST_RETURN_SUCCESS) {
+        CHECK (strcmp (ast_sha256_engine (), "sha-ni") == 0);
+        _test_sha256_vectors ("sha-ni");
+        _test_sha256_split (hardware);
+        CHECK (memcmp (portable, hardware, sizeof (portable)) == 0);
+    } else {
+        printf ("pe: no SHA-NI here, portable SHA-256 only\n");
+    }
+}
+
+/**
+ * Build an image: three sections, listed out of file order, the last one empty; then debug data and,
+ * if cert, a Certificate Table at the end. PE32+ if plus, PE32 otherwise.
+ */
+static void _test_image (uint8_t *p, int plus, int cert)
+{
+    size_t opt     = LFANEW + 4 + 20;
+    size_t optSize = plus ? 112 + 16 * 8 : 96 + 16 * 8;
+    size_t dirs    = opt + (plus ? 112 : 96);
+    size_t table   = opt + optSize;
+
+    for (size_t i = 0; i < IMAGE_SIZE; i++) {
+        p[i] = (uint8_t) (i * 31 + (i >> 8));
+    }
+    memset (p, 0, HEADERS_SIZE);
+    p[0] = 'M';
+    p[1] = 'Z';
+    _test_put (p + 0x3c, LFANEW, 4);
+    memcpy (p + LFANEW, "PE\0\0", 4);
+    _test_put (p + LFANEW + 4, plus ? 0x8664 : 0x14c, 2);
+    _test_put (p + LFANEW + 6, 3, 2);
+    _test_put (p + LFANEW + 20, optSize, 2);
+    _test_put (p + opt, plus ? 0x20b : 0x10b, 2);
+    _test_put (p + opt + 60, HEADERS_SIZE, 4);
+    _test_put (p + opt + 64, 0xdeadbeef, 4);
+    _test_put (p + opt + (plus ? 108 : 92), 16, 4);
+    for (int k = 0; k < 16; k++) {
+        _test_put (p + dirs + 8 * k, 0x1000 * (k + 1), 4);
+        _test_put (p + dirs + 8 * k + 4, 0x10, 4);
+    }
+    if (cert) {
+        _test_put (p + dirs + 32, CERT_OFFSET, 4);
+        _test_put (p + dirs + 36, CERT_SIZE, 4);
+    } else {
+        _test_put (p + dirs + 32, 0, 8);
+    }
+
+    // .data at 0x400, .text at 0x200, .bss with no raw data.
+    memcpy (p + table, ".data\0\0\0", 8);
+    _test_put (p + table + 16, 0x200, 4);
+    _test_put (p + table + 20, 0x400, 4);
+    memcpy (p + table + 40, ".text\0\0\0", 8);
+    _test_put (p + table + 40 + 16, 0x200, 4);
+    _test_put (p + table + 40 + 20, 0x200, 4);
+    memcpy (p + table + 80, ".bss\0\0\0\0", 8);
+    _test_put (p + table + 80 + 20, 0x600, 4);
+}
+
+/** The digest the specification asks for, spelled out for the images _test_image builds. */
+static void _test_expected (const uint8_t *p, int plus, int cert, uint8_t *digest)
+{
+    size_t checksum = LFANEW + 4 + 20 + 64;
+    size_t certDir  = LFANEW + 4 + 20 + (plus ? 112 : 96) + 32;
+    size_t end      = cert ? CERT_OFFSET : IMAGE_SIZE;
+    struct ast_sha256 ctx;
+
+    ast_sha256_init (&ctx);
+    ast_sha256_update (&ctx, p, checksum);
+    ast_sha256_update (&ctx, p + checksum + 4, certDir - checksum - 4);
+    ast_sha256_update (&ctx, p + certDir + 8, HEADERS_SIZE - certDir - 8);
+    ast_sha256_update (&ctx, p + 0x200, 0x200);
+    ast_sha256_update (&ctx, p + 0x400, 0x200);
+    ast_sha256_update (&ctx, p + 0x600, end - 0x600);
+    ast_sha256_final (&ctx, digest);
+}
+
+static void _test_authenticode (int plus, int cert)
+{
+    static uint8_t p[IMAGE_SIZE];
+    uint8_t digest[AST_SHA256_SIZE];
+    uint8_t expected[AST_SHA256_SIZE];
+    uint8_t changed[AST_SHA256_SIZE];
+
+    _test_image (p, plus, cert);
+    _test_expected (p, plus, cert, expected);
+    CHECK (ast_pe_hash (p, IMAGE_SIZE, digest) == AST_RETURN_SUCCESS);
+    if (!CHECK (memcmp (digest, expected, AST_SHA256_SIZE) == 0)) {
+        fprintf (stderr, "pe: %s, %s certificates\n", plus ? "PE32+" : "PE32", cert ? "with" : "without");
+    }
+
+    // CheckSum and the signatures are not hashed; section bytes are.
+    _test_put (p + LFANEW + 4 + 20 + 64, 0x12345678, 4);
+    if (cert) {
+        p[CERT_OFFSET + 5] ^= 0xff;
+    }
+    CHECK (ast_pe_hash (p, IMAGE_SIZE, changed) == AST_RETURN_SUCCESS);
+    CHECK (memcmp (changed, expected, AST_SHA256_SIZE) == 0);
+    p[0x2ff] ^= 1;
+    CHECK (ast_pe_hash (p, IMAGE_SIZE, changed) == AST_RETURN_SUCCESS);
+    CHECK (memcmp (changed, expected, AST_SHA256_SIZE) != 0);
+}
+
+/** Every prefix of the image, each in a buffer of its exact size so that overreads are caught. */
+static void _test_truncated (int cert)
+{
+    static uint8_t image[IMAGE_SIZE];
+    uint8_t digest[AST_SHA256_SIZE];
+    int ok = 1;
+
+    _test_image (image, 1, cert);
+    for (size_t len = 0; len < IMAGE_SIZE; len++) {
+        uint8_t *p = malloc ((len == 0) ? 1 : len);
+        int ret = 0;
+
+        if (!CHECK (p != NULL)) {
+            return;
+        }
+        memcpy (p, image, len);
+        ret = ast_pe_hash (p, len, digest);
+        // Past the last section and without signatures, a shorter tail is still a well formed image.
+        if (ret != (((len >= 0x600) && !cert) ? AST_RETURN_SUCCESS : AST_RETURN_INVALID_PARAMETER)) {
+            fprintf (stderr, "pe: prefix of %zu bytes gives %d\n", len, ret);
+            ok = 0;
+        }
+        free (p);
+    }
+    CHECK (ok);
+}
+
+/** Headers whose fields point past the end of the image, or make regions overlap. */
+static void _test_malformed (void)
+{
+    static uint8_t image[IMAGE_SIZE];
+    static uint8_t p[IMAGE_SIZE];
+    uint8_t digest[AST_SHA256_SIZE];
+    size_t  opt   = LFANEW + 4 + 20;
+    size_t  dirs  = opt + 112;
+    size_t  table = opt + 240;
+
+    _test_image (image, 1, 1);
+
+#define _TEST_BAD(offset, value, n) do {                                                  \
+        memcpy (p, image, IMAGE_SIZE);                                                    \
+        _test_put (p + (offset), (value), (n));                                           \
+        CHECK (ast_pe_hash (p, IMAGE_SIZE, digest) == AST_RETURN_INVALID_PARAMETER);      \
+    } while (0)
+
+    _TEST_BAD (0, 'Z', 1);                                      // Not MZ
+    _TEST_BAD (0x3c, IMAGE_SIZE - 2, 4);                        // PE signature across the end
+    _TEST_BAD (0x3c, 0xffffffff, 4);                            // PE header past the end
+    _TEST_BAD (LFANEW, 'P', 4);                                 // Not PE\0\0
+    _TEST_BAD (LFANEW + 6, AST_PE_MAX_SECTIONS + 1, 2);         // Too many sections
+    _TEST_BAD (LFANEW + 20, 0xffff, 2);                         // Optional header past the end
+    _TEST_BAD (LFANEW + 20, 100, 2);                            // Optional header too short for PE32+
+    _TEST_BAD (opt, 0x107, 2);                                  // Unknown magic
+    _TEST_BAD (opt + 108, 17, 4);                               // Data directories past the optional header
+    _TEST_BAD (opt + 60, table + 2 * 40, 4);                    // Section table overlapping the headers' end
+    _TEST_BAD (opt + 60, IMAGE_SIZE + 1, 4);                    // Headers past the end
+    _TEST_BAD (dirs + 36, CERT_SIZE + 1, 4);                    // Certificate Table past the end
+    _TEST_BAD (dirs + 32, 0xffffff00, 4);                       // Certificate Table offset wrapping around
+    _TEST_BAD (table + 16, 0x400, 4);                           // Section raw data past the end...
+    _TEST_BAD (table + 20, 0xfffffe00, 4);                      // ... or wrapping around
+#undef _TEST_BAD
+
+    // Sections sharing raw data are hashed as listed, in file order; nothing is read twice past the end.
+    memcpy (p, image, IMAGE_SIZE);
+    _test_put (p + table + 20, 0x200, 4);
+    CHECK (ast_pe_hash (p, IMAGE_SIZE, digest) == AST_RETURN_SUCCESS);
+
+    // Fewer than five data directories: no Certificate Table, everything past the headers is hashed.
+    memcpy (p, image, IMAGE_SIZE);
+    _test_put (p + opt + 108, 4, 4);
+    CHECK (ast_pe_hash (p, IMAGE_SIZE, digest) == AST_RETURN_SUCCESS);
+}
+
+static void _test_file (void)
+{
+    static uint8_t image[IMAGE_SIZE];
+    uint8_t digest[AST_SHA256_SIZE];
+    uint8_t expected[AST_SHA256_SIZE];
+    FILE *fp = NULL;
+
+    _test_image (image, 1, 1);
+    _test_expected (image, 1, 1, expected);
+    fp = fopen (_test_path, "wb");
+    if (!CHECK (fp != NULL)) {
+        return;
+    }
+    CHECK (fwrite (image, 1, IMAGE_SIZE, fp) == IMAGE_SIZE);
+    fclose (fp);
+
+    CHECK (ast_pe_hash_file (_test_path, digest) == AST_RETURN_SUCCESS);
+    CHECK (memcmp (digest, expected, AST_SHA256_SIZE) == 0);
+    remove (_test_path);
+    CHECK (ast_pe_hash_file (_test_path, digest) == AST_RETURN_NOT_FOUND);
+}
+
+int main (void)
+{
+    check_init ("pe");
+
+    _test_sha256 ();
+    _test_authenticode (0, 0);
+    _test_authenticode (0, 1);
+    _test_authenticode (1, 0);
+    _test_authenticode (1, 1);
+    _test_truncated (0);
+    _test_truncated (1);
+    _test_malformed ();
+    _test_file ();
+
+    return check_finish ();
+}
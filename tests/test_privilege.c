@@ -0,0 +1,79 @@
+/**
+ * @file test_privilege.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file checks the calls the privilege manager makes to the operating system, through the stub
+ * table: a privilege held is not asked for again until the manager is released, and several statuses
+ * are answered from one token query.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../src/privilege/privilege.h"
+#include "check.h"
+
+#define NREQUESTS 100
+
+static void _test_counts (int cached)
+{
+    struct ast_privilege_os_counters c;
+    unsigned long n = cached ? 1 : NREQUESTS;
+
+    ast_privilege_os_stub_reset ();
+    for (int i = 0; i < NREQUESTS; i++) {
+        CHECK (ast_privilege_obtain (SE_SYSTEM_ENVIRONMENT_NAME) == EXIT_SUCCESS);
+        if (!cached) {
+            ast_privilege_release ();
+        }
+    }
+    ast_privilege_release ();
+    ast_privilege_os_stub_counters (&c);
+
+    // Every token opened is closed; cached, the token, the LUID and the adjustment are got once.
+    CHECK (c.openToken == n);
+    CHECK (c.closeToken == n);
+    CHECK (c.lookupValue == n);
+    CHECK (c.adjust == n);
+}
+
+static void _test_status (void)
+{
+    static char *names[] = {
+        SE_SYSTEM_ENVIRONMENT_NAME, SE_BACKUP_NAME, SE_RESTORE_NAME
+    };
+    struct ast_privilege_query queries[3];
+    struct ast_privilege_os_counters c;
+
+    ast_privilege_os_stub_reset ();
+    for (int i = 0; i < 3; i++) {
+        queries[i].privName = names[i];
+    }
+    CHECK (ast_privilege_query_many (queries, 3) == EXIT_SUCCESS);
+    ast_privilege_os_stub_counters (&c);
+    CHECK (c.query == 1);
+    for (int i = 0; i < 3; i++) {
+        CHECK (queries[i].found && (queries[i].status == AST_PRIVILEGE_ENABLED));
+    }
+
+    CHECK (ast_privilege_remove (SE_BACKUP_NAME) == EXIT_SUCCESS);
+    CHECK (ast_privilege_check_status (SE_BACKUP_NAME, AST_PRIVILEGE_ENABLED) != EXIT_SUCCESS);
+    CHECK (ast_privilege_obtain (SE_BACKUP_NAME) == EXIT_SUCCESS);
+    CHECK (ast_privilege_check_status (SE_BACKUP_NAME, AST_PRIVILEGE_ENABLED) == EXIT_SUCCESS);
+    ast_privilege_release ();
+}
+
+int main (void)
+{
+    check_init ("privilege");
+    ast_privilege_set_os (ast_privilege_os_stub ());
+
+    _test_counts (0);
+    _test_counts (1);
+    _test_status ();
+
+    ast_privilege_set_os (NULL);
+    return check_finish ();
+}
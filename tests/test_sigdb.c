@@ -0,0 +1,319 @@
+/**
+ * @file test_sigdb.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file checks the signature list walker and the lookup index on databases it builds: SHA-256, X.509
+ * and SHA-1 lists, truncated databases, and lists whose sizes overlap their neighbours or the end.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../src/sigdb/sigdb.h"
+#include "../src/firmware/firmware.h"
+#include "check.h"
+
+#define NDIGESTS 300
+
+static const ast_guid _test_sha256   = AST_GUID_CERT_SHA256;
+static const ast_guid _test_sha1     = AST_GUID_CERT_SHA1;
+static const ast_guid _test_x509     = AST_GUID_CERT_X509;
+static const ast_guid _test_global   = AST_GUID_EFI_GLOBAL;
+static const ast_guid _test_security = AST_GUID_IMAGE_SECURITY_DATABASE;
+static const ast_guid _test_shim     = AST_GUID_SHIM_LOCK;
+static const ast_guid _test_owner    = AST_GUID_INIT (0x77fa9abd, 0x0359, 0x4d32, 0xbd, 0x60, 0x28, 0xf4, 0xe7, 0x8f, 0x78, 0x4b);
+
+/** SHA-256 ("abc"). */
+static const uint8_t _test_abc[AST_SHA256_SIZE] = {
+    0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+    0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad
+};
+
+static void _test_put32 (uint8_t *p, uint32_t v)
+{
+    for (int k = 0; k < 4; k++) {
+        p[k] = (uint8_t) (v >> (8 * k));
+    }
+}
+
+/** Append a list of n entries of entrySize bytes (owner included), the k-th signature filled by fill. */
+static size_t _test_list (uint8_t *p, const ast_guid *type, size_t headerSize, size_t entrySize, size_t n, void (*fill) (uint8_t *, size_t, size_t))
+{
+    size_t size = AST_SIGNATURE_LIST_HEADER_SIZE + headerSize + n * entrySize;
+
+    memcpy (p, type, sizeof (ast_guid));
+    _test_put32 (p + 16, (uint32_t) size);
+    _test_put32 (p + 20, (uint32_t) headerSize);
+    _test_put32 (p + 24, (uint32_t) entrySize);
+    memset (p + AST_SIGNATURE_LIST_HEADER_SIZE, 0xaa, headerSize);
+    for (size_t k = 0; k < n; k++) {
+        uint8_t *e = p + AST_SIGNATURE_LIST_HEADER_SIZE + headerSize + k * entrySize;
+
+        memcpy (e, &_test_owner, sizeof (ast_guid));
+        fill (e + sizeof (ast_guid), entrySize - sizeof (ast_guid), k);
+    }
+    return size;
+}
+
+/** Digest k: the first eight bytes are the same for all, so that every lookup probes past collisions. */
+static void _test_digest (uint8_t *p, size_t size, size_t k)
+{
+    memset (p, 0x5a, size);
+    _test_put32 (p + 8, (uint32_t) k);
+}
+
+static void _test_abc_digest (uint8_t *p, size_t size, size_t k)
+{
+    (void) k;
+    memcpy (p, _test_abc, size);
+}
+
+/** Certificate k: a DER SEQUENCE header, then bytes that tell the certificates apart. */
+static void _test_cert (uint8_t *p, size_t size, size_t k)
+{
+    p[0] = 0x30;
+    p[1] = (uint8_t) (size - 2);
+    memset (p + 2, (int) ('A' + k), size - 2);
+}
+
+/** A db of three lists: two digests, two certificates, then one SHA-1 hash that is not indexed. */
+static size_t _test_db (uint8_t *buf)
+{
+    size_t n = 0;
+
+    n += _test_list (buf + n, &_test_sha256, 0, 16 + AST_SHA256_SIZE, 1, _test_abc_digest);
+    n += _test_list (buf + n, &_test_sha256, 0, 16 + AST_SHA256_SIZE, 1, _test_digest);
+    n += _test_list (buf + n, &_test_x509, 0, 16 + 40, 2, _test_cert);
+    n += _test_list (buf + n, &_test_sha1, 0, 16 + 20, 1, _test_digest);
+    return n;
+}
+
+static void _test_walk (void)
+{
+    uint8_t buf[1024];
+    size_t  size = _test_db (buf);
+    struct ast_siglist_iter iter;
+    struct ast_siglist list;
+    struct ast_sig sig;
+    size_t n = 0;
+
+    CHECK (size == 76 + 76 + 140 + 64);
+    CHECK (ast_siglist_validate (buf, size, &n) == AST_RETURN_SUCCESS);
+    CHECK (n == 5);
+    CHECK (ast_siglist_validate (buf, 0, &n) == AST_RETURN_SUCCESS);
+    CHECK (n == 0);
+
+    ast_siglist_iter_init (&iter, buf, size);
+    CHECK (ast_siglist_next (&iter, &list) == 1);
+    CHECK (ast_guid_equal (&(list.type), &_test_sha256) && (list.nEntries == 1) && (list.entrySize == 48));
+    ast_siglist_entry (&list, 0, &sig);
+    CHECK (ast_guid_equal (&(sig.owner), &_test_owner) && (sig.size == AST_SHA256_SIZE));
+    CHECK ((sig.data == buf + 28 + 16) && (memcmp (sig.data, _test_abc, AST_SHA256_SIZE) == 0));
+    CHECK (ast_siglist_next (&iter, &list) == 1);
+    CHECK (ast_siglist_next (&iter, &list) == 1);
+    CHECK (ast_guid_equal (&(list.type), &_test_x509) && (list.nEntries == 2));
+    ast_siglist_entry (&list, 1, &sig);
+    CHECK ((sig.size == 40) && (sig.data == buf + 152 + 28 + 56 + 16) && (sig.data[2] == 'B'));
+    CHECK (ast_siglist_next (&iter, &list) == 1);
+    CHECK (ast_guid_equal (&(list.type), &_test_sha1) && (list.nEntries == 1));
+    CHECK (ast_siglist_next (&iter, &list) == 0);
+}
+
+static void _test_index (void)
+{
+    uint8_t buf[1024];
+    uint8_t digest[AST_SHA256_SIZE];
+    uint8_t cert[40];
+    size_t  size = _test_db (buf);
+    struct ast_sigdb db;
+
+    ast_sigdb_init (&db);
+    CHECK (!ast_sigdb_has_sha256 (&db, _test_abc));
+
+    CHECK (ast_sigdb_add (&db, buf, size) == AST_RETURN_SUCCESS);
+    CHECK ((db.count == 4) && (db.nSkipped == 1));
+    CHECK (ast_sigdb_has_sha256 (&db, _test_abc));
+    _test_digest (digest, sizeof (digest), 0);
+    CHECK (ast_sigdb_has_sha256 (&db, digest));
+    _test_digest (digest, sizeof (digest), 1);
+    CHECK (!ast_sigdb_has_sha256 (&db, digest));
+
+    _test_cert (cert, sizeof (cert), 1);
+    CHECK (ast_sigdb_has_x509 (&db, cert, sizeof (cert)));
+    CHECK (!ast_sigdb_has_x509 (&db, cert, sizeof (cert) - 1));
+    _test_cert (cert, sizeof (cert), 2);
+    CHECK (!ast_sigdb_has_x509 (&db, cert, sizeof (cert)));
+    // The same bytes as a listed digest, asked as a certificate, are not a match.
+    CHECK (!ast_sigdb_has_x509 (&db, _test_abc, AST_SHA256_SIZE));
+
+    // Adding the same database again indexes duplicates once.
+    CHECK (ast_sigdb_add (&db, buf, size) == AST_RETURN_SUCCESS);
+    CHECK (db.count == 4);
+
+    ast_sigdb_free (&db);
+    CHECK ((db.count == 0) && !ast_sigdb_has_sha256 (&db, _test_abc));
+}
+
+/** Enough digests, all of the same hash, to grow the table several times and probe long chains. */
+static void _test_grow (void)
+{
+    size_t  bufSiz = AST_SIGNATURE_LIST_HEADER_SIZE + NDIGESTS * (16 + AST_SHA256_SIZE);
+    uint8_t *buf = malloc (bufSiz);
+    uint8_t digest[AST_SHA256_SIZE];
+    struct ast_sigdb db;
+    int     ok = 1;
+
+    if (!CHECK (buf != NULL)) {
+        return;
+    }
+    _test_list (buf, &_test_sha256, 0, 16 + AST_SHA256_SIZE, NDIGESTS, _test_digest);
+
+    ast_sigdb_init (&db);
+    CHECK (ast_sigdb_add (&db, buf, bufSiz) == AST_RETURN_SUCCESS);
+    CHECK ((db.count == NDIGESTS) && (db.cap >= 2 * NDIGESTS));
+    for (size_t k = 0; k <= NDIGESTS; k++) {
+        _test_digest (digest, sizeof (digest), k);
+        ok &= (ast_sigdb_has_sha256 (&db, digest) == (k < NDIGESTS));
+    }
+    CHECK (ok);
+    ast_sigdb_free (&db);
+    free (buf);
+}
+
+static void _test_verdict (void)
+{
+    uint8_t buf[1024];
+    uint8_t dbxBuf[128];
+    uint8_t digest[AST_SHA256_SIZE];
+    struct ast_sigdb db, dbx;
+
+    ast_sigdb_init (&db);
+    ast_sigdb_init (&dbx);
+    ast_sigdb_add (&db, buf, _test_db (buf));
+    ast_sigdb_add (&dbx, dbxBuf, _test_list (dbxBuf, &_test_sha256, 0, 16 + AST_SHA256_SIZE, 1, _test_abc_digest));
+
+    _test_digest (digest, sizeof (digest), 0);
+    CHECK (ast_sigdb_check_sha256 (&db, &dbx, digest) == AST_SIGDB_ALLOWED);
+    CHECK (ast_sigdb_check_sha256 (&db, &dbx, _test_abc) == AST_SIGDB_FORBIDDEN);
+    CHECK (ast_sigdb_check_sha256 (&db, NULL, _test_abc) == AST_SIGDB_ALLOWED);
+    CHECK (ast_sigdb_check_sha256 (NULL, NULL, _test_abc) == AST_SIGDB_UNKNOWN);
+    _test_digest (digest, sizeof (digest), 7);
+    CHECK (ast_sigdb_check_sha256 (&db, &dbx, digest) == AST_SIGDB_UNKNOWN);
+
+    ast_sigdb_free (&db);
+    ast_sigdb_free (&dbx);
+}
+
+/** Every prefix that does not end on a list boundary, each in a buffer of its exact size. */
+static void _test_truncated (void)
+{
+    uint8_t buf[1024];
+    size_t  size = _test_db (buf);
+
+    for (size_t len = 1; len < size; len++) {
+        uint8_t *p = malloc (len);
+        struct ast_sigdb db;
+        int boundary = (len == 76) || (len == 152) || (len == 292);
+        int ok = 1;
+
+        if (!CHECK (p != NULL)) {
+            return;
+        }
+        memcpy (p, buf, len);
+        ast_sigdb_init (&db);
+        ok &= (ast_siglist_validate (p, len, NULL) == (boundary ? AST_RETURN_SUCCESS : AST_RETURN_INVALID_PARAMETER));
+        ok &= (ast_sigdb_add (&db, p, len) == (boundary ? AST_RETURN_SUCCESS : AST_RETURN_INVALID_PARAMETER));
+        // A malformed database indexes nothing, not even its sound first lists.
+        ok &= boundary || (db.count == 0);
+        if (!CHECK (ok)) {
+            fprintf (stderr, "sigdb: prefix of %zu bytes\n", len);
+        }
+        ast_sigdb_free (&db);
+        free (p);
+    }
+}
+
+/** Lists whose sizes run into the next list or past the end, or do not add up. */
+static void _test_malformed (void)
+{
+    uint8_t buf[1024];
+    size_t  size = _test_db (buf);
+    uint8_t bad[1024];
+
+    // ListSize past the end of the database.
+    memcpy (bad, buf, size);
+    _test_put32 (bad + 152 + 16, 140 + 64 + 1);
+    CHECK (ast_siglist_validate (bad, size, NULL) == AST_RETURN_INVALID_PARAMETER);
+
+    // ListSize taking in the next list: its entries no longer divide the rest.
+    memcpy (bad, buf, size);
+    _test_put32 (bad + 16, 76 + 76);
+    CHECK (ast_siglist_validate (bad, size, NULL) == AST_RETURN_INVALID_PARAMETER);
+
+    // ListSize below the list header, zero included, which would otherwise never advance.
+    memcpy (bad, buf, size);
+    _test_put32 (bad + 16, 0);
+    CHECK (ast_siglist_validate (bad, size, NULL) == AST_RETURN_INVALID_PARAMETER);
+    _test_put32 (bad + 16, AST_SIGNATURE_LIST_HEADER_SIZE - 1);
+    CHECK (ast_siglist_validate (bad, size, NULL) == AST_RETURN_INVALID_PARAMETER);
+
+    // SignatureHeaderSize overlapping the entries, or past the list.
+    memcpy (bad, buf, size);
+    _test_put32 (bad + 20, 20);
+    CHECK (ast_siglist_validate (bad, size, NULL) == AST_RETURN_INVALID_PARAMETER);
+    _test_put32 (bad + 20, 49);
+    CHECK (ast_siglist_validate (bad, size, NULL) == AST_RETURN_INVALID_PARAMETER);
+    _test_put32 (bad + 20, 0xffffffff);
+    CHECK (ast_siglist_validate (bad, size, NULL) == AST_RETURN_INVALID_PARAMETER);
+
+    // SignatureSize smaller than the owner GUID, zero included.
+    memcpy (bad, buf, size);
+    _test_put32 (bad + 24, 0);
+    CHECK (ast_siglist_validate (bad, size, NULL) == AST_RETURN_INVALID_PARAMETER);
+    _test_put32 (bad + 24, 15);
+    CHECK (ast_siglist_validate (bad, size, NULL) == AST_RETURN_INVALID_PARAMETER);
+
+    // A SHA-256 list whose entries are not digests is sound, but not indexed.
+    memcpy (bad, buf, size);
+    _test_put32 (bad + 20, 16);
+    _test_put32 (bad + 24, 32);
+    {
+        struct ast_sigdb db;
+
+        ast_sigdb_init (&db);
+        CHECK (ast_sigdb_add (&db, bad, size) == AST_RETURN_SUCCESS);
+        CHECK ((db.count == 3) && (db.nSkipped == 2));
+        CHECK (!ast_sigdb_has_sha256 (&db, _test_abc));
+        ast_sigdb_free (&db);
+    }
+}
+
+static void _test_names (void)
+{
+    CHECK (ast_siglist_is_database (&_test_global, "PK"));
+    CHECK (ast_siglist_is_database (&_test_global, "dbxDefault"));
+    CHECK (!ast_siglist_is_database (&_test_global, "db"));
+    CHECK (ast_siglist_is_database (&_test_security, "dbx"));
+    CHECK (!ast_siglist_is_database (&_test_security, "PK"));
+    CHECK (ast_siglist_is_database (&_test_shim, "MokListRT"));
+    CHECK (!ast_siglist_is_database (&_test_shim, "SbatLevel"));
+    CHECK (!ast_siglist_is_database (&_test_owner, "db"));
+}
+
+int main (void)
+{
+    check_init ("sigdb");
+
+    _test_walk ();
+    _test_index ();
+    _test_grow ();
+    _test_verdict ();
+    _test_truncated ();
+    _test_malformed ();
+    _test_names ();
+
+    return check_finish ();
+}
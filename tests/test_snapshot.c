@@ -0,0 +1,145 @@
+/**
+ * @file test_snapshot.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file checks capturing an emulated store into snapshot files, opening them, looking variables up,
+ * serving one as a read-only backend and comparing two of them.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "../src/firmware/firmware.h"
+#include "../src/firmware/backend.h"
+#include "../src/snapshot/snapshot.h"
+#include "../src/snapshot/diff.h"
+#include "check.h"
+
+#define ATTR (AST_EFIVAR_NON_VOLATILE | AST_EFIVAR_BOOTSERVICE_ACCESS | AST_EFIVAR_RUNTIME_ACCESS)
+
+static const char *_test_before = "test_snapshot_before.snap";
+static const char *_test_after  = "test_snapshot_after.snap";
+static const ast_guid _test_guid = AST_GUID_EFI_GLOBAL;
+
+static void _test_capture (void)
+{
+    size_t n = 0;
+
+    CHECK (ast_write_efivar_guid ("same", 4, &_test_guid, "Same", ATTR) == AST_RETURN_SUCCESS);
+    CHECK (ast_write_efivar_guid ("old", 3, &_test_guid, "Changed", ATTR) == AST_RETURN_SUCCESS);
+    CHECK (ast_write_efivar_guid ("old", 3, &_test_guid, "Removed", ATTR) == AST_RETURN_SUCCESS);
+    CHECK (ast_snapshot_capture (_test_before, &n) == AST_RETURN_SUCCESS);
+    CHECK (n == 3);
+
+    CHECK (ast_write_efivar_guid ("new", 3, &_test_guid, "Changed", ATTR) == AST_RETURN_SUCCESS);
+    CHECK (ast_write_efivar_guid (NULL, 0, &_test_guid, "Removed", 0) == AST_RETURN_SUCCESS);
+    CHECK (ast_write_efivar_guid ("new", 3, &_test_guid, "Added", ATTR) == AST_RETURN_SUCCESS);
+    CHECK (ast_snapshot_capture (_test_after, &n) == AST_RETURN_SUCCESS);
+    CHECK (n == 3);
+}
+
+static void _test_open (void)
+{
+    struct ast_snapshot *snap = NULL;
+    struct ast_snapshot_var var;
+
+    if (!CHECK (ast_snapshot_open (_test_before, AST_SNAPSHOT_VERIFY, &snap) == AST_RETURN_SUCCESS)) {
+        return;
+    }
+    CHECK (ast_snapshot_count (snap) == 3);
+    CHECK (ast_snapshot_find (snap, &_test_guid, "Changed", &var) == AST_RETURN_SUCCESS);
+    CHECK ((var.size == 3) && (memcmp (var.data, "old", 3) == 0) && (var.attr == ATTR));
+    CHECK (ast_snapshot_find (snap, &_test_guid, "Added", &var) == AST_RETURN_NOT_FOUND);
+    for (size_t i = 0; i < ast_snapshot_count (snap); i++) {
+        struct ast_snapshot_var found;
+
+        CHECK (ast_snapshot_get (snap, i, &var) == AST_RETURN_SUCCESS);
+        CHECK (ast_snapshot_find (snap, &var.guid, var.name, &found) == AST_RETURN_SUCCESS);
+        CHECK (found.data == var.data);
+    }
+    ast_snapshot_close (snap);
+}
+
+static void _test_backend (void)
+{
+    struct ast_efivar_backend *backend = ast_efivar_backend_snapshot_new (_test_before);
+    struct ast_efivar_backend *previous = ast_efivar_backend_get ();
+    char   buf[16];
+    size_t n = 0;
+
+    if (!CHECK (backend != NULL)) {
+        return;
+    }
+    ast_efivar_backend_set (backend);
+    CHECK (ast_read_efivar_guid (buf, sizeof (buf), &_test_guid, "Removed", &n, NULL) == AST_RETURN_SUCCESS);
+    CHECK ((n == 3) && (memcmp (buf, "old", 3) == 0));
+    CHECK (ast_write_efivar_guid ("x", 1, &_test_guid, "Removed", ATTR) != AST_RETURN_SUCCESS);
+    ast_efivar_backend_set (previous);
+    ast_efivar_backend_free (backend);
+}
+
+static void _test_diff (unsigned int flags)
+{
+    struct ast_snapshot *a = NULL, *b = NULL;
+    struct ast_snapshot_diff diff;
+    int added = 0, removed = 0, modified = 0;
+
+    if (!CHECK (ast_snapshot_open (_test_before, 0, &a) == AST_RETURN_SUCCESS) ||
+        !CHECK (ast_snapshot_open (_test_after, 0, &b) == AST_RETURN_SUCCESS) ||
+        !CHECK (ast_snapshot_diff (a, b, flags, &diff) == AST_RETURN_SUCCESS)) {
+        ast_snapshot_close (a);
+        ast_snapshot_close (b);
+        return;
+    }
+
+    CHECK (diff.nChanges == 3);
+    for (size_t i = 0; i < diff.nChanges; i++) {
+        const struct ast_snapshot_change *c = &(diff.changes[i]);
+
+        switch (c->type) {
+            case AST_SNAPSHOT_ADDED:
+                added++;
+                CHECK (strcmp (c->after.name, "Added") == 0);
+                break;
+            case AST_SNAPSHOT_REMOVED:
+                removed++;
+                CHECK (strcmp (c->before.name, "Removed") == 0);
+                break;
+            case AST_SNAPSHOT_MODIFIED:
+                modified++;
+                CHECK (strcmp (c->after.name, "Changed") == 0);
+                CHECK ((c->kind == AST_SNAPSHOT_KIND_RAW) && (c->fields == AST_SNAPSHOT_FIELD_DATA));
+                break;
+        }
+    }
+    CHECK ((added == 1) && (removed == 1) && (modified == 1));
+
+    ast_snapshot_diff_free (&diff);
+    ast_snapshot_close (a);
+    ast_snapshot_close (b);
+}
+
+int main (void)
+{
+    struct ast_efivar_backend *backend = ast_efivar_backend_emu_new (NULL, NULL);
+
+    check_init ("snapshot");
+    if (!CHECK (backend != NULL)) {
+        return check_finish ();
+    }
+    ast_efivar_backend_set (backend);
+
+    _test_capture ();
+    _test_open ();
+    _test_backend ();
+    _test_diff (0);
+    _test_diff (AST_SNAPSHOT_DIFF_TRUST_HASH);
+
+    ast_efivar_backend_set (NULL);
+    ast_efivar_backend_free (backend);
+    remove (_test_before);
+    remove (_test_after);
+    return check_finish ();
+}
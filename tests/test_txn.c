@@ -0,0 +1,111 @@
+/**
+ * @file test_txn.c
+ * @version 0.3
+ * @author Junde Yhi <lmy441900@gmail.com>
+ * @copyright (C) 2012-2017 Anthon Open Source Community Development Hub
+ * @copyright This program is licensed under GNU Lesser General Public License. See LICENSE file for details.
+ *
+ * This file checks variable write transactions against an emulated store in memory: a commit writes only
+ * what changes, and a failed write rolls back the writes before it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "../src/firmware/firmware.h"
+#include "../src/firmware/backend.h"
+#include "check.h"
+
+#define ATTR (AST_EFIVAR_NON_VOLATILE | AST_EFIVAR_BOOTSERVICE_ACCESS | AST_EFIVAR_RUNTIME_ACCESS)
+
+/** Largest name and value the store takes at once; larger writes fail. */
+#define MAX_VARIABLE_SIZE 128
+
+static const ast_guid _test_guid = AST_GUID_EFI_GLOBAL;
+
+/** Check that a variable holds value, or does not exist if value is NULL. */
+static int _test_value (const char *name, const char *value)
+{
+    char   buf[MAX_VARIABLE_SIZE];
+    size_t n = 0;
+    int    ret = ast_read_efivar_guid (buf, sizeof (buf), &_test_guid, name, &n, NULL);
+
+    if (value == NULL) {
+        return ret == AST_RETURN_NOT_FOUND;
+    }
+    return (ret == AST_RETURN_SUCCESS) && (n == strlen (value)) && (memcmp (buf, value, n) == 0);
+}
+
+static void _test_commit (struct ast_efivar_backend *backend)
+{
+    struct ast_efivar_txn *txn = NULL;
+    struct ast_efivar_emu_stats before, after;
+    size_t nWritten = 99;
+
+    CHECK (ast_write_efivar_guid ("old", 3, &_test_guid, "Kept", ATTR) == AST_RETURN_SUCCESS);
+    CHECK (ast_write_efivar_guid ("old", 3, &_test_guid, "Changed", ATTR) == AST_RETURN_SUCCESS);
+    CHECK (ast_write_efivar_guid ("old", 3, &_test_guid, "Deleted", ATTR) == AST_RETURN_SUCCESS);
+
+    ast_efivar_backend_emu_stats (backend, &before);
+    CHECK (ast_efivar_txn_begin (&txn) == AST_RETURN_SUCCESS);
+    CHECK (ast_efivar_txn_put (txn, "old", 3, &_test_guid, "Kept", ATTR) == AST_RETURN_SUCCESS);
+    CHECK (ast_efivar_txn_put (txn, "first", 5, &_test_guid, "Changed", ATTR) == AST_RETURN_SUCCESS);
+    CHECK (ast_efivar_txn_put (txn, "new", 3, &_test_guid, "Changed", ATTR) == AST_RETURN_SUCCESS); // Last one wins
+    CHECK (ast_efivar_txn_put (txn, "new", 3, &_test_guid, "Boot0001", ATTR) == AST_RETURN_SUCCESS);
+    CHECK (ast_efivar_txn_delete (txn, &_test_guid, "Deleted") == AST_RETURN_SUCCESS);
+    CHECK (ast_efivar_txn_delete (txn, &_test_guid, "Absent") == AST_RETURN_SUCCESS);
+    CHECK (ast_efivar_txn_commit (txn, &nWritten) == AST_RETURN_SUCCESS);
+    ast_efivar_backend_emu_stats (backend, &after);
+
+    // The unchanged value and the absent variable are skipped.
+    CHECK (nWritten == 3);
+    CHECK (after.writes - before.writes == 3);
+    CHECK (_test_value ("Kept", "old"));
+    CHECK (_test_value ("Changed", "new"));
+    CHECK (_test_value ("Boot0001", "new"));
+    CHECK (_test_value ("Deleted", NULL));
+    CHECK (_test_value ("Absent", NULL));
+}
+
+static void _test_rollback (void)
+{
+    struct ast_efivar_txn *txn = NULL;
+    char   big[MAX_VARIABLE_SIZE] = {0};
+    size_t nWritten = 99;
+
+    CHECK (ast_write_efivar_guid ("before", 6, &_test_guid, "Rolled", ATTR) == AST_RETURN_SUCCESS);
+
+    // Load options are written first, so the option and the first value are both written before the
+    // oversized write fails.
+    CHECK (ast_efivar_txn_begin (&txn) == AST_RETURN_SUCCESS);
+    CHECK (ast_efivar_txn_put (txn, "after", 5, &_test_guid, "Rolled", ATTR) == AST_RETURN_SUCCESS);
+    CHECK (ast_efivar_txn_put (txn, "option", 6, &_test_guid, "Boot0002", ATTR) == AST_RETURN_SUCCESS);
+    CHECK (ast_efivar_txn_put (txn, big, sizeof (big), &_test_guid, "TooBig", ATTR) == AST_RETURN_SUCCESS);
+    CHECK (ast_efivar_txn_commit (txn, &nWritten) != AST_RETURN_SUCCESS);
+
+    CHECK (nWritten == 0);
+    CHECK (_test_value ("Rolled", "before"));
+    CHECK (_test_value ("Boot0002", NULL));
+    CHECK (_test_value ("TooBig", NULL));
+}
+
+int main (void)
+{
+    struct ast_efivar_emu_config config;
+    struct ast_efivar_backend *backend = NULL;
+
+    check_init ("txn");
+    memset (&config, 0, sizeof (config));
+    config.maxVariableSiz = MAX_VARIABLE_SIZE;
+    backend = ast_efivar_backend_emu_new (NULL, &config);
+    if (!CHECK (backend != NULL)) {
+        return check_finish ();
+    }
+    ast_efivar_backend_set (backend);
+
+    _test_commit (backend);
+    _test_rollback ();
+
+    ast_efivar_backend_set (NULL);
+    ast_efivar_backend_free (backend);
+    return check_finish ();
+}